@@ -0,0 +1,209 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifdef ENABLE_DECODE
+#include <libsigrokdecode/libsigrokdecode.h> /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <getopt.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+#include "pv/batchprocessor.h"
+
+#include "config.h"
+
+using std::string;
+using std::vector;
+
+void usage()
+{
+	fprintf(stdout,
+		"Usage:\n"
+		"  %s-cli [OPTION…] FILE… — Convert and decode session files\n"
+		"\n"
+		"Processing Options:\n"
+		"  -O, --output-format <id>        Write the samples with an output module\n"
+		"  -o, --output-dir <dir>          Write the outputs to a directory\n"
+		"  -P, --protocol-decoders <spec>  Decode, id[:channel=probe|option=value]...[,id...]\n"
+		"  -j, --jobs <n>                  Number of files processed at once\n"
+		"\n"
+		"Help Options:\n"
+		"  -l, --loglevel                  Set libsigrok/libsigrokdecode loglevel\n"
+		"  -V, --version                   Show release version\n"
+		"  -h, -?, --help                  Show help option\n"
+		"\n"
+		"Output modules:", DS_BIN_NAME);
+
+	for (const sr_output_module **m = sr_output_list(); *m; m++)
+		fprintf(stdout, " %s", (*m)->id);
+	fprintf(stdout, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+	struct sr_context *sr_ctx = NULL;
+	vector<string> output_ids;
+	vector<string> decoder_specs;
+	string output_dir = ".";
+	unsigned int jobs = boost::thread::hardware_concurrency();
+
+	// Parse arguments
+	while (1) {
+		static const struct option long_options[] = {
+			{"output-format", required_argument, 0, 'O'},
+			{"output-dir", required_argument, 0, 'o'},
+			{"protocol-decoders", required_argument, 0, 'P'},
+			{"jobs", required_argument, 0, 'j'},
+			{"loglevel", required_argument, 0, 'l'},
+			{"version", no_argument, 0, 'V'},
+			{"help", no_argument, 0, 'h'},
+			{0, 0, 0, 0}
+		};
+
+		const int c = getopt_long(argc, argv,
+			"O:o:P:j:l:Vh?", long_options, NULL);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'O':
+			output_ids.push_back(optarg);
+			break;
+
+		case 'o':
+			output_dir = optarg;
+			break;
+
+		case 'P':
+			decoder_specs.push_back(optarg);
+			break;
+
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+
+		case 'l':
+		{
+			const int loglevel = atoi(optarg);
+			sr_log_loglevel_set(loglevel);
+
+#ifdef ENABLE_DECODE
+			srd_log_loglevel_set(loglevel);
+#endif
+
+			break;
+		}
+
+		case 'V':
+			// Print version info
+			fprintf(stdout, "%s %s\n", DS_TITLE, DS_VERSION_STRING);
+			return 0;
+
+		case 'h':
+		case '?':
+			usage();
+			return 0;
+		}
+	}
+
+	if (argc == optind) {
+		fprintf(stderr, "No file given.\n");
+		return 1;
+	}
+	const vector<string> file_names(argv + optind, argv + argc);
+
+	if (output_ids.empty() && decoder_specs.empty()) {
+		fprintf(stderr, "Nothing to do, give an output format or a "
+			"protocol decoder.\n");
+		return 1;
+	}
+
+	// Initialise libsigrok
+	if (sr_init(&sr_ctx) != SR_OK) {
+		fprintf(stderr, "ERROR: libsigrok init failed.\n");
+		return 1;
+	}
+
+	do {
+
+#ifdef ENABLE_DECODE
+		// Initialise libsigrokdecode
+		if (srd_init(NULL) != SRD_OK) {
+			fprintf(stderr, "ERROR: libsigrokdecode init failed.\n");
+			ret = 1;
+			break;
+		}
+
+		// Load the protocol decoders
+		srd_decoder_load_all();
+#endif
+
+		try {
+			vector<pv::BatchProcessor::DecoderStack> decoders;
+			BOOST_FOREACH(const string &spec, decoder_specs)
+				decoders.push_back(
+					pv::BatchProcessor::parse_decoder_stack(spec));
+
+			pv::BatchProcessor processor(output_ids, output_dir,
+				decoders);
+			const vector<pv::BatchProcessor::Result> results =
+				processor.run(file_names, jobs);
+
+			unsigned int failed = 0;
+			BOOST_FOREACH(const pv::BatchProcessor::Result &r, results)
+				if (!r.error.empty())
+					failed++;
+			fprintf(stdout, "%u of %u files processed.\n",
+				(unsigned int)results.size() - failed,
+				(unsigned int)results.size());
+			if (failed)
+				ret = 1;
+		} catch(const std::exception &e) {
+			fprintf(stderr, "%s\n", e.what());
+			ret = 1;
+		}
+
+#ifdef ENABLE_DECODE
+		// Destroy libsigrokdecode
+		srd_exit();
+#endif
+
+	} while (0);
+
+	// Destroy libsigrok
+	if (sr_ctx)
+		sr_exit(sr_ctx);
+
+	return ret;
+}
@@ -48,6 +48,9 @@ void usage()
 		"\n"
 		"Help Options:\n"
 		"  -l, --loglevel                  Set libsigrok/libsigrokdecode loglevel\n"
+		"  -m, --metrics-log FILE          Append the acquisition metrics to FILE every second\n"
+		"  -d, --demo-devices N            Simulate N demo devices\n"
+		"  -s, --sync                      Capture with all devices of the selected one's driver\n"
 		"  -V, --version                   Show release version\n"
 		"  -h, -?, --help                  Show help option\n"
 		"\n", DS_BIN_NAME, DS_DESCRIPTION);
@@ -58,6 +61,9 @@ int main(int argc, char *argv[])
 	int ret = 0;
 	struct sr_context *sr_ctx = NULL;
 	const char *open_file = NULL;
+	const char *metrics_log = NULL;
+	unsigned int demo_devices = 1;
+	bool sync_capture = false;
 
 	QApplication a(argc, argv);
 
@@ -81,13 +87,16 @@ int main(int argc, char *argv[])
 	while (1) {
 		static const struct option long_options[] = {
 			{"loglevel", required_argument, 0, 'l'},
+			{"metrics-log", required_argument, 0, 'm'},
+			{"demo-devices", required_argument, 0, 'd'},
+			{"sync", no_argument, 0, 's'},
 			{"version", no_argument, 0, 'V'},
 			{"help", no_argument, 0, 'h'},
 			{0, 0, 0, 0}
 		};
 
 		const int c = getopt_long(argc, argv,
-			"l:Vh?", long_options, NULL);
+			"l:m:d:sVh?", long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -104,6 +113,18 @@ int main(int argc, char *argv[])
 			break;
 		}
 
+		case 'm':
+			metrics_log = optarg;
+			break;
+
+		case 'd':
+			demo_devices = atoi(optarg);
+			break;
+
+		case 's':
+			sync_capture = true;
+			break;
+
 		case 'V':
 			// Print version info
 			fprintf(stdout, "%s %s\n", DS_TITLE, DS_VERSION_STRING);
@@ -144,6 +165,7 @@ int main(int argc, char *argv[])
 		try {
 			// Create the device manager, initialise the drivers
 			pv::DeviceManager device_manager(sr_ctx);
+			device_manager.set_demo_devices(demo_devices);
 
 			// Initialise the main window
             		pv::MainWindow w(device_manager, open_file);
@@ -151,6 +173,11 @@ int main(int argc, char *argv[])
             		qss.open(QFile::ReadOnly);
             		a.setStyleSheet(qss.readAll());
             		qss.close();
+			if (metrics_log && !w.start_metrics_log(
+					QString::fromLocal8Bit(metrics_log)))
+				qDebug() << "ERROR: cannot open" << metrics_log;
+			if (sync_capture)
+				w.set_sync_capture(true);
 			w.show();
 
 			// Run the application
@@ -0,0 +1,603 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifdef ENABLE_DECODE
+#include <libsigrokdecode/libsigrokdecode.h>
+#endif
+
+#include "batchprocessor.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+#include "data/logicsnapshot.h"
+#ifdef ENABLE_DECODE
+#include "data/decode/instance.h"
+#endif
+
+using boost::lock_guard;
+using boost::mutex;
+using boost::shared_ptr;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
+using std::map;
+using std::min;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+namespace pv {
+
+// The chunk length of DecoderStack, also used for the output modules
+const uint64_t BatchProcessor::ChunkSamples = 1024 * 1024;
+
+mutex BatchProcessor::_session_mutex;
+
+/**
+ * A loaded capture, which no longer depends on the session.
+ **/
+struct BatchProcessor::Capture
+{
+    Capture();
+    ~Capture();
+
+    void copy_dev_inst(const sr_dev_inst *sdi);
+
+    // The channels and mode of the device, without a driver, which
+    // is cleared after loading
+    sr_dev_inst sdi;
+    uint64_t samplerate;
+    uint16_t unit_size;
+    // Samples which came as copies instead of a mapping or blocks
+    vector<uint8_t> data;
+    shared_ptr<data::LogicSnapshot> snapshot;
+};
+
+BatchProcessor::Capture::Capture() :
+    samplerate(0),
+    unit_size(0)
+{
+    memset(&sdi, 0, sizeof(sdi));
+}
+
+BatchProcessor::Capture::~Capture()
+{
+    for (GSList *l = sdi.channels; l; l = l->next) {
+        sr_channel *const probe = (sr_channel*)l->data;
+        g_free(probe->name);
+        g_free(probe);
+    }
+    g_slist_free(sdi.channels);
+}
+
+void BatchProcessor::Capture::copy_dev_inst(const sr_dev_inst *src)
+{
+    sdi.mode = src->mode;
+    sdi.status = src->status;
+    for (const GSList *l = src->channels; l; l = l->next) {
+        sr_channel *const probe = (sr_channel*)g_memdup(l->data,
+            sizeof(sr_channel));
+        probe->name = g_strdup(probe->name);
+        probe->trigger = NULL;
+        sdi.channels = g_slist_append(sdi.channels, probe);
+    }
+}
+
+BatchProcessor::BatchProcessor(const vector<string> &output_ids,
+    const string &output_dir, const vector<DecoderStack> &decoders) :
+    _output_dir(output_dir),
+    _decoders(decoders),
+    _next(0)
+{
+    BOOST_FOREACH(const string &id, output_ids) {
+        const sr_output_module *const module =
+            sr_output_find(const_cast<char*>(id.c_str()));
+        if (!module)
+            throw runtime_error("Unknown output module: " + id);
+
+        // The modules fill in their option defaults on first use, do
+        // it here instead of in the worker threads
+        if (module->options)
+            module->options();
+        _outputs.push_back(module);
+    }
+}
+
+BatchProcessor::~BatchProcessor()
+{
+    BOOST_FOREACH(const DecoderStack &stack, _decoders)
+        BOOST_FOREACH(const Decoder &dec, stack)
+            for (map<string, GVariant*>::const_iterator i =
+                dec.options.begin(); i != dec.options.end(); i++)
+                g_variant_unref((*i).second);
+}
+
+BatchProcessor::DecoderStack BatchProcessor::parse_decoder_stack(
+    const string &spec)
+{
+    DecoderStack stack;
+
+#ifdef ENABLE_DECODE
+    gchar **const decoders = g_strsplit(spec.c_str(), ",", 0);
+    try {
+        for (gchar **d = decoders; *d; d++) {
+            gchar **const tokens = g_strsplit(*d, ":", 0);
+            Decoder dec;
+            dec.decoder = srd_decoder_get_by_id(tokens[0]);
+            if (!dec.decoder) {
+                const string id(tokens[0]);
+                g_strfreev(tokens);
+                throw runtime_error("Unknown protocol decoder: " + id);
+            }
+
+            for (gchar **t = tokens + 1; *t; t++) {
+                gchar **const kv = g_strsplit(*t, "=", 2);
+                const string key(kv[0]);
+                const string value(kv[1] ? kv[1] : "");
+                g_strfreev(kv);
+
+                bool found = false;
+                const GSList *const lists[] = {dec.decoder->channels,
+                    dec.decoder->opt_channels};
+                for (int i = 0; !found && i < 2; i++)
+                    for (const GSList *l = lists[i]; !found && l; l = l->next)
+                        if (key == ((const srd_channel*)l->data)->id) {
+                            dec.probes[key] = atoi(value.c_str());
+                            found = true;
+                        }
+
+                for (const GSList *l = dec.decoder->options; !found && l;
+                    l = l->next) {
+                    const srd_decoder_option *const opt =
+                        (const srd_decoder_option*)l->data;
+                    if (key != opt->id)
+                        continue;
+
+                    GVariant *gvar;
+                    if (g_variant_is_of_type(opt->def, G_VARIANT_TYPE("x")))
+                        gvar = g_variant_new_int64(
+                            strtoll(value.c_str(), NULL, 10));
+                    else if (g_variant_is_of_type(opt->def,
+                        G_VARIANT_TYPE("d")))
+                        gvar = g_variant_new_double(
+                            strtod(value.c_str(), NULL));
+                    else
+                        gvar = g_variant_new_string(value.c_str());
+                    dec.options[key] = g_variant_ref_sink(gvar);
+                    found = true;
+                }
+
+                if (!found) {
+                    g_strfreev(tokens);
+                    throw runtime_error("Protocol decoder " +
+                        string(dec.decoder->id) + " has no channel or " +
+                        "option " + key);
+                }
+            }
+            g_strfreev(tokens);
+
+            stack.push_back(dec);
+        }
+    } catch (...) {
+        g_strfreev(decoders);
+        BOOST_FOREACH(const Decoder &dec, stack)
+            for (map<string, GVariant*>::const_iterator i =
+                dec.options.begin(); i != dec.options.end(); i++)
+                g_variant_unref((*i).second);
+        throw;
+    }
+    g_strfreev(decoders);
+#else
+    (void)spec;
+    throw runtime_error("Built without protocol decoders");
+#endif
+
+    return stack;
+}
+
+vector<BatchProcessor::Result> BatchProcessor::run(
+    const vector<string> &file_names, unsigned int jobs)
+{
+    _results.clear();
+    BOOST_FOREACH(const string &file_name, file_names) {
+        Result result;
+        result.file_name = file_name;
+        result.samples = 0;
+        result.bytes = 0;
+        result.seconds = 0;
+        _results.push_back(result);
+    }
+    _next = 0;
+
+    boost::thread_group workers;
+    jobs = min<size_t>(std::max(jobs, 1u), _results.size());
+    for (unsigned int i = 0; i < jobs; i++)
+        workers.create_thread(boost::bind(&BatchProcessor::worker_proc, this));
+    workers.join_all();
+
+    return _results;
+}
+
+void BatchProcessor::worker_proc()
+{
+    while (true) {
+        Result *result;
+        {
+            lock_guard<mutex> lock(_queue_mutex);
+            if (_next == _results.size())
+                return;
+            result = &_results[_next++];
+        }
+
+        const ptime start = microsec_clock::universal_time();
+        try {
+            process(*result);
+        } catch (const std::exception &e) {
+            result->error = e.what();
+        }
+        result->seconds = (microsec_clock::universal_time() - start).
+            total_microseconds() * 1e-6;
+
+        print_result(*result);
+    }
+}
+
+void BatchProcessor::process(Result &result)
+{
+    Capture capture;
+    load(result.file_name, capture);
+
+    const uint64_t sample_count = capture.snapshot->get_sample_count();
+    result.samples = sample_count;
+    result.bytes = sample_count * capture.unit_size;
+
+    const string base_name = (boost::filesystem::path(_output_dir) /
+        boost::filesystem::path(result.file_name).stem()).string();
+
+    BOOST_FOREACH(const sr_output_module *module, _outputs)
+        write_output(module, capture, base_name);
+
+    BOOST_FOREACH(const DecoderStack &stack, _decoders)
+        decode(stack, capture, base_name);
+}
+
+void BatchProcessor::load(const string &file_name, Capture &capture)
+{
+    lock_guard<mutex> lock(_session_mutex);
+
+    if (sr_session_load(file_name.c_str()) != SR_OK)
+        throw runtime_error("Failed to open file");
+
+    GSList *devlist = NULL;
+    sr_session_dev_list(&devlist);
+    sr_dev_inst *const sdi = devlist ? (sr_dev_inst*)devlist->data : NULL;
+    g_slist_free(devlist);
+
+    bool ok = false;
+    if (sdi && sdi->mode == LOGIC) {
+        capture.copy_dev_inst(sdi);
+
+        GVariant *gvar;
+        if (sr_config_get(sdi->driver, sdi, NULL, NULL, SR_CONF_SAMPLERATE,
+            &gvar) == SR_OK) {
+            capture.samplerate = g_variant_get_uint64(gvar);
+            g_variant_unref(gvar);
+        }
+
+        // The session driver sends the whole capture before the
+        // session stops
+        sr_session_datafeed_callback_add(data_feed_in_proc, &capture);
+        ok = sr_session_start() == SR_OK && sr_session_run() == SR_OK;
+    }
+
+    if (sdi) {
+        sr_dev_close(sdi);
+        sr_dev_clear(sdi->driver);
+    }
+    sr_session_destroy();
+
+    if (!sdi)
+        throw runtime_error("Failed to start session");
+    if (capture.sdi.mode != LOGIC)
+        throw runtime_error("Not a logic capture");
+    if (!ok)
+        throw runtime_error("Failed to read the capture");
+
+    if (!capture.snapshot && !capture.data.empty()) {
+        sr_datafeed_logic logic;
+        logic.length = capture.data.size();
+        logic.unitsize = capture.unit_size;
+        logic.data_error = 0;
+        logic.data = &capture.data[0];
+        capture.snapshot.reset(new data::LogicSnapshot(logic,
+            logic.length / logic.unitsize, 1));
+        vector<uint8_t>().swap(capture.data);
+        if (capture.snapshot->buf_null())
+            throw runtime_error("Out of memory");
+    }
+
+    if (!capture.snapshot)
+        throw runtime_error("The capture is empty");
+}
+
+void BatchProcessor::data_feed_in_proc(const sr_dev_inst *sdi,
+    const sr_datafeed_packet *packet, void *cb_data)
+{
+    (void)sdi;
+
+    Capture &capture = *(Capture*)cb_data;
+
+    switch (packet->type) {
+    case SR_DF_META:
+        for (const GSList *l = ((const sr_datafeed_meta*)packet->payload)->
+            config; l; l = l->next) {
+            const sr_config *const src = (const sr_config*)l->data;
+            if (src->key == SR_CONF_SAMPLERATE)
+                capture.samplerate = g_variant_get_uint64(src->data);
+        }
+        break;
+
+    case SR_DF_LOGIC:
+    {
+        const sr_datafeed_logic &logic =
+            *(const sr_datafeed_logic*)packet->payload;
+        capture.unit_size = logic.unitsize;
+        capture.data.insert(capture.data.end(), (const uint8_t*)logic.data,
+            (const uint8_t*)logic.data + logic.length);
+        break;
+    }
+
+    // The snapshots keep a reference, the samples are read in place
+    case SR_DF_LOGIC_MAP:
+    {
+        const sr_datafeed_logic_map &logic_map =
+            *(const sr_datafeed_logic_map*)packet->payload;
+        capture.unit_size = logic_map.unitsize;
+        if (!capture.snapshot && capture.data.empty())
+            capture.snapshot.reset(new data::LogicSnapshot(logic_map, 1));
+        else
+            capture.data.insert(capture.data.end(), logic_map.map->data,
+                logic_map.map->data + logic_map.map->length);
+        break;
+    }
+
+    case SR_DF_LOGIC_BLOCKS:
+    {
+        const sr_datafeed_logic_blocks &logic_blocks =
+            *(const sr_datafeed_logic_blocks*)packet->payload;
+        capture.unit_size = logic_blocks.unitsize;
+        if (!capture.snapshot && capture.data.empty())
+            capture.snapshot.reset(new data::LogicSnapshot(logic_blocks, 1));
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void BatchProcessor::write_output(const sr_output_module *module,
+    const Capture &capture, const string &base_name)
+{
+    const string file_name = base_name + "." +
+        (module->exts && module->exts[0] ? module->exts[0] : module->id);
+
+    // srzip writes the file itself, the others return their output
+    GHashTable *const options = g_hash_table_new_full(g_str_hash,
+        g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+    FILE *file = NULL;
+    if (!strcmp(module->id, "srzip"))
+        g_hash_table_insert(options, g_strdup("filename"),
+            g_variant_ref_sink(g_variant_new_string(file_name.c_str())));
+    else if (!(file = fopen(file_name.c_str(), "wb"))) {
+        g_hash_table_destroy(options);
+        throw runtime_error("Failed to create " + file_name);
+    }
+
+    const sr_output *const output = sr_output_new(module, options,
+        &capture.sdi);
+    g_hash_table_destroy(options);
+    if (!output) {
+        if (file)
+            fclose(file);
+        throw runtime_error(string("Failed to start output module ") +
+            module->id);
+    }
+
+    sr_datafeed_header header;
+    header.feed_version = 1;
+    gettimeofday(&header.starttime, NULL);
+
+    sr_config samplerate;
+    samplerate.key = SR_CONF_SAMPLERATE;
+    samplerate.data = g_variant_new_uint64(capture.samplerate);
+    g_variant_ref_sink(samplerate.data);
+    sr_datafeed_meta meta;
+    meta.config = g_slist_append(NULL, &samplerate);
+
+    sr_datafeed_logic logic;
+    logic.unitsize = capture.unit_size;
+    logic.data_error = 0;
+
+    // The samples are sent in chunks as the session driver does
+    const uint64_t sample_count = capture.snapshot->get_sample_count();
+    const uint64_t chunk_count = (sample_count + ChunkSamples - 1) /
+        ChunkSamples;
+    bool ok = true;
+    for (uint64_t n = 0; ok && n < chunk_count + 3; n++) {
+        sr_datafeed_packet packet;
+        if (n == 0) {
+            packet.type = SR_DF_HEADER;
+            packet.payload = &header;
+        } else if (n == 1) {
+            packet.type = SR_DF_META;
+            packet.payload = &meta;
+        } else if (n < chunk_count + 2) {
+            const uint64_t start = (n - 2) * ChunkSamples;
+            const uint64_t end = min(start + ChunkSamples, sample_count);
+            logic.data = capture.snapshot->get_samples(start, end - 1);
+            logic.length = (end - start) * capture.unit_size;
+            packet.type = SR_DF_LOGIC;
+            packet.payload = &logic;
+        } else {
+            packet.type = SR_DF_END;
+            packet.payload = NULL;
+        }
+
+        GString *out = NULL;
+        if (sr_output_send(output, &packet, &out) != SR_OK)
+            ok = false;
+        if (out) {
+            if (file && fwrite(out->str, 1, out->len, file) != out->len)
+                ok = false;
+            g_string_free(out, TRUE);
+        }
+    }
+
+    sr_output_free(output);
+    g_slist_free(meta.config);
+    g_variant_unref(samplerate.data);
+    if (file && fclose(file) != 0)
+        ok = false;
+
+    if (!ok)
+        throw runtime_error("Failed to write " + file_name);
+}
+
+#ifdef ENABLE_DECODE
+namespace {
+
+struct AnnotationOutput
+{
+    FILE *file;
+    bool failed;
+};
+
+void annotation_callback(srd_proto_data *pdata, void *cb_data)
+{
+    assert(pdata);
+    AnnotationOutput *const out = (AnnotationOutput*)cb_data;
+
+    const srd_proto_data_annotation *const pda =
+        (const srd_proto_data_annotation*)pdata->data;
+    const char *const *const text = (const char* const*)pda->ann_text;
+    if (fprintf(out->file, "%" PRIu64 "-%" PRIu64 " %s: %s\n",
+        pdata->start_sample, pdata->end_sample,
+        pdata->pdo->di->decoder->id, text[0] ? text[0] : "") < 0)
+        out->failed = true;
+}
+
+}
+#endif
+
+void BatchProcessor::decode(const DecoderStack &stack,
+    const Capture &capture, const string &base_name)
+{
+#ifdef ENABLE_DECODE
+    assert(!stack.empty());
+
+    string file_name = base_name;
+    BOOST_FOREACH(const Decoder &dec, stack)
+        file_name += string(".") + dec.decoder->id;
+    file_name += ".txt";
+
+    AnnotationOutput out;
+    out.failed = false;
+    if (!(out.file = fopen(file_name.c_str(), "w")))
+        throw runtime_error("Failed to create " + file_name);
+
+    srd_session *session;
+    srd_session_new(&session);
+    assert(session);
+
+    // Each file decodes in a session of its own, the decoder stacks of
+    // the GUI run side by side in the same way
+    srd_decoder_inst *prev_di = NULL;
+    BOOST_FOREACH(const Decoder &dec, stack) {
+        srd_decoder_inst *const di = data::decode::create_decoder_inst(
+            session, dec.decoder, dec.options, dec.probes);
+        if (!di) {
+            srd_session_destroy(session);
+            fclose(out.file);
+            throw runtime_error("Failed to create decoder instance");
+        }
+
+        if (prev_di)
+            srd_inst_stack(session, prev_di, di);
+        prev_di = di;
+    }
+
+    srd_session_metadata_set(session, SRD_CONF_SAMPLERATE,
+        g_variant_new_uint64(capture.samplerate ? capture.samplerate : 1));
+    srd_pd_output_callback_add(session, SRD_OUTPUT_ANN,
+        annotation_callback, &out);
+    srd_session_start(session);
+
+    const uint64_t sample_count = capture.snapshot->get_sample_count();
+    bool ok = true;
+    for (uint64_t i = 0; ok && i < sample_count; i += ChunkSamples) {
+        const uint64_t end = min(i + ChunkSamples, sample_count);
+        const uint8_t *const chunk = capture.snapshot->get_samples(i, end - 1);
+        ok = srd_session_send(session, i, end, chunk,
+            (end - i) * capture.unit_size, capture.unit_size) == SRD_OK;
+    }
+
+    srd_session_destroy(session);
+
+    if (fclose(out.file) != 0 || out.failed)
+        throw runtime_error("Failed to write " + file_name);
+    if (!ok)
+        throw runtime_error("Decoder reported an error");
+#else
+    (void)stack;
+    (void)capture;
+    (void)base_name;
+#endif
+}
+
+void BatchProcessor::print_result(const Result &result)
+{
+    lock_guard<mutex> lock(_print_mutex);
+
+    if (!result.error.empty()) {
+        fprintf(stderr, "%s: %s\n", result.file_name.c_str(),
+            result.error.c_str());
+        return;
+    }
+
+    const double seconds = std::max(result.seconds, 1e-6);
+    fprintf(stdout, "%s: %" PRIu64 " samples in %.2f s, %.1f MB/s, "
+        "%.1f Msamples/s\n", result.file_name.c_str(), result.samples,
+        result.seconds, result.bytes / seconds * 1e-6,
+        result.samples / seconds * 1e-6);
+    fflush(stdout);
+}
+
+} // namespace pv
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_BATCHPROCESSOR_H
+#define DSVIEW_PV_BATCHPROCESSOR_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+struct srd_decoder;
+
+namespace pv {
+
+namespace data {
+class LogicSnapshot;
+}
+
+/**
+ * Converts and decodes session files without the GUI.
+ *
+ * Each file is loaded through the session driver, then handed to the
+ * output modules and protocol decoders. Files are taken by a pool of
+ * worker threads; libsigrok has a single session, so only loading is
+ * done one file at a time, the samples are read from the file mapping
+ * or the session file blocks while the other files are loaded.
+ **/
+class BatchProcessor
+{
+public:
+    static const uint64_t ChunkSamples;
+
+public:
+    struct Decoder
+    {
+        const srd_decoder *decoder;
+        /** Channel id to probe index. */
+        std::map<std::string, int> probes;
+        /** Option id to value, with one reference each. */
+        std::map<std::string, GVariant*> options;
+    };
+
+    /** A decoder with the decoders stacked on top of it. */
+    typedef std::vector<Decoder> DecoderStack;
+
+    struct Result
+    {
+        std::string file_name;
+        std::string error;
+        uint64_t samples;
+        uint64_t bytes;
+        double seconds;
+    };
+
+public:
+    /**
+     * @param output_ids the ids of the output modules to run.
+     * @param output_dir where the outputs are written, named after the
+     * session file.
+     * @param decoders the decoder stacks to run, which the processor
+     * takes the option references of.
+     * @throws std::runtime_error if an output module does not exist.
+     **/
+    BatchProcessor(const std::vector<std::string> &output_ids,
+        const std::string &output_dir,
+        const std::vector<DecoderStack> &decoders);
+
+    ~BatchProcessor();
+
+    /**
+     * Parses a decoder stack given as
+     * "id[:key=value]...[,id[:key=value]...]", where a key is either a
+     * channel id, mapped to a probe index, or an option id.
+     * @throws std::runtime_error on an unknown decoder, channel or
+     * option.
+     **/
+    static DecoderStack parse_decoder_stack(const std::string &spec);
+
+    /**
+     * Processes the files on a number of worker threads, a line is
+     * printed for each file when it is done.
+     * @return the results in the order of the files.
+     **/
+    std::vector<Result> run(const std::vector<std::string> &file_names,
+        unsigned int jobs);
+
+private:
+    struct Capture;
+
+    void worker_proc();
+
+    void process(Result &result);
+
+    void load(const std::string &file_name, Capture &capture);
+
+    static void data_feed_in_proc(const sr_dev_inst *sdi,
+        const sr_datafeed_packet *packet, void *cb_data);
+
+    void write_output(const sr_output_module *module,
+        const Capture &capture, const std::string &base_name);
+
+    void decode(const DecoderStack &stack, const Capture &capture,
+        const std::string &base_name);
+
+    void print_result(const Result &result);
+
+private:
+    std::vector<const sr_output_module*> _outputs;
+    const std::string _output_dir;
+    const std::vector<DecoderStack> _decoders;
+
+    /**
+     * The session and the data feed callbacks of libsigrok are global,
+     * only one file can be loaded at a time.
+     **/
+    static boost::mutex _session_mutex;
+
+    boost::mutex _queue_mutex;
+    std::vector<Result> _results;
+    size_t _next;
+
+    boost::mutex _print_mutex;
+};
+
+} // namespace pv
+
+#endif // DSVIEW_PV_BATCHPROCESSOR_H
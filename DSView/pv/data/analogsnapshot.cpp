@@ -55,6 +55,24 @@ AnalogSnapshot::AnalogSnapshot(const sr_datafeed_analog &analog, uint64_t _total
 	append_payload(analog);
 }
 
+AnalogSnapshot::AnalogSnapshot(const sr_datafeed_analog_pcm &pcm, unsigned int channel_num) :
+    Snapshot(sizeof(uint16_t)*channel_num, pcm.num_samples, channel_num)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    memset(_envelope_levels, 0, sizeof(_envelope_levels));
+    assert(pcm.map);
+    if (init(_total_sample_count) != SR_OK)
+        return;
+
+    sr_pcm_to_analog(pcm.format, pcm.map->data, (uint16_t*)_data,
+        pcm.num_samples * channel_num);
+    _sample_count = pcm.num_samples;
+    _ring_sample_count = 0;
+
+    append_payload_to_envelope_levels();
+    commit();
+}
+
 AnalogSnapshot::~AnalogSnapshot()
 {
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
@@ -70,6 +88,7 @@ void AnalogSnapshot::append_payload(
 
 	// Generate the first mip-map from the data
 	append_payload_to_envelope_levels();
+    commit();
 }
 
 const uint16_t* AnalogSnapshot::get_samples(
@@ -139,7 +158,7 @@ void AnalogSnapshot::append_payload_to_envelope_levels()
 
         // Expand the data buffer to fit the new samples
         prev_length = e0.length;
-        e0.length = get_sample_count() / EnvelopeScaleFactor;
+        e0.length = _sample_count / EnvelopeScaleFactor;
 
         // Break off if there are no new samples to compute
     //	if (e0.length == prev_length)
@@ -71,6 +71,12 @@ private:
 public:
     AnalogSnapshot(const sr_datafeed_analog &analog, uint64_t _total_sample_len, unsigned int channel_num);
 
+    /**
+     * Converts the PCM samples of a file mapping straight into the
+     * sample buffer, the snapshot is complete.
+     **/
+    AnalogSnapshot(const sr_datafeed_analog_pcm &pcm, unsigned int channel_num);
+
 	virtual ~AnalogSnapshot();
 
 	void append_payload(const sr_datafeed_analog &analog);
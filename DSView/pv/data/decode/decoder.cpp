@@ -22,6 +22,7 @@
 #include <libsigrokdecode/libsigrokdecode.h>
 
 #include "decoder.h"
+#include "instance.h"
 
 #include <pv/view/logicsignal.h>
 
@@ -135,43 +136,17 @@ set< shared_ptr<pv::data::Logic> > Decoder::get_data()
 srd_decoder_inst* Decoder::create_decoder_inst(srd_session *session, int unit_size) const
 {
     (void)unit_size;
-	GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
-		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
-
-	for (map<string, GVariant*>::const_iterator i = _options.begin();
-		i != _options.end(); i++)
-	{
-		GVariant *const value = (*i).second;
-		g_variant_ref(value);
-		g_hash_table_replace(opt_hash, (void*)g_strdup(
-			(*i).first.c_str()), value);
-	}
-
-	srd_decoder_inst *const decoder_inst = srd_inst_new(
-		session, _decoder->id, opt_hash);
-	g_hash_table_destroy(opt_hash);
-
-	if(!decoder_inst)
-		return NULL;
-
-	// Setup the probes
-	GHashTable *const probes = g_hash_table_new_full(g_str_hash,
-		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
 
+	map<string, int> probes;
 	for(map<const srd_channel*, shared_ptr<view::LogicSignal> >::
 		const_iterator i = _probes.begin();
 		i != _probes.end(); i++)
 	{
 		shared_ptr<view::LogicSignal> signal((*i).second);
-		GVariant *const gvar = g_variant_new_int32(
-			signal->probe()->index);
-		g_variant_ref_sink(gvar);
-		g_hash_table_insert(probes, (*i).first->id, gvar);
+		probes[(*i).first->id] = signal->probe()->index;
 	}
 
-    srd_inst_channel_set_all(decoder_inst, probes);
-
-	return decoder_inst;
+	return decode::create_decoder_inst(session, _decoder, _options, probes);
 }
 
 } // decode
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the DSView project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <libsigrokdecode/libsigrokdecode.h>
+
+#include "instance.h"
+
+using std::map;
+using std::string;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+srd_decoder_inst* create_decoder_inst(srd_session *session,
+    const srd_decoder *decoder,
+    const map<string, GVariant*> &options,
+    const map<string, int> &probes)
+{
+	GHashTable *const opt_hash = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+	for (map<string, GVariant*>::const_iterator i = options.begin();
+		i != options.end(); i++)
+	{
+		GVariant *const value = (*i).second;
+		g_variant_ref(value);
+		g_hash_table_replace(opt_hash, (void*)g_strdup(
+			(*i).first.c_str()), value);
+	}
+
+	srd_decoder_inst *const decoder_inst = srd_inst_new(
+		session, decoder->id, opt_hash);
+	g_hash_table_destroy(opt_hash);
+
+	if(!decoder_inst)
+		return NULL;
+
+	// Setup the probes
+	GHashTable *const probe_hash = g_hash_table_new_full(g_str_hash,
+		g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+
+	for (map<string, int>::const_iterator i = probes.begin();
+		i != probes.end(); i++)
+	{
+		GVariant *const gvar = g_variant_new_int32((*i).second);
+		g_variant_ref_sink(gvar);
+		g_hash_table_insert(probe_hash, (void*)g_strdup(
+			(*i).first.c_str()), gvar);
+	}
+
+	srd_inst_channel_set_all(decoder_inst, probe_hash);
+	g_hash_table_destroy(probe_hash);
+
+	return decoder_inst;
+}
+
+} // namespace decode
+} // namespace data
+} // namespace pv
@@ -0,0 +1,53 @@
+/*
+ * This file is part of the DSView project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_DATA_DECODE_INSTANCE_H
+#define DSVIEW_PV_DATA_DECODE_INSTANCE_H
+
+#include <map>
+#include <string>
+
+#include <glib.h>
+
+struct srd_decoder;
+struct srd_decoder_inst;
+struct srd_session;
+
+namespace pv {
+namespace data {
+namespace decode {
+
+/**
+ * Creates a decoder instance in a session, without the GUI objects, so
+ * that the decoder stacks and the command line tool share it.
+ * @param options option id to value, the values are referenced.
+ * @param probes channel id to probe index.
+ * @return NULL if the instance could not be created.
+ **/
+srd_decoder_inst* create_decoder_inst(srd_session *session,
+    const srd_decoder *decoder,
+    const std::map<std::string, GVariant*> &options,
+    const std::map<std::string, int> &probes);
+
+} // namespace decode
+} // namespace data
+} // namespace pv
+
+#endif // DSVIEW_PV_DATA_DECODE_INSTANCE_H
@@ -291,11 +291,11 @@ void DecoderStack::begin_decode()
 		return;
 
 	// Check we have a snapshot of data
-	const deque< shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-		data->get_snapshots();
-	if (snapshots.empty())
+	const shared_ptr<pv::data::LogicSnapshot> snapshot =
+		data->get_snapshot();
+	if (!snapshot)
 		return;
-	_snapshot = snapshots.front();
+	_snapshot = snapshot;
 
 	// Get the samplerate and start time
 	_start_time = data->get_start_time();
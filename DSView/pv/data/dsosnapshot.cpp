@@ -55,7 +55,8 @@ DsoSnapshot::DsoSnapshot(const sr_datafeed_dso &dso, uint64_t _total_sample_len,
 {
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	memset(_envelope_levels, 0, sizeof(_envelope_levels));
-    init(_total_sample_len);
+    // The ring of instant mode is held twice, see refill_data()
+    init(_instant ? _total_sample_len * 2 : _total_sample_len);
     append_payload(dso);
 }
 
@@ -71,21 +72,38 @@ void DsoSnapshot::append_payload(const sr_datafeed_dso &dso)
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
     if (_channel_num > 0) {
+        const uint64_t write_pos = _instant ? _ring_sample_count : 0;
+        const bool was_full = _sample_count == _total_sample_count;
         refill_data(dso.data, dso.num_samples, _instant);
 
-        // Generate the first mip-map from the data
-        if (_envelope_en)
-            append_payload_to_envelope_levels(dso.samplerate_tog);
+        // Generate the first mip-map from the data, the copy of the
+        // ring is summarised from the time it is full
+        if (!_envelope_en)
+            _envelope_done = false;
+        else if (_instant && _envelope_done && !dso.samplerate_tog &&
+            was_full == (_sample_count == _total_sample_count))
+            append_payload_to_envelope_levels(write_pos, dso.num_samples);
+        else
+            rebuild_envelope_levels();
+        commit();
     }
 }
 
 void DsoSnapshot::enable_envelope(bool enable)
 {
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
     if (!_envelope_done && enable)
-        append_payload_to_envelope_levels(true);
+        rebuild_envelope_levels();
     _envelope_en = enable;
 }
 
+void * DsoSnapshot::get_data() const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    return (uint8_t*)_data + get_ring_start() * _channel_num;
+}
+
 const uint8_t *DsoSnapshot::get_samples(
     int64_t start_sample, int64_t end_sample, uint16_t index) const
 {
@@ -103,7 +121,8 @@ const uint8_t *DsoSnapshot::get_samples(
 //    memcpy(data, (uint16_t*)_data + start_sample, sizeof(uint16_t) *
 //		(end_sample - start_sample));
 //	return data;
-    return (uint8_t*)_data + start_sample * _channel_num + index * (_channel_num != 1);
+    return (uint8_t*)_data + (get_ring_start() + start_sample) * _channel_num +
+        index * (_channel_num != 1);
 }
 
 void DsoSnapshot::get_envelope_section(EnvelopeSection &s,
@@ -119,10 +138,18 @@ void DsoSnapshot::get_envelope_section(EnvelopeSection &s,
 		LogEnvelopeScaleFactor) - 1, 0);
 	const unsigned int scale_power = (min_level + 1) *
 		EnvelopeScalePower;
-	start >>= scale_power;
-	end >>= scale_power;
 
-	s.start = start << scale_power;
+	// The levels summarise the buffer, a block which begins before
+	// the oldest sample of the ring is left out
+	const uint64_t ring_start = get_ring_start();
+	start = (ring_start + start) >> scale_power;
+	end = (ring_start + end) >> scale_power;
+	if ((start << scale_power) < ring_start)
+		start++;
+	end = max(start, min(end,
+		_envelope_levels[probe_index][min_level].length));
+
+	s.start = (start << scale_power) - ring_start;
 	s.scale = 1 << scale_power;
     //if (_envelope_levels[probe_index][min_level].length < get_sample_count() / EnvelopeScaleFactor)
     //    s.length = 0;
@@ -146,34 +173,70 @@ void DsoSnapshot::reallocate_envelope(Envelope &e)
 	}
 }
 
-void DsoSnapshot::append_payload_to_envelope_levels(bool header)
+void DsoSnapshot::rebuild_envelope_levels()
+{
+    for (unsigned int i = 0; i < _channel_num; i++)
+        for (unsigned int level = 0; level < ScaleStepCount; level++)
+            _envelope_levels[i][level].length = 0;
+
+    update_envelope_levels(0, get_buffer_sample_count());
+    _envelope_done = true;
+}
+
+void DsoSnapshot::append_payload_to_envelope_levels(uint64_t start, uint64_t samples)
+{
+    assert(start < _total_sample_count);
+
+    if (samples >= _total_sample_count) {
+        rebuild_envelope_levels();
+        return;
+    }
+
+    // The new samples may wrap around the end of the ring buffer, and
+    // are written to its copy as well
+    const uint64_t end = start + samples;
+    for (uint64_t copy = 0; copy < get_buffer_sample_count();
+        copy += _total_sample_count) {
+        if (end > _total_sample_count) {
+            update_envelope_levels(copy + start, copy + _total_sample_count);
+            update_envelope_levels(copy, copy + end - _total_sample_count);
+        } else {
+            update_envelope_levels(copy + start, copy + end);
+        }
+    }
+}
+
+void DsoSnapshot::update_envelope_levels(uint64_t start, uint64_t end)
 {
+    const uint64_t buffer_sample_count = get_buffer_sample_count();
+    end = min(end, buffer_sample_count);
+    if (start >= end)
+        return;
+
     for (unsigned int i = 0; i < _channel_num; i++) {
         Envelope &e0 = _envelope_levels[i][0];
-        uint64_t prev_length;
-        EnvelopeSample *dest_ptr;
 
-        if (header)
-            prev_length = 0;
-        else
-            prev_length = e0.length;
-        e0.length = _sample_count / EnvelopeScaleFactor;
-
-        if (e0.length == 0)
-            return;
-        if (e0.length == prev_length)
-            prev_length = 0;
+        // Every block touched by the new samples is recomputed, except
+        // for a partial block at the end of the valid data, which is
+        // summarized once its remaining samples arrive.
+        uint64_t first = start / EnvelopeScaleFactor;
+        uint64_t last = min((end + EnvelopeScaleFactor - 1) / EnvelopeScaleFactor,
+                            buffer_sample_count / EnvelopeScaleFactor);
+        if (first >= last)
+            continue;
 
         // Expand the data buffer to fit the new samples
-        reallocate_envelope(e0);
-
-        dest_ptr = e0.samples + prev_length;
+        if (last > e0.length) {
+            e0.length = last;
+            reallocate_envelope(e0);
+        }
 
         // Iterate through the samples to populate the first level mipmap
+        EnvelopeSample *dest_ptr = e0.samples + first;
         const uint8_t *const stop_src_ptr = (uint8_t*)_data +
-            e0.length * EnvelopeScaleFactor * _channel_num;
+            last * EnvelopeScaleFactor * _channel_num;
         for (const uint8_t *src_ptr = (uint8_t*)_data +
-            prev_length * EnvelopeScaleFactor * _channel_num + i;
+            first * EnvelopeScaleFactor * _channel_num + i;
             src_ptr < stop_src_ptr; src_ptr += EnvelopeScaleFactor * _channel_num)
         {
             const uint8_t * begin_src_ptr =
@@ -184,7 +247,6 @@ void DsoSnapshot::append_payload_to_envelope_levels(bool header)
             EnvelopeSample sub_sample;
             sub_sample.min = *begin_src_ptr;
             sub_sample.max = *begin_src_ptr;
-            //begin_src_ptr += _channel_num;
             while (begin_src_ptr < end_src_ptr)
             {
                 sub_sample.min = min(sub_sample.min, *begin_src_ptr);
@@ -194,29 +256,30 @@ void DsoSnapshot::append_payload_to_envelope_levels(bool header)
             *dest_ptr++ = sub_sample;
         }
 
-        // Compute higher level mipmaps
+        // Compute higher level mipmaps, only the blocks which cover
+        // the updated region of the level below are touched
         for (unsigned int level = 1; level < ScaleStepCount; level++)
         {
             Envelope &e = _envelope_levels[i][level];
             const Envelope &el = _envelope_levels[i][level-1];
 
-            // Expand the data buffer to fit the new samples
-            prev_length = e.length;
-            e.length = el.length / EnvelopeScaleFactor;
-
-            // Break off if there are no more samples to computed
-    //		if (e.length == prev_length)
-    //			break;
-            if (e.length == prev_length)
-                prev_length = 0;
+            first = first / EnvelopeScaleFactor;
+            last = min((last + EnvelopeScaleFactor - 1) / EnvelopeScaleFactor,
+                       el.length / EnvelopeScaleFactor);
+            if (first >= last)
+                break;
 
-            reallocate_envelope(e);
+            // Expand the data buffer to fit the new samples
+            if (last > e.length) {
+                e.length = last;
+                reallocate_envelope(e);
+            }
 
             // Subsample the level lower level
             const EnvelopeSample *src_ptr =
-                el.samples + prev_length * EnvelopeScaleFactor;
-            const EnvelopeSample *const end_dest_ptr = e.samples + e.length;
-            for (dest_ptr = e.samples + prev_length;
+                el.samples + first * EnvelopeScaleFactor;
+            const EnvelopeSample *const end_dest_ptr = e.samples + last;
+            for (EnvelopeSample *dest_ptr = e.samples + first;
                 dest_ptr < end_dest_ptr; dest_ptr++)
             {
                 const EnvelopeSample *const end_src_ptr =
@@ -234,7 +297,18 @@ void DsoSnapshot::append_payload_to_envelope_levels(bool header)
             }
         }
     }
-    _envelope_done = true;
+}
+
+uint64_t DsoSnapshot::get_ring_start() const
+{
+    return (_instant && _sample_count == _total_sample_count) ?
+        _ring_sample_count : 0;
+}
+
+uint64_t DsoSnapshot::get_buffer_sample_count() const
+{
+    return (_instant && _sample_count == _total_sample_count) ?
+        _total_sample_count * 2 : _sample_count;
 }
 
 double DsoSnapshot::cal_vrms(double zero_off, int index) const
@@ -248,9 +322,9 @@ double DsoSnapshot::cal_vrms(double zero_off, int index) const
     double tmp;
 
     // Iterate through the samples to populate the first level mipmap
-    const uint8_t *const stop_src_ptr = (uint8_t*)_data +
-        _sample_count * _channel_num;
-    for (const uint8_t *src_ptr = (uint8_t*)_data + index;
+    const uint8_t *const data = (uint8_t*)_data + get_ring_start() * _channel_num;
+    const uint8_t *const stop_src_ptr = data + _sample_count * _channel_num;
+    for (const uint8_t *src_ptr = data + index;
         src_ptr < stop_src_ptr; src_ptr += VrmsScaleFactor * _channel_num)
     {
         const uint8_t * begin_src_ptr =
@@ -282,9 +356,9 @@ double DsoSnapshot::cal_vmean(int index) const
     double vmean = 0;
 
     // Iterate through the samples to populate the first level mipmap
-    const uint8_t *const stop_src_ptr = (uint8_t*)_data +
-        _sample_count * _channel_num;
-    for (const uint8_t *src_ptr = (uint8_t*)_data + index;
+    const uint8_t *const data = (uint8_t*)_data + get_ring_start() * _channel_num;
+    const uint8_t *const stop_src_ptr = data + _sample_count * _channel_num;
+    for (const uint8_t *src_ptr = data + index;
         src_ptr < stop_src_ptr; src_ptr += VrmsScaleFactor * _channel_num)
     {
         const uint8_t * begin_src_ptr =
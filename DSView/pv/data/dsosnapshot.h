@@ -30,6 +30,7 @@
 
 namespace DsoSnapshotTest {
 class Basic;
+class RollOrder;
 }
 
 namespace pv {
@@ -76,6 +77,12 @@ public:
 
     void append_payload(const sr_datafeed_dso &dso);
 
+    /**
+     * Returns the samples from the oldest on, which in instant mode is
+     * where the ring was last written.
+     **/
+    void * get_data() const;
+
     const uint8_t* get_samples(int64_t start_sample,
         int64_t end_sample, uint16_t index) const;
 
@@ -90,7 +97,33 @@ public:
 private:
 	void reallocate_envelope(Envelope &l);
 
-    void append_payload_to_envelope_levels(bool header);
+    /**
+     * Recomputes all envelope levels from the samples in the buffer.
+     **/
+    void rebuild_envelope_levels();
+
+    /**
+     * Updates the envelope levels after samples were written to the
+     * ring buffer, only the blocks which cover them are recomputed.
+     * @param start the buffer position of the first new sample.
+     * @param samples the number of new samples, which may wrap around
+     * the end of the buffer.
+     **/
+    void append_payload_to_envelope_levels(uint64_t start, uint64_t samples);
+
+    void update_envelope_levels(uint64_t start, uint64_t end);
+
+    /**
+     * Returns the buffer position of the oldest sample, the readers
+     * index the samples and the envelope from there.
+     **/
+    uint64_t get_ring_start() const;
+
+    /**
+     * Returns the samples held in the buffer, which are the ring and
+     * its copy once an instant capture filled it.
+     **/
+    uint64_t get_buffer_sample_count() const;
 
 private:
     struct Envelope _envelope_levels[2*DS_MAX_DSO_PROBES_NUM][ScaleStepCount];
@@ -99,6 +132,7 @@ private:
     bool _instant;
 
     friend class DsoSnapshotTest::Basic;
+    friend class DsoSnapshotTest::RollOrder;
 };
 
 } // namespace data
@@ -46,18 +46,24 @@ const int GroupSnapshot::EnvelopeScaleFactor = 1 << EnvelopeScalePower;
 const float GroupSnapshot::LogEnvelopeScaleFactor =
 	logf(EnvelopeScaleFactor);
 const uint64_t GroupSnapshot::EnvelopeDataUnit = 64*1024;	// bytes
+const uint64_t GroupSnapshot::EnvelopeChunkLength = 1024;	// samples
 const uint16_t GroupSnapshot::value_mask[16] = {0x1, 0x2, 0x4, 0x8,
                                                 0x10, 0x20, 0x40, 0x80,
                                                 0x100, 0x200, 0x400, 0x800,
                                                 0x1000, 0x2000, 0x4000, 0x8000};
 
-GroupSnapshot::GroupSnapshot(const boost::shared_ptr<LogicSnapshot> &_logic_snapshot, std::list<int> index_list)
+GroupSnapshot::GroupSnapshot(const boost::shared_ptr<LogicSnapshot> &_logic_snapshot, std::list<int> index_list,
+    boost::function<void ()> built) :
+    _built(built),
+    _request_level(-1),
+    _request_start(0),
+    _request_end(0),
+    _logic_snapshot(_logic_snapshot)
 {
     assert(_logic_snapshot);
 
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	memset(_envelope_levels, 0, sizeof(_envelope_levels));
-    _data = _logic_snapshot->get_data();
     _sample_count = _logic_snapshot->get_sample_count();
     _unit_size = _logic_snapshot->unit_size();
     _index_list = index_list;
@@ -67,39 +73,45 @@ GroupSnapshot::GroupSnapshot(const boost::shared_ptr<LogicSnapshot> &_logic_snap
     while(j != _index_list.end())
         _mask |= value_mask[(*j++)];
 
-    for (int i=0; i<32; i++) {
-        _bubble_start[i] = -1;
-        _bubble_end[i] = -1;
+    // Compact the group channels into the low bits of each value, the
+    // shift method needs no table and is tried if the fastest one can
+    // not be set up; a group which can not be gathered stays empty
+    memset(&_gather, 0, sizeof(_gather));
+    if (sr_bitgather_init(&_gather, _mask, _unit_size, sizeof(uint16_t),
+            SR_BITGATHER_AUTO) != SR_OK &&
+        sr_bitgather_init(&_gather, _mask, _unit_size, sizeof(uint16_t),
+            SR_BITGATHER_SHIFT) != SR_OK) {
+        memset(&_gather, 0, sizeof(_gather));
+        _sample_count = 0;
+        return;
     }
-    uint16_t mask = _mask;
-    int i = 0;
-    int k = 0;
-    int zero = 0;
-    int zero_pre = 0;
-    // max bubble count: 31
-    do {
-        if (mask & 0x1) {
-            if (_bubble_start[k] != -1 &&
-                _bubble_end[k] == -1)
-                _bubble_end[k++] = i - zero_pre;
-        } else {
-            if (_bubble_start[k] == -1) {
-                _bubble_start[k] = i - zero;
-                zero_pre = zero;
-            }
-            zero++;
-        }
-        i++;
-    }while(mask >>= 1);
 
-    append_payload();
+    // The envelope levels are computed on demand, only the storage is
+    // set up here, so that creating a group does not stall the caller
+    uint64_t length = _sample_count;
+    for (unsigned int level = 0; level < ScaleStepCount; level++) {
+        length /= EnvelopeScaleFactor;
+        _envelope_levels[level].length = length;
+        reallocate_envelope(_envelope_levels[level]);
+        _envelope_chunk_done[level].assign(
+            (length + EnvelopeChunkLength - 1) / EnvelopeChunkLength, false);
+    }
+
+    // Warm up the cache in the background
+    _build_thread.reset(new boost::thread(&GroupSnapshot::build_proc, this));
 }
 
 GroupSnapshot::~GroupSnapshot()
 {
+    if (_build_thread.get()) {
+        _build_thread->interrupt();
+        _build_thread->join();
+    }
+
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	BOOST_FOREACH(Envelope &e, _envelope_levels)
 		free(e.samples);
+    sr_bitgather_cleanup(&_gather);
 }
 
 uint64_t GroupSnapshot::get_sample_count() const
@@ -108,16 +120,8 @@ uint64_t GroupSnapshot::get_sample_count() const
     return _sample_count;
 }
 
-void GroupSnapshot::append_payload()
-{
-	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-
-	// Generate the first mip-map from the data
-	append_payload_to_envelope_levels();
-}
-
-const uint16_t* GroupSnapshot::get_samples(
-    int64_t start_sample, int64_t end_sample)
+void GroupSnapshot::get_samples(uint16_t *data,
+    int64_t start_sample, int64_t end_sample) const
 {
 	assert(start_sample >= 0);
 	assert(start_sample < (int64_t)_sample_count);
@@ -125,32 +129,15 @@ const uint16_t* GroupSnapshot::get_samples(
 	assert(end_sample < (int64_t)_sample_count);
 	assert(start_sample <= end_sample);
 
-    int64_t i;
-    uint16_t tmpl, tmpr;
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
-    uint16_t *const data = new uint16_t[end_sample - start_sample];
-//    memcpy(data, (uint16_t*)_data + start_sample, sizeof(uint16_t) *
-//		(end_sample - start_sample));
-//    memset(data, 0, sizeof(uint16_t) * (end_sample - start_sample));
-    for(i = start_sample; i < end_sample; i++) {
-        if (_unit_size == 2)
-            tmpl = *((uint16_t*)_data + i) & _mask;
-        else
-            tmpl = *((uint8_t*)_data + i) & _mask;
-        for(int j=0; _bubble_start[j] != -1; j++) {
-            tmpr = tmpl & (0xffff >> (16 - _bubble_start[j]));
-            tmpl >>= _bubble_end[j];
-            tmpl <<= _bubble_start[j];
-            tmpl += tmpr;
-        }
-        *(data + i - start_sample) = tmpl;
-    }
-	return data;
+    sr_bitgather_run(&_gather,
+        _logic_snapshot->get_samples(start_sample, end_sample),
+        (uint8_t*)data, end_sample - start_sample);
 }
 
-void GroupSnapshot::get_envelope_section(EnvelopeSection &s,
-	uint64_t start, uint64_t end, float min_length) const
+bool GroupSnapshot::get_envelope_section(EnvelopeSection &s,
+	uint64_t start, uint64_t end, float min_length)
 {
     assert(end <= _sample_count);
 	assert(start <= end);
@@ -165,12 +152,48 @@ void GroupSnapshot::get_envelope_section(EnvelopeSection &s,
 	start >>= scale_power;
 	end >>= scale_power;
 
-	s.start = start << scale_power;
+    // Nothing is computed on the caller's thread, the section is the
+    // first run of finished chunks and the missing ones are queued
+    const std::vector<bool> &done = _envelope_chunk_done[min_level];
+    uint64_t run_start = end, run_end = end;
+    uint64_t missing_start = end, missing_end = start;
+    for (uint64_t chunk = start / EnvelopeChunkLength;
+        chunk * EnvelopeChunkLength < end; chunk++) {
+        const uint64_t first = max(chunk * EnvelopeChunkLength, start);
+        const uint64_t last = min((chunk + 1) * EnvelopeChunkLength, end);
+        if (!done[chunk]) {
+            missing_start = min(missing_start, first);
+            missing_end = last;
+        } else if (run_start == end) {
+            run_start = first;
+            run_end = last;
+        } else if (run_end == first) {
+            run_end = last;
+        }
+    }
+
+    if (missing_start < missing_end) {
+        // Merge with the request of the same level, which may be
+        // served partly; a request of another zoom level is dropped
+        if (_request_level == (int)min_level) {
+            _request_start = min(_request_start, missing_start);
+            _request_end = max(_request_end, missing_end);
+        } else {
+            _request_level = min_level;
+            _request_start = missing_start;
+            _request_end = missing_end;
+        }
+        _build_cond.notify_one();
+    }
+
+	s.start = run_start << scale_power;
 	s.scale = 1 << scale_power;
-	s.length = end - start;
-	s.samples = new EnvelopeSample[s.length];
-	memcpy(s.samples, _envelope_levels[min_level].samples + start,
-		s.length * sizeof(EnvelopeSample));
+	s.length = run_end - run_start;
+	s.samples = _envelope_levels[min_level].samples + run_start;
+
+	// The storage never moves, so the samples can be read after the
+	// lock is released; finished chunks are not written again
+	return s.length != 0;
 }
 
 void GroupSnapshot::reallocate_envelope(Envelope &e)
@@ -185,91 +208,122 @@ void GroupSnapshot::reallocate_envelope(Envelope &e)
 	}
 }
 
-void GroupSnapshot::append_payload_to_envelope_levels()
+void GroupSnapshot::build_proc()
 {
-	Envelope &e0 = _envelope_levels[0];
-	uint64_t prev_length;
-	EnvelopeSample *dest_ptr;
+    // Finish the levels bottom-up, so that every chunk is computed from
+    // the completed level below it; the queued chunks go first
+    unsigned int level = 0;
+    uint64_t chunk = 0;
+    for (;;) {
+        boost::this_thread::interruption_point();
+
+        bool request_done = false;
+        {
+            boost::unique_lock<boost::recursive_mutex> lock(_mutex);
+            if (_request_level >= 0) {
+                const std::vector<bool> &done =
+                    _envelope_chunk_done[_request_level];
+                uint64_t c = _request_start / EnvelopeChunkLength;
+                while (c * EnvelopeChunkLength < _request_end && done[c])
+                    c++;
+
+                if (c * EnvelopeChunkLength < _request_end) {
+                    build_envelope(_request_level, c * EnvelopeChunkLength,
+                        (c + 1) * EnvelopeChunkLength);
+                    _request_start = (c + 1) * EnvelopeChunkLength;
+                } else {
+                    _request_level = -1;
+                    request_done = true;
+                }
+            } else if (level < ScaleStepCount) {
+                if (chunk < _envelope_chunk_done[level].size()) {
+                    build_envelope(level, chunk * EnvelopeChunkLength,
+                        (chunk + 1) * EnvelopeChunkLength);
+                    chunk++;
+                } else {
+                    level++;
+                    chunk = 0;
+                }
+            } else {
+                _build_cond.wait(lock);
+            }
+        }
 
-	// Expand the data buffer to fit the new samples
-	prev_length = e0.length;
-	e0.length = _sample_count / EnvelopeScaleFactor;
+        // Outside of the lock, the view reads the sections back
+        if (request_done && _built)
+            _built();
+    }
+}
 
-	// Break off if there are no new samples to compute
-	if (e0.length == prev_length)
-		return;
+void GroupSnapshot::build_envelope(unsigned int level,
+    uint64_t start, uint64_t end)
+{
+	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
-	reallocate_envelope(e0);
+    const Envelope &e = _envelope_levels[level];
+    end = min(end, e.length);
+    if (start >= end)
+        return;
+
+    for (uint64_t chunk = start / EnvelopeChunkLength;
+        chunk <= (end - 1) / EnvelopeChunkLength; chunk++) {
+        if (_envelope_chunk_done[level][chunk])
+            continue;
+        build_envelope_chunk(level, chunk);
+        _envelope_chunk_done[level][chunk] = true;
+    }
+}
 
-	dest_ptr = e0.samples + prev_length;
+void GroupSnapshot::build_envelope_chunk(unsigned int level, uint64_t chunk)
+{
+    const Envelope &e = _envelope_levels[level];
+    const uint64_t first = chunk * EnvelopeChunkLength;
+    const uint64_t last = min(first + EnvelopeChunkLength, e.length);
+    const uint64_t scale = (uint64_t)1 << ((level + 1) * EnvelopeScalePower);
 
-	// Iterate through the samples to populate the first level mipmap
     uint16_t group_value[EnvelopeScaleFactor];
-    const uint8_t *const end_src_ptr = (uint8_t*)_data +
-        e0.length * EnvelopeScaleFactor * _unit_size;
-    for (const uint8_t *src_ptr = (uint8_t*)_data +
-        prev_length * EnvelopeScaleFactor * _unit_size;
-        src_ptr < end_src_ptr; src_ptr += EnvelopeScaleFactor * _unit_size)
-	{
-        uint16_t tmpr;
-        for(int i = 0; i < EnvelopeScaleFactor; i++) {
-            if (_unit_size == 2)
-                group_value[i] = *((uint16_t*)src_ptr + i) & _mask;
-            else
-                group_value[i] = *((uint8_t*)src_ptr + i) & _mask;
-            for(int j=0; _bubble_start[j] != -1; j++) {
-                tmpr = group_value[i] & (0xffff >> (16 - _bubble_start[j]));
-                group_value[i] >>= _bubble_end[j];
-                group_value[i] <<= _bubble_start[j];
-                group_value[i] += tmpr;
+    for (uint64_t i = first; i < last; i++) {
+        EnvelopeSample &dest = e.samples[i];
+
+        // The transition mip-map of the logic snapshot covers the same
+        // blocks, where none of the grouped channels toggled the value
+        // is that of the first sample; samples are fetched through the
+        // logic snapshot, which may still have to load them
+        if ((_logic_snapshot->get_block_transitions(level, i) & _mask) == 0) {
+            sr_bitgather_run(&_gather,
+                _logic_snapshot->get_samples(i * scale, i * scale),
+                (uint8_t*)group_value, 1);
+            dest.min = dest.max = group_value[0];
+        } else if (level == 0) {
+            sr_bitgather_run(&_gather,
+                _logic_snapshot->get_samples(i * scale, i * scale + scale - 1),
+                (uint8_t*)group_value, EnvelopeScaleFactor);
+            dest.min = *min_element(group_value,
+                group_value + EnvelopeScaleFactor);
+            dest.max = *max_element(group_value,
+                group_value + EnvelopeScaleFactor);
+        } else {
+            // Subsample the level lower level, which is only needed
+            // below the blocks that changed
+            build_envelope(level - 1, i * EnvelopeScaleFactor,
+                (i + 1) * EnvelopeScaleFactor);
+
+            const EnvelopeSample *src_ptr =
+                _envelope_levels[level - 1].samples + i * EnvelopeScaleFactor;
+            const EnvelopeSample *const end_src_ptr =
+                src_ptr + EnvelopeScaleFactor;
+
+            EnvelopeSample sub_sample = *src_ptr++;
+            while (src_ptr < end_src_ptr)
+            {
+                sub_sample.min = min(sub_sample.min, src_ptr->min);
+                sub_sample.max = max(sub_sample.max, src_ptr->max);
+                src_ptr++;
             }
-        }
-
-		const EnvelopeSample sub_sample = {
-            *min_element(group_value, group_value + EnvelopeScaleFactor),
-            *max_element(group_value, group_value + EnvelopeScaleFactor),
-		};
-
-		*dest_ptr++ = sub_sample;
-	}
 
-	// Compute higher level mipmaps
-	for (unsigned int level = 1; level < ScaleStepCount; level++)
-	{
-		Envelope &e = _envelope_levels[level];
-		const Envelope &el = _envelope_levels[level-1];
-
-		// Expand the data buffer to fit the new samples
-		prev_length = e.length;
-		e.length = el.length / EnvelopeScaleFactor;
-
-		// Break off if there are no more samples to computed
-		if (e.length == prev_length)
-			break;
-
-		reallocate_envelope(e);
-
-		// Subsample the level lower level
-		const EnvelopeSample *src_ptr =
-			el.samples + prev_length * EnvelopeScaleFactor;
-		const EnvelopeSample *const end_dest_ptr = e.samples + e.length;
-		for (dest_ptr = e.samples + prev_length;
-			dest_ptr < end_dest_ptr; dest_ptr++)
-		{
-			const EnvelopeSample *const end_src_ptr =
-				src_ptr + EnvelopeScaleFactor;
-
-			EnvelopeSample sub_sample = *src_ptr++;
-			while (src_ptr < end_src_ptr)
-			{
-				sub_sample.min = min(sub_sample.min, src_ptr->min);
-				sub_sample.max = max(sub_sample.max, src_ptr->max);
-				src_ptr++;
-			}
-
-			*dest_ptr = sub_sample;
-		}
-	}
+            dest = sub_sample;
+        }
+    }
 }
 
 } // namespace data
@@ -24,20 +24,27 @@
 #ifndef DSVIEW_PV_DATA_GROUPSNAPSHOT_H
 #define DSVIEW_PV_DATA_GROUPSNAPSHOT_H
 
+#include <libsigrok4DSL/libsigrok.h>
+
+#include <boost/function.hpp>
 #include <boost/thread.hpp>
 #include <boost/shared_ptr.hpp>
 
-#include "../view/signal.h"
-
+#include <list>
+#include <memory>
 #include <utility>
 #include <vector>
-#include <list>
 
 namespace GroupSnapshotTest {
 class Basic;
 }
 
 namespace pv {
+
+namespace view {
+class Signal;
+}
+
 namespace data {
 
 class LogicSnapshot;
@@ -73,39 +80,78 @@ private:
 	static const int EnvelopeScaleFactor;
 	static const float LogEnvelopeScaleFactor;
 	static const uint64_t EnvelopeDataUnit;
+    static const uint64_t EnvelopeChunkLength;
     static const uint16_t value_mask[16];
 
 public:
-    GroupSnapshot(const boost::shared_ptr<LogicSnapshot> &_logic_snapshot, std::list<int> index_list);
+    /**
+     * @param built called from the build thread when the envelope
+     * chunks a section waited for are finished, to repaint the view.
+     **/
+    GroupSnapshot(const boost::shared_ptr<LogicSnapshot> &_logic_snapshot, std::list<int> index_list,
+        boost::function<void ()> built = boost::function<void ()>());
 
     virtual ~GroupSnapshot();
 
-    void append_payload();
-
     uint64_t get_sample_count() const;
 
-    const uint16_t* get_samples(int64_t start_sample,
-        int64_t end_sample);
-
-	void get_envelope_section(EnvelopeSection &s,
-		uint64_t start, uint64_t end, float min_length) const;
+    /**
+     * Gathers the group values of a range of samples.
+     * @param data the buffer to fill, it must hold
+     * end_sample - start_sample values.
+     **/
+    void get_samples(uint16_t *data, int64_t start_sample,
+        int64_t end_sample) const;
+
+    /**
+     * Points the section at the first run of finished samples in
+     * [start, end) of the envelope level which best fits min_length,
+     * the samples are not copied and stay valid as long as the snapshot
+     * lives. The chunks of the range which are not finished yet are
+     * queued for the build thread, which calls built when they are.
+     * @return false if no sample of the range is finished; call again
+     * from the end of the section for the following runs.
+     **/
+	bool get_envelope_section(EnvelopeSection &s,
+		uint64_t start, uint64_t end, float min_length);
 
 private:
 	void reallocate_envelope(Envelope &l);
 
-	void append_payload_to_envelope_levels();
+    /**
+     * Computes the envelope levels in the background, the queued
+     * chunks first.
+     **/
+    void build_proc();
+
+    /**
+     * Computes the blocks [start, end) of an envelope level, and the
+     * blocks of the lower levels they depend on, unless cached.
+     **/
+    void build_envelope(unsigned int level, uint64_t start, uint64_t end);
+
+    void build_envelope_chunk(unsigned int level, uint64_t chunk);
 
 private:
 	struct Envelope _envelope_levels[ScaleStepCount];
+    std::vector<bool> _envelope_chunk_done[ScaleStepCount];
+    std::unique_ptr<boost::thread> _build_thread;
+    boost::condition_variable_any _build_cond;
+    boost::function<void ()> _built;
+
+    // The chunks a section waited for, -1 if none
+    int _request_level;
+    uint64_t _request_start;
+    uint64_t _request_end;
+
+    boost::shared_ptr<LogicSnapshot> _logic_snapshot;
     mutable boost::recursive_mutex _mutex;
-    void *_data;
     uint64_t _sample_count;
     int _unit_size;
     boost::shared_ptr<view::Signal> _signal;
     std::list<int> _index_list;
     uint16_t _mask;
-    int _bubble_start[32];
-    int _bubble_end[32];
+    struct sr_bitgather _gather;
 
     friend class GroupSnapshotTest::Basic;
 };
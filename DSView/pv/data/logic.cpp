@@ -24,12 +24,17 @@
 #include "logic.h"
 #include "logicsnapshot.h"
 
+#include <boost/foreach.hpp>
+
 using namespace boost;
 using namespace std;
 
 namespace pv {
 namespace data {
 
+// The capture shown and one to write the next into
+const unsigned int Logic::RetiredSnapshots = 1;
+
 Logic::Logic() :
     SignalData()
 {
@@ -38,18 +43,64 @@ Logic::Logic() :
 void Logic::push_snapshot(
 	boost::shared_ptr<LogicSnapshot> &snapshot)
 {
+	boost::lock_guard<boost::mutex> lock(_mutex);
 	_snapshots.push_front(snapshot);
+	while (_snapshots.size() > 1) {
+		retire(_snapshots.back());
+		_snapshots.pop_back();
+	}
+}
+
+boost::shared_ptr<LogicSnapshot> Logic::recycle_snapshot(
+	const sr_datafeed_logic &logic, uint64_t total_sample_len,
+	unsigned int channel_num)
+{
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	boost::shared_ptr<LogicSnapshot> snapshot;
+	while (!_retired.empty()) {
+		snapshot.swap(_retired.front());
+		_retired.pop_front();
+
+		// A snapshot still read elsewhere, by a decoder for instance,
+		// is left to its readers
+		if (snapshot.unique() &&
+			snapshot->reuse(logic, total_sample_len, channel_num))
+			return snapshot;
+		snapshot.reset();
+	}
+
+	return snapshot;
 }
 
-deque< boost::shared_ptr<LogicSnapshot> >& Logic::get_snapshots()
+boost::shared_ptr<LogicSnapshot> Logic::get_snapshot() const
 {
-	return _snapshots;
+	boost::lock_guard<boost::mutex> lock(_mutex);
+	if (_snapshots.empty())
+		return boost::shared_ptr<LogicSnapshot>();
+	return _snapshots.front();
 }
 
 void Logic::clear()
 {
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    BOOST_FOREACH(const boost::shared_ptr<LogicSnapshot> &s, _snapshots)
+        retire(s);
     _snapshots.clear();
 }
 
+void Logic::release_snapshots()
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _snapshots.clear();
+    _retired.clear();
+}
+
+void Logic::retire(const boost::shared_ptr<LogicSnapshot> &snapshot)
+{
+    _retired.push_front(snapshot);
+    if (_retired.size() > RetiredSnapshots)
+        _retired.pop_back();
+}
+
 } // namespace data
 } // namespace pv
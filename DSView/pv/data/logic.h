@@ -26,7 +26,10 @@
 
 #include "signaldata.h"
 
+#include <libsigrok4DSL/libsigrok.h>
+
 #include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 #include <deque>
 
 namespace pv {
@@ -39,16 +42,50 @@ class Logic : public SignalData
 public:
     Logic();
 
+	/**
+	 * Makes a snapshot the one shown, the one it replaces is retired
+	 * and can be recycled for a later capture.
+	 **/
 	void push_snapshot(
 		boost::shared_ptr<LogicSnapshot> &snapshot);
 
-	std::deque< boost::shared_ptr<LogicSnapshot> >&
-		get_snapshots();
+	/**
+	 * Returns a retired snapshot of the size asked for, started over
+	 * with the first packet of a capture, or NULL if there is none.
+	 * A capture of a new size drops the retired snapshots instead.
+	 **/
+	boost::shared_ptr<LogicSnapshot> recycle_snapshot(
+		const sr_datafeed_logic &logic, uint64_t total_sample_len,
+		unsigned int channel_num);
+
+	/**
+	 * Returns the snapshot shown, or NULL if there is none. The
+	 * snapshot returned stays valid when a capture replaces it.
+	 **/
+	boost::shared_ptr<LogicSnapshot> get_snapshot() const;
 
+    /**
+     * Retires the snapshots, the view no longer shows them.
+     **/
     void clear();
 
+    /**
+     * Drops the snapshot shown and the retired ones, to make room for
+     * a capture which does not fit next to them.
+     **/
+    void release_snapshots();
+
+private:
+    void retire(const boost::shared_ptr<LogicSnapshot> &snapshot);
+
+private:
+    static const unsigned int RetiredSnapshots;
+
 private:
+	// The feed thread replaces the snapshots while the view reads them
+	mutable boost::mutex _mutex;
 	std::deque< boost::shared_ptr<LogicSnapshot> > _snapshots;
+	std::deque< boost::shared_ptr<LogicSnapshot> > _retired;
 };
 
 } // namespace data
@@ -45,12 +45,70 @@ const uint64_t LogicSnapshot::MipMapDataUnit = 64*1024;	// bytes
 
 LogicSnapshot::LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len, unsigned int channel_num) :
     Snapshot(logic.unitsize, _total_sample_len, channel_num),
-	_last_append_sample(0)
+	_last_append_sample(0),
+    _blocks(NULL)
 {
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	memset(_mip_map, 0, sizeof(_mip_map));
-    if (init(_total_sample_len * channel_num) == SR_OK)
-        append_payload(logic);
+    if (init(_total_sample_len * channel_num) != SR_OK)
+        return;
+
+    // The levels get their full size up front, they are never moved
+    // while the view reads them without the lock
+    for (unsigned int level = 0; level < ScaleStepCount; level++) {
+        MipMapLevel &m = _mip_map[level];
+        m.length = _total_sample_count >> ((level + 1) * MipMapScalePower);
+        reallocate_mipmap_level(m);
+        m.length = 0;
+    }
+
+    append_payload(logic);
+}
+
+LogicSnapshot::LogicSnapshot(const sr_datafeed_logic_map &logic, unsigned int channel_num) :
+    Snapshot(logic.unitsize, 0, channel_num),
+    _last_append_sample(0),
+    _blocks(NULL)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    memset(_mip_map, 0, sizeof(_mip_map));
+    init(logic.map);
+    append_payload_to_mipmap();
+    commit();
+}
+
+LogicSnapshot::LogicSnapshot(const sr_datafeed_logic_blocks &logic, unsigned int channel_num) :
+    Snapshot(logic.unitsize, logic.blocks->total_samples, channel_num),
+    _last_append_sample(0),
+    _blocks(NULL)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    memset(_mip_map, 0, sizeof(_mip_map));
+    assert(logic.unitsize == logic.blocks->unitsize);
+    assert(logic.blocks->block_samples % (1 << (2 * MipMapScalePower)) == 0);
+
+    // The buffer is only touched where blocks are loaded
+    if (init(_total_sample_count) != SR_OK)
+        return;
+    _blocks = sr_session_blocks_ref(logic.blocks);
+    _block_loaded.assign(_blocks->num_blocks, false);
+    _sample_count = _total_sample_count;
+
+    // The two finest levels are filled in with the blocks, every level
+    // above matches the granularity of the summary
+    for (unsigned int level = 0; level < 2; level++) {
+        _mip_map[level].length = _sample_count >> ((level + 1) * MipMapScalePower);
+        reallocate_mipmap_level(_mip_map[level]);
+    }
+
+    MipMapLevel &m2 = _mip_map[2];
+    assert((1 << (3 * MipMapScalePower)) == SR_SESSION_SUMMARY_SAMPLES);
+    m2.length = _sample_count / SR_SESSION_SUMMARY_SAMPLES;
+    reallocate_mipmap_level(m2);
+    memcpy(m2.data, _blocks->summary, m2.length * _unit_size);
+
+    append_mipmap_levels(3);
+    commit();
 }
 
 LogicSnapshot::~LogicSnapshot()
@@ -58,6 +116,7 @@ LogicSnapshot::~LogicSnapshot()
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 	BOOST_FOREACH(MipMapLevel &l, _mip_map)
 		free(l.data);
+    sr_session_blocks_unref(_blocks);
 }
 
 void LogicSnapshot::append_payload(
@@ -65,25 +124,97 @@ void LogicSnapshot::append_payload(
 {
 	assert(_unit_size == logic.unitsize);
 	assert((logic.length % _unit_size) == 0);
+	assert(!_blocks);
 
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
+    const int64_t start = g_get_monotonic_time();
 	append_data(logic.data, logic.length / _unit_size);
+    const int64_t appended = g_get_monotonic_time();
+    sr_metric_observe(SR_METRIC_FEED_APPEND, appended - start);
 
 	// Generate the first mip-map from the data
     append_payload_to_mipmap();
+    sr_metric_observe(SR_METRIC_FEED_MIPMAP,
+        g_get_monotonic_time() - appended);
+
+    // The samples and their mip-map entries are written, publish them
+    commit();
+}
+
+bool LogicSnapshot::reuse(const sr_datafeed_logic &logic,
+    uint64_t _total_sample_len, unsigned int channel_num)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    if (buf_null() || _map || _blocks ||
+        _unit_size != logic.unitsize ||
+        _total_sample_count != _total_sample_len ||
+        _channel_num != channel_num)
+        return false;
+
+    // The mip-map levels keep their size, they are written over from
+    // the start like the samples
+    _sample_count = 0;
+    _ring_sample_count = 0;
+    _last_append_sample = 0;
+    BOOST_FOREACH(MipMapLevel &m, _mip_map)
+        m.length = 0;
+    commit();
+
+    append_payload(logic);
+    return true;
+}
+
+void LogicSnapshot::drop_front(uint64_t samples)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    assert(!_map && !_blocks);
+
+    samples = min(samples, _sample_count);
+    samples -= samples % MipMapScaleFactor;
+    if (samples == 0)
+        return;
+
+    memmove(_data, (uint8_t*)_data + samples * _unit_size,
+        (_sample_count - samples) * _unit_size);
+    _sample_count -= samples;
+    _ring_sample_count = _sample_count;
+
+    // The levels whose blocks the count is a multiple of move along
+    // with the samples, the ones above are built again
+    unsigned int level;
+    for (level = 0; level < ScaleStepCount; level++) {
+        const uint64_t scale = 1ULL << ((level + 1) * MipMapScalePower);
+        if (samples % scale != 0)
+            break;
+
+        MipMapLevel &m = _mip_map[level];
+        const uint64_t offset = samples / scale;
+        memmove(m.data, (uint8_t*)m.data + offset * _unit_size,
+            (m.length - offset) * _unit_size);
+        m.length -= offset;
+    }
+    if (level < ScaleStepCount) {
+        for (unsigned int i = level; i < ScaleStepCount; i++)
+            _mip_map[i].length = 0;
+        append_mipmap_levels(level);
+    }
+
+    commit();
 }
 
 uint8_t * LogicSnapshot::get_samples(int64_t start_sample, int64_t end_sample) const
 {
     //assert(data);
     assert(start_sample >= 0);
-    assert(start_sample <= (int64_t)_sample_count);
+    assert(start_sample <= (int64_t)get_sample_count());
     assert(end_sample >= 0);
-    assert(end_sample <= (int64_t)_sample_count);
+    assert(end_sample <= (int64_t)get_sample_count());
     assert(start_sample <= end_sample);
 
-    (void)end_sample;
+    if (_blocks)
+        load_blocks(start_sample, end_sample + 1);
     //lock_guard<recursive_mutex> lock(_mutex);
 
     //const size_t size = (end_sample - start_sample) * _unit_size;
@@ -91,6 +222,102 @@ uint8_t * LogicSnapshot::get_samples(int64_t start_sample, int64_t end_sample) c
     return (uint8_t*)_data + start_sample * _unit_size;
 }
 
+uint64_t LogicSnapshot::get_sample(uint64_t index) const
+{
+    if (_blocks)
+        load_blocks(index, index + 1);
+    return Snapshot::get_sample(index);
+}
+
+void * LogicSnapshot::get_data() const
+{
+    if (_blocks)
+        load_blocks(0, _sample_count);
+    return Snapshot::get_data();
+}
+
+void LogicSnapshot::load_blocks(uint64_t start, uint64_t end) const
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+
+    end = min(end, _sample_count);
+    if (start >= end)
+        return;
+
+    const uint64_t block_samples = _blocks->block_samples;
+    const uint64_t last = (end - 1) / block_samples;
+    for (uint64_t block = start / block_samples; block <= last; block++) {
+        if (_block_loaded[block])
+            continue;
+
+        // Runs of missing blocks are decompressed in parallel, which
+        // matters when a decoder or an export goes through the capture
+        uint64_t count = 1;
+        while (block + count <= last && !_block_loaded[block + count])
+            count++;
+
+        uint8_t *const dest = (uint8_t*)_data +
+            block * block_samples * _unit_size;
+        if (sr_session_blocks_load(_blocks, block, count, dest,
+            boost::thread::hardware_concurrency()) != SR_OK) {
+            // Show damaged blocks as idle rather than retrying them
+            const uint64_t samples = min(count * block_samples,
+                _sample_count - block * block_samples);
+            memset(dest, 0, samples * _unit_size);
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            load_block_mipmap(block + i);
+            _block_loaded[block + i] = true;
+        }
+        block += count - 1;
+    }
+}
+
+void LogicSnapshot::load_block_mipmap(uint64_t block) const
+{
+    const MipMapLevel &m0 = _mip_map[0];
+    const MipMapLevel &m1 = _mip_map[1];
+    const uint64_t block_samples = _blocks->block_samples;
+
+    // Blocks are aligned to the second level, so only their own samples
+    // and the last sample of the block before are needed. Entries are
+    // stored unit by unit, as blocks may be loaded in any order.
+    uint64_t last_sample = 0;
+    if (block > 0)
+        memcpy(&last_sample, _blocks->block_last + (block - 1) * _unit_size,
+            _unit_size);
+
+    const uint64_t first0 = block * block_samples / MipMapScaleFactor;
+    const uint64_t end0 = min(first0 + block_samples / MipMapScaleFactor,
+        m0.length);
+    const uint8_t *src_ptr = (uint8_t*)_data +
+        first0 * MipMapScaleFactor * _unit_size;
+    for (uint64_t i = first0; i < end0; i++) {
+        uint64_t accumulator = 0;
+        for (int j = 0; j < MipMapScaleFactor; j++) {
+            const uint64_t sample = *(uint64_t*)src_ptr;
+            accumulator |= last_sample ^ sample;
+            last_sample = sample;
+            src_ptr += _unit_size;
+        }
+        memcpy((uint8_t*)m0.data + i * _unit_size, &accumulator, _unit_size);
+    }
+
+    const uint64_t first1 = first0 / MipMapScaleFactor;
+    const uint64_t end1 = min(first1 + block_samples /
+        (MipMapScaleFactor * MipMapScaleFactor), m1.length);
+    src_ptr = (uint8_t*)m0.data + first0 * _unit_size;
+    for (uint64_t i = first1; i < end1; i++) {
+        uint64_t accumulator = 0;
+        for (int j = 0; j < MipMapScaleFactor; j++) {
+            accumulator |= *(uint64_t*)src_ptr;
+            src_ptr += _unit_size;
+        }
+        memcpy((uint8_t*)m1.data + i * _unit_size, &accumulator, _unit_size);
+    }
+}
+
 void LogicSnapshot::reallocate_mipmap_level(MipMapLevel &m)
 {
 	const uint64_t new_data_length = ((m.length + MipMapDataUnit - 1) /
@@ -148,8 +375,19 @@ void LogicSnapshot::append_payload_to_mipmap()
 		dest_ptr += _unit_size;
 	}
 
+	append_mipmap_levels(1);
+}
+
+void LogicSnapshot::append_mipmap_levels(unsigned int first_level)
+{
+	uint64_t prev_length;
+	const uint8_t *src_ptr;
+	uint8_t *dest_ptr;
+	uint64_t accumulator;
+	unsigned int diff_counter;
+
 	// Compute higher level mipmaps
-	for (unsigned int level = 1; level < ScaleStepCount; level++)
+	for (unsigned int level = first_level; level < ScaleStepCount; level++)
 	{
 		MipMapLevel &m = _mip_map[level];
 		const MipMapLevel &ml = _mip_map[level-1];
@@ -195,7 +433,10 @@ void LogicSnapshot::get_subsampled_edges(
 	uint64_t index = start;
 	bool last_sample;
 
-    assert(end <= get_sample_count());
+    // More samples may be committed meanwhile, the view is drawn up to
+    // those it has seen
+    const uint64_t sample_count = get_sample_count();
+    assert(end <= sample_count);
 	assert(start <= end);
 	assert(min_length > 0);
 	assert(sig_index >= 0);
@@ -204,8 +445,6 @@ void LogicSnapshot::get_subsampled_edges(
     if (!_data)
         return;
 
-	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-
 	const uint64_t block_length = (uint64_t)max(min_length, 1.0f);
 	const uint64_t sig_mask = 1ULL << sig_index;
 
@@ -238,11 +477,11 @@ void LogicSnapshot::get_subsampled_edges(
 
     // Add the final state
     const bool end_sample = ((get_sample(end) & sig_mask) != 0);
-    if ((end != get_sample_count() - 1) ||
-            ((end == get_sample_count() - 1) && end_sample != last_sample))
+    if ((end != sample_count - 1) ||
+            ((end == sample_count - 1) && end_sample != last_sample))
         edges.push_back(pair<int64_t, bool>(end, end_sample));
 
-    if (end == get_sample_count() - 1)
+    if (end == sample_count - 1)
         edges.push_back(pair<int64_t, bool>(end + 1, ~last_sample));
 }
 
@@ -325,7 +564,7 @@ bool LogicSnapshot::get_nxt_edge(
 
             // Check if we reached the last block at this
             // level, or if there was a change in this block
-            if (offset >= _mip_map[level].length ||
+            if (offset >= get_mipmap_length(level) ||
                 (get_subsample(level, offset) &
                     sig_mask))
                 break;
@@ -359,7 +598,7 @@ bool LogicSnapshot::get_nxt_edge(
 
             // Check if we reached the last block at this
             // level, or if there was a change in this block
-            if (offset >= _mip_map[level].length ||
+            if (offset >= get_mipmap_length(level) ||
                 (get_subsample(level, offset) &
                     sig_mask)) {
                 // Zoom in unless we reached the minimum
@@ -551,10 +790,33 @@ bool LogicSnapshot::get_pre_edge(
     return false;
 }
 
+uint64_t LogicSnapshot::get_block_transitions(
+    unsigned int level, uint64_t offset) const
+{
+    if (level >= ScaleStepCount || offset >= get_mipmap_length(level))
+        return ~0ULL;
+
+    const uint64_t transitions = get_subsample(level, offset);
+    if (_unit_size < (int)sizeof(uint64_t))
+        return transitions & ((1ULL << (_unit_size * 8)) - 1);
+    return transitions;
+}
+
+uint64_t LogicSnapshot::get_mipmap_length(unsigned int level) const
+{
+	// The levels are built before the samples are committed
+	return get_sample_count() >> ((level + 1) * MipMapScalePower);
+}
+
 uint64_t LogicSnapshot::get_subsample(int level, uint64_t offset) const
 {
 	assert(level >= 0);
 	assert(_mip_map[level].data);
+	if (_blocks && level < 2) {
+		const int level_scale_power = (level + 1) * MipMapScalePower;
+		load_blocks(offset << level_scale_power,
+			(offset + 1) << level_scale_power);
+	}
 	return *(uint64_t*)((uint8_t*)_mip_map[level].data +
 		_unit_size * offset);
 }
@@ -35,6 +35,9 @@ class Basic;
 class LargeData;
 class Pulses;
 class LongPulses;
+class Blocks;
+class Reuse;
+class DropFront;
 }
 
 namespace pv {
@@ -63,17 +66,61 @@ public:
 public:
     LogicSnapshot(const sr_datafeed_logic &logic, uint64_t _total_sample_len, unsigned int channel_num);
 
+    /**
+     * Creates a snapshot of the samples in a file mapping, which are
+     * used in place.
+     **/
+    LogicSnapshot(const sr_datafeed_logic_map &logic, unsigned int channel_num);
+
+    /**
+     * Creates a snapshot of the blocks of an indexed session file. The
+     * coarse mip-map levels come from the summary of the file, the
+     * samples and the fine levels are read when they are first used.
+     **/
+    LogicSnapshot(const sr_datafeed_logic_blocks &logic, unsigned int channel_num);
+
 	virtual ~LogicSnapshot();
 
 	void append_payload(const sr_datafeed_logic &logic);
 
+    /**
+     * Starts the snapshot over with the first packet of a new capture,
+     * keeping the buffers which are already paged in. Nobody else may
+     * hold the snapshot.
+     * @return false if the buffers are not of the size asked for, the
+     * snapshot is then left as it was.
+     **/
+    bool reuse(const sr_datafeed_logic &logic, uint64_t _total_sample_len,
+               unsigned int channel_num);
+
+    /**
+     * Drops the oldest samples and moves the others to the front, so
+     * that a capture can go on in a window of the snapshot size. The
+     * count is rounded down to a whole entry of the first mip-map
+     * level. Readers without the lock see the samples move.
+     **/
+    void drop_front(uint64_t samples);
+
     uint8_t * get_samples(int64_t start_sample, int64_t end_sample) const;
 
+    uint64_t get_sample(uint64_t index) const;
+
+    /**
+     * Returns all samples, which reads any blocks not loaded yet.
+     **/
+    void * get_data() const;
+
 private:
 	void reallocate_mipmap_level(MipMapLevel &m);
 
 	void append_payload_to_mipmap();
 
+	void append_mipmap_levels(unsigned int first_level);
+
+    void load_blocks(uint64_t start, uint64_t end) const;
+
+    void load_block_mipmap(uint64_t block) const;
+
 public:
 	/**
 	 * Parses a logic data snapshot to generate a list of transitions
@@ -95,7 +142,23 @@ public:
     bool get_pre_edge(uint64_t &index, bool last_sample,
                       float min_length, int sig_index);
 
+    /**
+     * Returns the channels which toggled within a block of the mip-map,
+     * including the edge from the sample before the block.
+     * @param level the mip-map level, a block covers 16^(level+1) samples.
+     * @param offset the index of the block in the level.
+     * @return the transition mask, or all ones if the block is not
+     * covered by the mip-map.
+     **/
+    uint64_t get_block_transitions(unsigned int level, uint64_t offset) const;
+
 private:
+	/**
+	 * Returns the entries of a mip-map level which cover committed
+	 * samples, these can be read without the lock.
+	 **/
+	uint64_t get_mipmap_length(unsigned int level) const;
+
 	uint64_t get_subsample(int level, uint64_t offset) const;
 
 	static uint64_t pow2_ceil(uint64_t x, unsigned int power);
@@ -104,11 +167,17 @@ private:
 	struct MipMapLevel _mip_map[ScaleStepCount];
 	uint64_t _last_append_sample;
 
+    struct sr_session_blocks *_blocks;
+    mutable std::vector<bool> _block_loaded;
+
 	friend class LogicSnapshotTest::Pow2;
 	friend class LogicSnapshotTest::Basic;
 	friend class LogicSnapshotTest::LargeData;
 	friend class LogicSnapshotTest::Pulses;
 	friend class LogicSnapshotTest::LongPulses;
+	friend class LogicSnapshotTest::Blocks;
+	friend class LogicSnapshotTest::Reuse;
+	friend class LogicSnapshotTest::DropFront;
 };
 
 } // namespace data
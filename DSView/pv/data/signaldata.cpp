@@ -47,7 +47,12 @@ void SignalData::set_samplerate(double samplerate)
 
 double SignalData::get_start_time() const
 {
-	return _start_time;
+	return _start_time.load();
+}
+
+void SignalData::set_start_time(double start_time)
+{
+    _start_time.store(start_time);
 }
 
 } // namespace data
@@ -26,6 +26,8 @@
 
 #include <stdint.h>
 
+#include <atomic>
+
 namespace pv {
 namespace data {
 
@@ -41,10 +43,12 @@ public:
     virtual void clear() = 0;
 
 	double get_start_time() const;
+    void set_start_time(double start_time);
 
 protected:
     double _samplerate;
-    double _start_time;
+    // Set by the thread of a synchronised device, read by the view
+    std::atomic<double> _start_time;
 };
 
 } // namespace data
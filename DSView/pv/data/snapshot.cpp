@@ -27,15 +27,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 using namespace boost;
+using namespace std;
 
 namespace pv {
 namespace data {
 
 Snapshot::Snapshot(int unit_size, uint64_t total_sample_count, unsigned int channel_num) :
     _data(NULL),
+    _map(NULL),
     _channel_num(channel_num),
     _sample_count(0),
+    _committed_sample_count(0),
     _total_sample_count(total_sample_count),
     _ring_sample_count(0),
     _unit_size(unit_size)
@@ -47,7 +52,9 @@ Snapshot::Snapshot(int unit_size, uint64_t total_sample_count, unsigned int chan
 Snapshot::~Snapshot()
 {
 	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    if (_data != NULL)
+    if (_map != NULL)
+        sr_file_map_unref(_map);
+    else if (_data != NULL)
         free(_data);
     _data = NULL;
 }
@@ -64,6 +71,20 @@ int Snapshot::init(uint64_t _total_sample_len)
         return SR_OK;
 }
 
+void Snapshot::init(struct sr_file_map *map)
+{
+    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    assert(map);
+    assert(!_data);
+
+    // The mapping is followed by padding for the uint64_t read word,
+    // as the allocated buffers are
+    _map = sr_file_map_ref(map);
+    _data = (void*)map->data;
+    _sample_count = _total_sample_count = map->length / _unit_size;
+    _ring_sample_count = 0;
+}
+
 bool Snapshot::buf_null() const
 {
     if (_data == NULL)
@@ -74,34 +95,30 @@ bool Snapshot::buf_null() const
 
 uint64_t Snapshot::get_sample_count() const
 {
-	boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-    return _sample_count;
+    // Pairs with the release in commit(), the samples below the count
+    // are visible to this thread
+    return _committed_sample_count.load(std::memory_order_acquire);
 }
 
 void* Snapshot::get_data() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     return _data;
 }
 
 int Snapshot::unit_size() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     return _unit_size;
 }
 
 unsigned int Snapshot::get_channel_num() const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
     return _channel_num;
 }
 
 uint64_t Snapshot::get_sample(uint64_t index) const
 {
-    boost::lock_guard<boost::recursive_mutex> lock(_mutex);
-
     assert(_data);
-    assert(index < _sample_count);
+    assert(index < get_sample_count());
 
     return *(uint64_t*)((uint8_t*)_data + index * _unit_size);
 }
@@ -109,24 +126,21 @@ uint64_t Snapshot::get_sample(uint64_t index) const
 void Snapshot::append_data(void *data, uint64_t samples)
 {
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
+    assert(!_map);
 //	_data = realloc(_data, (_sample_count + samples) * _unit_size +
 //		sizeof(uint64_t));
-    if (_sample_count + samples < _total_sample_count)
-        _sample_count += samples;
-    else
-        _sample_count = _total_sample_count;
-
-    if (_ring_sample_count + samples > _total_sample_count) {
-        memcpy((uint8_t*)_data + _ring_sample_count * _unit_size,
-            data, (_total_sample_count - _ring_sample_count) * _unit_size);
-        _ring_sample_count = (samples + _ring_sample_count - _total_sample_count) % _total_sample_count;
-        memcpy((uint8_t*)_data,
-            data, _ring_sample_count * _unit_size);
-    } else {
-        memcpy((uint8_t*)_data + _ring_sample_count * _unit_size,
-            data, samples * _unit_size);
-        _ring_sample_count += samples;
-    }
+    // Committed samples are read without the lock, a full snapshot
+    // drops the samples past its end instead of writing over them
+    samples = min(samples, _total_sample_count - _sample_count);
+    memcpy((uint8_t*)_data + _sample_count * _unit_size,
+        data, samples * _unit_size);
+    _sample_count += samples;
+    _ring_sample_count = _sample_count;
+}
+
+void Snapshot::commit()
+{
+    _committed_sample_count.store(_sample_count, std::memory_order_release);
 }
 
 void Snapshot::refill_data(void *data, uint64_t samples, bool instant)
@@ -134,8 +148,24 @@ void Snapshot::refill_data(void *data, uint64_t samples, bool instant)
     boost::lock_guard<boost::recursive_mutex> lock(_mutex);
 
     if (instant) {
-        memcpy((uint8_t*)_data + _sample_count * _channel_num, data, samples*_channel_num);
-        _sample_count = (_sample_count + samples) % (_total_sample_count + 1);
+        // Roll mode: write behind the last packet and wrap around the
+        // end of the ring, the oldest samples are overwritten. The
+        // buffer holds the ring twice, each write goes to both copies
+        // so the samples from the oldest on are always contiguous.
+        if (samples >= _total_sample_count) {
+            data = (uint8_t*)data + (samples - _total_sample_count) * _channel_num;
+            samples = _total_sample_count;
+            _ring_sample_count = 0;
+        }
+        const uint64_t tail = min(samples, _total_sample_count - _ring_sample_count);
+        const uint64_t ring_bytes = _total_sample_count * _channel_num;
+        uint8_t *const dest = (uint8_t*)_data + _ring_sample_count * _channel_num;
+        memcpy(dest, data, tail*_channel_num);
+        memcpy(dest + ring_bytes, data, tail*_channel_num);
+        memcpy((uint8_t*)_data, (uint8_t*)data + tail * _channel_num, (samples - tail)*_channel_num);
+        memcpy((uint8_t*)_data + ring_bytes, (uint8_t*)data + tail * _channel_num, (samples - tail)*_channel_num);
+        _ring_sample_count = (_ring_sample_count + samples) % _total_sample_count;
+        _sample_count = min(_sample_count + samples, _total_sample_count);
     } else {
         memcpy((uint8_t*)_data, data, samples*_channel_num);
         _sample_count = samples;
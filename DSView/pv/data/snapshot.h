@@ -26,6 +26,8 @@
 
 #include <libsigrok4DSL/libsigrok.h>
 
+#include <atomic>
+
 #include <boost/thread.hpp>
 
 namespace pv {
@@ -40,9 +42,20 @@ public:
 
     int init(uint64_t _total_sample_len);
 
+    /**
+     * Uses the samples of a file mapping in place instead of a buffer,
+     * the snapshot is complete and can not be appended to.
+     **/
+    void init(struct sr_file_map *map);
+
+    /**
+     * Returns the number of committed samples. The samples below it,
+     * and what the snapshot derived from them, are complete and can be
+     * read without the lock while the capture goes on.
+     **/
 	uint64_t get_sample_count() const;
 
-    void * get_data() const;
+    virtual void * get_data() const;
 
     int unit_size() const;
 
@@ -53,14 +66,36 @@ public:
     uint64_t get_sample(uint64_t index) const;
 
 protected:
+	/**
+	 * Appends the samples which fit, those past the sample limit are
+	 * dropped.
+	 **/
 	void append_data(void *data, uint64_t samples);
+    /**
+     * Replaces the samples, or in instant mode writes them to a ring
+     * which is held twice in a buffer of twice the sample limit.
+     **/
     void refill_data(void *data, uint64_t samples, bool instant);
 
+    /**
+     * Publishes the samples written so far to get_sample_count(),
+     * called with the lock held once everything derived from them is
+     * written too.
+     **/
+    void commit();
+
 protected:
+	/**
+	 * Taken by the writer and by structural changes. The buffer is
+	 * allocated once, readers of committed samples do not take it.
+	 **/
 	mutable boost::recursive_mutex _mutex;
 	void *_data;
+    struct sr_file_map *_map;
     unsigned int _channel_num;
+	/** The samples written, only used with the lock held. */
 	uint64_t _sample_count;
+	std::atomic<uint64_t> _committed_sample_count;
     uint64_t _total_sample_count;
     uint64_t _ring_sample_count;
 	int _unit_size;
@@ -26,6 +26,7 @@
 #include "device/device.h"
 #include "sigsession.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 #include <stdexcept>
@@ -36,10 +37,13 @@
 #include <QDebug>
 #include <QDir>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 #include <libsigrok4DSL/libsigrok.h>
 
+using boost::lock_guard;
+using boost::mutex;
 using boost::shared_ptr;
 using std::list;
 using std::map;
@@ -52,14 +56,16 @@ char config_path[256];
 namespace pv {
 
 DeviceManager::DeviceManager(struct sr_context *sr_ctx) :
-	_sr_ctx(sr_ctx)
+	_sr_ctx(sr_ctx),
+    _demo_devices(1)
 {
 	init_drivers();
-	scan_all_drivers();
 }
 
 DeviceManager::~DeviceManager()
 {
+    wait_scan();
+    collect_scanned();
 	release_devices();
 }
 
@@ -80,10 +86,96 @@ void DeviceManager::add_device(boost::shared_ptr<pv::device::DevInst> device)
 std::list<boost::shared_ptr<device::DevInst> > DeviceManager::driver_scan(
 	struct sr_dev_driver *const driver, GSList *const drvopts)
 {
-    list< shared_ptr<device::DevInst> > driver_devices;
-
 	assert(driver);
 
+    // Let a scan in the background finish first
+    wait_scan();
+    collect_scanned();
+
+    clear_driver(driver);
+    if (!set_config_path(driver))
+        return list< shared_ptr<device::DevInst> >();
+
+	// Do the scan
+	return add_devices(scan_driver(driver, drvopts));
+}
+
+void DeviceManager::start_scan(boost::function<void ()> scanned)
+{
+    wait_scan();
+
+    // The virtual drivers find their devices at once
+	struct sr_dev_driver **const drivers = sr_driver_list();
+	for (struct sr_dev_driver **driver = drivers; *driver; driver++) {
+        clear_driver(*driver);
+        if (!set_config_path(*driver))
+            continue;
+        if (strncmp((*driver)->name, "virtual", 7) == 0)
+            add_devices(scan_driver(*driver, NULL));
+        else
+            _scan_threads.create_thread(boost::bind(
+                &DeviceManager::scan_proc, this, *driver, scanned));
+    }
+}
+
+bool DeviceManager::collect_scanned()
+{
+    list<GSList*> scanned;
+    bool added = false;
+
+    {
+        lock_guard<mutex> lock(_scan_mutex);
+        scanned.swap(_scanned);
+    }
+
+    BOOST_FOREACH(GSList *const devices, scanned)
+        if (!add_devices(devices).empty())
+            added = true;
+
+    return added;
+}
+
+void DeviceManager::wait_scan()
+{
+    _scan_threads.join_all();
+}
+
+void DeviceManager::set_demo_devices(unsigned int count)
+{
+    _demo_devices = std::max(count, 1U);
+}
+
+void DeviceManager::scan_proc(struct sr_dev_driver *const driver,
+                              boost::function<void ()> scanned)
+{
+    GSList *const devices = sr_driver_scan(driver, NULL);
+
+    {
+        lock_guard<mutex> lock(_scan_mutex);
+        _scanned.push_back(devices);
+    }
+
+    if (scanned)
+        scanned();
+}
+
+bool DeviceManager::set_config_path(struct sr_dev_driver *const driver)
+{
+    // Check If DSL hardware driver
+    if (strncmp(driver->name, "virtual", 7)) {
+        QDir dir(QCoreApplication::applicationDirPath());
+        if (!dir.cd("res"))
+            return false;
+        QString str = dir.absolutePath() + "/";
+        QString str_utf8 = QString::fromLocal8Bit(str.toLocal8Bit());
+        strcpy(config_path, str_utf8.toUtf8().data());
+    }
+
+    return true;
+}
+
+void DeviceManager::clear_driver(struct sr_dev_driver *const driver)
+{
 	// Remove any device instances from this driver from the device
 	// list. They will not be valid after the scan.
     list< shared_ptr<device::DevInst> >::iterator i = _devices.begin();
@@ -100,19 +192,31 @@ std::list<boost::shared_ptr<device::DevInst> > DeviceManager::driver_scan(
     // Clear all the old device instances from this driver
     sr_dev_clear(driver);
     //release_driver(driver);
+}
 
-    // Check If DSL hardware driver
-    if (strncmp(driver->name, "virtual", 7)) {
-        QDir dir(QCoreApplication::applicationDirPath());
-        if (!dir.cd("res"))
-            return driver_devices;
-        QString str = dir.absolutePath() + "/";
-        QString str_utf8 = QString::fromLocal8Bit(str.toLocal8Bit());
-        strcpy(config_path, str_utf8.toUtf8().data());
-    }
+GSList* DeviceManager::scan_driver(struct sr_dev_driver *const driver,
+                                   GSList *const drvopts)
+{
+    // The demo driver simulates as many devices as it is asked for
+    if (drvopts || _demo_devices == 1 || strcmp(driver->name, "virtual-demo"))
+        return sr_driver_scan(driver, drvopts);
+
+    sr_config count;
+    count.key = SR_CONF_DEVICE_COUNT;
+    count.data = g_variant_ref_sink(g_variant_new_uint64(_demo_devices));
+    GSList *const options = g_slist_append(NULL, &count);
+    GSList *const devices = sr_driver_scan(driver, options);
+    g_slist_free(options);
+    g_variant_unref(count.data);
+
+    return devices;
+}
+
+std::list<boost::shared_ptr<device::DevInst> > DeviceManager::add_devices(
+    GSList *const devices)
+{
+    list< shared_ptr<device::DevInst> > driver_devices;
 
-	// Do the scan
-	GSList *const devices = sr_driver_scan(driver, drvopts);
 	for (GSList *l = devices; l; l = l->next)
         driver_devices.push_front(shared_ptr<device::DevInst>(
                                      new device::Device((sr_dev_inst*)l->data)));
@@ -154,14 +258,6 @@ void DeviceManager::release_devices()
         sr_dev_clear(*driver);
 }
 
-void DeviceManager::scan_all_drivers()
-{
-	// Scan all drivers for all devices.
-	struct sr_dev_driver **const drivers = sr_driver_list();
-	for (struct sr_dev_driver **driver = drivers; *driver; driver++)
-		driver_scan(*driver);
-}
-
 void DeviceManager::release_driver(struct sr_dev_driver *const driver)
 {
     BOOST_FOREACH(shared_ptr<device::DevInst> dev, _devices) {
@@ -66,12 +66,43 @@ public:
 		struct sr_dev_driver *const driver,
 		GSList *const drvopts = NULL);
 
+    /**
+     * Scans all drivers, the hardware ones each in a thread of its own.
+     * @param scanned Called from the scan thread when a driver is done.
+     */
+    void start_scan(boost::function<void ()> scanned);
+
+    /**
+     * Adds the devices the scan threads have found so far to the list.
+     * @return true if there were any.
+     */
+    bool collect_scanned();
+
+    void wait_scan();
+
+    /**
+     * Sets the number of devices the demo driver simulates, from the
+     * next scan on.
+     */
+    void set_demo_devices(unsigned int count);
+
 private:
 	void init_drivers();
 
 	void release_devices();
 
-    void scan_all_drivers();
+    void scan_proc(struct sr_dev_driver *const driver,
+                   boost::function<void ()> scanned);
+
+    bool set_config_path(struct sr_dev_driver *const driver);
+
+    void clear_driver(struct sr_dev_driver *const driver);
+
+    GSList* scan_driver(struct sr_dev_driver *const driver,
+                        GSList *const drvopts);
+
+    std::list< boost::shared_ptr<pv::device::DevInst> > add_devices(
+        GSList *const devices);
 
 	void release_driver(struct sr_dev_driver *const driver);
 
@@ -81,6 +112,12 @@ private:
 private:
 	struct sr_context *const _sr_ctx;
     std::list< boost::shared_ptr<pv::device::DevInst> > _devices;
+
+    boost::thread_group _scan_threads;
+    boost::mutex _scan_mutex;
+    std::list<GSList*> _scanned;
+
+    unsigned int _demo_devices;
 };
 
 } // namespace pv
@@ -0,0 +1,165 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "metricsdock.h"
+
+#include <string.h>
+
+#include <QDateTime>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+
+namespace pv {
+namespace dock {
+
+MetricsDock::MetricsDock(QWidget *parent) :
+    QScrollArea(parent)
+{
+    _widget = new QWidget(this);
+
+    _table = new QTableWidget(SR_METRIC_COUNT, 4, _widget);
+    _table->setHorizontalHeaderLabels(QStringList() << tr("Rate/s") <<
+        tr("Mean") << tr("p99") << tr("Max"));
+    _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    _table->setSelectionMode(QAbstractItemView::NoSelection);
+    _table->horizontalHeader()->setStretchLastSection(true);
+
+    sr_metrics_get(_last, SR_METRIC_COUNT);
+    for (int i = 0; i < SR_METRIC_COUNT; i++) {
+        _table->setVerticalHeaderItem(i, new QTableWidgetItem(_last[i].name));
+        for (int j = 0; j < _table->columnCount(); j++)
+            _table->setItem(i, j, new QTableWidgetItem("-"));
+    }
+
+    _reset_button = new QPushButton(tr("Reset"), _widget);
+    _log_checkBox = new QCheckBox(tr("Log to file"), _widget);
+
+    QHBoxLayout *button_layout = new QHBoxLayout();
+    button_layout->addWidget(_reset_button);
+    button_layout->addWidget(_log_checkBox);
+    button_layout->addStretch(1);
+
+    QVBoxLayout *layout = new QVBoxLayout(_widget);
+    layout->addWidget(_table);
+    layout->addLayout(button_layout);
+    _widget->setLayout(layout);
+
+    connect(_reset_button, SIGNAL(clicked()), this, SLOT(reset()));
+    connect(_log_checkBox, SIGNAL(clicked(bool)), this, SLOT(log_toggled(bool)));
+    connect(&_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+
+    setWidget(_widget);
+    setWidgetResizable(true);
+
+    _elapsed.start();
+    _timer.start(UpdateInterval);
+}
+
+MetricsDock::~MetricsDock()
+{
+    stop_log();
+}
+
+bool MetricsDock::start_log(const QString &filename)
+{
+    stop_log();
+    _log.setFileName(filename);
+    if (!_log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return false;
+    _log_checkBox->setChecked(true);
+    return true;
+}
+
+void MetricsDock::stop_log()
+{
+    if (_log.isOpen())
+        _log.close();
+    _log_checkBox->setChecked(false);
+}
+
+void MetricsDock::log_toggled(bool checked)
+{
+    if (!checked) {
+        stop_log();
+        return;
+    }
+
+    const QString filename = QFileDialog::getSaveFileName(this,
+        tr("Log Metrics"), "", tr("Log files (*.log *.txt)"), 0,
+        QFileDialog::DontConfirmOverwrite);
+    if (filename.isEmpty() || !start_log(filename))
+        _log_checkBox->setChecked(false);
+}
+
+void MetricsDock::reset()
+{
+    sr_metrics_reset();
+    sr_metrics_get(_last, SR_METRIC_COUNT);
+    _elapsed.restart();
+}
+
+void MetricsDock::refresh()
+{
+    struct sr_metric cur[SR_METRIC_COUNT];
+
+    sr_metrics_get(cur, SR_METRIC_COUNT);
+    const double seconds = _elapsed.restart() / 1000.0;
+
+    if (_log.isOpen()) {
+        char *const dump = sr_metrics_dump();
+        _log.write(("# " + QDateTime::currentDateTime().toString(Qt::ISODate) +
+            "\n").toUtf8());
+        _log.write(dump);
+        _log.flush();
+        g_free(dump);
+    }
+
+    if (isVisible() && seconds > 0) {
+        for (int i = 0; i < SR_METRIC_COUNT; i++) {
+            // The histogram of this interval only, the maximum is the
+            // overall one
+            struct sr_metric delta = cur[i];
+            delta.count -= _last[i].count;
+            delta.sum -= _last[i].sum;
+            for (int b = 0; b < SR_METRIC_BUCKETS; b++)
+                delta.buckets[b] -= _last[i].buckets[b];
+
+            const double rate = delta.count / seconds;
+            _table->item(i, 0)->setText(i == SR_METRIC_USB_BYTES ?
+                QString::number(rate / (1 << 20), 'f', 1) + " MiB" :
+                QString::number(rate, 'f', 0));
+            if (cur[i].type != SR_METRIC_HISTOGRAM)
+                continue;
+            _table->item(i, 1)->setText(delta.count ?
+                QString::number((qulonglong)(delta.sum / delta.count)) + " us" : "-");
+            _table->item(i, 2)->setText(delta.count ?
+                QString::number((qulonglong)sr_metric_percentile(&delta, 0.99)) + " us" : "-");
+            _table->item(i, 3)->setText(QString::number((qulonglong)cur[i].max) + " us");
+        }
+    }
+
+    memcpy(_last, cur, sizeof(_last));
+}
+
+} // namespace dock
+} // namespace pv
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_METRICSDOCK_H
+#define DSVIEW_PV_METRICSDOCK_H
+
+#include <QScrollArea>
+#include <QTableWidget>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QFile>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+namespace pv {
+namespace dock {
+
+/**
+ * Rates and latencies of the acquisition pipeline, from the libsigrok
+ * metrics. The metrics can also be appended to a log file periodically,
+ * whether the dock is shown or not.
+ */
+class MetricsDock : public QScrollArea
+{
+    Q_OBJECT
+
+private:
+    static const int UpdateInterval = 1000; // ms
+
+public:
+    MetricsDock(QWidget *parent);
+    ~MetricsDock();
+
+    bool start_log(const QString &filename);
+    void stop_log();
+
+private slots:
+    void refresh();
+    void reset();
+    void log_toggled(bool checked);
+
+private:
+    QWidget *_widget;
+    QTableWidget *_table;
+    QPushButton *_reset_button;
+    QCheckBox *_log_checkBox;
+
+    QTimer _timer;
+    QElapsedTimer _elapsed;
+    QFile _log;
+    struct sr_metric _last[SR_METRIC_COUNT];
+};
+
+} // namespace dock
+} // namespace pv
+
+#endif // DSVIEW_PV_METRICSDOCK_H
@@ -65,6 +65,7 @@
 #include "dock/triggerdock.h"
 #include "dock/dsotriggerdock.h"
 #include "dock/measuredock.h"
+#include "dock/metricsdock.h"
 #include "dock/searchdock.h"
 
 #include "view/view.h"
@@ -220,6 +221,13 @@ void MainWindow::setup_ui()
     //dock::SearchDock *_search_widget = new dock::SearchDock(_search_dock, *_view, _session);
     _search_widget = new dock::SearchDock(_search_dock, *_view, _session);
     _search_dock->setWidget(_search_widget);
+    // metrics dock
+    _metrics_dock=new QDockWidget(tr("Acquisition Metrics"),this);
+    _metrics_dock->setFeatures(QDockWidget::DockWidgetMovable);
+    _metrics_dock->setAllowedAreas(Qt::RightDockWidgetArea);
+    _metrics_dock->setVisible(false);
+    _metrics_widget = new dock::MetricsDock(_metrics_dock);
+    _metrics_dock->setWidget(_metrics_widget);
 
 #ifdef ENABLE_DECODE
     addDockWidget(Qt::RightDockWidgetArea,_protocol_dock);
@@ -228,6 +236,7 @@ void MainWindow::setup_ui()
     addDockWidget(Qt::RightDockWidgetArea,_dso_trigger_dock);
     addDockWidget(Qt::RightDockWidgetArea, _measure_dock);
     addDockWidget(Qt::BottomDockWidgetArea, _search_dock);
+    addDockWidget(Qt::RightDockWidgetArea, _metrics_dock);
 
 	// Set the title
     QString title = QApplication::applicationName()+" v"+QApplication::applicationVersion();
@@ -245,6 +254,8 @@ void MainWindow::setup_ui()
             SLOT(test_data_error()));
     connect(&_session, SIGNAL(malloc_error()), this,
             SLOT(malloc_error()));
+    connect(&_session, SIGNAL(record_finished(QString)), this,
+            SLOT(record_finished(QString)));
 
     connect(_view, SIGNAL(cursor_update()), _measure_widget,
             SLOT(cursor_update()));
@@ -266,8 +277,11 @@ void MainWindow::setup_ui()
 #endif
     _measure_dock->installEventFilter(this);
     _search_dock->installEventFilter(this);
+    _metrics_dock->installEventFilter(this);
 
-    // Populate the device list and select the initially selected device
+    // Populate the device list and select the initially selected device,
+    // the hardware is selected when its scan has finished
+    _device_manager.start_scan(boost::bind(&MainWindow::driver_scanned, this));
     _session.set_default_device(boost::bind(&MainWindow::session_error, this,
                                             QString("Set Default Device failed"), _1));
     update_device_list();
@@ -283,6 +297,31 @@ void MainWindow::session_error(
 		Q_ARG(QString, info_text));
 }
 
+void MainWindow::driver_scanned()
+{
+    QMetaObject::invokeMethod(this, "devices_scanned",
+        Qt::QueuedConnection);
+}
+
+void MainWindow::devices_scanned()
+{
+    if (!_device_manager.collect_scanned())
+        return;
+
+    // Switch from the demo device to the hardware, unless it is in use
+    shared_ptr<pv::device::DevInst> selected_device = _session.get_device();
+    if (!selected_device ||
+        (!dynamic_pointer_cast<pv::device::File>(selected_device) &&
+         !strncmp(selected_device->dev_inst()->driver->name, "virtual", 7) &&
+         _session.get_capture_state() != SigSession::Running)) {
+        _session.set_default_device(boost::bind(&MainWindow::session_error, this,
+                                                QString("Set Default Device failed"), _1));
+        update_device_list();
+    } else {
+        _sampling_bar->set_device_list(_device_manager.devices(), selected_device);
+    }
+}
+
 void MainWindow::update_device_list()
 {
     assert(_sampling_bar);
@@ -478,6 +517,16 @@ void MainWindow::malloc_error()
     msg.exec();
 }
 
+void MainWindow::record_finished(QString info)
+{
+    QMessageBox msg(this);
+    msg.setText(tr("Record"));
+    msg.setInformativeText(info);
+    msg.setStandardButtons(QMessageBox::Ok);
+    msg.setIcon(QMessageBox::Information);
+    msg.exec();
+}
+
 void MainWindow::capture_state_changed(int state)
 {
     _file_bar->enable_toggle(state != SigSession::Running);
@@ -517,6 +566,8 @@ void MainWindow::capture_state_changed(int state)
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    _device_manager.wait_scan();
+
     QDir dir(QCoreApplication::applicationDirPath());
     if (dir.cd("res")) {
         QString driver_name = _session.get_device()->dev_inst()->driver->name;
@@ -581,6 +632,22 @@ void MainWindow::on_search(bool visible)
     _view->show_search_cursor(visible);
 }
 
+void MainWindow::on_metrics(bool visible)
+{
+    _metrics_dock->setVisible(visible);
+}
+
+bool MainWindow::start_metrics_log(const QString &filename)
+{
+    return _metrics_widget->start_log(filename);
+}
+
+void MainWindow::set_sync_capture(bool enable)
+{
+    _session.set_sync_capture(enable);
+    update_device_list();
+}
+
 void MainWindow::on_screenShot()
 {
     QPixmap pixmap;
@@ -846,6 +913,9 @@ bool MainWindow::eventFilter(QObject *object, QEvent *event)
         case Qt::Key_R:
             on_search(!_search_dock->isVisible());
             break;
+        case Qt::Key_P:
+            on_metrics(!_metrics_dock->isVisible());
+            break;
         case Qt::Key_O:
             _sampling_bar->on_configure();
             break;
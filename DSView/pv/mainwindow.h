@@ -56,6 +56,7 @@ class ProtocolDock;
 class TriggerDock;
 class DsoTriggerDock;
 class MeasureDock;
+class MetricsDock;
 class SearchDock;
 }
 
@@ -72,6 +73,10 @@ public:
 		const char *open_file_name = NULL,
 		QWidget *parent = 0);
 
+    bool start_metrics_log(const QString &filename);
+
+    void set_sync_capture(bool enable);
+
 protected:
     void closeEvent(QCloseEvent *event);
 
@@ -80,6 +85,8 @@ private:
 
 	void session_error(const QString text, const QString info_text);
 
+    void driver_scanned();
+
     bool eventFilter(QObject *object, QEvent *event);
 
 private slots:
@@ -106,6 +113,8 @@ private slots:
 
     void malloc_error();
 
+    void record_finished(QString info);
+
     void capture_state_changed(int state);
 
     void on_protocol(bool visible);
@@ -118,6 +127,8 @@ private slots:
 
     void on_search(bool visible);
 
+    void on_metrics(bool visible);
+
     void on_screenShot();
 
     void on_save();
@@ -131,6 +142,8 @@ private slots:
     void device_attach();
     void device_detach();
 
+    void devices_scanned();
+
 private:
 	DeviceManager &_device_manager;
 
@@ -173,6 +186,8 @@ private:
     dock::MeasureDock *_measure_widget;
     QDockWidget *_search_dock;
     dock::SearchDock * _search_widget;
+    QDockWidget *_metrics_dock;
+    dock::MetricsDock *_metrics_widget;
 
     QTimer test_timer;
     bool test_timer_linked;
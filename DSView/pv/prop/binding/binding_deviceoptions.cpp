@@ -25,6 +25,7 @@
 #include <QDebug>
 #include <QObject>
 
+#include <limits.h>
 #include <stdint.h>
 
 #include "deviceoptions.h"
@@ -78,6 +79,16 @@ DeviceOptions::DeviceOptions(struct sr_dev_inst *sdi) :
 			bind_int(name, key, "%", pair<int64_t, int64_t>(0, 100));
 			break;
 
+        case SR_CONF_PATTERN_BITRATE:
+            bind_int(name, key, QObject::tr("Hz"),
+                     pair<int64_t, int64_t>(1, INT_MAX));
+            break;
+
+        case SR_CONF_PATTERN_SEED:
+            bind_int(name, key, "",
+                     pair<int64_t, int64_t>(0, INT_MAX));
+            break;
+
 		case SR_CONF_PATTERN_MODE:
 		case SR_CONF_BUFFERSIZE:
 		case SR_CONF_TRIGGER_SOURCE:
@@ -108,6 +119,7 @@ DeviceOptions::DeviceOptions(struct sr_dev_inst *sdi) :
         case SR_CONF_CLOCK_EDGE:
         case SR_CONF_INSTANT:
         case SR_CONF_DATALOCK:
+        case SR_CONF_BENCHMARK:
             bind_bool(name, key);
             break;
 
@@ -0,0 +1,238 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "recorder.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+using boost::lock_guard;
+using boost::mutex;
+using boost::unique_lock;
+using boost::posix_time::microsec_clock;
+using std::min;
+using std::string;
+
+namespace pv {
+
+// 16 x 4 MiB absorb a stall of the disk of about a quarter of a second
+// at the highest stream rates
+const uint64_t Recorder::BufferSize = 4 * 1024 * 1024;
+const unsigned int Recorder::BufferCount = 16;
+
+Recorder::Recorder(const string &file_name, const sr_dev_inst *sdi,
+    int unit_size, bool compress) :
+    _file_name(file_name),
+    _sdi(sdi),
+    _unit_size(unit_size),
+    _compress(compress),
+    _writer(NULL),
+    _fill(NULL),
+    _gap(false),
+    _stopping(false),
+    _samples_written(0),
+    _samples_dropped(0),
+    _packets_dropped(0),
+    _failed(false),
+    _seconds(0)
+{
+    assert(_sdi);
+    assert(_unit_size > 0);
+}
+
+Recorder::~Recorder()
+{
+    if (_thread.joinable()) {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _full_cond.notify_one();
+        _thread.join();
+    }
+    sr_session_writer_abort(_writer);
+}
+
+bool Recorder::start()
+{
+    assert(!_writer);
+
+    if (sr_session_writer_new(_file_name.c_str(), _sdi, _unit_size,
+        &_writer) != SR_OK) {
+        _failed = true;
+        return false;
+    }
+    sr_session_writer_set_compress(_writer, _compress);
+
+    // Whole samples per buffer, so that each can be written on its own
+    _buffers.resize(BufferCount);
+    for (unsigned int i = 0; i < BufferCount; i++) {
+        _buffers[i].data.resize(BufferSize / _unit_size * _unit_size);
+        _buffers[i].used = 0;
+        _free.push_back(&_buffers[i]);
+    }
+
+    _start_time = microsec_clock::universal_time();
+    _thread = boost::thread(&Recorder::write_proc, this);
+
+    return true;
+}
+
+void Recorder::push(const void *data, uint64_t length)
+{
+    assert(length % _unit_size == 0);
+
+    // Once samples are lost, so are the ones which follow
+    if (_gap) {
+        lock_guard<mutex> lock(_mutex);
+        _samples_dropped += length / _unit_size;
+        _packets_dropped++;
+        return;
+    }
+
+    const uint8_t *src = (const uint8_t*)data;
+    while (length > 0) {
+        if (!_fill || _fill->used == _fill->data.size()) {
+            lock_guard<mutex> lock(_mutex);
+            if (_fill) {
+                _full.push_back(_fill);
+                _full_cond.notify_one();
+                _fill = NULL;
+            }
+            if (_free.empty()) {
+                // The rest of the packet is lost, the file can not be
+                // completed but the capture goes on
+                _samples_dropped += length / _unit_size;
+                _packets_dropped++;
+                _gap = true;
+                _failed = true;
+                return;
+            }
+            _fill = _free.front();
+            _free.pop_front();
+        }
+
+        const uint64_t n = min(length, _fill->data.size() - _fill->used);
+        memcpy(&_fill->data[_fill->used], src, n);
+        _fill->used += n;
+        src += n;
+        length -= n;
+    }
+}
+
+bool Recorder::stop()
+{
+    if (!_thread.joinable())
+        return false;
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_fill && _fill->used > 0)
+            _full.push_back(_fill);
+        _fill = NULL;
+        _stopping = true;
+    }
+    _full_cond.notify_one();
+    _thread.join();
+
+    const int ret = _failed ? SR_ERR : sr_session_writer_finish(_writer);
+    if (_failed)
+        sr_session_writer_abort(_writer);
+    _writer = NULL;
+
+    lock_guard<mutex> lock(_mutex);
+    _seconds = (microsec_clock::universal_time() - _start_time)
+        .total_microseconds() * 1e-6;
+    _failed = ret != SR_OK;
+
+    return !_failed;
+}
+
+const string& Recorder::file_name() const
+{
+    return _file_name;
+}
+
+uint64_t Recorder::samples_written() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _samples_written;
+}
+
+uint64_t Recorder::samples_dropped() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _samples_dropped;
+}
+
+uint64_t Recorder::packets_dropped() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _packets_dropped;
+}
+
+double Recorder::throughput() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _seconds > 0 ? _samples_written * _unit_size / _seconds : 0;
+}
+
+bool Recorder::failed() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _failed;
+}
+
+void Recorder::write_proc()
+{
+    unique_lock<mutex> lock(_mutex);
+
+    for (;;) {
+        while (_full.empty() && !_stopping)
+            _full_cond.wait(lock);
+        if (_full.empty())
+            break;
+
+        Buffer *const buf = _full.front();
+        _full.pop_front();
+
+        // After a failure the buffers are only recycled, so that the
+        // capture itself is not held up
+        if (!_failed) {
+            lock.unlock();
+            const uint64_t samples = buf->used / _unit_size;
+            const bool ok = sr_session_writer_append(_writer,
+                &buf->data[0], samples) == SR_OK;
+            lock.lock();
+            if (ok)
+                _samples_written += samples;
+            else
+                _failed = true;
+        }
+
+        buf->used = 0;
+        _free.push_back(buf);
+    }
+}
+
+} // namespace pv
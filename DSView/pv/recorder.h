@@ -0,0 +1,136 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef DSVIEW_PV_RECORDER_H
+#define DSVIEW_PV_RECORDER_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <libsigrok4DSL/libsigrok.h>
+
+namespace pv {
+
+/**
+ * Writes the logic samples of a running capture to a session file.
+ *
+ * The samples are copied into a fixed set of buffers, which a thread of
+ * its own compresses and writes out. push() never waits for the disk: if
+ * the writer falls behind and no buffer is free, the samples are counted
+ * as dropped and the recording fails, a file with a gap in it would not
+ * be the capture.
+ **/
+class Recorder
+{
+public:
+    static const uint64_t BufferSize;
+    static const unsigned int BufferCount;
+
+public:
+    Recorder(const std::string &file_name, const sr_dev_inst *sdi,
+        int unit_size, bool compress);
+
+    /**
+     * Stops the writer thread, a file which was not finished is removed.
+     **/
+    ~Recorder();
+
+    /**
+     * Creates the file and starts the writer thread.
+     * @return false if the file could not be created.
+     **/
+    bool start();
+
+    /**
+     * Queues samples for writing, called from the sampling thread.
+     * Nothing is queued any more once the recording has failed.
+     * @param data the samples.
+     * @param length the length of the samples in bytes, a multiple of
+     * the unit size.
+     **/
+    void push(const void *data, uint64_t length);
+
+    /**
+     * Writes out the queued samples and finishes the file.
+     * @return false if anything could not be written, the file is
+     * removed then.
+     **/
+    bool stop();
+
+    const std::string& file_name() const;
+
+    uint64_t samples_written() const;
+    uint64_t samples_dropped() const;
+    uint64_t packets_dropped() const;
+
+    /**
+     * Returns the bytes written per second from start() to stop().
+     **/
+    double throughput() const;
+
+    bool failed() const;
+
+private:
+    struct Buffer
+    {
+        std::vector<uint8_t> data;
+        uint64_t used;
+    };
+
+    void write_proc();
+
+private:
+    const std::string _file_name;
+    const sr_dev_inst *const _sdi;
+    const int _unit_size;
+    const bool _compress;
+
+    struct sr_session_writer *_writer;
+    boost::thread _thread;
+
+    // Buffers move from _free to _full through _fill, which like _gap
+    // only the sampling thread touches; the lock is held to move them,
+    // never while samples are copied or written
+    std::vector<Buffer> _buffers;
+    Buffer *_fill;
+    bool _gap;
+    mutable boost::mutex _mutex;
+    boost::condition_variable _full_cond;
+    std::deque<Buffer*> _free;
+    std::deque<Buffer*> _full;
+    bool _stopping;
+
+    uint64_t _samples_written;
+    uint64_t _samples_dropped;
+    uint64_t _packets_dropped;
+    bool _failed;
+    boost::posix_time::ptime _start_time;
+    double _seconds;
+};
+
+} // namespace pv
+
+#endif // DSVIEW_PV_RECORDER_H
@@ -28,6 +28,7 @@
 #include "mainwindow.h"
 
 #include "devicemanager.h"
+#include "recorder.h"
 #include "device/device.h"
 #include "device/file.h"
 
@@ -60,6 +61,7 @@
 #include <QJsonDocument>
 #include <QtConcurrent/QtConcurrent>
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 //using boost::dynamic_pointer_cast;
@@ -83,10 +85,17 @@ namespace pv {
 // TODO: This should not be necessary
 SigSession* SigSession::_session = NULL;
 
+const uint64_t SigSession::RecordWindowSamples = 64 * 1024 * 1024;
+
 SigSession::SigSession(DeviceManager &device_manager) :
 	_device_manager(device_manager),
     _capture_state(Init),
-    _instant(false)    
+    _instant(false),
+    _record_compress(false),
+    _record_window(0),
+    _sync_capture(false),
+    _triggered(false),
+    _trigger_pos(0)
 {
 	// TODO: This should not be necessary
 	_session = this;
@@ -99,6 +108,7 @@ SigSession::SigSession(DeviceManager &device_manager) :
     _refresh_timer.stop();
     _refresh_timer.setSingleShot(true);
     _data_lock = false;
+    _feed_subscription = NULL;
     connect(this, SIGNAL(start_timer(int)), &_view_timer, SLOT(start(int)));
     //connect(&_view_timer, SIGNAL(timeout()), this, SLOT(refresh()));
     connect(&_refresh_timer, SIGNAL(timeout()), this, SLOT(data_unlock()));
@@ -134,7 +144,8 @@ void SigSession::set_device(boost::shared_ptr<device::DevInst> dev_inst) throw(Q
     stop_capture();
 
     if (_dev_inst) {
-        sr_session_datafeed_callback_remove_all();
+        sr_session_datafeed_unsubscribe(_feed_subscription);
+        _feed_subscription = NULL;
         _dev_inst->release();
     }
 
@@ -151,7 +162,10 @@ void SigSession::set_device(boost::shared_ptr<device::DevInst> dev_inst) throw(Q
             throw(e);
             return;
         }
-        sr_session_datafeed_callback_add(data_feed_in_proc, NULL);
+        sr_session_datafeed_subscribe_dev(_dev_inst->dev_inst(),
+                                          data_feed_in_proc, NULL,
+                                          FeedQueueSize, SR_BUS_COALESCE,
+                                          &_feed_subscription);
         device_setted();
     }
 }
@@ -201,12 +215,10 @@ void SigSession::save_file(const QString name, int type){
         unit_size = get_ch_num(SR_CHANNEL_DSO);
         sample_count = snapshot->get_sample_count();
     } else {
-        const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-            _logic_data->get_snapshots();
-        if (snapshots.empty())
+        const boost::shared_ptr<pv::data::LogicSnapshot> snapshot =
+            _logic_data->get_snapshot();
+        if (!snapshot)
             return;
-        const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-            snapshots.front();
         data = (unsigned char*)snapshot->get_data();
         unit_size = snapshot->unit_size();
         sample_count = snapshot->get_sample_count();
@@ -243,11 +255,9 @@ void SigSession::export_file(const QString name, QWidget* parent, const QString
     int channel_type;
 
     if (_dev_inst->dev_inst()->mode == LOGIC) {
-        const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-                _logic_data->get_snapshots();
-        if(snapshots.empty())
+        snapshot = _logic_data->get_snapshot();
+        if(!snapshot)
             return;
-        snapshot = snapshots.front();
         channel_type = SR_CHANNEL_LOGIC;
     } else if (_dev_inst->dev_inst()->mode == DSO) {
         const deque< boost::shared_ptr<pv::data::DsoSnapshot> > &snapshots =
@@ -295,11 +305,14 @@ void SigSession::export_file(const QString name, QWidget* parent, const QString
     output.param = NULL;
     if(outModule->init)
         outModule->init(&output, params);
+    // The bit planes are binary, the other modules write text
+    const bool binary = !strcmp(outModule->id, "planes");
     QFile file(name);
-    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    file.open(binary ? QIODevice::WriteOnly :
+                       QIODevice::WriteOnly | QIODevice::Text);
     QTextStream out(&file);
     out.setCodec("UTF-8");
-    out.setGenerateByteOrderMark(true);
+    out.setGenerateByteOrderMark(!binary);
     QFuture<void> future;
     if (_dev_inst->dev_inst()->mode == LOGIC) {
         future = QtConcurrent::run([&]{
@@ -311,20 +324,30 @@ void SigSession::export_file(const QString name, QWidget* parent, const QString
             unsigned int size = usize;
             struct sr_datafeed_logic lp;
             struct sr_datafeed_packet p;
-            for(uint64_t i = 0; i < numsamples; i+=usize){
-                if(numsamples - i < usize)
-                    size = numsamples - i;
-                lp.data = &datat[i];
-                lp.length = size;
-                lp.unitsize = snapshot->unit_size();
-                p.type = SR_DF_LOGIC;
-                p.payload = &lp;
+            for(uint64_t i = 0; i <= numsamples; i+=size){
+                if (i == numsamples) {
+                    // Let the module write what it still holds
+                    p.type = SR_DF_END;
+                    p.payload = NULL;
+                } else {
+                    if(numsamples - i < usize)
+                        size = numsamples - i;
+                    lp.data = &datat[i];
+                    lp.length = size;
+                    lp.unitsize = snapshot->unit_size();
+                    p.type = SR_DF_LOGIC;
+                    p.payload = &lp;
+                }
                 outModule->receive(&output, &p, &data_out);
                 if(data_out){
-                    out << QString::fromUtf8((char*) data_out->str);
+                    if (binary)
+                        file.write(data_out->str, data_out->len);
+                    else
+                        out << QString::fromUtf8((char*) data_out->str);
                     g_string_free(data_out,TRUE);
                 }
-                emit  progressSaveFileValueChanged(i*100/numsamples);
+                if (i < numsamples)
+                    emit  progressSaveFileValueChanged(i*100/numsamples);
                 if(!saveFileThreadRunning)
                     break;
             }
@@ -411,6 +434,9 @@ void SigSession::release_device(device::DevInst *dev_inst)
     assert(_capture_state != Running);
     _dev_inst = boost::shared_ptr<device::DevInst>();
     //_dev_inst.reset();
+
+    // The devices which captured with it share its session
+    clear_sync_devices();
 }
 
 SigSession::capture_state SigSession::get_capture_state() const
@@ -454,6 +480,24 @@ void SigSession::start_capture(bool instant,
     if (~_instant)
         _view_timer.blockSignals(false);
 
+    // The devices which capture together run at the same rate
+    {
+        boost::lock_guard<boost::mutex> lock(_sync_mutex);
+        _triggered = false;
+        const uint64_t sample_rate = _dev_inst->get_sample_rate();
+        const uint64_t sample_limit = _dev_inst->get_sample_limit();
+        BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices) {
+            sr_dev_inst *const sdi = sync->dev_inst->dev_inst();
+            sr_config_set(sdi, NULL, NULL, SR_CONF_SAMPLERATE,
+                          g_variant_new_uint64(sample_rate));
+            sr_config_set(sdi, NULL, NULL, SR_CONF_LIMIT_SAMPLES,
+                          g_variant_new_uint64(sample_limit));
+            sync->sample_limit = sample_limit;
+            sync->triggered = false;
+            sync->logic_data->set_start_time(0);
+        }
+    }
+
 	// Begin the session
 
 	_sampling_thread.reset(new boost::thread(
@@ -508,14 +552,11 @@ bool SigSession::get_instant()
 void* SigSession::get_buf(int& unit_size, uint64_t &length)
 {
     if (_dev_inst->dev_inst()->mode == LOGIC) {
-        const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-            _logic_data->get_snapshots();
-        if (snapshots.empty())
+        const boost::shared_ptr<pv::data::LogicSnapshot> snapshot =
+            _logic_data->get_snapshot();
+        if (!snapshot)
             return NULL;
 
-        const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-            snapshots.front();
-
         unit_size = snapshot->unit_size();
         length = snapshot->get_sample_count();
         return snapshot->get_data();
@@ -580,6 +621,79 @@ void SigSession::sample_thread_proc(boost::shared_ptr<device::DevInst> dev_inst,
     assert(!_cur_analog_snapshot);
 }
 
+void SigSession::set_record_file(const QString &name, bool compress)
+{
+    boost::lock_guard<boost::mutex> lock(_data_mutex);
+    _record_file = name;
+    _record_compress = compress;
+}
+
+QString SigSession::get_record_file() const
+{
+    boost::lock_guard<boost::mutex> lock(_data_mutex);
+    return _record_file;
+}
+
+void SigSession::start_record(int unit_size)
+{
+    assert(!_recorder);
+
+    if (_record_file.isEmpty())
+        return;
+
+    _recorder.reset(new Recorder(_record_file.toLocal8Bit().data(),
+        _dev_inst->dev_inst(), unit_size, _record_compress));
+    if (!_recorder->start()) {
+        _recorder.reset();
+        record_finished(tr("Failed to create %1.").arg(_record_file));
+    }
+}
+
+void SigSession::stop_record()
+{
+    if (!_recorder)
+        return;
+
+    const bool ok = _recorder->stop();
+    const QString file_name =
+        QString::fromLocal8Bit(_recorder->file_name().c_str());
+    const QString info = tr("%1 samples recorded at %2 MB/s, "
+        "%3 samples in %4 packets dropped.")
+        .arg(_recorder->samples_written())
+        .arg(_recorder->throughput() * 1e-6, 0, 'f', 1)
+        .arg(_recorder->samples_dropped())
+        .arg(_recorder->packets_dropped());
+    qDebug() << info;
+    if (ok)
+        record_finished(info);
+    else if (_recorder->samples_dropped() > 0)
+        record_finished(tr("%1 was removed, the disk did not keep up "
+            "with the capture.").arg(file_name) + " " + info);
+    else
+        record_finished(tr("Failed to write %1.").arg(file_name) + " " + info);
+    _recorder.reset();
+
+    // The file holds the whole capture and replaces the window in the
+    // view: its summary gives the overview and the blocks are read
+    // where the view is zoomed in
+    sr_session_blocks *blocks;
+    if (!ok || sr_session_blocks_open(file_name.toLocal8Bit().data(),
+        "data", &blocks) != SR_OK)
+        return;
+
+    sr_datafeed_logic_blocks logic_blocks;
+    logic_blocks.unitsize = blocks->unitsize;
+    logic_blocks.blocks = blocks;
+    boost::shared_ptr<data::LogicSnapshot> snapshot(
+        new data::LogicSnapshot(logic_blocks, 1));
+    sr_session_blocks_unref(blocks);
+    if (snapshot->buf_null())
+        return;
+
+    boost::lock_guard<boost::mutex> lock(_data_mutex);
+    _logic_data->push_snapshot(snapshot);
+}
+
 void SigSession::read_sample_rate(const sr_dev_inst *const sdi)
 {
     GVariant *gvar;
@@ -598,10 +712,17 @@ void SigSession::read_sample_rate(const sr_dev_inst *const sdi)
         g_variant_unref(gvar);
     }
 
-    // Set the sample rate of all data
-    const set< boost::shared_ptr<data::SignalData> > data_set = get_data();
+    // Set the sample rate of all data, the devices which capture
+    // together with this one set their own
+    set< boost::shared_ptr<data::SignalData> > data_set = get_data();
+    BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices)
+        data_set.erase(sync->logic_data);
     BOOST_FOREACH(boost::shared_ptr<data::SignalData> data, data_set) {
         assert(data);
+        // The last logic capture stays in view until the samples of
+        // this one come in and replace it
+        if (data == _logic_data && data->samplerate() == sample_rate)
+            continue;
         data->set_samplerate(sample_rate);
     }
 }
@@ -633,14 +754,15 @@ void SigSession::add_group()
         _group_traces.push_back(signal);
         _group_cnt++;
 
-        const deque< boost::shared_ptr<data::LogicSnapshot> > &snapshots =
-            _logic_data->get_snapshots();
-        if (!snapshots.empty()) {
+        const boost::shared_ptr<data::LogicSnapshot> snapshot =
+            _logic_data->get_snapshot();
+        if (snapshot) {
             //if (!_cur_group_snapshot)
             //{
                 // Create a new data snapshot
                 _cur_group_snapshot = boost::shared_ptr<data::GroupSnapshot>(
-                            new data::GroupSnapshot(snapshots.front(), signal->get_index_list()));
+                            new data::GroupSnapshot(snapshot, signal->get_index_list(),
+                                boost::bind(&SigSession::data_updated, this)));
                 //_cur_group_snapshot->append_payload();
                 _group_data->push_snapshot(_cur_group_snapshot);
                 _cur_group_snapshot.reset();
@@ -701,6 +823,9 @@ void SigSession::init_signals()
     _decode_traces.clear();
 #endif
 
+    clear_sync_devices();
+    add_sync_devices();
+
     // Detect what data types we will receive
     if(_dev_inst) {
         assert(_dev_inst->dev_inst());
@@ -779,6 +904,7 @@ void SigSession::init_signals()
             if(signal.get())
                 sigs.push_back(signal);
         }
+        add_sync_signals(sigs);
 
         _signals.clear();
         vector< boost::shared_ptr<view::Signal> >().swap(_signals);
@@ -840,6 +966,7 @@ void SigSession::reload()
             if (signal.get())
                 sigs.push_back(signal);
         }
+        add_sync_signals(sigs);
 
         _signals.clear();
         vector< boost::shared_ptr<view::Signal> >().swap(_signals);
@@ -863,6 +990,11 @@ void SigSession::refresh(int holdtime)
         _analog_data->clear();
         _cur_analog_snapshot.reset();
     }
+    BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices) {
+        boost::lock_guard<boost::mutex> lock(sync->mutex);
+        sync->logic_data->clear();
+        sync->cur_snapshot.reset();
+    }
     if (strncmp(_dev_inst->dev_inst()->driver->name, "virtual", 7)) {
         _data_lock = true;
         _refresh_timer.start(holdtime);
@@ -902,6 +1034,13 @@ void SigSession::feed_in_meta(const sr_dev_inst *sdi,
 void SigSession::feed_in_trigger(const ds_trigger_pos &trigger_pos)
 {
     if (_dev_inst->dev_inst()->mode != DSO) {
+        {
+            boost::lock_guard<boost::mutex> lock(_sync_mutex);
+            _triggered = true;
+            _trigger_pos = trigger_pos.real_pos;
+            BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices)
+                align_sync_device(*sync);
+        }
         receive_trigger(trigger_pos.real_pos);
     } else {
         int probe_count = 0;
@@ -919,9 +1058,35 @@ void SigSession::feed_in_trigger(const ds_trigger_pos &trigger_pos)
     }
 }
 
+boost::shared_ptr<data::LogicSnapshot> SigSession::new_logic_snapshot(
+    data::Logic &logic_data, const sr_datafeed_logic &logic,
+    uint64_t sample_limit)
+{
+    // Write into the buffers of an earlier capture if one fits, a
+    // new data snapshot is only created the first time
+    boost::shared_ptr<data::LogicSnapshot> snapshot =
+        logic_data.recycle_snapshot(logic, sample_limit, 1);
+    if (snapshot)
+        return snapshot;
+
+    snapshot = boost::shared_ptr<data::LogicSnapshot>(
+        new data::LogicSnapshot(logic, sample_limit, 1));
+    if (snapshot->buf_null()) {
+        // A deep capture may only fit once the last one is freed
+        snapshot.reset();
+        logic_data.release_snapshots();
+        snapshot = boost::shared_ptr<data::LogicSnapshot>(
+            new data::LogicSnapshot(logic, sample_limit, 1));
+    }
+    return snapshot;
+}
+
 void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
 {
+    const int64_t wait_start = g_get_monotonic_time();
 	boost::lock_guard<boost::mutex> lock(_data_mutex);
+    sr_metric_observe(SR_METRIC_FEED_LOCK_WAIT,
+        g_get_monotonic_time() - wait_start);
 
 	if (!_logic_data)
 	{
@@ -935,9 +1100,18 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
 
 	if (!_cur_logic_snapshot)
 	{
-		// Create a new data snapshot
-		_cur_logic_snapshot = boost::shared_ptr<data::LogicSnapshot>(
-            new data::LogicSnapshot(logic, _dev_inst->get_sample_limit(), 1));
+        // While recording, the file holds the capture and the memory
+        // only the latest window of it
+        uint64_t sample_limit = _dev_inst->get_sample_limit();
+        start_record(logic.unitsize);
+        if (_recorder) {
+            _recorder->push(logic.data, logic.length);
+            sample_limit = std::min(sample_limit, RecordWindowSamples);
+        }
+        _record_window = sample_limit;
+
+        _cur_logic_snapshot = new_logic_snapshot(
+            *_logic_data, logic, sample_limit);
         if (_cur_logic_snapshot->buf_null())
         {
             malloc_error();
@@ -951,6 +1125,16 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
         // frame_began is DecoderStack, but in future we need to signal
         // this after both analog and logic sweeps have begun.
         frame_began();
+    } else if (_recorder) {
+        _recorder->push(logic.data, logic.length);
+
+        // The window rolls on, its older half makes room for the packet
+        if (!_cur_logic_snapshot->buf_null()) {
+            if (_cur_logic_snapshot->get_sample_count() +
+                logic.length / logic.unitsize > _record_window)
+                _cur_logic_snapshot->drop_front(_record_window / 2);
+            _cur_logic_snapshot->append_payload(logic);
+        }
     } else if(!_cur_logic_snapshot->buf_null()) {
 		// Append to the existing data snapshot
 		_cur_logic_snapshot->append_payload(logic);
@@ -963,6 +1147,86 @@ void SigSession::feed_in_logic(const sr_datafeed_logic &logic)
     //data_updated();
 }
 
+void SigSession::feed_in_logic_map(const sr_datafeed_logic_map &logic_map)
+{
+    assert(logic_map.map);
+
+    {
+        boost::lock_guard<boost::mutex> lock(_data_mutex);
+
+        if (!_logic_data)
+        {
+            qDebug() << "Unexpected logic packet";
+            return;
+        }
+
+        if (!_cur_logic_snapshot)
+        {
+            // The snapshot keeps a reference and reads the file in place
+            _cur_logic_snapshot = boost::shared_ptr<data::LogicSnapshot>(
+                new data::LogicSnapshot(logic_map, 1));
+            _logic_data->push_snapshot(_cur_logic_snapshot);
+            frame_began();
+
+            emit receive_data(logic_map.map->length / logic_map.unitsize);
+            data_received();
+            return;
+        }
+    }
+
+    // Samples following other packets are copied as usual
+    sr_datafeed_logic logic;
+    logic.length = logic_map.map->length;
+    logic.unitsize = logic_map.unitsize;
+    logic.data_error = 0;
+    logic.data = (void*)logic_map.map->data;
+    feed_in_logic(logic);
+}
+
+void SigSession::feed_in_logic_blocks(const sr_datafeed_logic_blocks &logic_blocks)
+{
+    sr_session_blocks *const blocks = logic_blocks.blocks;
+    assert(blocks);
+
+    {
+        boost::lock_guard<boost::mutex> lock(_data_mutex);
+
+        if (!_logic_data)
+        {
+            qDebug() << "Unexpected logic packet";
+            return;
+        }
+
+        if (!_cur_logic_snapshot)
+        {
+            // The snapshot keeps a reference and reads blocks on demand
+            _cur_logic_snapshot = boost::shared_ptr<data::LogicSnapshot>(
+                new data::LogicSnapshot(logic_blocks, 1));
+            _logic_data->push_snapshot(_cur_logic_snapshot);
+            frame_began();
+
+            emit receive_data(blocks->total_samples);
+            data_received();
+            return;
+        }
+    }
+
+    // Samples following other packets are copied as usual
+    std::vector<uint8_t> buf(blocks->block_samples * blocks->unitsize);
+    sr_datafeed_logic logic;
+    logic.unitsize = logic_blocks.unitsize;
+    logic.data_error = 0;
+    logic.data = &buf[0];
+    for (uint64_t block = 0; block < blocks->num_blocks; block++) {
+        if (sr_session_blocks_read(blocks, block, &buf[0]) != SR_OK)
+            break;
+        logic.length = std::min(blocks->block_samples,
+            blocks->total_samples - block * blocks->block_samples) *
+            blocks->unitsize;
+        feed_in_logic(logic);
+    }
+}
+
 void SigSession::feed_in_dso(const sr_datafeed_dso &dso)
 {
     boost::lock_guard<boost::mutex> lock(_data_mutex);
@@ -1039,6 +1303,56 @@ void SigSession::feed_in_analog(const sr_datafeed_analog &analog)
     data_updated();
 }
 
+void SigSession::feed_in_analog_pcm(const sr_datafeed_analog_pcm &pcm)
+{
+    assert(pcm.map);
+
+    {
+        boost::lock_guard<boost::mutex> lock(_data_mutex);
+
+        if(!_analog_data)
+        {
+            qDebug() << "Unexpected analog packet";
+            return;
+        }
+
+        if (!_cur_analog_snapshot)
+        {
+            // The snapshot converts the file into its own buffer
+            _cur_analog_snapshot = boost::shared_ptr<data::AnalogSnapshot>(
+                new data::AnalogSnapshot(pcm, get_ch_num(SR_CHANNEL_ANALOG)));
+            if (_cur_analog_snapshot->buf_null())
+            {
+                malloc_error();
+                return;
+            }
+            _analog_data->push_snapshot(_cur_analog_snapshot);
+
+            receive_data(pcm.num_samples);
+            data_updated();
+            return;
+        }
+    }
+
+    // Samples following other packets are converted in chunks
+    const unsigned int channel_num = g_slist_length(pcm.probes);
+    const uint64_t frame_size = sr_pcm_sample_size(pcm.format) * channel_num;
+    const uint64_t chunk = 64 * 1024;
+    std::vector<uint16_t> buf(chunk * channel_num);
+    sr_datafeed_analog analog;
+    analog.probes = pcm.probes;
+    analog.mq = 0;
+    analog.unit = 0;
+    analog.mqflags = 0;
+    analog.data = (float*)&buf[0];
+    for (uint64_t i = 0; i < pcm.num_samples; i += chunk) {
+        analog.num_samples = std::min(chunk, pcm.num_samples - i);
+        sr_pcm_to_analog(pcm.format, pcm.map->data + i * frame_size,
+            &buf[0], analog.num_samples * channel_num);
+        feed_in_analog(analog);
+    }
+}
+
 void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
     const struct sr_datafeed_packet *packet)
 {
@@ -1069,6 +1383,16 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
         feed_in_logic(*(const sr_datafeed_logic*)packet->payload);
 		break;
 
+    case SR_DF_LOGIC_MAP:
+        assert(packet->payload);
+        feed_in_logic_map(*(const sr_datafeed_logic_map*)packet->payload);
+        break;
+
+    case SR_DF_LOGIC_BLOCKS:
+        assert(packet->payload);
+        feed_in_logic_blocks(*(const sr_datafeed_logic_blocks*)packet->payload);
+        break;
+
     case SR_DF_DSO:
         assert(packet->payload);
         feed_in_dso(*(const sr_datafeed_dso*)packet->payload);
@@ -1079,8 +1403,17 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
         feed_in_analog(*(const sr_datafeed_analog*)packet->payload);
 		break;
 
+    case SR_DF_ANALOG_PCM:
+        assert(packet->payload);
+        feed_in_analog_pcm(*(const sr_datafeed_analog_pcm*)packet->payload);
+        break;
+
 	case SR_DF_END:
 	{
+        // The recorder is only used from this thread, the writes which
+        // are still queued are waited for without holding up the view;
+        // the groups are built on the file it leaves in the view
+        stop_record();
 		{
             boost::lock_guard<boost::mutex> lock(_data_mutex);
             if (_cur_logic_snapshot) {
@@ -1089,7 +1422,7 @@ void SigSession::data_feed_in(const struct sr_dev_inst *sdi,
                     assert(g);
 
                     _cur_group_snapshot = boost::shared_ptr<data::GroupSnapshot>(
-                                new data::GroupSnapshot(_logic_data->get_snapshots().front(), g->get_index_list()));
+                                new data::GroupSnapshot(_logic_data->get_snapshot(), g->get_index_list()));
                     _group_data->push_snapshot(_cur_group_snapshot);
                     _cur_group_snapshot.reset();
                 }
@@ -1119,6 +1452,184 @@ void SigSession::data_feed_in_proc(const struct sr_dev_inst *sdi,
 	_session->data_feed_in(sdi, packet);
 }
 
+/*
+ * synchronized devices
+ */
+void SigSession::set_sync_capture(bool enable)
+{
+    _sync_capture = enable;
+}
+
+bool SigSession::get_sync_capture() const
+{
+    return _sync_capture;
+}
+
+void SigSession::add_sync_devices()
+{
+    assert(_sync_devices.empty());
+
+    if (!_sync_capture || !_dev_inst ||
+        dynamic_pointer_cast<device::File>(_dev_inst))
+        return;
+
+    const sr_dev_inst *const main_sdi = _dev_inst->dev_inst();
+    if (main_sdi->mode != LOGIC)
+        return;
+
+    BOOST_FOREACH(const boost::shared_ptr<device::DevInst> &dev_inst,
+                  _device_manager.devices()) {
+        sr_dev_inst *const sdi = dev_inst->dev_inst();
+        if (dev_inst == _dev_inst || !sdi ||
+            sdi->driver != main_sdi->driver || sdi->mode != LOGIC)
+            continue;
+
+        // The selected device's session runs them all, each device's
+        // data is taken in by a subscriber of its own
+        boost::shared_ptr<SyncDevice> sync(new SyncDevice());
+        sync->dev_inst = dev_inst;
+        sync->logic_data.reset(new data::Logic());
+        sync->subscription = NULL;
+        sync->sample_limit = 0;
+        sync->triggered = false;
+        sync->trigger_pos = 0;
+
+        const int ret = sr_dev_open(sdi);
+        if (ret != SR_OK) {
+            qDebug() << "Failed to open" << dev_inst->format_device_title()
+                     << "for a synchronised capture:" << ret;
+            continue;
+        }
+        if (sr_session_dev_add(sdi) != SR_OK) {
+            sr_dev_close(sdi);
+            continue;
+        }
+        if (sr_session_datafeed_subscribe_dev(sdi, sync_feed_in_proc,
+                sync.get(), FeedQueueSize, SR_BUS_COALESCE,
+                &sync->subscription) != SR_OK) {
+            sr_session_dev_remove(sdi);
+            sr_dev_close(sdi);
+            continue;
+        }
+        _sync_devices.push_back(sync);
+    }
+}
+
+void SigSession::clear_sync_devices()
+{
+    if (_sync_devices.empty())
+        return;
+
+    BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices) {
+        sr_dev_inst *const sdi = sync->dev_inst->dev_inst();
+        sr_session_datafeed_unsubscribe(sync->subscription);
+        sr_session_dev_remove(sdi);
+        sr_dev_close(sdi);
+    }
+    _sync_devices.clear();
+}
+
+void SigSession::add_sync_signals(
+    vector< boost::shared_ptr<view::Signal> > &sigs)
+{
+    BOOST_FOREACH(const boost::shared_ptr<SyncDevice> &sync, _sync_devices) {
+        const QString title = sync->dev_inst->format_device_title();
+        for (const GSList *l = sync->dev_inst->dev_inst()->channels;
+            l; l = l->next) {
+            const sr_channel *const probe = (const sr_channel *)l->data;
+            if (probe->type != SR_CHANNEL_LOGIC || !probe->enabled)
+                continue;
+            boost::shared_ptr<view::Signal> signal(
+                new view::LogicSignal(sync->dev_inst, sync->logic_data, probe));
+            signal->set_name(title + " " + probe->name);
+            sigs.push_back(signal);
+        }
+    }
+}
+
+void SigSession::align_sync_device(SyncDevice &sync)
+{
+    // Both devices saw the trigger at the same time
+    if (!_triggered || !sync.triggered)
+        return;
+
+    const double samplerate = sync.logic_data->samplerate();
+    if (samplerate > 0)
+        sync.logic_data->set_start_time(
+            ((double)_trigger_pos - (double)sync.trigger_pos) / samplerate);
+}
+
+void SigSession::sync_feed_in(SyncDevice &sync,
+    const struct sr_dev_inst *sdi,
+    const struct sr_datafeed_packet *packet)
+{
+    if (_data_lock)
+        return;
+
+    switch (packet->type) {
+    case SR_DF_HEADER:
+    {
+        GVariant *gvar;
+        if (sr_config_get(sdi->driver, sdi, NULL, NULL,
+                          SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+            boost::lock_guard<boost::mutex> lock(sync.mutex);
+            // Like the main device, the last capture stays in view
+            const uint64_t sample_rate = g_variant_get_uint64(gvar);
+            if (sync.logic_data->samplerate() != sample_rate)
+                sync.logic_data->set_samplerate(sample_rate);
+            g_variant_unref(gvar);
+        }
+        break;
+    }
+
+    case SR_DF_TRIGGER:
+    {
+        assert(packet->payload);
+        boost::lock_guard<boost::mutex> lock(_sync_mutex);
+        sync.triggered = true;
+        sync.trigger_pos = ((const ds_trigger_pos*)packet->payload)->real_pos;
+        align_sync_device(sync);
+        break;
+    }
+
+    case SR_DF_LOGIC:
+    {
+        assert(packet->payload);
+        const sr_datafeed_logic &logic =
+            *(const sr_datafeed_logic*)packet->payload;
+        boost::lock_guard<boost::mutex> lock(sync.mutex);
+        if (!sync.cur_snapshot) {
+            sync.cur_snapshot = new_logic_snapshot(
+                *sync.logic_data, logic, sync.sample_limit);
+            if (sync.cur_snapshot->buf_null()) {
+                malloc_error();
+                break;
+            }
+            sync.logic_data->push_snapshot(sync.cur_snapshot);
+        } else if (!sync.cur_snapshot->buf_null()) {
+            sync.cur_snapshot->append_payload(logic);
+        }
+        data_received();
+        break;
+    }
+
+    case SR_DF_END:
+    {
+        boost::lock_guard<boost::mutex> lock(sync.mutex);
+        sync.cur_snapshot.reset();
+        break;
+    }
+    }
+}
+
+void SigSession::sync_feed_in_proc(const struct sr_dev_inst *sdi,
+    const struct sr_datafeed_packet *packet, void *cb_data)
+{
+    assert(_session);
+    assert(cb_data);
+    _session->sync_feed_in(*(SyncDevice*)cb_data, sdi, packet);
+}
+
 /*
  * hotplug function
  */
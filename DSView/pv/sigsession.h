@@ -29,6 +29,7 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include <atomic>
 #include <string>
 #include <utility>
 #include <map>
@@ -56,6 +57,7 @@ struct srd_channel;
 namespace pv {
 
 class DeviceManager;
+class Recorder;
 
 namespace data {
 class SignalData;
@@ -92,6 +94,9 @@ private:
     static constexpr float Oversampling = 2.0f;
     static const int ViewTime = 800;
     static const int RefreshTime = 500;
+    // Packets the data feed may be behind the device before it coalesces
+    static const unsigned int FeedQueueSize = 16;
+    static const uint64_t RecordWindowSamples;
 	bool saveFileThreadRunning = false;
 
 public:
@@ -175,6 +180,52 @@ public:
 
     bool get_data_lock();
 
+    /**
+     * Records the logic samples of the following captures to a session
+     * file while they are acquired, only the latest RecordWindowSamples
+     * samples are kept in memory. The view shows the file once the
+     * capture ends.
+     * @param name the session file, or empty to stop recording.
+     * @param compress whether the blocks of the file are compressed,
+     * which may not keep up with the highest stream rates.
+     **/
+    void set_record_file(const QString &name, bool compress = false);
+
+    QString get_record_file() const;
+
+    /**
+     * Captures with the other logic devices of the selected device's
+     * driver too. Each device's data is taken in on a thread of its own
+     * and put on the selected device's timeline by the trigger positions.
+     * Takes effect with the next init_signals().
+     **/
+    void set_sync_capture(bool enable);
+    bool get_sync_capture() const;
+
+private:
+    // A device which captures together with the selected one
+    struct SyncDevice {
+        boost::shared_ptr<device::DevInst> dev_inst;
+        boost::shared_ptr<data::Logic> logic_data;
+        boost::shared_ptr<data::LogicSnapshot> cur_snapshot;
+        sr_datafeed_subscription *subscription;
+        boost::mutex mutex;
+        uint64_t sample_limit;
+        bool triggered;
+        uint64_t trigger_pos;
+    };
+
+    void add_sync_devices();
+    void clear_sync_devices();
+    void add_sync_signals(
+        std::vector< boost::shared_ptr<view::Signal> > &sigs);
+    void align_sync_device(SyncDevice &sync);
+    void sync_feed_in(SyncDevice &sync,
+        const struct sr_dev_inst *sdi,
+        const struct sr_datafeed_packet *packet);
+    static void sync_feed_in_proc(const struct sr_dev_inst *sdi,
+        const struct sr_datafeed_packet *packet, void *cb_data);
+
 private:
 	void set_capture_state(capture_state state);
 
@@ -196,6 +247,13 @@ private:
         boost::function<void (const QString)> error_handler,
         sr_input_format *format = NULL);
 
+    void start_record(int unit_size);
+    void stop_record();
+
+    static boost::shared_ptr<data::LogicSnapshot> new_logic_snapshot(
+        data::Logic &logic_data, const sr_datafeed_logic &logic,
+        uint64_t sample_limit);
+
     void sample_thread_proc(boost::shared_ptr<device::DevInst> dev_inst,
                             boost::function<void (const QString)> error_handler);
 
@@ -205,8 +263,12 @@ private:
 		const sr_datafeed_meta &meta);
     void feed_in_trigger(const ds_trigger_pos &trigger_pos);
 	void feed_in_logic(const sr_datafeed_logic &logic);
+    void feed_in_logic_map(const sr_datafeed_logic_map &logic_map);
+
+    void feed_in_logic_blocks(const sr_datafeed_logic_blocks &logic_blocks);
     void feed_in_dso(const sr_datafeed_dso &dso);
 	void feed_in_analog(const sr_datafeed_analog &analog);
+    void feed_in_analog_pcm(const sr_datafeed_analog_pcm &pcm);
 	void data_feed_in(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
 	static void data_feed_in_proc(const struct sr_dev_inst *sdi,
@@ -224,6 +286,7 @@ private:
 	 * The device instance that will be used in the next capture session.
 	 */
     boost::shared_ptr<device::DevInst> _dev_inst;
+    sr_datafeed_subscription *_feed_subscription;
 
 	mutable boost::mutex _sampling_mutex;
 	capture_state _capture_state;
@@ -254,9 +317,22 @@ private:
     bool _hot_attach;
     bool _hot_detach;
 
+    QString _record_file;
+    bool _record_compress;
+    boost::shared_ptr<Recorder> _recorder;
+    uint64_t _record_window;
+
     QTimer _view_timer;
     QTimer _refresh_timer;
-    bool _data_lock;
+    // Read by the subscriber threads of the datafeed
+    std::atomic<bool> _data_lock;
+
+    bool _sync_capture;
+    std::vector< boost::shared_ptr<SyncDevice> > _sync_devices;
+    // Guards the trigger positions the devices are aligned by
+    mutable boost::mutex _sync_mutex;
+    bool _triggered;
+    uint64_t _trigger_pos;
 
 signals:
 	void capture_state_changed(int state);
@@ -288,6 +364,8 @@ signals:
 
     void malloc_error();
 
+    void record_finished(QString info);
+
     void zero_adj();
     void progressSaveFileValueChanged(int percent);
 
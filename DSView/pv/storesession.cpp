@@ -96,17 +96,13 @@ bool StoreSession::start()
 	}
 
 	// Get the snapshot
-	const deque< shared_ptr<data::LogicSnapshot> > &snapshots =
-		data->get_snapshots();
+	const shared_ptr<data::LogicSnapshot> snapshot(data->get_snapshot());
 
-	if (snapshots.empty()) {
+	if (!snapshot) {
 		_error = tr("No snapshots to save.");
 		return false;
 	}
 
-	const shared_ptr<data::LogicSnapshot> snapshot(snapshots.front());
-	assert(snapshot);
-
 	// Make a list of probes
 	char **const probes = new char*[sigs.size() + 1];
 	for (size_t i = 0; i < sigs.size(); i++) {
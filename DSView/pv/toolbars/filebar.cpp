@@ -109,6 +109,15 @@ FileBar::FileBar(SigSession &session, QWidget *parent) :
     _action_capture->setObjectName(QString::fromUtf8("actionCapture"));
     connect(_action_capture, SIGNAL(triggered()), this, SLOT(on_actionCapture_triggered()));
 
+    _action_record = new QAction(this);
+    _action_record->setText(QApplication::translate(
+        "File", "&Record to File...", 0));
+    _action_record->setIcon(QIcon::fromTheme("file",
+        QIcon(":/icons/save.png")));
+    _action_record->setObjectName(QString::fromUtf8("actionRecord"));
+    _action_record->setCheckable(true);
+    connect(_action_record, SIGNAL(triggered(bool)), this, SLOT(on_actionRecord_triggered(bool)));
+
     _file_button.setPopupMode(QToolButton::InstantPopup);
 #ifdef LANGUAGE_ZH_CN
     _file_button.setIcon(QIcon(":/icons/file_cn.png"));
@@ -122,6 +131,7 @@ FileBar::FileBar(SigSession &session, QWidget *parent) :
     _menu->addAction(_action_save);
     _menu->addAction(_action_export);
     _menu->addAction(_action_capture);
+    _menu->addAction(_action_record);
     _file_button.setMenu(_menu);
     addWidget(&_file_button);
 }
@@ -214,6 +224,27 @@ void FileBar::on_actionSave_triggered()
     }
 }
 
+void FileBar::on_actionRecord_triggered(bool checked)
+{
+    if (!checked) {
+        _session.set_record_file(QString());
+        return;
+    }
+
+    // Logic captures which follow are written to the file as they arrive
+    QString file_name = QFileDialog::getSaveFileName(
+                    this, tr("Record to File"), "",
+                    tr("DSView Data (*.dsl)"));
+    if (file_name.isEmpty()) {
+        _action_record->setChecked(false);
+        return;
+    }
+
+    QFileInfo f(file_name);
+    if(f.suffix().compare("dsl"))
+        file_name.append(tr(".dsl"));
+    _session.set_record_file(file_name);
+}
 
 void FileBar::on_actionLoad_triggered()
 {
@@ -65,6 +65,7 @@ private slots:
     void on_actionSave_triggered();
     void on_actionCapture_triggered();
     void on_actionExport_triggered();
+    void on_actionRecord_triggered(bool checked);
 
 private:
     bool _enable;
@@ -83,6 +84,7 @@ private:
     QAction *_action_save;
     QAction *_action_export;
     QAction *_action_capture;
+    QAction *_action_record;
 
 };
 
@@ -136,18 +136,13 @@ void AnalogSignal::paint_trace(QPainter &p,
         p.setPen(_colour);
         //p.setPen(QPen(_colour, 2, Qt::SolidLine));
 
-        QPointF *points = new QPointF[sample_count];
-        QPointF *point = points;        
-        for (int64_t sample = start; sample != end; sample++) {
-            const float x = (sample / samples_per_pixel -
-                pixels_offset) + left;
-            *point++ = QPointF(x,
-                               y - samples[(sample - start) * channel_num + get_index()] * _scale);
-        }
-
-        p.drawPolyline(points, point - points);
-        //delete[] samples;
-        delete[] points;
+        _decimator.set_y_transform(y, -_scale);
+        const int point_count = _decimator.decimate(
+            samples + get_index(), sample_count, channel_num,
+            (start / samples_per_pixel - pixels_offset) + left,
+            samples_per_pixel);
+
+        p.drawPolyline(_decimator.points(), point_count);
     }
 }
 
@@ -169,7 +164,9 @@ void AnalogSignal::paint_envelope(QPainter &p,
     //p.setPen(QPen(_colour, 2, Qt::SolidLine));
     p.setBrush(_colour);
 
-	QRectF *const rects = new QRectF[e.length];
+    if (_envelope_rects.size() < e.length)
+        _envelope_rects.resize(e.length);
+    QRectF *const rects = &_envelope_rects[0];
 	QRectF *rect = rects;
 
 	for(uint64_t sample = 0; sample < e.length-1; sample++) {
@@ -192,10 +189,7 @@ void AnalogSignal::paint_envelope(QPainter &p,
 		*rect++ = QRectF(x, t, 1.0f, h);
 	}
 
-	p.drawRects(rects, e.length);
-
-	delete[] rects;
-    //delete[] e.samples;
+	p.drawRects(rects, rect - rects);
 }
 
 const std::vector< std::pair<uint64_t, bool> > AnalogSignal::cur_edges() const
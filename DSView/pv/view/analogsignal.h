@@ -25,6 +25,7 @@
 #define DSVIEW_PV_ANALOGSIGNAL_H
 
 #include "signal.h"
+#include "polylinedecimator.h"
 
 #include <boost/shared_ptr.hpp>
 
@@ -81,6 +82,9 @@ private:
 private:
 	boost::shared_ptr<pv::data::Analog> _data;
 	float _scale;
+
+	PolylineDecimator _decimator;
+	std::vector<QRectF> _envelope_rects;
 };
 
 } // namespace view
@@ -928,37 +928,22 @@ void DsoSignal::paint_trace(QPainter &p,
         trace_colour.setAlpha(150);
         p.setPen(trace_colour);
 
-        QPointF *points = new QPointF[sample_count];
-        QPointF *point = points;
-
         float top = get_view_rect().top();
         float bottom = get_view_rect().bottom();
         float zeroP = _zeroPos * get_view_rect().height() + top;;
         if (strcmp(_dev_inst->dev_inst()->driver->name, "DSCope") == 0 &&
             _view->session().get_capture_state() == SigSession::Running)
             _zero_off = _zeroPos * 255;
-        float x = (start / samples_per_pixel - pixels_offset) + left;
-        double  pixels_per_sample = 1.0/samples_per_pixel;
-        uint8_t offset;
-        int64_t sample_end = sample_count*num_channels;
-        for (int64_t sample = 0; sample < sample_end; sample+=num_channels) {
-            //const float x = (sample / samples_per_pixel - pixels_offset) + left;
-            //uint8_t offset = samples[(sample - start)*num_channels];
-
-            //offset = samples[(sample - start)*num_channels];
-            offset = samples[sample];
-            const float y = min(max(top, zeroP + (offset - _zero_off) * _scale), bottom);
-            *point++ = QPointF(x, y);
-            x += pixels_per_sample;
-            //*point++ = QPointF(x, top + offset);
-        }
 
-        p.drawPolyline(points, point - points);
+        _decimator.set_y_transform(zeroP - _zero_off * _scale, _scale,
+                                   top, bottom);
+        const int point_count = _decimator.decimate(samples, sample_count,
+            num_channels, (start / samples_per_pixel - pixels_offset) + left,
+            samples_per_pixel);
+
+        p.drawPolyline(_decimator.points(), point_count);
         p.eraseRect(get_view_rect().right(), get_view_rect().top(),
                     _view->viewport()->width() - get_view_rect().width(), get_view_rect().height());
-
-        //delete[] samples;
-        delete[] points;
     }
 }
 
@@ -985,7 +970,9 @@ void DsoSignal::paint_envelope(QPainter &p,
     envelope_colour.setAlpha(150);
     p.setBrush(envelope_colour);
 
-	QRectF *const rects = new QRectF[e.length];
+    if (_envelope_rects.size() < e.length)
+        _envelope_rects.resize(e.length);
+    QRectF *const rects = &_envelope_rects[0];
 	QRectF *rect = rects;
     float top = get_view_rect().top();
     float bottom = get_view_rect().bottom();
@@ -1013,10 +1000,7 @@ void DsoSignal::paint_envelope(QPainter &p,
 		*rect++ = QRectF(x, t, 1.0f, h);
 	}
 
-	p.drawRects(rects, e.length);
-
-	delete[] rects;
-    //delete[] e.samples;
+	p.drawRects(rects, rect - rects);
 }
 
 const std::vector< std::pair<uint64_t, bool> > DsoSignal::cur_edges() const
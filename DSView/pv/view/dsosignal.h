@@ -24,6 +24,7 @@
 #define DSVIEW_PV_DSOSIGNAL_H
 
 #include "signal.h"
+#include "polylinedecimator.h"
 
 #include <boost/shared_ptr.hpp>
 
@@ -258,6 +259,9 @@ private:
     bool _ms_show;
     bool _ms_en[DSO_MS_END-DSO_MS_BEGIN];
     QString _ms_string[DSO_MS_END-DSO_MS_BEGIN];
+
+    PolylineDecimator _decimator;
+    std::vector<QRectF> _envelope_rects;
 };
 
 } // namespace view
@@ -123,26 +123,19 @@ void GroupSignal::paint_trace(QPainter &p,
 	const double pixels_offset, const double samples_per_pixel)
 {
 	const int64_t sample_count = end - start;
+    if (sample_count <= 0)
+        return;
 
-    const uint16_t *samples = snapshot->get_samples(start, end);
-	assert(samples);
+    if ((int64_t)_samples.size() < sample_count)
+        _samples.resize(sample_count);
+    snapshot->get_samples(&_samples[0], start, end);
 
 	p.setPen(_colour);
 
-	QPointF *points = new QPointF[sample_count];
-	QPointF *point = points;
-
-	for (int64_t sample = start; sample != end; sample++) {
-		const float x = (sample / samples_per_pixel -
-			pixels_offset) + left;
-		*point++ = QPointF(x,
-			y - samples[sample - start] * _scale);
-	}
-
-	p.drawPolyline(points, point - points);
-
-	delete[] samples;
-	delete[] points;
+    _decimator.set_y_transform(y, -_scale);
+    const int point_count = _decimator.decimate(&_samples[0], sample_count, 1,
+        (start / samples_per_pixel - pixels_offset) + left, samples_per_pixel);
+    p.drawPolyline(_decimator.points(), point_count);
 }
 
 void GroupSignal::paint_envelope(QPainter &p,
@@ -154,41 +147,46 @@ void GroupSignal::paint_envelope(QPainter &p,
     using pv::data::GroupSnapshot;
 
     GroupSnapshot::EnvelopeSection e;
-	snapshot->get_envelope_section(e, start, end, samples_per_pixel);
-
-	if (e.length < 2)
-		return;
 
 	p.setPen(QPen(NoPen));
 	p.setBrush(_colour);
 
-	QRectF *const rects = new QRectF[e.length];
-	QRectF *rect = rects;
-
-	for(uint64_t sample = 0; sample < e.length-1; sample++) {
-		const float x = ((e.scale * sample + e.start) /
-			samples_per_pixel - pixels_offset) + left;
-        const GroupSnapshot::EnvelopeSample *const s =
-			e.samples + sample;
-
-		// We overlap this sample with the next so that vertical
-		// gaps do not appear during steep rising or falling edges
-		const float b = y - max(s->max, (s+1)->min) * _scale;
-		const float t = y - min(s->min, (s+1)->max) * _scale;
-
-		float h = b - t;
-		if(h >= 0.0f && h <= 1.0f)
-			h = 1.0f;
-		if(h <= 0.0f && h >= -1.0f)
-			h = -1.0f;
-
-		*rect++ = QRectF(x, t, 1.0f, h);
+	// The runs which are not built yet are left blank, the session
+	// repaints once the snapshot has finished them
+	uint64_t pos = start;
+	while (pos < (uint64_t)end &&
+		snapshot->get_envelope_section(e, pos, end, samples_per_pixel)) {
+		pos = e.start + e.length * e.scale;
+		if (e.length < 2)
+			continue;
+
+		if (_envelope_rects.size() < e.length)
+			_envelope_rects.resize(e.length);
+		QRectF *const rects = &_envelope_rects[0];
+		QRectF *rect = rects;
+
+		for(uint64_t sample = 0; sample < e.length-1; sample++) {
+			const float x = ((e.scale * sample + e.start) /
+				samples_per_pixel - pixels_offset) + left;
+			const GroupSnapshot::EnvelopeSample *const s =
+				e.samples + sample;
+
+			// We overlap this sample with the next so that vertical
+			// gaps do not appear during steep rising or falling edges
+			const float b = y - max(s->max, (s+1)->min) * _scale;
+			const float t = y - min(s->min, (s+1)->max) * _scale;
+
+			float h = b - t;
+			if(h >= 0.0f && h <= 1.0f)
+				h = 1.0f;
+			if(h <= 0.0f && h >= -1.0f)
+				h = -1.0f;
+
+			*rect++ = QRectF(x, t, 1.0f, h);
+		}
+
+		p.drawRects(rects, rect - rects);
 	}
-
-	p.drawRects(rects, e.length);
-
-	delete[] rects;
-	delete[] e.samples;
 }
 
 const std::vector< std::pair<uint64_t, bool> > GroupSignal::cur_edges() const
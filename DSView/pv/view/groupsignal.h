@@ -25,9 +25,11 @@
 #define DSVIEW_SV_GROUPSIGNAL_H
 
 #include "signal.h"
+#include "polylinedecimator.h"
 #include "../data/groupsnapshot.h"
 
 #include <list>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 namespace pv {
@@ -98,6 +100,11 @@ private:
 private:
     boost::shared_ptr<pv::data::Group> _data;
 	float _scale;
+
+    // Buffers reused by every repaint
+    std::vector<uint16_t> _samples;
+    PolylineDecimator _decimator;
+    std::vector<QRectF> _envelope_rects;
 };
 
 } // namespace view
@@ -156,13 +156,11 @@ void LogicSignal::paint_mid(QPainter &p, int left, int right)
     const float high_offset = y - _signalHeight + 0.5f;
 	const float low_offset = y + 0.5f;
 
-	const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-		_data->get_snapshots();
-	if (snapshots.empty())
+	const boost::shared_ptr<pv::data::LogicSnapshot> snapshot =
+		_data->get_snapshot();
+	if (!snapshot)
 		return;
 
-	const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-		snapshots.front();
     if (snapshot->buf_null())
         return;
 
@@ -315,13 +313,11 @@ bool LogicSignal::measure(const QPointF &p, uint64_t &index0, uint64_t &index1,
 {
     const float gap = abs(p.y() - get_y());
     if (gap < get_signalHeight() * 0.5) {
-        const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-            _data->get_snapshots();
-        if (snapshots.empty())
+        const boost::shared_ptr<pv::data::LogicSnapshot> snapshot =
+            _data->get_snapshot();
+        if (!snapshot)
             return false;
 
-        const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-            snapshots.front();
         if (snapshot->buf_null())
             return false;
 
@@ -360,13 +356,11 @@ bool LogicSignal::edges(const QPointF &p, uint64_t start, uint64_t &rising, uint
     uint64_t index, end;
     const float gap = abs(p.y() - get_y());
     if (gap < get_signalHeight() * 0.5) {
-        const deque< boost::shared_ptr<pv::data::LogicSnapshot> > &snapshots =
-            _data->get_snapshots();
-        if (snapshots.empty())
+        const boost::shared_ptr<pv::data::LogicSnapshot> snapshot =
+            _data->get_snapshot();
+        if (!snapshot)
             return false;
 
-        const boost::shared_ptr<pv::data::LogicSnapshot> &snapshot =
-            snapshots.front();
         if (snapshot->buf_null())
             return false;
 
@@ -0,0 +1,225 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "polylinedecimator.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace pv {
+namespace view {
+
+PolylineDecimator::PolylineDecimator() :
+    _offset(0),
+    _gain(1),
+    _top(-FLT_MAX),
+    _bottom(FLT_MAX)
+{
+}
+
+void PolylineDecimator::set_y_transform(float offset, float gain,
+    float top, float bottom)
+{
+    _offset = offset;
+    _gain = gain;
+    _top = top;
+    _bottom = bottom;
+}
+
+const QPointF* PolylineDecimator::points() const
+{
+    return _points.empty() ? NULL : &_points[0];
+}
+
+int PolylineDecimator::decimate(const uint8_t *samples, int64_t count,
+    unsigned int stride, double x0, double samples_per_pixel)
+{
+    return decimate_samples(samples, count, stride, x0, samples_per_pixel);
+}
+
+int PolylineDecimator::decimate(const uint16_t *samples, int64_t count,
+    unsigned int stride, double x0, double samples_per_pixel)
+{
+    return decimate_samples(samples, count, stride, x0, samples_per_pixel);
+}
+
+float PolylineDecimator::map_y(unsigned int value) const
+{
+    return min(max(_top, _offset + value * _gain), _bottom);
+}
+
+template <typename T>
+int PolylineDecimator::decimate_samples(const T *samples, int64_t count,
+    unsigned int stride, double x0, double samples_per_pixel)
+{
+    assert(samples);
+    assert(stride > 0);
+    assert(samples_per_pixel > 0);
+
+    if (count <= 0)
+        return 0;
+
+    const double pixels_per_sample = 1.0 / samples_per_pixel;
+
+    // A column holds either its samples, or first/min/max/last
+    const int64_t columns = (int64_t)ceil(count * pixels_per_sample) + 2;
+    const int64_t max_points = min(count, columns * MinColumnSamples);
+    if ((int64_t)_points.size() < max_points)
+        _points.resize(max_points);
+
+    QPointF *point = &_points[0];
+    int64_t index = 0;
+    while (index < count) {
+        const double x = x0 + index * pixels_per_sample;
+        const double column = floor(x);
+
+        // Find the first sample which falls into the next pixel column,
+        // correcting for the rounding of the division
+        int64_t next = (int64_t)ceil((column + 1 - x0) * samples_per_pixel);
+        next = min(max(next, index + 1), count);
+        while (next < count &&
+               floor(x0 + next * pixels_per_sample) == column)
+            next++;
+        while (next - 1 > index &&
+               floor(x0 + (next - 1) * pixels_per_sample) != column)
+            next--;
+
+        const T *const src = samples + index * stride;
+        const int64_t n = next - index;
+        if (n <= MinColumnSamples) {
+            for (int64_t i = 0; i < n; i++)
+                *point++ = QPointF(x0 + (index + i) * pixels_per_sample,
+                                   map_y(src[i * stride]));
+        } else {
+            T min_value, max_value;
+            minmax(src, n, stride, min_value, max_value);
+
+            // All vertices lie in the same pixel column, so the vertical
+            // span is drawn exactly as the full polyline would draw it.
+            *point++ = QPointF(x, map_y(src[0]));
+            *point++ = QPointF(x, map_y(min_value));
+            *point++ = QPointF(x, map_y(max_value));
+            *point++ = QPointF(x0 + (next - 1) * pixels_per_sample,
+                               map_y(src[(n - 1) * stride]));
+        }
+
+        index = next;
+    }
+
+    assert(point - &_points[0] <= max_points);
+    return point - &_points[0];
+}
+
+void PolylineDecimator::minmax(const uint8_t *samples, int64_t count,
+    unsigned int stride, uint8_t &min_value, uint8_t &max_value)
+{
+    assert(count > 0);
+
+    min_value = max_value = samples[0];
+    int64_t i = 0;
+
+#ifdef __SSE2__
+    // The channel repeats at the same lanes of every vector when the
+    // stride divides the vector width, so interleaved channels are reduced
+    // column-wise and only the lanes of this channel are kept at the end.
+    if ((16 % stride) == 0) {
+        const int64_t vectors = ((count - 1) * stride + 1) / 16;
+        if (vectors > 0) {
+            __m128i vmin = _mm_loadu_si128((const __m128i*)samples);
+            __m128i vmax = vmin;
+            for (int64_t v = 1; v < vectors; v++) {
+                const __m128i d = _mm_loadu_si128(
+                    (const __m128i*)(samples + v * 16));
+                vmin = _mm_min_epu8(vmin, d);
+                vmax = _mm_max_epu8(vmax, d);
+            }
+
+            uint8_t lanes_min[16], lanes_max[16];
+            _mm_storeu_si128((__m128i*)lanes_min, vmin);
+            _mm_storeu_si128((__m128i*)lanes_max, vmax);
+            for (unsigned int l = 0; l < 16; l += stride) {
+                min_value = std::min(min_value, lanes_min[l]);
+                max_value = std::max(max_value, lanes_max[l]);
+            }
+            i = vectors * 16 / stride;
+        }
+    }
+#endif
+
+    for (const uint8_t *p = samples + i * stride; i < count; i++, p += stride) {
+        min_value = std::min(min_value, *p);
+        max_value = std::max(max_value, *p);
+    }
+}
+
+void PolylineDecimator::minmax(const uint16_t *samples, int64_t count,
+    unsigned int stride, uint16_t &min_value, uint16_t &max_value)
+{
+    assert(count > 0);
+
+    min_value = max_value = samples[0];
+    int64_t i = 0;
+
+#ifdef __SSE2__
+    if ((8 % stride) == 0) {
+        const int64_t vectors = ((count - 1) * stride + 1) / 8;
+        if (vectors > 0) {
+            // SSE2 only compares signed words, so flip the sign bit
+            const __m128i bias = _mm_set1_epi16((short)0x8000);
+            __m128i vmin = _mm_xor_si128(bias,
+                _mm_loadu_si128((const __m128i*)samples));
+            __m128i vmax = vmin;
+            for (int64_t v = 1; v < vectors; v++) {
+                const __m128i d = _mm_xor_si128(bias, _mm_loadu_si128(
+                    (const __m128i*)(samples + v * 8)));
+                vmin = _mm_min_epi16(vmin, d);
+                vmax = _mm_max_epi16(vmax, d);
+            }
+
+            uint16_t lanes_min[8], lanes_max[8];
+            _mm_storeu_si128((__m128i*)lanes_min, _mm_xor_si128(bias, vmin));
+            _mm_storeu_si128((__m128i*)lanes_max, _mm_xor_si128(bias, vmax));
+            for (unsigned int l = 0; l < 8; l += stride) {
+                min_value = std::min(min_value, lanes_min[l]);
+                max_value = std::max(max_value, lanes_max[l]);
+            }
+            i = vectors * 8 / stride;
+        }
+    }
+#endif
+
+    for (const uint16_t *p = samples + i * stride; i < count; i++, p += stride) {
+        min_value = std::min(min_value, *p);
+        max_value = std::max(max_value, *p);
+    }
+}
+
+} // namespace view
+} // namespace pv
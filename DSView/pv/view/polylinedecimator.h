@@ -0,0 +1,105 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef DSVIEW_PV_VIEW_POLYLINEDECIMATOR_H
+#define DSVIEW_PV_VIEW_POLYLINEDECIMATOR_H
+
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+#include <QPointF>
+
+namespace PolylineDecimatorTest {
+class MinMax;
+}
+
+namespace pv {
+namespace view {
+
+/**
+ * Reduces a run of raw samples to a polyline of at most four vertices
+ * per pixel column (first, min, max, last). The drawn result covers the
+ * same pixels as the undecimated polyline, but its cost is bounded by the
+ * width of the view instead of the number of samples.
+ *
+ * The vertex buffer is kept between calls, so repainting does not touch
+ * the heap once it has grown to the widest view.
+ */
+class PolylineDecimator
+{
+private:
+    static const int64_t MinColumnSamples = 4;
+
+public:
+    PolylineDecimator();
+
+    /**
+     * Sets the mapping of a sample value to the y-coordinate:
+     * y = min(max(offset + value * gain, top), bottom)
+     **/
+    void set_y_transform(float offset, float gain,
+        float top = -FLT_MAX, float bottom = FLT_MAX);
+
+    /**
+     * Builds the polyline of one channel.
+     * @param samples pointer to the first sample of the channel.
+     * @param count the number of samples to draw.
+     * @param stride the distance in elements between two samples of
+     * the channel, i.e. the number of interleaved channels.
+     * @param x0 the x-coordinate of the first sample.
+     * @param samples_per_pixel the horizontal scale.
+     * @return the number of points placed into points().
+     **/
+    int decimate(const uint8_t *samples, int64_t count,
+        unsigned int stride, double x0, double samples_per_pixel);
+    int decimate(const uint16_t *samples, int64_t count,
+        unsigned int stride, double x0, double samples_per_pixel);
+
+    const QPointF* points() const;
+
+private:
+    template <typename T>
+    int decimate_samples(const T *samples, int64_t count,
+        unsigned int stride, double x0, double samples_per_pixel);
+
+    inline float map_y(unsigned int value) const;
+
+    static void minmax(const uint8_t *samples, int64_t count,
+        unsigned int stride, uint8_t &min, uint8_t &max);
+    static void minmax(const uint16_t *samples, int64_t count,
+        unsigned int stride, uint16_t &min, uint16_t &max);
+
+private:
+    std::vector<QPointF> _points;
+    float _offset;
+    float _gain;
+    float _top;
+    float _bottom;
+
+    friend class PolylineDecimatorTest::MinMax;
+};
+
+} // namespace view
+} // namespace pv
+
+#endif // DSVIEW_PV_VIEW_POLYLINEDECIMATOR_H
@@ -0,0 +1,692 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Throughput of the logic capture path, from the packets of the driver to
+ * what the view and the exports read back. Not run by "make test", start
+ * it by hand: DSView-bench [OPTION…] > results.json
+ *
+ * Each measurement is printed as a line of JSON, the best of a number of
+ * rounds, so the results of releases can be compared by a script:
+ *   append       LogicSnapshot::append_payload(), copy and mip-map
+ *   mipmap       the mip-map part of it, from the pipeline metrics
+ *   restart      captures run one after the other, into new snapshots
+ *                and into the snapshots Logic recycles
+ *   edges        the edges of the channels of a view scrolled through
+ *                the capture, at a number of samples per pixel
+ *   live         the edges of the newest samples while the capture is
+ *                appended by another thread, as the view paints them
+ *   annotations  the annotations of a decoder row, the same way
+ *   export       the capture through an output module
+ */
+
+#ifdef ENABLE_DECODE
+#include <libsigrokdecode/libsigrokdecode.h> /* First, so we avoid a _POSIX_C_SOURCE warning. */
+#endif
+
+#include <extdef.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "../pv/data/logic.h"
+#include "../pv/data/logicsnapshot.h"
+#ifdef ENABLE_DECODE
+#include "../pv/data/decode/annotation.h"
+#include "../pv/data/decode/rowdata.h"
+#endif
+
+#include "config.h"
+
+using boost::shared_ptr;
+using std::max;
+using std::min;
+using std::sort;
+using std::unique;
+using std::string;
+using std::vector;
+
+using pv::data::Logic;
+using pv::data::LogicSnapshot;
+
+namespace {
+
+// The width of the view in pixels
+const uint64_t ViewWidth = 1920;
+
+// Samples per annotation, a UART byte of 8 samples per bit
+const uint64_t AnnotationSamples = 80;
+
+struct Options
+{
+	uint64_t samples;
+	vector<uint64_t> unit_sizes;
+	vector<uint64_t> packet_sizes;
+	vector<uint64_t> channels;
+	vector<uint64_t> scales;
+	vector<string> output_ids;
+	uint64_t export_samples;
+	uint64_t live_rate;
+	int rounds;
+};
+
+double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool parse_list(const char *arg, vector<uint64_t> &list)
+{
+	list.clear();
+	for (const char *p = arg; *p; ) {
+		char *end;
+		const uint64_t value = strtoull(p, &end, 0);
+		if (end == p || value == 0 || (*end && *end != ','))
+			return false;
+		list.push_back(value);
+		p = *end ? end + 1 : end;
+	}
+	return !list.empty();
+}
+
+void print_result(const char *bench, const string &params,
+	uint64_t samples, double seconds)
+{
+	printf("{\"bench\":\"%s\",%s,\"samples\":%" PRIu64 ",\"seconds\":%.6g,"
+		"\"samples_per_s\":%.6g}\n", bench, params.c_str(), samples,
+		seconds, samples / seconds);
+	fflush(stdout);
+}
+
+string format(const char *fmt, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+{
+	char buf[256];
+	snprintf(buf, sizeof(buf), fmt, a, b, c);
+	return buf;
+}
+
+/*
+ * Channel n is a square wave of a period of 2^(n%16+1) samples, shifted
+ * so no two channels are the same. The fast channels have an edge in
+ * every mip-map block, the slow ones let the edge search skip levels.
+ */
+vector<uint64_t> make_samples(uint64_t count)
+{
+	vector<uint64_t> samples(count);
+	for (uint64_t i = 0; i < count; i++) {
+		uint64_t value = 0;
+		for (unsigned int ch = 0; ch < 64; ch++)
+			value |= (((i + ch * 3) >> (ch % 16)) & 1) << ch;
+		samples[i] = value;
+	}
+	return samples;
+}
+
+vector<uint8_t> pack_samples(const vector<uint64_t> &samples,
+	unsigned int unit_size)
+{
+	vector<uint8_t> data(samples.size() * unit_size);
+	for (uint64_t i = 0; i < samples.size(); i++)
+		memcpy(&data[i * unit_size], &samples[i], unit_size);
+	return data;
+}
+
+/*
+ * Appends the capture in packets, as SigSession does with the packets of
+ * the driver. Returns the last snapshot for the query benchmarks.
+ */
+shared_ptr<LogicSnapshot> bench_append(const Options &opt,
+	const vector<uint8_t> &data, unsigned int unit_size,
+	uint64_t packet_size)
+{
+	shared_ptr<LogicSnapshot> snapshot;
+	const uint64_t packet_bytes = max<uint64_t>(
+		packet_size / unit_size, 1) * unit_size;
+	double append = 1e9, mipmap = 1e9;
+
+	for (int round = 0; round < opt.rounds; round++) {
+		sr_datafeed_logic logic;
+		logic.unitsize = unit_size;
+		logic.length = 0;
+		logic.data = NULL;
+		logic.data_error = 0;
+		snapshot.reset();
+		snapshot.reset(new LogicSnapshot(logic, opt.samples, 1));
+
+		sr_metrics_reset();
+		const double begin = now();
+		for (uint64_t offset = 0; offset < data.size();
+			offset += packet_bytes) {
+			logic.data = (void*)&data[offset];
+			logic.length = min<uint64_t>(packet_bytes,
+				data.size() - offset);
+			snapshot->append_payload(logic);
+		}
+		append = min(append, now() - begin);
+
+		struct sr_metric metrics[SR_METRIC_COUNT];
+		sr_metrics_get(metrics, SR_METRIC_COUNT);
+		mipmap = min(mipmap, metrics[SR_METRIC_FEED_MIPMAP].sum * 1e-6);
+	}
+
+	const string params = format("\"unit_size\":%" PRIu64
+		",\"packet_bytes\":%" PRIu64, unit_size, packet_bytes);
+	print_result("append", params, opt.samples, append);
+	print_result("mipmap", params, opt.samples, mipmap);
+
+	return snapshot;
+}
+
+/*
+ * Runs captures one after the other as repeated captures do, the
+ * snapshot of each one replacing the last in the view.
+ */
+void bench_restart(const Options &opt, const vector<uint8_t> &data,
+	unsigned int unit_size, uint64_t packet_size)
+{
+	const uint64_t packet_bytes = max<uint64_t>(
+		packet_size / unit_size, 1) * unit_size;
+
+	for (int recycle = 0; recycle < 2; recycle++) {
+		Logic logic_data;
+		double best = 1e9;
+
+		// The first capture always allocates, it is not counted
+		for (int round = 0; round <= opt.rounds; round++) {
+			sr_datafeed_logic logic;
+			logic.unitsize = unit_size;
+			logic.length = min<uint64_t>(packet_bytes, data.size());
+			logic.data = (void*)&data[0];
+			logic.data_error = 0;
+
+			const double begin = now();
+			shared_ptr<LogicSnapshot> snapshot;
+			if (recycle)
+				snapshot = logic_data.recycle_snapshot(logic,
+					opt.samples, 1);
+			if (!snapshot)
+				snapshot.reset(new LogicSnapshot(logic, opt.samples, 1));
+			for (uint64_t offset = logic.length; offset < data.size();
+				offset += packet_bytes) {
+				logic.data = (void*)&data[offset];
+				logic.length = min<uint64_t>(packet_bytes,
+					data.size() - offset);
+				snapshot->append_payload(logic);
+			}
+			logic_data.push_snapshot(snapshot);
+			if (round > 0)
+				best = min(best, now() - begin);
+		}
+
+		print_result("restart", format("\"unit_size\":%" PRIu64
+			",\"packet_bytes\":%" PRIu64, unit_size, packet_bytes) +
+			(recycle ? ",\"recycled\":true" : ",\"recycled\":false"),
+			opt.samples, best);
+	}
+}
+
+void bench_edges(const Options &opt, const shared_ptr<LogicSnapshot> &snapshot,
+	unsigned int unit_size, uint64_t channels)
+{
+	vector<LogicSnapshot::EdgePair> edges;
+	const uint64_t last = snapshot->get_sample_count() - 1;
+
+	for (uint64_t s = 0; s < opt.scales.size(); s++) {
+		const uint64_t scale = opt.scales[s];
+		const uint64_t window = ViewWidth * scale;
+		double best = 1e9;
+		uint64_t edge_count = 0;
+
+		for (int round = 0; round < opt.rounds; round++) {
+			edge_count = 0;
+			const double begin = now();
+			for (uint64_t start = 0; start < last; start += window) {
+				const uint64_t end = min(start + window, last);
+				for (uint64_t ch = 0; ch < channels; ch++) {
+					snapshot->get_subsampled_edges(edges, start, end,
+						scale, ch);
+					edge_count += edges.size();
+				}
+			}
+			best = min(best, now() - begin);
+		}
+
+		print_result("edges", format("\"unit_size\":%" PRIu64
+			",\"channels\":%" PRIu64 ",\"samples_per_pixel\":%" PRIu64,
+			unit_size, channels, scale) +
+			format(",\"edges\":%" PRIu64, edge_count),
+			opt.samples, best);
+	}
+}
+
+/*
+ * Paints the newest samples of each channel while another thread appends
+ * the capture at the rate of a device. The samples are those the writer
+ * appended, the results are the time per paint.
+ */
+void bench_live(const Options &opt, const vector<uint8_t> &data,
+	unsigned int unit_size, uint64_t channels, uint64_t packet_size)
+{
+	const uint64_t packet_bytes = max<uint64_t>(
+		packet_size / unit_size, 1) * unit_size;
+
+	for (uint64_t s = 0; s < opt.scales.size(); s++) {
+		const uint64_t scale = opt.scales[s];
+		const uint64_t window = ViewWidth * scale;
+
+		sr_datafeed_logic logic;
+		logic.unitsize = unit_size;
+		logic.length = 0;
+		logic.data = NULL;
+		logic.data_error = 0;
+		LogicSnapshot snapshot(logic, opt.samples, 1);
+
+		volatile bool done = false;
+		const double begin = now();
+		boost::thread writer([&]{
+			sr_datafeed_logic packet = logic;
+			for (uint64_t offset = 0; offset < data.size();
+				offset += packet_bytes) {
+				// Packets come in at the rate of the device
+				const double due = begin +
+					(double)offset / unit_size / opt.live_rate;
+				const double wait = due - now();
+				if (wait > 0)
+					boost::this_thread::sleep(
+						boost::posix_time::microseconds((int64_t)(wait * 1e6)));
+
+				packet.data = (void*)&data[offset];
+				packet.length = min<uint64_t>(packet_bytes,
+					data.size() - offset);
+				snapshot.append_payload(packet);
+			}
+			done = true;
+		});
+
+		vector<LogicSnapshot::EdgePair> edges;
+		double painting = 0, longest = 0;
+		uint64_t paints = 0;
+		while (!done) {
+			const double start = now();
+			const uint64_t count = snapshot.get_sample_count();
+			if (count < 2)
+				continue;
+			const uint64_t last = count - 1;
+			for (uint64_t ch = 0; ch < channels; ch++)
+				snapshot.get_subsampled_edges(edges,
+					last > window ? last - window : 0, last, scale, ch);
+
+			const double elapsed = now() - start;
+			painting += elapsed;
+			longest = max(longest, elapsed);
+			paints++;
+		}
+		writer.join();
+
+		print_result("live", format("\"unit_size\":%" PRIu64
+			",\"channels\":%" PRIu64 ",\"samples_per_pixel\":%" PRIu64,
+			unit_size, channels, scale) +
+			format(",\"paints\":%" PRIu64 ",\"paint_us\":%" PRIu64
+			",\"longest_paint_us\":%" PRIu64, paints,
+			paints ? painting / paints * 1e6 : 0, longest * 1e6),
+			opt.samples, now() - begin);
+	}
+}
+
+#ifdef ENABLE_DECODE
+void bench_annotations(const Options &opt)
+{
+	pv::data::decode::RowData row;
+	vector<pv::data::decode::Annotation> annotations;
+
+	char text0[] = "0x55", text1[] = "U";
+	char *texts[] = {text0, text1, NULL};
+	srd_proto_data_annotation pda;
+	pda.ann_class = 0;
+	pda.ann_text = texts;
+	srd_proto_data pdata;
+	memset(&pdata, 0, sizeof(pdata));
+	pdata.data = &pda;
+	for (uint64_t i = 0; i + AnnotationSamples <= opt.samples;
+		i += AnnotationSamples) {
+		pdata.start_sample = i;
+		pdata.end_sample = i + AnnotationSamples;
+		row.push_annotation(pv::data::decode::Annotation(&pdata));
+	}
+
+	for (uint64_t s = 0; s < opt.scales.size(); s++) {
+		const uint64_t scale = opt.scales[s];
+		const uint64_t window = ViewWidth * scale;
+		double best = 1e9;
+
+		for (int round = 0; round < opt.rounds; round++) {
+			const double begin = now();
+			for (uint64_t start = 0; start < opt.samples; start += window) {
+				annotations.clear();
+				row.get_annotation_subset(annotations, start,
+					min(start + window, opt.samples) - 1);
+			}
+			best = min(best, now() - begin);
+		}
+
+		print_result("annotations", format("\"samples_per_pixel\":%" PRIu64
+			",\"annotations\":%" PRIu64, scale,
+			opt.samples / AnnotationSamples), opt.samples, best);
+	}
+}
+#endif
+
+/*
+ * Sends the capture through an output module the way the batch processor
+ * does, the output is counted and thrown away.
+ */
+bool bench_export(const Options &opt, const shared_ptr<LogicSnapshot> &snapshot,
+	unsigned int unit_size, uint64_t channels, uint64_t packet_size,
+	const string &output_id)
+{
+	const sr_output_module *const module =
+		sr_output_find(const_cast<char*>(output_id.c_str()));
+	if (!module) {
+		fprintf(stderr, "Unknown output module %s.\n", output_id.c_str());
+		return false;
+	}
+
+	sr_dev_inst sdi;
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	for (uint64_t i = 0; i < channels; i++) {
+		sr_channel *const probe = g_new0(sr_channel, 1);
+		probe->index = i;
+		probe->type = SR_CHANNEL_LOGIC;
+		probe->enabled = TRUE;
+		probe->name = g_strdup_printf("%" PRIu64, i);
+		sdi.channels = g_slist_append(sdi.channels, probe);
+	}
+
+	sr_datafeed_header header;
+	header.feed_version = 1;
+	memset(&header.starttime, 0, sizeof(header.starttime));
+
+	sr_config samplerate;
+	samplerate.key = SR_CONF_SAMPLERATE;
+	samplerate.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(100)));
+	sr_datafeed_meta meta;
+	meta.config = g_slist_append(NULL, &samplerate);
+
+	const uint64_t samples = min(opt.export_samples,
+		snapshot->get_sample_count());
+	const uint64_t chunk_samples = max<uint64_t>(packet_size / unit_size, 1);
+	double best = 1e9;
+	uint64_t bytes = 0;
+	bool ok = true;
+
+	for (int round = 0; ok && round < opt.rounds; round++) {
+		GHashTable *const options = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+		const double begin = now();
+		const sr_output *const output = sr_output_new(module, options, &sdi);
+		g_hash_table_destroy(options);
+		if (!output) {
+			fprintf(stderr, "Failed to start output module %s.\n",
+				output_id.c_str());
+			ok = false;
+			break;
+		}
+
+		sr_datafeed_logic logic;
+		logic.unitsize = unit_size;
+		logic.data_error = 0;
+
+		bytes = 0;
+		const uint64_t chunk_count = (samples + chunk_samples - 1) /
+			chunk_samples;
+		for (uint64_t n = 0; ok && n < chunk_count + 3; n++) {
+			sr_datafeed_packet packet;
+			if (n == 0) {
+				packet.type = SR_DF_HEADER;
+				packet.payload = &header;
+			} else if (n == 1) {
+				packet.type = SR_DF_META;
+				packet.payload = &meta;
+			} else if (n < chunk_count + 2) {
+				const uint64_t start = (n - 2) * chunk_samples;
+				const uint64_t end = min(start + chunk_samples, samples);
+				logic.data = snapshot->get_samples(start, end - 1);
+				logic.length = (end - start) * unit_size;
+				packet.type = SR_DF_LOGIC;
+				packet.payload = &logic;
+			} else {
+				packet.type = SR_DF_END;
+				packet.payload = NULL;
+			}
+
+			GString *out = NULL;
+			if (sr_output_send(output, &packet, &out) != SR_OK)
+				ok = false;
+			if (out) {
+				bytes += out->len;
+				g_string_free(out, TRUE);
+			}
+		}
+
+		sr_output_free(output);
+		best = min(best, now() - begin);
+	}
+
+	g_slist_free(meta.config);
+	g_variant_unref(samplerate.data);
+	for (GSList *l = sdi.channels; l; l = l->next) {
+		sr_channel *const probe = (sr_channel*)l->data;
+		g_free(probe->name);
+		g_free(probe);
+	}
+	g_slist_free(sdi.channels);
+
+	if (!ok) {
+		fprintf(stderr, "Output module %s failed.\n", output_id.c_str());
+		return false;
+	}
+
+	print_result("export", "\"module\":\"" + output_id + "\"" +
+		format(",\"unit_size\":%" PRIu64 ",\"channels\":%" PRIu64
+		",\"bytes\":%" PRIu64, unit_size, channels, bytes), samples, best);
+	return true;
+}
+
+void usage()
+{
+	fprintf(stdout,
+		"Usage:\n"
+		"  %s-bench [OPTION…] — Measure the throughput of logic captures\n"
+		"\n"
+		"Options:\n"
+		"  -n, --samples <n>               Samples of a capture\n"
+		"  -u, --unit-sizes <list>         Bytes per sample, 1, 2, 4 or 8\n"
+		"  -p, --packet-sizes <list>       Bytes per packet appended\n"
+		"  -c, --channels <list>           Channels shown and exported\n"
+		"  -z, --samples-per-pixel <list>  Zoom levels of the view\n"
+		"  -O, --output-format <id>        Output module to export with\n"
+		"  -e, --export-samples <n>        Samples exported\n"
+		"  -l, --live-rate <n>             Samples per second appended while painting\n"
+		"  -r, --rounds <n>                Best of a number of rounds\n"
+		"  -h, -?, --help                  Show help option\n"
+		"\n"
+		"Lists are separated by commas. Results are printed to stdout as\n"
+		"lines of JSON.\n", DS_BIN_NAME);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	Options opt;
+	opt.samples = 16 << 20;
+	parse_list("1,2,4,8", opt.unit_sizes);
+	parse_list("4096,65536,1048576", opt.packet_sizes);
+	parse_list("1,8,16,32,64", opt.channels);
+	parse_list("1,64,4096,1048576", opt.scales);
+	opt.export_samples = 1 << 20;
+	opt.live_rate = SR_MHZ(100);
+	opt.rounds = 3;
+
+	while (1) {
+		static const struct option long_options[] = {
+			{"samples", required_argument, 0, 'n'},
+			{"unit-sizes", required_argument, 0, 'u'},
+			{"packet-sizes", required_argument, 0, 'p'},
+			{"channels", required_argument, 0, 'c'},
+			{"samples-per-pixel", required_argument, 0, 'z'},
+			{"output-format", required_argument, 0, 'O'},
+			{"export-samples", required_argument, 0, 'e'},
+			{"live-rate", required_argument, 0, 'l'},
+			{"rounds", required_argument, 0, 'r'},
+			{"help", no_argument, 0, 'h'},
+			{0, 0, 0, 0}
+		};
+
+		const int c = getopt_long(argc, argv,
+			"n:u:p:c:z:O:e:l:r:h?", long_options, NULL);
+		if (c == -1)
+			break;
+
+		bool valid = true;
+		switch (c) {
+		case 'n':
+			opt.samples = strtoull(optarg, NULL, 0);
+			valid = opt.samples >= 2;
+			break;
+
+		case 'u':
+			valid = parse_list(optarg, opt.unit_sizes);
+			for (size_t i = 0; i < opt.unit_sizes.size(); i++)
+				if (opt.unit_sizes[i] > sizeof(uint64_t))
+					valid = false;
+			break;
+
+		case 'p':
+			valid = parse_list(optarg, opt.packet_sizes);
+			break;
+
+		case 'c':
+			valid = parse_list(optarg, opt.channels);
+			break;
+
+		case 'z':
+			valid = parse_list(optarg, opt.scales);
+			break;
+
+		case 'O':
+			opt.output_ids.push_back(optarg);
+			break;
+
+		case 'e':
+			opt.export_samples = strtoull(optarg, NULL, 0);
+			valid = opt.export_samples > 0;
+			break;
+
+		case 'l':
+			opt.live_rate = strtoull(optarg, NULL, 0);
+			valid = opt.live_rate > 0;
+			break;
+
+		case 'r':
+			opt.rounds = atoi(optarg);
+			valid = opt.rounds > 0;
+			break;
+
+		case 'h':
+		case '?':
+			usage();
+			return 0;
+		}
+
+		if (!valid) {
+			fprintf(stderr, "Invalid argument to -%c: %s\n", c, optarg);
+			return 1;
+		}
+	}
+
+	// A scale beyond the capture shows all of it
+	const uint64_t full_scale = max<uint64_t>(opt.samples / ViewWidth, 1);
+	for (size_t i = 0; i < opt.scales.size(); i++)
+		opt.scales[i] = min(opt.scales[i], full_scale);
+	sort(opt.scales.begin(), opt.scales.end());
+	opt.scales.erase(unique(opt.scales.begin(), opt.scales.end()),
+		opt.scales.end());
+
+	if (opt.output_ids.empty()) {
+		opt.output_ids.push_back("csv");
+		opt.output_ids.push_back("vcd");
+	}
+
+	printf("{\"bench\":\"info\",\"version\":\"%s\",\"samples\":%" PRIu64
+		",\"rounds\":%d,\"threads\":%u}\n", DS_VERSION_STRING, opt.samples,
+		opt.rounds, boost::thread::hardware_concurrency());
+
+	const vector<uint64_t> samples = make_samples(opt.samples);
+	for (size_t u = 0; u < opt.unit_sizes.size(); u++) {
+		const unsigned int unit_size = opt.unit_sizes[u];
+		const vector<uint8_t> data = pack_samples(samples, unit_size);
+
+		shared_ptr<LogicSnapshot> snapshot;
+		for (size_t p = 0; p < opt.packet_sizes.size(); p++)
+			snapshot = bench_append(opt, data, unit_size,
+				opt.packet_sizes[p]);
+		bench_restart(opt, data, unit_size, opt.packet_sizes.back());
+
+		// The queries and exports read the snapshot of the last
+		// packet size, a unit holds 8 channels per byte
+		for (size_t c = 0; c < opt.channels.size(); c++) {
+			const uint64_t channels = opt.channels[c];
+			if (channels > unit_size * 8)
+				continue;
+
+			bench_edges(opt, snapshot, unit_size, channels);
+			bench_live(opt, data, unit_size, channels,
+				opt.packet_sizes.back());
+			for (size_t o = 0; o < opt.output_ids.size(); o++)
+				if (!bench_export(opt, snapshot, unit_size, channels,
+					opt.packet_sizes.back(), opt.output_ids[o]))
+					return 1;
+		}
+	}
+
+#ifdef ENABLE_DECODE
+	bench_annotations(opt);
+#endif
+
+	return 0;
+}
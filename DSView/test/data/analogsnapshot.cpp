@@ -33,19 +33,26 @@ using pv::data::AnalogSnapshot;
 
 BOOST_AUTO_TEST_SUITE(AnalogSnapshotTest)
 
+static const unsigned int ChannelNum = 2;
+static const uint64_t TotalSamples = 1024;
+
+// The samples of the channels are interleaved, channel 1 stays at a
+// level of its own. The drivers send 16 bit samples in the float buffer.
 void push_analog(AnalogSnapshot &s, unsigned int num_samples,
-	float value)
+	uint16_t value)
 {
 	sr_datafeed_analog analog;
 	analog.num_samples = num_samples;
 
-	float *data = new float[num_samples];
-	analog.data = data;
-	while(num_samples-- != 0)
+	uint16_t *data = new uint16_t[num_samples * ChannelNum];
+	analog.data = (float*)data;
+	while(num_samples-- != 0) {
 		*data++ = value;
+		*data++ = 0x100;
+	}
 
 	s.append_payload(analog);
-	delete[] (float*)analog.data;
+	delete[] (uint16_t*)analog.data;
 }
 
 BOOST_AUTO_TEST_CASE(Basic)
@@ -55,71 +62,78 @@ BOOST_AUTO_TEST_CASE(Basic)
 	analog.num_samples = 0;
 	analog.data = NULL;
 
-	AnalogSnapshot s(analog);
+	AnalogSnapshot s(analog, TotalSamples, ChannelNum);
 
 	//----- Test AnalogSnapshot::push_analog -----//
 
 	BOOST_CHECK(s.get_sample_count() == 0);
 	for (unsigned int i = 0; i < AnalogSnapshot::ScaleStepCount; i++)
 	{
-		const AnalogSnapshot::Envelope &m = s._envelope_levels[i];
+		const AnalogSnapshot::Envelope &m = s._envelope_levels[0][i];
 		BOOST_CHECK_EQUAL(m.length, 0);
 		BOOST_CHECK_EQUAL(m.data_length, 0);
 		BOOST_CHECK(m.samples == NULL);
 	}
 
 	// Push 8 samples of all zeros
-	push_analog(s, 8, 0.0f);
+	push_analog(s, 8, 0);
 
 	BOOST_CHECK(s.get_sample_count() == 8);
 
 	// There should not be enough samples to have a single mip map sample
 	for (unsigned int i = 0; i < AnalogSnapshot::ScaleStepCount; i++)
 	{
-		const AnalogSnapshot::Envelope &m = s._envelope_levels[i];
+		const AnalogSnapshot::Envelope &m = s._envelope_levels[0][i];
 		BOOST_CHECK_EQUAL(m.length, 0);
 		BOOST_CHECK_EQUAL(m.data_length, 0);
 		BOOST_CHECK(m.samples == NULL);
 	}
 
-	// Push 8 samples of 1.0s to bring the total up to 16
-	push_analog(s, 8, 1.0f);
+	// Push 8 samples of 1s to bring the total up to 16
+	push_analog(s, 8, 1);
 
 	// There should now be enough data for exactly one sample
-	// in mip map level 0, and that sample should be 0
-	const AnalogSnapshot::Envelope &e0 = s._envelope_levels[0];
+	// in mip map level 0, which spans both values
+	const AnalogSnapshot::Envelope &e0 = s._envelope_levels[0][0];
 	BOOST_CHECK_EQUAL(e0.length, 1);
 	BOOST_CHECK_EQUAL(e0.data_length, AnalogSnapshot::EnvelopeDataUnit);
 	BOOST_REQUIRE(e0.samples != NULL);
-	BOOST_CHECK_EQUAL(e0.samples[0].min, 0.0f);
-	BOOST_CHECK_EQUAL(e0.samples[0].max, 1.0f);
+	BOOST_CHECK_EQUAL(e0.samples[0].min, 0);
+	BOOST_CHECK_EQUAL(e0.samples[0].max, 1);
 
 	// The higher levels should still be empty
 	for (unsigned int i = 1; i < AnalogSnapshot::ScaleStepCount; i++)
 	{
-		const AnalogSnapshot::Envelope &m = s._envelope_levels[i];
+		const AnalogSnapshot::Envelope &m = s._envelope_levels[0][i];
 		BOOST_CHECK_EQUAL(m.length, 0);
 		BOOST_CHECK_EQUAL(m.data_length, 0);
 		BOOST_CHECK(m.samples == NULL);
 	}
 
-	// Push 240 samples of all zeros to bring the total up to 256
-	push_analog(s, 240, -1.0f);
+	// Push 240 samples of 2s to bring the total up to 256
+	push_analog(s, 240, 2);
 
 	BOOST_CHECK_EQUAL(e0.length, 16);
 	BOOST_CHECK_EQUAL(e0.data_length, AnalogSnapshot::EnvelopeDataUnit);
 
 	for (unsigned int i = 1; i < e0.length; i++) {
-		BOOST_CHECK_EQUAL(e0.samples[i].min, -1.0f);
-		BOOST_CHECK_EQUAL(e0.samples[i].max, -1.0f);
+		BOOST_CHECK_EQUAL(e0.samples[i].min, 2);
+		BOOST_CHECK_EQUAL(e0.samples[i].max, 2);
 	}
 
-	const AnalogSnapshot::Envelope &e1 = s._envelope_levels[1];
+	const AnalogSnapshot::Envelope &e1 = s._envelope_levels[0][1];
 	BOOST_CHECK_EQUAL(e1.length, 1);
 	BOOST_CHECK_EQUAL(e1.data_length, AnalogSnapshot::EnvelopeDataUnit);
 	BOOST_REQUIRE(e1.samples != NULL);
-	BOOST_CHECK_EQUAL(e1.samples[0].min, -1.0f);
-	BOOST_CHECK_EQUAL(e1.samples[0].max, 1.0f);
+	BOOST_CHECK_EQUAL(e1.samples[0].min, 0);
+	BOOST_CHECK_EQUAL(e1.samples[0].max, 2);
+
+	// The second channel has an envelope of its own
+	const AnalogSnapshot::Envelope &c1 = s._envelope_levels[1][1];
+	BOOST_CHECK_EQUAL(c1.length, 1);
+	BOOST_REQUIRE(c1.samples != NULL);
+	BOOST_CHECK_EQUAL(c1.samples[0].min, 0x100);
+	BOOST_CHECK_EQUAL(c1.samples[0].max, 0x100);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <extdef.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/dsosnapshot.h"
+
+using namespace std;
+
+using pv::data::DsoSnapshot;
+
+BOOST_AUTO_TEST_SUITE(DsoSnapshotTest)
+
+static const unsigned int ChannelNum = 2;
+static const uint64_t TotalSamples = 16 * 1024;
+
+static void push_dso(DsoSnapshot &s, int num_samples)
+{
+	sr_datafeed_dso dso;
+	dso.num_samples = num_samples;
+	dso.samplerate_tog = false;
+
+	uint8_t *data = new uint8_t[num_samples * ChannelNum];
+	for (int i = 0; i < num_samples * (int)ChannelNum; i++)
+		data[i] = rand() & 0xff;
+	dso.data = data;
+
+	s.append_payload(dso);
+	delete[] data;
+}
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+	sr_datafeed_dso dso;
+	dso.num_samples = 0;
+	dso.samplerate_tog = false;
+	dso.data = NULL;
+
+	DsoSnapshot s(dso, TotalSamples, ChannelNum, true);
+	s.enable_envelope(true);
+
+	// Every section must match a summary of the samples as the view
+	// reads them, computed from scratch
+	const auto check_envelope = [&s]() {
+		const uint8_t *const data = s.get_samples(0, 0, 0);
+		const uint64_t sample_count = s.get_sample_count();
+
+		for (unsigned int i = 0; i < ChannelNum; i++) {
+			uint64_t scale = 1;
+			for (unsigned int level = 0; scale <= sample_count &&
+				level < DsoSnapshot::ScaleStepCount; level++) {
+				scale *= DsoSnapshot::EnvelopeScaleFactor;
+
+				DsoSnapshot::EnvelopeSection e;
+				s.get_envelope_section(e, 0, sample_count, scale, i);
+				BOOST_REQUIRE_EQUAL(e.scale, scale);
+				BOOST_REQUIRE(e.length == 0 ||
+					e.start + e.length * scale <= sample_count);
+				BOOST_REQUIRE(e.start + (e.length + 2) * scale > sample_count);
+
+				for (uint64_t j = 0; j < e.length; j++) {
+					uint8_t lo = 0xff, hi = 0;
+					for (uint64_t k = e.start + j * scale;
+						k < e.start + (j + 1) * scale; k++) {
+						lo = min(lo, data[k * ChannelNum + i]);
+						hi = max(hi, data[k * ChannelNum + i]);
+					}
+					BOOST_REQUIRE_EQUAL(e.samples[j].min, lo);
+					BOOST_REQUIRE_EQUAL(e.samples[j].max, hi);
+				}
+			}
+		}
+	};
+
+	// Odd packet sizes make the writes straddle blocks and wrap
+	// around the end of the ring buffer
+	const int sizes[] = {1000, 3000, 7777, 100, 5000, 4096, 12345, 300};
+	for (int r = 0; r < 3; r++) {
+		for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			push_dso(s, sizes[i]);
+			check_envelope();
+		}
+	}
+
+	// A packet larger than the buffer only keeps its newest samples
+	push_dso(s, TotalSamples + 1234);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), TotalSamples);
+	check_envelope();
+}
+
+/*
+ * Once the ring of a roll capture wraps, the samples still read from the
+ * oldest to the newest, with the envelope in the same order.
+ */
+BOOST_AUTO_TEST_CASE(RollOrder)
+{
+	sr_datafeed_dso dso;
+	dso.num_samples = 0;
+	dso.samplerate_tog = false;
+	dso.data = NULL;
+
+	DsoSnapshot s(dso, TotalSamples, ChannelNum, true);
+	s.enable_envelope(true);
+
+	// Channel 0 counts the samples, channel 1 holds the packet number
+	uint64_t written = 0;
+	const int sizes[] = {5000, 7000, 3000, 9000, 777};
+	for (unsigned int p = 0; p < sizeof(sizes) / sizeof(sizes[0]); p++) {
+		vector<uint8_t> data(sizes[p] * ChannelNum);
+		for (int i = 0; i < sizes[p]; i++) {
+			data[i * ChannelNum] = (written + i) & 0xff;
+			data[i * ChannelNum + 1] = p;
+		}
+		dso.num_samples = sizes[p];
+		dso.data = &data[0];
+		s.append_payload(dso);
+		written += sizes[p];
+	}
+	BOOST_REQUIRE(written > TotalSamples);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), TotalSamples);
+
+	const uint64_t oldest = written - TotalSamples;
+	const uint8_t *const samples = s.get_samples(0, TotalSamples - 1, 0);
+	BOOST_CHECK(samples == s.get_data());
+	for (uint64_t i = 0; i < TotalSamples; i++)
+		BOOST_REQUIRE_EQUAL(samples[i * ChannelNum], (oldest + i) & 0xff);
+	BOOST_CHECK_EQUAL(*s.get_samples(TotalSamples - 1, TotalSamples - 1, 1),
+		sizeof(sizes) / sizeof(sizes[0]) - 1);
+
+	// The packet numbers only go up from the oldest sample on, the
+	// finest envelope blocks would go back down across a seam
+	DsoSnapshot::EnvelopeSection e;
+	s.get_envelope_section(e, 0, TotalSamples,
+		DsoSnapshot::EnvelopeScaleFactor, 1);
+	BOOST_REQUIRE(e.length > 0);
+	for (uint64_t j = 1; j < e.length; j++)
+		BOOST_CHECK(e.samples[j].min >= e.samples[j - 1].max);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,263 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <extdef.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <list>
+#include <new>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include "../../pv/data/groupsnapshot.h"
+#include "../../pv/data/logicsnapshot.h"
+
+using namespace std;
+
+using pv::data::GroupSnapshot;
+using pv::data::LogicSnapshot;
+
+// Heap allocations made by the test thread while counting is enabled.
+// The snapshot's build thread allocates concurrently and is not counted.
+static thread_local bool count_allocations = false;
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	if (count_allocations)
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	void *const p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+BOOST_AUTO_TEST_SUITE(GroupSnapshotTest)
+
+static const uint64_t SampleCount = 1024 * 1024;
+
+static boost::shared_ptr<LogicSnapshot> make_logic()
+{
+	vector<uint16_t> data(SampleCount);
+	for (uint64_t i = 0; i < SampleCount; i++)
+		data[i] = rand();
+
+	sr_datafeed_logic logic;
+	logic.length = SampleCount * sizeof(uint16_t);
+	logic.unitsize = sizeof(uint16_t);
+	logic.data = &data[0];
+
+	return boost::shared_ptr<LogicSnapshot>(
+		new LogicSnapshot(logic, SampleCount, 1));
+}
+
+// The sections are never built on the caller's thread, wait for the
+// build thread to finish the whole range
+static void get_whole_envelope(GroupSnapshot &s,
+	GroupSnapshot::EnvelopeSection &e,
+	uint64_t start, uint64_t end, float min_length)
+{
+	while (!s.get_envelope_section(e, start, end, min_length) ||
+		e.start != start / e.scale * e.scale ||
+		e.length != end / e.scale - start / e.scale)
+		boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+}
+
+static std::atomic<int> built_count(0);
+
+static void count_built()
+{
+	built_count++;
+}
+
+BOOST_AUTO_TEST_CASE(Basic)
+{
+	const boost::shared_ptr<LogicSnapshot> logic = make_logic();
+	list<int> index_list;
+	index_list.push_back(1);
+	index_list.push_back(3);
+	index_list.push_back(4);
+	index_list.push_back(9);
+
+	GroupSnapshot s(logic, index_list);
+	BOOST_REQUIRE_EQUAL(s.get_sample_count(), SampleCount);
+
+	// The group values hold the grouped channels in their low bits
+	const uint16_t *const raw = (const uint16_t*)logic->get_data();
+	vector<uint16_t> values(4096);
+	s.get_samples(&values[0], 1000, 1000 + values.size());
+	for (unsigned int i = 0; i < values.size(); i++) {
+		const uint16_t v = raw[1000 + i];
+		const uint16_t expected = ((v >> 1) & 1) | ((v >> 2) & 2) |
+			((v >> 2) & 4) | ((v >> 6) & 8);
+		BOOST_REQUIRE_EQUAL(values[i], expected);
+	}
+
+	// The first envelope level summarizes EnvelopeScaleFactor values
+	GroupSnapshot::EnvelopeSection e;
+	get_whole_envelope(s, e, 0, SampleCount - 1, 1.0f);
+	BOOST_REQUIRE_EQUAL(e.scale, 16);
+	vector<uint16_t> block(16);
+	for (uint64_t i = 0; i < 256; i++) {
+		s.get_samples(&block[0], i * 16, i * 16 + 16);
+		BOOST_CHECK_EQUAL(e.samples[i].min,
+			*min_element(block.begin(), block.end()));
+		BOOST_CHECK_EQUAL(e.samples[i].max,
+			*max_element(block.begin(), block.end()));
+	}
+}
+
+// Sparse toggles of the grouped channels, while the other channels are
+// noisy: most blocks are taken from the logic transition mip-map.
+BOOST_AUTO_TEST_CASE(Lazy)
+{
+	vector<uint16_t> data(SampleCount);
+	uint16_t group = 0;
+	for (uint64_t i = 0; i < SampleCount; i++) {
+		if (rand() % 5000 == 0)
+			group = rand();
+		data[i] = (group & 0x0f00) | (rand() & 0xf0ff);
+	}
+
+	sr_datafeed_logic logic;
+	logic.length = SampleCount * sizeof(uint16_t);
+	logic.unitsize = sizeof(uint16_t);
+	logic.data = &data[0];
+	const boost::shared_ptr<LogicSnapshot> logic_snapshot(
+		new LogicSnapshot(logic, SampleCount, 1));
+
+	list<int> index_list;
+	for (int i = 8; i < 12; i++)
+		index_list.push_back(i);
+	GroupSnapshot s(logic_snapshot, index_list);
+
+	// Request the coarse levels first, while the lower ones may still
+	// be in progress in the background
+	for (int level = 4; level >= 0; level--) {
+		const uint64_t scale = 1ULL << ((level + 1) * 4);
+		GroupSnapshot::EnvelopeSection e;
+		get_whole_envelope(s, e, 0, SampleCount, scale);
+		BOOST_REQUIRE_EQUAL(e.scale, scale);
+		BOOST_REQUIRE_EQUAL(e.length, SampleCount / scale);
+
+		for (uint64_t i = 0; i < e.length; i++) {
+			uint16_t lo = 0xffff, hi = 0;
+			for (uint64_t k = i * scale; k < (i + 1) * scale; k++) {
+				const uint16_t v = (data[k] >> 8) & 0xf;
+				lo = min(lo, v);
+				hi = max(hi, v);
+			}
+			BOOST_REQUIRE_EQUAL(e.samples[i].min, lo);
+			BOOST_REQUIRE_EQUAL(e.samples[i].max, hi);
+		}
+	}
+}
+
+// A section which is not finished is queued, and the build thread calls
+// back when it is.
+BOOST_AUTO_TEST_CASE(Deferred)
+{
+	const boost::shared_ptr<LogicSnapshot> logic = make_logic();
+	list<int> index_list;
+	index_list.push_back(0);
+	index_list.push_back(7);
+	GroupSnapshot s(logic, index_list, &count_built);
+
+	const uint64_t scale = 4096;
+	GroupSnapshot::EnvelopeSection e;
+	for (;;) {
+		const int built = built_count;
+		if (s.get_envelope_section(e, 0, SampleCount, scale) &&
+			e.start == 0 && e.length == SampleCount / scale)
+			break;
+
+		// Only finished runs are returned
+		BOOST_REQUIRE(e.length == 0 || e.start + e.length * scale <=
+			SampleCount);
+		while (built_count == built)
+			boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+
+	const uint16_t *const raw = (const uint16_t*)logic->get_data();
+	for (uint64_t i = 0; i < e.length; i++) {
+		uint16_t lo = 0xffff, hi = 0;
+		for (uint64_t k = i * scale; k < (i + 1) * scale; k++) {
+			const uint16_t v = (raw[k] & 1) | ((raw[k] >> 6) & 2);
+			lo = min(lo, v);
+			hi = max(hi, v);
+		}
+		BOOST_REQUIRE_EQUAL(e.samples[i].min, lo);
+		BOOST_REQUIRE_EQUAL(e.samples[i].max, hi);
+	}
+}
+
+// Repaint benchmark: the sample and envelope access of a frame must
+// not touch the heap, the caller's buffer is reused.
+BOOST_AUTO_TEST_CASE(RepaintAllocations)
+{
+	const boost::shared_ptr<LogicSnapshot> logic = make_logic();
+	list<int> index_list;
+	for (int i = 0; i < 16; i += 3)
+		index_list.push_back(i);
+	GroupSnapshot s(logic, index_list);
+
+	const int Frames = 200;
+	const int64_t Width = 1920;
+	vector<uint16_t> samples(Width);
+
+	allocations = 0;
+	count_allocations = true;
+	const boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+	for (int frame = 0; frame < Frames; frame++) {
+		// Zoomed in: one sample per pixel or less
+		const int64_t first = (frame * 4099) % (SampleCount - Width - 1);
+		s.get_samples(&samples[0], first, first + Width);
+
+		// Zoomed out: the whole capture in one view, which may still
+		// be queued for the build thread
+		GroupSnapshot::EnvelopeSection e;
+		s.get_envelope_section(e, 0, SampleCount - 1,
+			(float)SampleCount / Width);
+	}
+	const double elapsed = (boost::posix_time::microsec_clock::universal_time() -
+		start).total_microseconds();
+	count_allocations = false;
+
+	BOOST_TEST_MESSAGE("GroupSnapshot repaint: " <<
+		elapsed / Frames << " us/frame, " <<
+		allocations.load() << " allocations in " << Frames << " frames");
+	BOOST_CHECK_EQUAL(allocations.load(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
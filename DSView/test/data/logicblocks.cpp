@@ -0,0 +1,180 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <extdef.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zip.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/data/logicsnapshot.h"
+
+using namespace std;
+
+using pv::data::LogicSnapshot;
+
+BOOST_AUTO_TEST_SUITE(LogicSnapshotTest)
+
+static const uint64_t BlockSamples = 64 * 1024;
+static const uint64_t TotalSamples = 5 * BlockSamples + 12345;
+
+static void write_le64(uint8_t *p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		p[i] = v >> (8 * i);
+}
+
+static void add_entry(struct zip *archive, const string &name,
+	const void *data, size_t size)
+{
+	struct zip_source *const src = zip_source_buffer(archive, data, size, 0);
+	BOOST_REQUIRE(src);
+	BOOST_REQUIRE(zip_add(archive, name.c_str(), src) != -1);
+}
+
+/*
+ * A snapshot of an indexed session file must look the same as one of
+ * the same samples held in memory, while only the blocks which are
+ * looked at are read.
+ */
+BOOST_AUTO_TEST_CASE(Blocks)
+{
+	// Channel n toggles about every 2^n samples, the idle stretches of
+	// the slow channels cross the block boundaries
+	vector<uint16_t> data(TotalSamples);
+	uint16_t value = 0;
+	for (uint64_t i = 0; i < TotalSamples; i++) {
+		for (int ch = 0; ch < 16; ch++)
+			if ((rand() & ((1 << ch) - 1)) == 0)
+				value ^= 1 << ch;
+		data[i] = value;
+	}
+
+	sr_datafeed_logic logic;
+	logic.unitsize = sizeof(uint16_t);
+	logic.length = TotalSamples * sizeof(uint16_t);
+	logic.data_error = 0;
+	logic.data = &data[0];
+	LogicSnapshot ref(logic, TotalSamples, 1);
+
+	// Save the samples the way sr_session_save() does
+	const uint64_t num_blocks = (TotalSamples + BlockSamples - 1) /
+		BlockSamples;
+	vector<uint8_t> index(24 + num_blocks * sizeof(uint16_t));
+	write_le64(&index[0], BlockSamples);
+	write_le64(&index[8], TotalSamples);
+	write_le64(&index[16], sizeof(uint16_t));
+	for (uint64_t b = 0; b < num_blocks; b++) {
+		const uint64_t last = min((b + 1) * BlockSamples, TotalSamples) - 1;
+		memcpy(&index[24 + b * sizeof(uint16_t)], &data[last],
+			sizeof(uint16_t));
+	}
+
+	char filename[] = "DSView-blocks-XXXXXX";
+	const int fd = mkstemp(filename);
+	BOOST_REQUIRE(fd != -1);
+	close(fd);
+	unlink(filename);
+
+	int ret;
+	struct zip *const archive = zip_open(filename, ZIP_CREATE, &ret);
+	BOOST_REQUIRE(archive);
+	add_entry(archive, "data-index", &index[0], index.size());
+	add_entry(archive, "data-summary", ref._mip_map[2].data,
+		ref._mip_map[2].length * sizeof(uint16_t));
+	for (uint64_t b = 0; b < num_blocks; b++) {
+		const uint64_t first = b * BlockSamples;
+		add_entry(archive, "data-" + to_string(b), &data[first],
+			(min(first + BlockSamples, TotalSamples) - first) *
+			sizeof(uint16_t));
+	}
+	BOOST_REQUIRE(zip_close(archive) != -1);
+
+	sr_session_blocks *blocks;
+	BOOST_REQUIRE_EQUAL(sr_session_blocks_open(filename, "data", &blocks),
+		SR_OK);
+	BOOST_CHECK_EQUAL(blocks->num_blocks, num_blocks);
+
+	sr_datafeed_logic_blocks logic_blocks;
+	logic_blocks.unitsize = sizeof(uint16_t);
+	logic_blocks.blocks = blocks;
+	LogicSnapshot s(logic_blocks, 1);
+	sr_session_blocks_unref(blocks);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), TotalSamples);
+
+	// The coarse levels come from the summary alone
+	for (unsigned int level = 2; level < LogicSnapshot::ScaleStepCount;
+		level++) {
+		BOOST_REQUIRE_EQUAL(s._mip_map[level].length,
+			ref._mip_map[level].length);
+		for (uint64_t i = 0; i < s._mip_map[level].length; i++)
+			BOOST_REQUIRE_EQUAL(s.get_block_transitions(level, i),
+				ref.get_block_transitions(level, i));
+	}
+	for (uint64_t b = 0; b < num_blocks; b++)
+		BOOST_CHECK(!s._block_loaded[b]);
+
+	// A sample only loads its own block
+	BOOST_CHECK_EQUAL(s.get_sample(3 * BlockSamples + 7) & 0xFFFF,
+		data[3 * BlockSamples + 7]);
+	for (uint64_t b = 0; b < num_blocks; b++)
+		BOOST_CHECK_EQUAL(s._block_loaded[b], b == 3);
+
+	// The fine levels match once their blocks are loaded
+	for (unsigned int level = 0; level < 2; level++) {
+		BOOST_REQUIRE_EQUAL(s._mip_map[level].length,
+			ref._mip_map[level].length);
+		for (uint64_t i = 0; i < s._mip_map[level].length; i++)
+			BOOST_REQUIRE_EQUAL(s.get_block_transitions(level, i),
+				ref.get_block_transitions(level, i));
+	}
+
+	const float min_lengths[] = {1, 20, 5000};
+	for (int ch = 0; ch < 16; ch++) {
+		for (unsigned int i = 0; i < sizeof(min_lengths) /
+			sizeof(min_lengths[0]); i++) {
+			vector<LogicSnapshot::EdgePair> edges, ref_edges;
+			s.get_subsampled_edges(edges, 0, TotalSamples - 1,
+				min_lengths[i], ch);
+			ref.get_subsampled_edges(ref_edges, 0, TotalSamples - 1,
+				min_lengths[i], ch);
+			BOOST_REQUIRE_EQUAL(edges.size(), ref_edges.size());
+			for (size_t e = 0; e < edges.size(); e++) {
+				BOOST_CHECK_EQUAL(edges[e].first, ref_edges[e].first);
+				BOOST_CHECK_EQUAL(edges[e].second, ref_edges[e].second);
+			}
+		}
+	}
+
+	BOOST_CHECK(memcmp(s.get_data(), &data[0],
+		TotalSamples * sizeof(uint16_t)) == 0);
+
+	unlink(filename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -69,17 +69,22 @@ BOOST_AUTO_TEST_CASE(Basic)
 	logic.unitsize = 1;
 	logic.data = NULL;
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, 256, 1);
 
 	//----- Test LogicSnapshot::push_logic -----//
 
+	// The levels the capacity reaches are allocated up front, and
+	// never move while the snapshot is appended to
+	void *mip_map_data[LogicSnapshot::ScaleStepCount];
 	BOOST_CHECK(s.get_sample_count() == 0);
 	for (unsigned int i = 0; i < LogicSnapshot::ScaleStepCount; i++)
 	{
 		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
 		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
+		BOOST_CHECK_EQUAL(m.data_length,
+			i < 2 ? LogicSnapshot::MipMapDataUnit : 0);
+		BOOST_CHECK((m.data != NULL) == (i < 2));
+		mip_map_data[i] = m.data;
 	}
 
 	// Push 8 samples of all zeros
@@ -92,8 +97,7 @@ BOOST_AUTO_TEST_CASE(Basic)
 	{
 		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
 		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
+		BOOST_CHECK(m.data == mip_map_data[i]);
 	}
 
 	// Push 8 samples of 0x11s to bring the total up to 16
@@ -112,8 +116,7 @@ BOOST_AUTO_TEST_CASE(Basic)
 	{
 		const LogicSnapshot::MipMapLevel &m = s._mip_map[i];
 		BOOST_CHECK_EQUAL(m.length, 0);
-		BOOST_CHECK_EQUAL(m.data_length, 0);
-		BOOST_CHECK(m.data == NULL);
+		BOOST_CHECK(m.data == mip_map_data[i]);
 	}
 
 	// Push 240 samples of all zeros to bring the total up to 256
@@ -131,6 +134,8 @@ BOOST_AUTO_TEST_CASE(Basic)
 	BOOST_CHECK_EQUAL(m1.data_length, LogicSnapshot::MipMapDataUnit);
 	BOOST_REQUIRE(m1.data != NULL);
 	BOOST_CHECK_EQUAL(((uint8_t*)m1.data)[0], 0x11);
+	BOOST_CHECK(m0.data == mip_map_data[0]);
+	BOOST_CHECK(m1.data == mip_map_data[1]);
 
 	//----- Test LogicSnapshot::get_subsampled_edges -----//
 
@@ -142,7 +147,8 @@ BOOST_AUTO_TEST_CASE(Basic)
 	BOOST_CHECK_EQUAL(edges[0].first, 0);
 	BOOST_CHECK_EQUAL(edges[1].first, 8);
 	BOOST_CHECK_EQUAL(edges[2].first, 16);
-	BOOST_CHECK_EQUAL(edges[3].first, 255);
+	// A view which reaches the last sample ends one past it
+	BOOST_CHECK_EQUAL(edges[3].first, 256);
 
 	// Test a subset at high zoom
 	edges.clear();
@@ -155,6 +161,130 @@ BOOST_AUTO_TEST_CASE(Basic)
 	BOOST_CHECK_EQUAL(edges[3].first, 17);
 }
 
+/*
+ * A snapshot started over for a new capture keeps its buffers, and reads
+ * as if it had been created from the new packet.
+ */
+BOOST_AUTO_TEST_CASE(Reuse)
+{
+	const int Length = 256;
+	uint8_t data[Length];
+
+	sr_datafeed_logic logic;
+	logic.unitsize = 1;
+	logic.length = Length;
+	logic.data = data;
+
+	for (int i = 0; i < Length; i++)
+		data[i] = (i & 8) ? 0x11 : 0;
+
+	LogicSnapshot s(logic, Length, 1);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), Length);
+
+	const void *const samples = s.get_data();
+	const void *const m0_data = s._mip_map[0].data;
+
+	// A capture of another size needs other buffers
+	BOOST_CHECK(!s.reuse(logic, Length * 2, 1));
+	BOOST_CHECK_EQUAL(s.get_sample_count(), Length);
+
+	memset(data, 0, sizeof(data));
+	logic.length = 16;
+	BOOST_REQUIRE(s.reuse(logic, Length, 1));
+
+	BOOST_CHECK(s.get_data() == samples);
+	BOOST_CHECK(s._mip_map[0].data == m0_data);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), 16);
+	BOOST_CHECK_EQUAL(s._mip_map[0].length, 1);
+	BOOST_CHECK_EQUAL(((uint8_t*)s._mip_map[0].data)[0], 0);
+	for (unsigned int i = 1; i < LogicSnapshot::ScaleStepCount; i++)
+		BOOST_CHECK_EQUAL(s._mip_map[i].length, 0);
+
+	// None of the edges of the last capture are left
+	vector<LogicSnapshot::EdgePair> edges;
+	s.get_subsampled_edges(edges, 0, 15, 1, 0);
+	BOOST_REQUIRE_EQUAL(edges.size(), 2);
+	BOOST_CHECK_EQUAL(edges[0].first, 0);
+	BOOST_CHECK_EQUAL(edges[1].first, 16);
+}
+
+BOOST_AUTO_TEST_CASE(Full)
+{
+	const int Length = 256;
+	uint8_t data[Length];
+
+	sr_datafeed_logic logic;
+	logic.unitsize = 1;
+	logic.length = 200;
+	logic.data = data;
+
+	memset(data, 0x11, sizeof(data));
+	LogicSnapshot s(logic, Length, 1);
+
+	// The samples past the limit are dropped, the committed ones and
+	// their edges are not written over
+	push_logic(s, 100, 0);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), Length);
+	push_logic(s, 100, 0x11);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), Length);
+
+	const uint8_t *const samples = (const uint8_t*)s.get_data();
+	for (int i = 0; i < Length; i++)
+		BOOST_CHECK_EQUAL(samples[i], i < 200 ? 0x11 : 0);
+
+	vector<LogicSnapshot::EdgePair> edges;
+	s.get_subsampled_edges(edges, 0, Length - 1, 1, 0);
+	BOOST_REQUIRE_EQUAL(edges.size(), 3);
+	BOOST_CHECK_EQUAL(edges[0].first, 0);
+	BOOST_CHECK_EQUAL(edges[1].first, 200);
+	BOOST_CHECK_EQUAL(edges[2].first, Length);
+}
+
+BOOST_AUTO_TEST_CASE(DropFront)
+{
+	const int Length = 4096;
+	uint8_t data[Length];
+
+	sr_datafeed_logic logic;
+	logic.unitsize = 1;
+	logic.length = Length;
+	logic.data = data;
+
+	for (int i = 0; i < Length; i++)
+		data[i] = (i & 32) ? 0x11 : 0;
+	data[3000] = 0x22;
+
+	LogicSnapshot s(logic, Length, 1);
+
+	// 16 blocks of the second level move, the third level is built
+	// again
+	s.drop_front(2048 + 7);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), 2048);
+	BOOST_CHECK_EQUAL(s._mip_map[0].length, 128);
+	BOOST_CHECK_EQUAL(s._mip_map[1].length, 8);
+	BOOST_CHECK_EQUAL(s._mip_map[2].length, 0);
+
+	const uint8_t *const samples = (const uint8_t*)s.get_data();
+	for (int i = 0; i < 2048; i++)
+		BOOST_CHECK_EQUAL(samples[i], data[i + 2048]);
+
+	vector<LogicSnapshot::EdgePair> edges;
+	s.get_subsampled_edges(edges, 0, 2047, 1, 1);
+	BOOST_REQUIRE_EQUAL(edges.size(), 4);
+	BOOST_CHECK_EQUAL(edges[1].first, 3000 - 2048);
+	BOOST_CHECK_EQUAL(edges[2].first, 3001 - 2048);
+
+	// The window goes on after the samples kept, the glitch is gone
+	push_logic(s, 1024, 0x11);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), 3072);
+	BOOST_CHECK_EQUAL(s._mip_map[2].length, 0);
+	s.drop_front(1024);
+	push_logic(s, 2048, 0);
+	BOOST_CHECK_EQUAL(s.get_sample_count(), Length);
+	BOOST_CHECK_EQUAL(s._mip_map[2].length, 1);
+	BOOST_CHECK_EQUAL(((uint8_t*)s._mip_map[2].data)[0], 0x11);
+}
+
 BOOST_AUTO_TEST_CASE(LargeData)
 {
 	uint8_t prev_sample;
@@ -169,7 +299,7 @@ BOOST_AUTO_TEST_CASE(LargeData)
 	for (unsigned int i = 0; i < Length; i++)
 		*data++ = (uint8_t)(i >> 8);
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 	delete[] (uint8_t*)logic.data;
 
 	BOOST_CHECK(s.get_sample_count() == Length);
@@ -265,7 +395,7 @@ BOOST_AUTO_TEST_CASE(LargeData)
 		BOOST_CHECK_EQUAL(edges[i].second, i & 1);
 	}
 
-	BOOST_CHECK_EQUAL(edges[31].first, 999999);
+	BOOST_CHECK_EQUAL(edges[31].first, Length);
 
 	// Check in very low zoom case
 	edges.clear();
@@ -295,7 +425,7 @@ BOOST_AUTO_TEST_CASE(Pulses)
 			*p++ = 0x00;
 	}
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 	delete[] (uint8_t*)logic.data;
 
 	//----- Check the mip-map -----//
@@ -331,8 +461,9 @@ BOOST_AUTO_TEST_CASE(Pulses)
 	BOOST_REQUIRE_EQUAL(edges.size(), Cycles + 2);
 
 	BOOST_CHECK_EQUAL(0, false);
-	for (unsigned int i = 1; i < edges.size(); i++)
+	for (unsigned int i = 1; i < edges.size() - 1; i++)
 		BOOST_CHECK_EQUAL(edges[i].second, false);
+	BOOST_CHECK_EQUAL(edges.back().first, Length);
 }
 
 BOOST_AUTO_TEST_CASE(LongPulses)
@@ -359,7 +490,7 @@ BOOST_AUTO_TEST_CASE(LongPulses)
 			*p++ = 0;
 	}
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 	delete[] (uint64_t*)logic.data;
 
 	//----- Check the mip-map -----//
@@ -403,8 +534,7 @@ BOOST_AUTO_TEST_CASE(LongPulses)
 		BOOST_CHECK_EQUAL(edges[i*2+1].second, false);
 	}
 
-	BOOST_CHECK_EQUAL(edges.back().first, Length-1);
-	BOOST_CHECK_EQUAL(edges.back().second, false);
+	BOOST_CHECK_EQUAL(edges.back().first, Length);
 
 	//----- Test get_subsampled_edges at a simplified scale -----//
 	edges.clear();
@@ -420,8 +550,7 @@ BOOST_AUTO_TEST_CASE(LongPulses)
 		BOOST_CHECK_EQUAL(edges[i+1].second, false);
 	}
 
-	BOOST_CHECK_EQUAL(edges.back().first, Length-1);
-	BOOST_CHECK_EQUAL(edges.back().second, false);
+	BOOST_CHECK_EQUAL(edges.back().first, Length);
 }
 
 BOOST_AUTO_TEST_CASE(LisaMUsbHid)
@@ -456,7 +585,7 @@ BOOST_AUTO_TEST_CASE(LisaMUsbHid)
 		state = !state;
 	}
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 	delete[] (uint64_t*)logic.data;
 
 	vector<LogicSnapshot::EdgePair> edges;
@@ -493,7 +622,7 @@ BOOST_AUTO_TEST_CASE(WideData)
 	for (int i = 0; i < Length; i++)
 		data[i] = 0x0FF0;
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 
 	vector<LogicSnapshot::EdgePair> edges;
 
@@ -525,7 +654,7 @@ BOOST_AUTO_TEST_CASE(Sixteen)
 	for (int i = 0; i < Length; i++)
 		data[i] = 0xFFFE;
 
-	LogicSnapshot s(logic);
+	LogicSnapshot s(logic, Length, 1);
 
 	vector<LogicSnapshot::EdgePair> edges;
 	s.get_subsampled_edges(edges, 0, 2, 0.0004, 1);
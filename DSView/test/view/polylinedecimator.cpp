@@ -0,0 +1,120 @@
+/*
+ * This file is part of the DSView project.
+ * DSView is based on PulseView.
+ *
+ * Copyright (C) 2013 DreamSourceLab <dreamsourcelab@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../pv/view/polylinedecimator.h"
+
+using namespace std;
+
+using pv::view::PolylineDecimator;
+
+BOOST_AUTO_TEST_SUITE(PolylineDecimatorTest)
+
+typedef map<long, pair<double, double> > ColumnSpans;
+
+static void add_span(ColumnSpans &spans, double x, double y)
+{
+	const long column = (long)floor(x);
+	ColumnSpans::iterator i = spans.find(column);
+	if (i == spans.end()) {
+		spans[column] = make_pair(y, y);
+	} else {
+		i->second.first = min(i->second.first, y);
+		i->second.second = max(i->second.second, y);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MinMax)
+{
+	uint8_t data[101];
+	for (unsigned int i = 0; i < sizeof(data); i++)
+		data[i] = 100 + (i % 7);
+	data[60] = 3;
+	data[61] = 250;
+
+	uint8_t mn, mx;
+	PolylineDecimator::minmax(data, sizeof(data), 1, mn, mx);
+	BOOST_CHECK_EQUAL(mn, 3);
+	BOOST_CHECK_EQUAL(mx, 250);
+
+	// Only even samples belong to the channel
+	PolylineDecimator::minmax(data, sizeof(data) / 2, 2, mn, mx);
+	BOOST_CHECK_EQUAL(mn, 3);
+	BOOST_CHECK_EQUAL(mx, 106);
+	PolylineDecimator::minmax(data + 1, sizeof(data) / 2, 2, mn, mx);
+	BOOST_CHECK_EQUAL(mn, 100);
+	BOOST_CHECK_EQUAL(mx, 250);
+
+	uint16_t data16[77];
+	for (unsigned int i = 0; i < 77; i++)
+		data16[i] = 30000 + i;
+	data16[40] = 65535;
+	data16[41] = 0;
+	uint16_t mn16, mx16;
+	PolylineDecimator::minmax(data16, 77, 1, mn16, mx16);
+	BOOST_CHECK_EQUAL(mn16, 0);
+	BOOST_CHECK_EQUAL(mx16, 65535);
+	PolylineDecimator::minmax(data16 + 1, 38, 2, mn16, mx16);
+	BOOST_CHECK_EQUAL(mn16, 0);
+	BOOST_CHECK_EQUAL(mx16, 30075);
+}
+
+BOOST_AUTO_TEST_CASE(Columns)
+{
+	srand(1);
+	PolylineDecimator d;
+	d.set_y_transform(0.0f, 1.0f);
+
+	for (int trial = 0; trial < 100; trial++) {
+		const unsigned int stride = 1 << (rand() % 3);
+		const unsigned int channel = rand() % stride;
+		const int64_t count = 1 + rand() % 4000;
+		const double samples_per_pixel = 0.5 + (rand() % 2000) / 10.0;
+		const double x0 = (rand() % 100) / 7.0;
+
+		vector<uint8_t> data(count * stride);
+		for (unsigned int i = 0; i < data.size(); i++)
+			data[i] = rand();
+
+		const int point_count = d.decimate(&data[channel], count,
+			stride, x0, samples_per_pixel);
+		BOOST_CHECK(point_count <= count);
+
+		// Every pixel column must span the same vertical range
+		ColumnSpans expected, actual;
+		for (int64_t i = 0; i < count; i++)
+			add_span(expected, x0 + i * (1.0 / samples_per_pixel),
+				data[i * stride + channel]);
+		for (int i = 0; i < point_count; i++)
+			add_span(actual, d.points()[i].x(), d.points()[i].y());
+
+		BOOST_CHECK(expected == actual);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,190 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+/* Message logging helpers with subsystem-specific prefix string. */
+#define LOG_PREFIX "filemap: "
+#define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
+#define sr_spew(s, args...) sr_spew(LOG_PREFIX s, ## args)
+#define sr_dbg(s, args...) sr_dbg(LOG_PREFIX s, ## args)
+#define sr_info(s, args...) sr_info(LOG_PREFIX s, ## args)
+#define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
+#define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
+
+/**
+ * @file
+ *
+ * Read-only file mappings, which let captures be used in place instead
+ * of being read and copied.
+ */
+
+/**
+ * @defgroup grp_filemap File mappings
+ *
+ * Read-only file mappings, which let captures be used in place instead
+ * of being read and copied.
+ *
+ * @{
+ */
+
+/**
+ * Map a region of a file into memory.
+ *
+ * The pages are shared with the page cache and are only read from
+ * disk when they are touched. Like the sample buffers of the frontends,
+ * the region is followed by at least 8 readable bytes, so that samples
+ * can be loaded as 64-bit words.
+ *
+ * @param filename The name of the file.
+ * @param offset The start of the region in the file.
+ * @param length The length of the region, must not be 0.
+ * @param map Will be set to the new mapping, which holds one reference.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG on invalid arguments,
+ *         SR_ERR_NA if the platform does not support mappings, or
+ *         SR_ERR if the file could not be mapped.
+ */
+SR_API int sr_file_map_new(const char *filename, uint64_t offset,
+			   uint64_t length, struct sr_file_map **map)
+{
+#ifdef _WIN32
+	(void)filename;
+	(void)offset;
+	(void)length;
+	(void)map;
+
+	return SR_ERR_NA;
+#else
+	struct sr_file_map *m;
+	struct stat st;
+	uint64_t page, start, file_size;
+	size_t size;
+	void *addr;
+	int fd;
+
+	if (!filename || !map || length == 0) {
+		sr_err("%s: invalid arguments", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if ((fd = open(filename, O_RDONLY)) == -1) {
+		sr_err("Failed to open '%s'.", filename);
+		return SR_ERR;
+	}
+
+	if (fstat(fd, &st) == -1 || (uint64_t)st.st_size < offset ||
+	    (uint64_t)st.st_size - offset < length) {
+		sr_err("Region is outside of '%s'.", filename);
+		close(fd);
+		return SR_ERR;
+	}
+
+	/* Mappings start at a page boundary. */
+	page = sysconf(_SC_PAGESIZE);
+	start = offset - offset % page;
+	file_size = offset + length - start;
+	if (file_size + page > SIZE_MAX) {
+		close(fd);
+		return SR_ERR;
+	}
+
+	/* Reserve one more page of zeros, so that reading past the end
+	 * of the region stays inside the mapping even if the file ends
+	 * on a page boundary. */
+	size = ((file_size + page - 1) / page + 1) * page;
+	addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		sr_err("Failed to reserve %zu bytes.", size);
+		close(fd);
+		return SR_ERR;
+	}
+
+	if (mmap(addr, file_size, PROT_READ, MAP_SHARED | MAP_FIXED, fd,
+		 start) == MAP_FAILED) {
+		sr_err("Failed to map '%s'.", filename);
+		munmap(addr, size);
+		close(fd);
+		return SR_ERR;
+	}
+	close(fd);
+
+	/* Captures are mostly read front to back. */
+	madvise(addr, file_size, MADV_SEQUENTIAL);
+
+	if (!(m = g_try_malloc0(sizeof(*m)))) {
+		sr_err("File map malloc failed.");
+		munmap(addr, size);
+		return SR_ERR_MALLOC;
+	}
+
+	m->addr = addr;
+	m->size = size;
+	m->data = (const uint8_t *)addr + (offset - start);
+	m->length = length;
+	m->refcount = 1;
+	*map = m;
+
+	return SR_OK;
+#endif
+}
+
+/**
+ * Take a reference on a mapping.
+ *
+ * @param map The mapping.
+ *
+ * @return The mapping.
+ */
+SR_API struct sr_file_map *sr_file_map_ref(struct sr_file_map *map)
+{
+	g_atomic_int_inc(&map->refcount);
+
+	return map;
+}
+
+/**
+ * Drop a reference on a mapping, the last one unmaps the file.
+ *
+ * @param map The mapping, may be NULL.
+ */
+SR_API void sr_file_map_unref(struct sr_file_map *map)
+{
+	if (!map || !g_atomic_int_dec_and_test(&map->refcount))
+		return;
+
+#ifndef _WIN32
+	munmap(map->addr, map->size);
+#endif
+	g_free(map);
+}
+
+/** @} */
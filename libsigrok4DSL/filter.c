@@ -24,6 +24,16 @@
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAVE_BITGATHER_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* Message logging helpers with subsystem-specific prefix string. */
 #define LOG_PREFIX "filter: "
 #define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
@@ -47,6 +57,371 @@
  * @{
  */
 
+/*
+ * Samples are stored little endian, in_unitsize/out_unitsize bytes each,
+ * as the hardware drivers send them.
+ */
+static inline uint64_t load_sample(const uint8_t *p, unsigned int unitsize)
+{
+	uint64_t v = 0;
+
+	memcpy(&v, p, unitsize);
+	return v;
+}
+
+static inline void store_sample(uint8_t *p, uint64_t v, unsigned int unitsize)
+{
+	memcpy(p, &v, unitsize);
+}
+
+/*
+ * Away from the end of the buffers whole 64 bit words are accessed,
+ * which is much cheaper than a variable sized copy. The bytes beyond
+ * the sample are ignored on load, as the mask never selects them, and
+ * are overwritten by the following samples on store.
+ */
+#define WIDE_ACCESS_MARGIN 8
+
+static inline uint64_t load_wide(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void store_wide(uint8_t *p, uint64_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline uint64_t gather_runs(const struct sr_bitgather *bg, uint64_t v)
+{
+	uint64_t out = 0;
+	unsigned int r;
+
+	for (r = 0; r < bg->num_runs; r++)
+		out |= (v & bg->run_mask[r]) >> bg->run_shift[r];
+	return out;
+}
+
+static void gather_shift(const struct sr_bitgather *bg,
+			 const uint8_t *data_in, uint8_t *data_out,
+			 uint64_t samples)
+{
+	const unsigned int in_unitsize = bg->in_unitsize;
+	const unsigned int out_unitsize = bg->out_unitsize;
+	uint64_t i = 0;
+
+#ifdef __SSE2__
+	/*
+	 * Up to 16 bit wide samples are widened to 16 bit lanes, so each
+	 * run of the mask is applied to 8 samples with one and/shift/or.
+	 */
+	if (in_unitsize <= 2 && out_unitsize <= 2) {
+		const __m128i zero = _mm_setzero_si128();
+		__m128i masks[SR_BITGATHER_MAX_RUNS];
+		__m128i shifts[SR_BITGATHER_MAX_RUNS];
+		unsigned int r;
+
+		for (r = 0; r < bg->num_runs; r++) {
+			masks[r] = _mm_set1_epi16((short)bg->run_mask[r]);
+			shifts[r] = _mm_cvtsi32_si128(bg->run_shift[r]);
+		}
+
+		for (; i + 8 <= samples; i += 8) {
+			__m128i v, acc = zero;
+
+			if (in_unitsize == 1)
+				v = _mm_unpacklo_epi8(_mm_loadl_epi64(
+					(const __m128i *)(data_in + i)), zero);
+			else
+				v = _mm_loadu_si128(
+					(const __m128i *)(data_in + i * 2));
+
+			for (r = 0; r < bg->num_runs; r++)
+				acc = _mm_or_si128(acc, _mm_srl_epi16(
+					_mm_and_si128(v, masks[r]), shifts[r]));
+
+			if (out_unitsize == 1)
+				_mm_storel_epi64((__m128i *)(data_out + i),
+					_mm_packus_epi16(acc, acc));
+			else
+				_mm_storeu_si128((__m128i *)(data_out + i * 2), acc);
+		}
+	}
+#endif
+
+	for (; i + WIDE_ACCESS_MARGIN < samples; i++)
+		store_wide(data_out + i * out_unitsize,
+			gather_runs(bg, load_wide(data_in + i * in_unitsize)));
+	for (; i < samples; i++)
+		store_sample(data_out + i * out_unitsize,
+			gather_runs(bg, load_sample(data_in + i * in_unitsize,
+				in_unitsize)), out_unitsize);
+}
+
+static void gather_table(const struct sr_bitgather *bg,
+			 const uint8_t *data_in, uint8_t *data_out,
+			 uint64_t samples)
+{
+	const unsigned int in_unitsize = bg->in_unitsize;
+	const unsigned int out_unitsize = bg->out_unitsize;
+	const uint64_t *const table = bg->table;
+	uint64_t i, out;
+
+	if (in_unitsize == 1 && out_unitsize == 1) {
+		for (i = 0; i < samples; i++)
+			data_out[i] = (uint8_t)table[data_in[i]];
+	} else if (in_unitsize == 2 && out_unitsize == 2) {
+		for (i = 0; i < samples; i++, data_in += 2, data_out += 2) {
+			out = table[data_in[0]] | table[256 + data_in[1]];
+			data_out[0] = (uint8_t)out;
+			data_out[1] = (uint8_t)(out >> 8);
+		}
+	} else {
+		for (i = 0; i < samples; i++) {
+			out = 0;
+			switch (in_unitsize) {
+			case 8: out |= table[7 * 256 + data_in[7]]; /* Fall through. */
+			case 7: out |= table[6 * 256 + data_in[6]]; /* Fall through. */
+			case 6: out |= table[5 * 256 + data_in[5]]; /* Fall through. */
+			case 5: out |= table[4 * 256 + data_in[4]]; /* Fall through. */
+			case 4: out |= table[3 * 256 + data_in[3]]; /* Fall through. */
+			case 3: out |= table[2 * 256 + data_in[2]]; /* Fall through. */
+			case 2: out |= table[1 * 256 + data_in[1]]; /* Fall through. */
+			default: out |= table[data_in[0]];
+			}
+			if (i + WIDE_ACCESS_MARGIN < samples)
+				store_wide(data_out, out);
+			else
+				store_sample(data_out, out, out_unitsize);
+			data_in += in_unitsize;
+			data_out += out_unitsize;
+		}
+	}
+}
+
+#ifdef HAVE_BITGATHER_X86
+__attribute__((target("bmi2")))
+static void gather_pext(const struct sr_bitgather *bg,
+			const uint8_t *data_in, uint8_t *data_out,
+			uint64_t samples)
+{
+	const unsigned int in_unitsize = bg->in_unitsize;
+	const unsigned int out_unitsize = bg->out_unitsize;
+	const uint64_t mask = bg->mask;
+	uint64_t i;
+	uint16_t v16;
+
+	if (in_unitsize == 1 && out_unitsize == 1) {
+		for (i = 0; i < samples; i++)
+			data_out[i] = (uint8_t)_pext_u32(data_in[i], (uint32_t)mask);
+	} else if (in_unitsize == 2 && out_unitsize == 2) {
+		for (i = 0; i < samples; i++) {
+			memcpy(&v16, data_in + i * 2, 2);
+			v16 = (uint16_t)_pext_u32(v16, (uint32_t)mask);
+			memcpy(data_out + i * 2, &v16, 2);
+		}
+	} else {
+		for (i = 0; i + WIDE_ACCESS_MARGIN < samples; i++)
+			store_wide(data_out + i * out_unitsize,
+				_pext_u64(load_wide(data_in + i * in_unitsize),
+					mask));
+		for (; i < samples; i++)
+			store_sample(data_out + i * out_unitsize,
+				_pext_u64(load_sample(data_in + i * in_unitsize,
+					in_unitsize), mask), out_unitsize);
+	}
+}
+
+/*
+ * PEXT is microcoded, and much slower than the table lookups, on AMD
+ * CPUs before Zen 3 (family 19h).
+ */
+static int have_fast_pext(void)
+{
+	static int fast_pext = -1;
+	unsigned int eax, ebx, ecx, edx, family;
+
+	if (fast_pext >= 0)
+		return fast_pext;
+
+	fast_pext = 0;
+	if (!__builtin_cpu_supports("bmi2"))
+		return fast_pext;
+
+	if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) &&
+	    ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163) {
+		/* "AuthenticAMD" */
+		__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+		family = (eax >> 8) & 0xf;
+		if (family == 0xf)
+			family += (eax >> 20) & 0xff;
+		if (family < 0x19)
+			return fast_pext;
+	}
+
+	fast_pext = 1;
+	return fast_pext;
+}
+#endif
+
+/**
+ * Prepare gathering the bits selected by a mask.
+ *
+ * Every set bit of the mask is copied to the next free bit of the output
+ * sample, from the lowest to the highest one, like the PEXT instruction
+ * does; the remaining output bits are zero. sr_filter_probes() and the
+ * logic channel groups are built on it.
+ *
+ * @param bg The gather context to initialize. Must not be NULL.
+ * @param mask The bits to extract from each input sample. It must not
+ *             have more bits set than fit into out_unitsize bytes.
+ * @param in_unitsize The unit size (1 - 8) of the input samples.
+ * @param out_unitsize The unit size (1 - 8) of the output samples.
+ * @param method SR_BITGATHER_AUTO, or one of the SR_BITGATHER_* methods
+ *               to force it, e.g. for benchmarking.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_NA if the requested method is not supported by this CPU,
+ *         or SR_ERR_MALLOC upon memory allocation errors.
+ *         The context must be released with sr_bitgather_cleanup() after
+ *         SR_OK was returned.
+ */
+SR_API int sr_bitgather_init(struct sr_bitgather *bg, uint64_t mask,
+			     unsigned int in_unitsize, unsigned int out_unitsize,
+			     int method)
+{
+	unsigned int bit, out_bit, k;
+	uint64_t b;
+
+	if (!bg) {
+		sr_err("%s: bg was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (in_unitsize < 1 || in_unitsize > 8 ||
+	    out_unitsize < 1 || out_unitsize > 8) {
+		sr_err("%s: invalid unit size (%d/%d)", __func__,
+		       in_unitsize, out_unitsize);
+		return SR_ERR_ARG;
+	}
+
+	if (in_unitsize < 8)
+		mask &= (UINT64_C(1) << (in_unitsize * 8)) - 1;
+
+	memset(bg, 0, sizeof(struct sr_bitgather));
+	bg->in_unitsize = in_unitsize;
+	bg->out_unitsize = out_unitsize;
+	bg->mask = mask;
+
+	/* Split the mask into runs of bits which move by the same amount. */
+	out_bit = 0;
+	for (bit = 0; bit < 64; bit++) {
+		if (!(mask & (UINT64_C(1) << bit)))
+			continue;
+		if (bg->num_runs == 0 ||
+		    bg->run_shift[bg->num_runs - 1] != bit - out_bit)
+			bg->run_shift[bg->num_runs++] = bit - out_bit;
+		bg->run_mask[bg->num_runs - 1] |= UINT64_C(1) << bit;
+		out_bit++;
+	}
+
+	if (out_bit > out_unitsize * 8) {
+		sr_err("%s: too many bits (%d) for the target unit "
+		       "size (%d)", __func__, out_bit, out_unitsize);
+		return SR_ERR_ARG;
+	}
+
+	if (method == SR_BITGATHER_AUTO) {
+#ifdef HAVE_BITGATHER_X86
+		if (have_fast_pext())
+			method = SR_BITGATHER_PEXT;
+		else
+#endif
+#ifdef __SSE2__
+		if (in_unitsize <= 2 && out_unitsize <= 2)
+			method = SR_BITGATHER_SHIFT;
+		else
+#endif
+		if (bg->num_runs <= 2)
+			method = SR_BITGATHER_SHIFT;
+		else
+			method = SR_BITGATHER_TABLE;
+	}
+
+	switch (method) {
+	case SR_BITGATHER_SHIFT:
+		break;
+	case SR_BITGATHER_TABLE:
+		if (!(bg->table = g_try_malloc(in_unitsize * 256 *
+					       sizeof(uint64_t)))) {
+			sr_err("%s: table malloc failed", __func__);
+			return SR_ERR_MALLOC;
+		}
+		for (k = 0; k < in_unitsize; k++)
+			for (b = 0; b < 256; b++)
+				bg->table[k * 256 + b] =
+					gather_runs(bg, b << (k * 8));
+		break;
+	case SR_BITGATHER_PEXT:
+#ifdef HAVE_BITGATHER_X86
+		if (__builtin_cpu_supports("bmi2"))
+			break;
+#endif
+		return SR_ERR_NA;
+	default:
+		sr_err("%s: unknown method %d", __func__, method);
+		return SR_ERR_ARG;
+	}
+	bg->method = method;
+
+	return SR_OK;
+}
+
+/**
+ * Release the resources of a gather context.
+ *
+ * @param bg The context set up by sr_bitgather_init(). May be NULL.
+ */
+SR_API void sr_bitgather_cleanup(struct sr_bitgather *bg)
+{
+	if (!bg)
+		return;
+
+	g_free(bg->table);
+	bg->table = NULL;
+}
+
+/**
+ * Gather the masked bits of a block of samples.
+ *
+ * @param bg The context set up by sr_bitgather_init().
+ * @param data_in The input samples, in_unitsize bytes each.
+ * @param data_out The output buffer, out_unitsize bytes per sample. It must
+ *                 not overlap the input buffer.
+ * @param samples The number of samples.
+ */
+SR_API void sr_bitgather_run(const struct sr_bitgather *bg,
+			     const uint8_t *data_in, uint8_t *data_out,
+			     uint64_t samples)
+{
+	switch (bg->method) {
+	case SR_BITGATHER_TABLE:
+		gather_table(bg, data_in, data_out, samples);
+		break;
+#ifdef HAVE_BITGATHER_X86
+	case SR_BITGATHER_PEXT:
+		gather_pext(bg, data_in, data_out, samples);
+		break;
+#endif
+	default:
+		gather_shift(bg, data_in, data_out, samples);
+		break;
+	}
+}
+
 /**
  * Remove unused probes from samples.
  *
@@ -106,7 +481,8 @@ SR_API int sr_filter_probes(unsigned int in_unitsize, unsigned int out_unitsize,
 	unsigned int in_offset, out_offset;
 	int *probelist, out_bit;
 	unsigned int i;
-	uint64_t sample_in, sample_out;
+	uint64_t sample_in, sample_out, mask, samples;
+	struct sr_bitgather bg;
 
 	if (!probe_array) {
 		sr_err("%s: probe_array was NULL", __func__);
@@ -149,13 +525,32 @@ SR_API int sr_filter_probes(unsigned int in_unitsize, unsigned int out_unitsize,
 	}
 
 	/* If we reached this point, not all probes are used, so "compress". */
+	mask = 0;
+	for (i = 0; i < probe_array->len; i++) {
+		if (probelist[i] < 0 || probelist[i] >= (int)in_unitsize * 8 ||
+		    (mask >> probelist[i]) != 0)
+			break;
+		mask |= UINT64_C(1) << probelist[i];
+	}
+
+	/* Probes in ascending order are a plain bit gather. */
+	if (i == probe_array->len && in_unitsize <= 8 && out_unitsize <= 8 &&
+	    sr_bitgather_init(&bg, mask, in_unitsize, out_unitsize,
+			      SR_BITGATHER_AUTO) == SR_OK) {
+		samples = length_in / in_unitsize;
+		sr_bitgather_run(&bg, data_in, *data_out, samples);
+		sr_bitgather_cleanup(&bg);
+		*length_out = samples * out_unitsize;
+		return SR_OK;
+	}
+
 	in_offset = out_offset = 0;
 	while (in_offset <= length_in - in_unitsize) {
 		memcpy(&sample_in, data_in + in_offset, in_unitsize);
 		sample_out = out_bit = 0;
 		for (i = 0; i < probe_array->len; i++) {
-			if (sample_in & (1 << (probelist[i])))
-				sample_out |= (1 << out_bit);
+			if (sample_in & (UINT64_C(1) << (probelist[i])))
+				sample_out |= (UINT64_C(1) << out_bit);
 			out_bit++;
 		}
 		memcpy((*data_out) + out_offset, &sample_out, out_unitsize);
@@ -22,6 +22,28 @@
 //#include "libsigrok.h"
 #include "dsl.h"
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+/*
+ * FPGA bitstreams which were read from res/, shared by all devices. An
+ * image is read again when its file has changed.
+ */
+struct fpga_image {
+    gint refcount;
+    char *filename;
+    time_t mtime;
+    off_t size;
+    unsigned char *data;
+    /* Tells the images apart, never 0. */
+    uint64_t id;
+};
+
+static GMutex fpga_mutex;
+static GSList *fpga_images;
+static uint64_t fpga_last_id;
 
 SR_PRIV int command_get_fw_version(libusb_device_handle *devhdl,
                    struct version_info *vi)
@@ -145,6 +167,155 @@ SR_PRIV int command_fpga_config(libusb_device_handle *devhdl)
     return SR_OK;
 }
 
+static void fpga_image_unref(struct fpga_image *image)
+{
+    if (!g_atomic_int_dec_and_test(&image->refcount))
+        return;
+
+    g_free(image->filename);
+    g_free(image->data);
+    g_free(image);
+}
+
+static struct fpga_image *fpga_image_read(const char *filename,
+                                          const struct stat *f_stat)
+{
+    struct fpga_image *image;
+    FILE *fw;
+
+    if ((fw = g_fopen(filename, "rb")) == NULL) {
+        sr_err("Unable to open FPGA bit file %s for reading: %s",
+               filename, strerror(errno));
+        return NULL;
+    }
+
+    if (!(image = g_try_malloc0(sizeof(struct fpga_image))) ||
+        !(image->data = g_try_malloc(f_stat->st_size))) {
+        sr_err("FPGA configure bit malloc failed.");
+        g_free(image);
+        fclose(fw);
+        return NULL;
+    }
+
+    if (fread(image->data, 1, f_stat->st_size, fw) != (size_t)f_stat->st_size) {
+        sr_err("Unable to read FPGA bit file %s.", filename);
+        g_free(image->data);
+        g_free(image);
+        fclose(fw);
+        return NULL;
+    }
+    fclose(fw);
+
+    image->refcount = 1;
+    image->filename = g_strdup(filename);
+    image->mtime = f_stat->st_mtime;
+    image->size = f_stat->st_size;
+    image->id = ++fpga_last_id;
+
+    return image;
+}
+
+/* The cached image of filename, with a reference for the caller. */
+static struct fpga_image *fpga_image_get(const char *filename)
+{
+    struct fpga_image *image;
+    struct stat f_stat;
+    GSList *l;
+
+    if (stat(filename, &f_stat) == -1) {
+        sr_err("Unable to stat FPGA bit file %s: %s",
+               filename, strerror(errno));
+        return NULL;
+    }
+
+    g_mutex_lock(&fpga_mutex);
+    for (l = fpga_images; l; l = l->next) {
+        image = l->data;
+        if (!strcmp(image->filename, filename))
+            break;
+    }
+    if (l) {
+        if (image->mtime == f_stat.st_mtime && image->size == f_stat.st_size) {
+            g_atomic_int_inc(&image->refcount);
+            g_mutex_unlock(&fpga_mutex);
+            return image;
+        }
+        fpga_images = g_slist_delete_link(fpga_images, l);
+        fpga_image_unref(image);
+    }
+
+    sr_info("Reading FPGA bit file %s", filename);
+    if ((image = fpga_image_read(filename, &f_stat))) {
+        fpga_images = g_slist_prepend(fpga_images, image);
+        g_atomic_int_inc(&image->refcount);
+    }
+    g_mutex_unlock(&fpga_mutex);
+
+    return image;
+}
+
+/**
+ * Configure the FPGA with the bitstream in filename, unless it is the one
+ * the device was last configured with since it was opened. The device does
+ * not report its bitstream, so loaded is only trusted while the device stays
+ * open; the drivers reset it in dev_close.
+ *
+ * @param loaded The bitstream the device was last configured with, 0 for
+ *               none. Updated on return.
+ */
+SR_PRIV int command_fpga_load(libusb_device_handle *devhdl,
+                              const char *filename, uint64_t *loaded)
+{
+    struct fpga_image *image;
+    int ret, result, transferred;
+
+    if (!(image = fpga_image_get(filename)))
+        return SR_ERR;
+
+    if (image->id == *loaded) {
+        sr_info("FPGA is configured with %s already", filename);
+        fpga_image_unref(image);
+        return SR_OK;
+    }
+
+    *loaded = 0;
+    if ((result = command_fpga_config(devhdl)) != SR_OK) {
+        sr_err("Send FPGA configure command failed!");
+        fpga_image_unref(image);
+        return result;
+    }
+    /* Takes >= 10ms for the FX2 to be ready for FPGA configure. */
+    g_usleep(10 * 1000);
+
+    sr_info("Configure FPGA using %s", filename);
+    ret = libusb_bulk_transfer(devhdl, 2 | LIBUSB_ENDPOINT_OUT,
+                               image->data, image->size,
+                               &transferred, 1000);
+    if (ret < 0) {
+        sr_err("Unable to configure FPGA: %s.", libusb_error_name(ret));
+        result = SR_ERR;
+    } else if (transferred != image->size) {
+        sr_err("Configure FPGA error: expacted transfer size %d; actually %d",
+                (int)image->size, transferred);
+        result = SR_ERR;
+    } else {
+        sr_info("FPGA configure done");
+        *loaded = image->id;
+    }
+    fpga_image_unref(image);
+
+    return result;
+}
+
+/* Forget the cached bitstreams, called when a driver is cleaned up. */
+SR_PRIV void command_fpga_cache_clear(void)
+{
+    g_mutex_lock(&fpga_mutex);
+    g_slist_free_full(fpga_images, (GDestroyNotify)fpga_image_unref);
+    fpga_images = NULL;
+    g_mutex_unlock(&fpga_mutex);
+}
+
 SR_PRIV int command_fpga_setting(libusb_device_handle *devhdl, uint32_t setting_count)
 {
     struct cmd_setting_count cmd;
@@ -132,6 +132,9 @@ SR_PRIV int command_start_acquisition(libusb_device_handle *devhdl,
 SR_PRIV int command_stop_acquistition(libusb_device_handle *devhdl);
 
 SR_PRIV int command_fpga_config(libusb_device_handle *devhdl);
+SR_PRIV int command_fpga_load(libusb_device_handle *devhdl,
+                              const char *filename, uint64_t *loaded);
+SR_PRIV void command_fpga_cache_clear(void);
 SR_PRIV int command_fpga_setting(libusb_device_handle *devhdl, uint32_t setting_count);
 
 SR_PRIV int command_dso_ctrl(libusb_device_handle *devhdl, uint64_t command);
@@ -340,64 +340,25 @@ static int fpga_setting(const struct sr_dev_inst *sdi)
     return result;
 }
 
-static int fpga_config(struct libusb_device_handle *hdl, const char *filename)
+/* Configure the FPGA, unless it is configured already. */
+static int fpga_load(const struct sr_dev_inst *sdi)
 {
-    FILE *fw;
-    int offset, chunksize, ret, result;
-    unsigned char *buf;
-    int transferred;
-    uint64_t filesize;
-	struct stat f_stat;
-
-    sr_info("Configure FPGA using %s", filename);
-    if ((fw = g_fopen(filename, "rb")) == NULL) {
-        sr_err("Unable to open FPGA bit file %s for reading: %s",
-               filename, strerror(errno));
-        return SR_ERR;
-    }
-	
-    if (stat(filename, &f_stat) == -1)
-        return SR_ERR;
-
-    filesize = (uint64_t)f_stat.st_size;
-	
-    if (!(buf = g_try_malloc(filesize))) {
-            sr_err("FPGA configure bit malloc failed.");
-            return SR_ERR;
-    }
-
-    result = SR_OK;
-    offset = 0;
-    while (1) {
-        chunksize = fread(buf, 1, filesize, fw);
-        if (chunksize == 0)
-            break;
+    struct DSL_context *devc;
+    struct sr_usb_dev_inst *usb;
+    char *fpga_bit;
+    int ret;
 
-        //do {
-            ret = libusb_bulk_transfer(hdl, 2 | LIBUSB_ENDPOINT_OUT,
-                                       buf, chunksize,
-                                       &transferred, 1000);
-        //} while(ret == LIBUSB_ERROR_TIMEOUT);
+    devc = sdi->priv;
+    usb = sdi->conn;
 
-        if (ret < 0) {
-            sr_err("Unable to configure FPGA of DSCope: %s.",
-                    libusb_error_name(ret));
-            result = SR_ERR;
-            break;
-        } else if (transferred != chunksize) {
-            sr_err("Configure FPGA error: expacted transfer size %d; actually %d",
-                    chunksize, transferred);
-            result = SR_ERR;
-            break;
-        }
-        sr_info("Configure %d bytes", chunksize);
-        offset += chunksize;
-    }
-    fclose(fw);
-    if (result == SR_OK)
-        sr_info("FPGA configure done");
+    if (!(fpga_bit = g_strconcat(config_path, devc->profile->fpga_bit33, NULL)))
+        return SR_ERR_MALLOC;
+    ret = command_fpga_load(usb->devhdl, fpga_bit, &devc->fpga_image);
+    if (ret != SR_OK)
+        sr_err("Configure FPGA failed!");
+    g_free(fpga_bit);
 
-    return result;
+    return ret;
 }
 
 static int DSCope_dev_open(struct sr_dev_inst *sdi)
@@ -575,6 +536,7 @@ static struct DSL_context *DSCope_dev_new(void)
 
     devc->profile = NULL;
     devc->fw_updated = 0;
+    devc->fpga_image = 0;
     devc->cur_samplerate = DSCOPE_MAX_SAMPLERATE / MAX_DSO_PROBES_NUM;
     devc->limit_samples = DSCOPE_MAX_DEPTH / MAX_DSO_PROBES_NUM;
     devc->sample_wide = 0;
@@ -987,21 +949,7 @@ static int dev_open(struct sr_dev_inst *sdi)
         return SR_ERR;
 	}
 
-    if ((ret = command_fpga_config(usb->devhdl)) != SR_OK) {
-        sr_err("Send FPGA configure command failed!");
-    } else {
-        /* Takes >= 10ms for the FX2 to be ready for FPGA configure. */
-        g_usleep(10 * 1000);
-        char *fpga_bit = malloc(strlen(config_path)+strlen(devc->profile->fpga_bit33)+1);
-        if (fpga_bit == NULL)
-            return SR_ERR_MALLOC;
-        strcpy(fpga_bit, config_path);
-        strcat(fpga_bit, devc->profile->fpga_bit33);
-        ret = fpga_config(usb->devhdl, fpga_bit);
-        if (ret != SR_OK) {
-            sr_err("Configure FPGA failed!");
-        }
-    }
+    fpga_load(sdi);
 
     if (sdi->mode == DSO) {
         GSList *l;
@@ -1097,8 +1045,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
     struct sr_usb_dev_inst *usb;
+    struct DSL_context *devc;
 
 	usb = sdi->conn;
+    devc = sdi->priv;
 	if (usb->devhdl == NULL)
         return SR_ERR;
 
@@ -1108,6 +1058,9 @@ static int dev_close(struct sr_dev_inst *sdi)
 	libusb_close(usb->devhdl);
 	usb->devhdl = NULL;
     sdi->status = SR_ST_INACTIVE;
+    /* The FPGA can not be asked what it runs, and it may be power
+     * cycled before the next open, so configure it again then. */
+    devc->fpga_image = 0;
 
     return SR_OK;
 }
@@ -1121,6 +1074,7 @@ static int cleanup(void)
         return SR_OK;
 
 	ret = dev_clear();
+    command_fpga_cache_clear();
 
 	g_free(drvc);
 	di->priv = NULL;
@@ -1416,24 +1370,8 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
         } else {
             ret = SR_ERR;
         }
-        if ((ret = command_fpga_config(usb->devhdl)) != SR_OK) {
-            sr_err("Send FPGA configure command failed!");
-        } else {
-            /* Takes >= 10ms for the FX2 to be ready for FPGA configure. */
-            g_usleep(10 * 1000);
-            //char filename[256];
-            //sprintf(filename,"%s%s",config_path,devc->profile->fpga_bit33);
-            //const char *fpga_bit = filename;
-            char *fpga_bit = malloc(strlen(config_path)+strlen(devc->profile->fpga_bit33)+1);
-            if (fpga_bit == NULL)
-                return SR_ERR_MALLOC;
-            strcpy(fpga_bit, config_path);
-            strcat(fpga_bit, devc->profile->fpga_bit33);
-            ret = fpga_config(usb->devhdl, fpga_bit);
-            if (ret != SR_OK) {
-                sr_err("Configure FPGA failed!");
-            }
-        }
+        if (ret == SR_OK)
+            ret = fpga_load(sdi);
         sr_dbg("%s: setting threshold to %d",
             __func__, devc->th_level);
     }  else if (id == SR_CONF_FILTER) {
@@ -1704,8 +1642,9 @@ static void abort_acquisition(struct DSL_context *devc)
 
 static void finish_acquisition(struct DSL_context *devc)
 {
+    struct drv_context *drvc = di->priv;
     struct sr_datafeed_packet packet;
-    int i, ret;
+    int ret;
     struct sr_usb_dev_inst *usb;
 
     sr_err("finish acquisition: send SR_DF_END packet");
@@ -1715,9 +1654,7 @@ static void finish_acquisition(struct DSL_context *devc)
 
     sr_err("finish acquisition: remove fds from polling");
     /* Remove fds from polling. */
-    for (i = 0; devc->usbfd[i] != -1; i++)
-        sr_source_remove(devc->usbfd[i]);
-    g_free(devc->usbfd);
+    usb_source_remove(drvc->sr_ctx, devc->cb_data);
 	
     if (devc->num_transfers != 0) {
         devc->num_transfers = 0;
@@ -2080,34 +2017,6 @@ static size_t get_buffer_size(struct DSL_context *devc)
     return (s + 511) & ~511;
 }
 
-static unsigned int get_number_of_transfers(struct DSL_context *devc)
-{
-    unsigned int n;
-    size_t total_size;
-    total_size = min(devc->limit_samples * (devc->sample_wide ? 2 : 1),
-                      total_buffer_time * to_bytes_per_ms(devc));
-    /* Total buffer size should be able to hold about 500ms of data. */
-    //n = 500 * to_bytes_per_ms(devc) / get_buffer_size(devc);
-    n = ceil(total_size * 1.0 / get_buffer_size(devc));
-
-    if (n > NUM_SIMUL_TRANSFERS)
-        return NUM_SIMUL_TRANSFERS;
-
-    return n;
-    //return 1;
-}
-
-static unsigned int get_timeout(struct DSL_context *devc)
-{
-    size_t total_size;
-    unsigned int timeout;
-
-    total_size = get_buffer_size(devc) * get_number_of_transfers(devc);
-    timeout = total_size / to_bytes_per_ms(devc);
-    //return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-    return timeout * 4;
-}
-
 static int dev_transfer_start(const struct sr_dev_inst *sdi)
 {
     struct DSL_context *devc;
@@ -2280,8 +2189,6 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
     struct sr_usb_dev_inst *usb;
     struct libusb_transfer *transfer;
     struct ds_trigger_pos *trigger_pos;
-    const struct libusb_pollfd **lupfd;
-	unsigned int i;
     int ret;
     int transferred;
     struct sr_datafeed_packet packet;
@@ -2356,17 +2263,10 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
     test_sample_value = 0;
 
     /* setup callback function for data transfer */
-    lupfd = libusb_get_pollfds(drvc->sr_ctx->libusb_ctx);
-    for (i = 0; lupfd[i]; i++);
-    if (!(devc->usbfd = g_try_malloc(sizeof(struct libusb_pollfd) * (i + 1))))
-    return SR_ERR;
-    for (i = 0; lupfd[i]; i++) {
-        sr_source_add(lupfd[i]->fd, lupfd[i]->events,
-    		      get_timeout(devc), receive_data, sdi);
-    	devc->usbfd[i] = lupfd[i]->fd;
+    if ((ret = usb_source_add(drvc->sr_ctx, 0, receive_data, sdi)) != SR_OK) {
+        abort_acquisition(devc);
+        return ret;
     }
-    devc->usbfd[i] = -1;
-    free(lupfd);
 	
     /* poll trigger status transfer*/
     if (!(trigger_pos = g_try_malloc0(sizeof(struct ds_trigger_pos)))) {
@@ -146,6 +146,9 @@ struct DSL_context {
 	 * until a proper delay after the last device was upgraded.
 	 */
 	int64_t fw_updated;
+    /* The FPGA bitstream the device was last configured with since it was
+     * opened, 0 for none. */
+    uint64_t fpga_image;
 
 	/* Device/capture settings */
 	uint64_t cur_samplerate;
@@ -186,7 +189,18 @@ struct DSL_context {
 	void *cb_data;
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
-	int *usbfd;
+
+	/* Logic transfers adapting to the host, see requeue_transfer(). */
+	size_t transfer_size;
+	unsigned int transfer_depth;
+	int64_t window_start;
+	int64_t last_resubmit;
+	int64_t max_gap;
+	int64_t busy_time;
+	int64_t max_busy;
+	unsigned int window_transfers;
+	int calm_windows;
+	double overflow_margin;
 
     int pipe_fds[2];
     GIOChannel *channel;
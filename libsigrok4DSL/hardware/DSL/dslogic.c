@@ -36,6 +36,10 @@
 
 static const int single_buffer_time = 20;
 static const int total_buffer_time = 200;
+static const int max_buffer_time = 100;
+static const int adapt_window_time = 250;
+static const int adapt_calm_windows = 40;
+static const size_t max_queued_size = 16 * 1024 * 1024;
 static const int buffer_size = 1024 * 1024;
 static const int instant_buffer_size = 1024 * 1024;
 static const int cons_buffer_size = 128;
@@ -448,65 +452,39 @@ static int fpga_setting(const struct sr_dev_inst *sdi)
     return result;
 }
 
-static int fpga_config(struct libusb_device_handle *hdl, const char *filename)
+/* Configure the FPGA with the bitstream for the threshold level. */
+static int fpga_load(const struct sr_dev_inst *sdi)
 {
-    FILE *fw;
-    int offset, chunksize, ret, result;
-    unsigned char *buf;
-    int transferred;
-    uint64_t filesize;
-	struct stat f_stat;
+    struct DSL_context *devc;
+    struct sr_usb_dev_inst *usb;
+    const char *name;
+    char *fpga_bit;
+    int ret;
 
-    sr_info("Configure FPGA using %s", filename);
-    if ((fw = g_fopen(filename, "rb")) == NULL) {
-        sr_err("Unable to open FPGA bit file %s for reading: %s",
-               filename, strerror(errno));
-        return SR_ERR;
-    }
-	
-    if (stat(filename, &f_stat) == -1)
-        return SR_ERR;
+    devc = sdi->priv;
+    usb = sdi->conn;
 
-    filesize = (uint64_t)f_stat.st_size;
-	
-    if (!(buf = g_try_malloc(filesize))) {
-            sr_err("FPGA configure bit malloc failed.");
-            return SR_ERR;
+    switch(devc->th_level) {
+    case SR_TH_3V3:
+        name = devc->profile->fpga_bit33;
+        break;
+    case SR_TH_5V0:
+        name = devc->profile->fpga_bit50;
+        break;
+    default:
+        return SR_ERR;
     }
 
-    result = SR_OK;
-    offset = 0;
-    while (1) {
-        chunksize = fread(buf, 1, filesize, fw);
-        if (chunksize == 0)
-            break;
-
-        //do {
-            ret = libusb_bulk_transfer(hdl, 2 | LIBUSB_ENDPOINT_OUT,
-                                       buf, chunksize,
-                                       &transferred, 1000);
-        //} while(ret == LIBUSB_ERROR_TIMEOUT);
-
-        if (ret < 0) {
-            sr_err("Unable to configure FPGA of DSLogic: %s.",
-                    libusb_error_name(ret));
-            result = SR_ERR;
-            break;
-        } else if (transferred != chunksize) {
-            sr_err("Configure FPGA error: expacted transfer size %d; actually %d",
-                    chunksize, transferred);
-            result = SR_ERR;
-            break;
-        }
-        sr_info("Configure %d bytes", chunksize);
-        offset += chunksize;
+    if (!(fpga_bit = g_strconcat(config_path, name, NULL))) {
+        sr_err("fpag_bit path malloc error!");
+        return SR_ERR_MALLOC;
     }
-    fclose(fw);
-    g_free(buf);
-    if (result == SR_OK)
-        sr_info("FPGA configure done");
+    ret = command_fpga_load(usb->devhdl, fpga_bit, &devc->fpga_image);
+    if (ret != SR_OK)
+        sr_err("Configure FPGA failed!");
+    g_free(fpga_bit);
 
-    return result;
+    return ret;
 }
 
 static int DSLogic_dev_open(struct sr_dev_inst *sdi)
@@ -678,6 +656,7 @@ static struct DSL_context *DSLogic_dev_new(void)
 
 	devc->profile = NULL;
 	devc->fw_updated = 0;
+    devc->fpga_image = 0;
     devc->cur_samplerate = DEFAULT_SAMPLERATE;
     devc->limit_samples = DEFAULT_SAMPLELIMIT;
     devc->sample_wide = TRUE;
@@ -1100,35 +1079,8 @@ static int dev_open(struct sr_dev_inst *sdi)
         return SR_ERR;
 	}
 
-    if (devc->fw_updated > 0) {
-        if ((ret = command_fpga_config(usb->devhdl)) != SR_OK) {
-            sr_err("Send FPGA configure command failed!");
-        } else {
-            /* Takes >= 10ms for the FX2 to be ready for FPGA configure. */
-            g_usleep(10 * 1000);
-            char *fpga_bit;
-            if (!(fpga_bit = g_try_malloc(strlen(config_path)+strlen(devc->profile->fpga_bit33)+1))) {
-                sr_err("fpag_bit path malloc error!");
-                return SR_ERR_MALLOC;
-            }
-            strcpy(fpga_bit, config_path);
-            switch(devc->th_level) {
-            case SR_TH_3V3:
-                strcat(fpga_bit, devc->profile->fpga_bit33);;
-                break;
-            case SR_TH_5V0:
-                strcat(fpga_bit, devc->profile->fpga_bit50);;
-                break;
-            default:
-                return SR_ERR;
-            }
-            ret = fpga_config(usb->devhdl, fpga_bit);
-            if (ret != SR_OK) {
-                sr_err("Configure FPGA failed!");
-            }
-            g_free(fpga_bit);
-        }
-    }
+    if (devc->fw_updated > 0)
+        fpga_load(sdi);
 
     ret = command_vth(usb->devhdl, devc->vth);
     if (ret == SR_OK)
@@ -1144,8 +1096,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
     struct sr_usb_dev_inst *usb;
+    struct DSL_context *devc;
 
 	usb = sdi->conn;
+    devc = sdi->priv;
 	if (usb->devhdl == NULL)
         return SR_ERR;
 
@@ -1155,6 +1109,9 @@ static int dev_close(struct sr_dev_inst *sdi)
 	libusb_close(usb->devhdl);
 	usb->devhdl = NULL;
     sdi->status = SR_ST_INACTIVE;
+    /* The FPGA can not be asked what it runs, and it may be power
+     * cycled before the next open, so configure it again then. */
+    devc->fpga_image = 0;
 
     return SR_OK;
 }
@@ -1168,6 +1125,7 @@ static int cleanup(void)
         return SR_OK;
 
 	ret = dev_clear();
+    command_fpga_cache_clear();
 
 	g_free(drvc);
 	di->priv = NULL;
@@ -1291,6 +1249,24 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
         devc = sdi->priv;
         *data = g_variant_new_double(devc->vth);
         break;
+    case SR_CONF_USB_TRANSFER_SIZE:
+        if (!sdi)
+            return SR_ERR;
+        devc = sdi->priv;
+        *data = g_variant_new_uint64(devc->transfer_size);
+        break;
+    case SR_CONF_USB_TRANSFERS:
+        if (!sdi)
+            return SR_ERR;
+        devc = sdi->priv;
+        *data = g_variant_new_uint64(devc->transfer_depth);
+        break;
+    case SR_CONF_USB_OVERFLOW_MARGIN:
+        if (!sdi)
+            return SR_ERR;
+        devc = sdi->priv;
+        *data = g_variant_new_double(devc->overflow_margin);
+        break;
     case SR_CONF_VDIV:
         if (!ch)
             return SR_ERR;
@@ -1664,35 +1640,8 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
         } else {
             ret = SR_ERR;
         }
-        if (sdi->mode == LOGIC) {
-            if ((ret = command_fpga_config(usb->devhdl)) != SR_OK) {
-                sr_err("Send FPGA configure command failed!");
-            } else {
-                /* Takes >= 10ms for the FX2 to be ready for FPGA configure. */
-                g_usleep(10 * 1000);
-                char *fpga_bit;
-                if (!(fpga_bit = g_try_malloc(strlen(config_path)+strlen(devc->profile->fpga_bit33)+1))) {
-                    sr_err("fpag_bit path malloc error!");
-                    return SR_ERR_MALLOC;
-                }
-                strcpy(fpga_bit, config_path);
-                switch(devc->th_level) {
-                case SR_TH_3V3:
-                    strcat(fpga_bit, devc->profile->fpga_bit33);;
-                    break;
-                case SR_TH_5V0:
-                    strcat(fpga_bit, devc->profile->fpga_bit50);;
-                    break;
-                default:
-                    return SR_ERR;
-                }
-                ret = fpga_config(usb->devhdl, fpga_bit);
-                if (ret != SR_OK) {
-                    sr_err("Configure FPGA failed!");
-                }
-                g_free(fpga_bit);
-            }
-        }
+        if (ret == SR_OK && sdi->mode == LOGIC)
+            ret = fpga_load(sdi);
         sr_dbg("%s: setting threshold to %d",
             __func__, devc->th_level);
     } else if (id == SR_CONF_VTH) {
@@ -1997,10 +1946,16 @@ static void abort_acquisition(struct DSL_context *devc)
 
 static void finish_acquisition(struct DSL_context *devc)
 {
+    struct drv_context *drvc = di->priv;
     struct sr_datafeed_packet packet;
-    int i, ret;
+    int ret;
     struct sr_usb_dev_inst *usb;
 
+    if (((struct sr_dev_inst *)devc->cb_data)->mode == LOGIC)
+        sr_info("finish acquisition: %u transfers of %u bytes, "
+                "overflow margin %.2f", devc->transfer_depth,
+                (unsigned int)devc->transfer_size, devc->overflow_margin);
+
     sr_err("finish acquisition: send SR_DF_END packet");
     /* Terminate session. */
     packet.type = SR_DF_END;
@@ -2008,9 +1963,7 @@ static void finish_acquisition(struct DSL_context *devc)
 
     sr_err("finish acquisition: remove fds from polling");
     /* Remove fds from polling. */
-    for (i = 0; devc->usbfd[i] != -1; i++)
-        sr_source_remove(devc->usbfd[i]);
-    g_free(devc->usbfd);
+    usb_source_remove(drvc->sr_ctx, devc->cb_data);
 	
     if (devc->num_transfers != 0) {
         devc->num_transfers = 0;
@@ -2054,6 +2007,7 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
     sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
+static void requeue_transfer(struct libusb_transfer *transfer, int64_t start);
 
 static void receive_transfer(struct libusb_transfer *transfer)
 {
@@ -2066,6 +2020,7 @@ static void receive_transfer(struct libusb_transfer *transfer)
     int trigger_offset, i, sample_width, cur_sample_count;
     int trigger_offset_bytes;
     uint8_t *cur_buf;
+    int64_t start;
     //GTimeVal cur_time;
 
     //g_get_current_time(&cur_time);
@@ -2073,6 +2028,7 @@ static void receive_transfer(struct libusb_transfer *transfer)
 
 
     devc = transfer->user_data;
+    start = g_get_monotonic_time();
 
     /*
      * If acquisition has already ended, just free any queued up
@@ -2106,9 +2062,13 @@ static void receive_transfer(struct libusb_transfer *transfer)
         break;
     }
 
+    sr_metric_add(SR_METRIC_USB_TRANSFERS, 1);
+    sr_metric_add(SR_METRIC_USB_BYTES, transfer->actual_length);
+
     if (transfer->actual_length == 0 ||
         packet_has_error ||
         devc->data_lock) {
+        sr_metric_add(SR_METRIC_USB_EMPTY, 1);
         devc->empty_transfer_count++;
         if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
             /*
@@ -2327,7 +2287,10 @@ static void receive_transfer(struct libusb_transfer *transfer)
          */
     }
 
-    resubmit_transfer(transfer);
+    if ((*(struct sr_dev_inst *)(devc->cb_data)).mode == LOGIC)
+        requeue_transfer(transfer, start);
+    else
+        resubmit_transfer(transfer);
 }
 
 static unsigned int to_bytes_per_ms(struct DSL_context *devc)
@@ -2351,42 +2314,180 @@ static size_t get_buffer_size(struct DSL_context *devc)
     return (s + 511) & ~511;
 }
 
-static unsigned int get_number_of_transfers(struct DSL_context *devc)
+static size_t clamp_transfer_size(struct DSL_context *devc, size_t size)
 {
-    unsigned int n;
-    /* Total buffer size should be able to hold about 100ms of data. */
-    n = 100 * to_bytes_per_ms(devc) / get_buffer_size(devc);
+    const size_t max_size = min(max_buffer_time * to_bytes_per_ms(devc),
+                                max_queued_size / 2);
+
+    if (size > max_size)
+        size = max_size;
+    if (size < get_buffer_size(devc))
+        size = get_buffer_size(devc);
+    return (size + 511) & ~511;
+}
 
-    if (n > NUM_SIMUL_TRANSFERS)
-        return NUM_SIMUL_TRANSFERS;
+/* Keep total_buffer_time ms of data queued, within the usbfs memory. */
+static unsigned int clamp_transfer_depth(struct DSL_context *devc,
+                                         unsigned int depth)
+{
+    const size_t size = devc->transfer_size;
+    const unsigned int min_depth = (total_buffer_time * (size_t)to_bytes_per_ms(devc) +
+                                    size - 1) / size;
+
+    if (depth < min_depth)
+        depth = min_depth;
+    if (depth > NUM_SIMUL_TRANSFERS)
+        depth = NUM_SIMUL_TRANSFERS;
+    if (depth > max_queued_size / size)
+        depth = max_queued_size / size;
+    return depth < 2 ? 2 : depth;
+}
 
-    return n;
+static int submit_transfer(struct DSL_context *devc, size_t size)
+{
+    struct sr_usb_dev_inst *usb;
+    struct libusb_transfer *transfer;
+    unsigned char *buf;
+    unsigned int i;
+    int ret;
+
+    usb = ((struct sr_dev_inst *)devc->cb_data)->conn;
+
+    for (i = 0; i < devc->num_transfers && devc->transfers[i]; i++);
+    if (i == devc->num_transfers)
+        return SR_ERR_BUG;
+
+    if (!(buf = g_try_malloc(size))) {
+        sr_err("USB transfer buffer malloc failed.");
+        return SR_ERR_MALLOC;
+    }
+    transfer = libusb_alloc_transfer(0);
+    libusb_fill_bulk_transfer(transfer, usb->devhdl,
+            6 | LIBUSB_ENDPOINT_IN, buf, size,
+            receive_transfer, devc, 0);
+    if ((ret = libusb_submit_transfer(transfer)) != 0) {
+        sr_err("Failed to submit transfer: %s.",
+               libusb_error_name(ret));
+        libusb_free_transfer(transfer);
+        g_free(buf);
+        return SR_ERR;
+    }
+    devc->transfers[i] = transfer;
+    devc->submitted_transfers++;
+
+    return SR_OK;
 }
 
-static unsigned int get_timeout(struct DSL_context *devc)
+/*
+ * Every adapt_window_time ms, the longest time between two resubmissions
+ * is compared with the time the queued transfers take to fill. While it
+ * uses more than half of that, the queue gets deeper, and once it holds
+ * NUM_SIMUL_TRANSFERS the transfers get larger. While handling them keeps
+ * the host busy more than half of the time, half as many transfers of
+ * twice the size spread the cost per transfer over more samples. After
+ * adapt_calm_windows windows with most of the queue unused and the host
+ * mostly idle, they shrink back one step. The queue
+ * never holds more than max_queued_size bytes, the usbfs default limit.
+ */
+static void adapt_transfers(struct DSL_context *devc, int64_t now)
 {
-    size_t total_size;
-    unsigned int timeout;
+    const double bytes_per_us = to_bytes_per_ms(devc) / 1000.0;
+    double queued, busy;
+    size_t size;
+    unsigned int depth;
+
+    /* A single stall is not a load, leave out the longest callback. */
+    queued = devc->transfer_depth * devc->transfer_size / bytes_per_us;
+    busy = (double)(devc->busy_time - devc->max_busy) /
+           (now - devc->window_start);
+    devc->overflow_margin = 1 - devc->max_gap / queued;
+
+    size = devc->transfer_size;
+    depth = devc->transfer_depth;
+    if (devc->overflow_margin <= 0.875 || busy >= 0.125)
+        devc->calm_windows = 0;
+    if (devc->overflow_margin < 0.5) {
+        if (depth < NUM_SIMUL_TRANSFERS)
+            depth *= 2;
+        else
+            size *= 2;
+    } else if (devc->overflow_margin > 0.875 && busy < 0.125 &&
+               ++devc->calm_windows >= adapt_calm_windows) {
+        devc->calm_windows = 0;
+        if (size > get_buffer_size(devc)) {
+            size /= 2;
+            depth *= 2;
+        } else {
+            depth--;
+        }
+    }
+    if (busy > 0.5 && depth >= 8) {
+        size *= 2;
+        depth /= 2;
+    }
+
+    size = clamp_transfer_size(devc, size);
+    if (size != devc->transfer_size || depth != devc->transfer_depth) {
+        devc->transfer_size = size;
+        devc->transfer_depth = clamp_transfer_depth(devc, depth);
+        sr_dbg("%s: %u transfers of %u bytes, overflow margin %.2f, "
+               "busy %.2f", __func__, devc->transfer_depth,
+               (unsigned int)devc->transfer_size, devc->overflow_margin, busy);
+    }
+
+    devc->window_start = now;
+    devc->window_transfers = 0;
+    devc->max_gap = 0;
+    devc->busy_time = 0;
+    devc->max_busy = 0;
+}
+
+/* Resubmit a logic transfer, sized and queued as adapt_transfers() says. */
+static void requeue_transfer(struct libusb_transfer *transfer, int64_t start)
+{
+    struct DSL_context *devc;
+    unsigned char *buf;
+    int64_t now;
+
+    devc = transfer->user_data;
+    now = g_get_monotonic_time();
+    devc->busy_time += now - start;
+    devc->max_busy = MAX(devc->max_busy, now - start);
+    devc->max_gap = MAX(devc->max_gap, now - devc->last_resubmit);
+    sr_metric_observe(SR_METRIC_USB_CALLBACK, now - start);
+    sr_metric_observe(SR_METRIC_USB_RESUBMIT_GAP, now - devc->last_resubmit);
+    devc->last_resubmit = now;
+    if (++devc->window_transfers >= 4 &&
+        now - devc->window_start >= adapt_window_time * 1000)
+        adapt_transfers(devc, now);
+
+    if ((unsigned int)devc->submitted_transfers > devc->transfer_depth) {
+        free_transfer(transfer);
+        return;
+    }
 
-    total_size = get_buffer_size(devc) * get_number_of_transfers(devc);
-    timeout = total_size / to_bytes_per_ms(devc);
-    //return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-    return 1000;
+    if ((size_t)transfer->length != devc->transfer_size &&
+        (buf = g_try_malloc(devc->transfer_size))) {
+        g_free(transfer->buffer);
+        transfer->buffer = buf;
+        transfer->length = devc->transfer_size;
+    }
+    resubmit_transfer(transfer);
+
+    while ((unsigned int)devc->submitted_transfers < devc->transfer_depth)
+        if (submit_transfer(devc, devc->transfer_size) != SR_OK)
+            break;
 }
 
 static int dev_transfer_start(const struct sr_dev_inst *sdi)
 {
     struct DSL_context *devc;
-    struct sr_usb_dev_inst *usb;
-    struct libusb_transfer *transfer;
-    unsigned int i, timeout, num_transfers;
+    unsigned int i, num_transfers;
     int ret;
-    unsigned char *buf;
     size_t size;
     int dso_buffer_size;
 
     devc = sdi->priv;
-    usb = sdi->conn;
 
     uint16_t channel_en_cnt = 0;
     uint16_t channel_cnt = 0;
@@ -2401,37 +2502,38 @@ static int dev_transfer_start(const struct sr_dev_inst *sdi)
     else
         dso_buffer_size = devc->limit_samples * channel_en_cnt + 512;
 
-    num_transfers = 1;
-    size = (sdi->mode == ANALOG) ? cons_buffer_size : ((sdi->mode == DSO) ? dso_buffer_size : get_buffer_size(devc));
+    if (sdi->mode == LOGIC) {
+        devc->transfer_size = clamp_transfer_size(devc, get_buffer_size(devc));
+        devc->transfer_depth = clamp_transfer_depth(devc, 0);
+        devc->window_start = devc->last_resubmit = g_get_monotonic_time();
+        devc->window_transfers = 0;
+        devc->max_gap = 0;
+        devc->busy_time = 0;
+        devc->max_busy = 0;
+        devc->calm_windows = 0;
+        devc->overflow_margin = 1;
+        num_transfers = devc->transfer_depth;
+        size = devc->transfer_size;
+    } else {
+        /* A DSO or DAQ frame comes in one transfer. */
+        num_transfers = 1;
+        size = (sdi->mode == ANALOG) ? cons_buffer_size : dso_buffer_size;
+    }
 
     devc->submitted_transfers = 0;
 
-    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
+    devc->num_transfers = (sdi->mode == LOGIC) ? NUM_SIMUL_TRANSFERS : 1;
+    devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * devc->num_transfers);
     if (!devc->transfers) {
         sr_err("USB transfers malloc failed.");
         return SR_ERR_MALLOC;
     }
 
-    devc->num_transfers = num_transfers;
     for (i = 0; i < num_transfers; i++) {
-        if (!(buf = g_try_malloc(size))) {
-            sr_err("USB transfer buffer malloc failed.");
-            return SR_ERR_MALLOC;
-        }
-        transfer = libusb_alloc_transfer(0);
-        libusb_fill_bulk_transfer(transfer, usb->devhdl,
-                6 | LIBUSB_ENDPOINT_IN, buf, size,
-                receive_transfer, devc, 0);
-        if ((ret = libusb_submit_transfer(transfer)) != 0) {
-            sr_err("Failed to submit transfer: %s.",
-                   libusb_error_name(ret));
-            libusb_free_transfer(transfer);
-            g_free(buf);
+        if ((ret = submit_transfer(devc, size)) != SR_OK) {
             abort_acquisition(devc);
-            return SR_ERR;
+            return ret;
         }
-        devc->transfers[i] = transfer;
-        devc->submitted_transfers++;
     }
 
     devc->status = DSL_DATA;
@@ -2547,8 +2649,6 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
     struct sr_usb_dev_inst *usb;
     struct libusb_transfer *transfer;
     struct ds_trigger_pos *trigger_pos;
-    const struct libusb_pollfd **lupfd;
-	unsigned int i;
     int ret;
     int transferred;
     struct sr_datafeed_packet packet;
@@ -2624,17 +2724,10 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
     test_sample_value = 0;
 
     /* setup callback function for data transfer */
-    lupfd = libusb_get_pollfds(drvc->sr_ctx->libusb_ctx);
-    for (i = 0; lupfd[i]; i++);
-    if (!(devc->usbfd = g_try_malloc(sizeof(struct libusb_pollfd) * (i + 1))))
-    return SR_ERR;
-    for (i = 0; lupfd[i]; i++) {
-        sr_source_add(lupfd[i]->fd, lupfd[i]->events,
-    		      get_timeout(devc), receive_data, sdi);
-    	devc->usbfd[i] = lupfd[i]->fd;
+    if ((ret = usb_source_add(drvc->sr_ctx, 0, receive_data, sdi)) != SR_OK) {
+        abort_acquisition(devc);
+        return ret;
     }
-    devc->usbfd[i] = -1;
-    free(lupfd);
 	
     /* poll trigger status transfer*/
     if (!(trigger_pos = g_try_malloc0(sizeof(struct ds_trigger_pos)))) {
@@ -62,13 +62,24 @@
 #define DEMO_MAX_DSO_SAMPLERATE SR_MHZ(200)
 #define DEMO_MAX_DSO_PROBES_NUM 2
 
-/* Supported patterns which we can generate */
+/* Independent generators of the PRBS pattern, see prbs_generator(). */
+#define PRBS_LANES              4
+
+/*
+ * Supported patterns which we can generate. The ones from PATTERN_PRBS
+ * on are logic patterns, the others are drawn from the waveform tables.
+ */
 enum {
     PATTERN_SINE = 0,
     PATTERN_SQUARE = 1,
     PATTERN_TRIANGLE = 2,
     PATTERN_SAWTOOTH = 3,
     PATTERN_RANDOM = 4,
+    PATTERN_PRBS = 5,
+    PATTERN_SPI = 6,
+    PATTERN_UART = 7,
+    PATTERN_I2C = 8,
+    PATTERN_BURST = 9,
 };
 static const char *pattern_strings[] = {
     "Sine",
@@ -76,6 +87,11 @@ static const char *pattern_strings[] = {
     "Triangle",
     "Sawtooth",
     "Random",
+    "PRBS",
+    "SPI",
+    "UART",
+    "I2C",
+    "Bursts",
 };
 
 static const char *maxHeights[] = {
@@ -101,6 +117,11 @@ struct dev_context {
 	uint64_t limit_samples;
 	uint64_t limit_msec;
 	uint8_t sample_generator;
+    uint64_t pattern_bitrate;
+    uint64_t pattern_seed;
+    uint64_t pattern_pos;
+    uint64_t prbs[PRBS_LANES];
+    gboolean benchmark;
 	uint64_t samples_counter;
 	void *cb_data;
 	int64_t starttime;
@@ -118,6 +139,7 @@ struct dev_context {
     uint16_t trigger_mask;
     uint16_t trigger_value;
     uint16_t trigger_edge;
+    uint16_t last_sample;
 };
 
 static const int hwcaps[] = {
@@ -130,8 +152,15 @@ static const int hwcaps[] = {
 	SR_CONF_CONTINUOUS,
 };
 
+static const int32_t scanopts[] = {
+    SR_CONF_DEVICE_COUNT,
+};
+
 static const int hwoptions[] = {
     SR_CONF_PATTERN_MODE,
+    SR_CONF_PATTERN_BITRATE,
+    SR_CONF_PATTERN_SEED,
+    SR_CONF_BENCHMARK,
     SR_CONF_MAX_HEIGHT,
 };
 
@@ -306,63 +335,81 @@ static GSList *hw_scan(GSList *options)
 	struct sr_channel *probe;
 	struct drv_context *drvc;
 	struct dev_context *devc;
-	GSList *devices;
+	struct sr_config *src;
+	GSList *devices, *l;
+	uint64_t count, n;
+	char version[16];
     uint16_t i;
 
-	(void)options;
-
 	drvc = di->priv;
 
+	count = 1;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		switch (src->key) {
+		case SR_CONF_DEVICE_COUNT:
+			count = MAX(g_variant_get_uint64(src->data), 1);
+			break;
+		}
+	}
+
 	devices = NULL;
 
-    sdi = sr_dev_inst_new(LOGIC, 0, SR_ST_ACTIVE, DEMONAME, NULL, NULL);
-	if (!sdi) {
-        sr_err("Device instance creation failed.");
-		return NULL;
-	}
-	sdi->driver = di;
+	for (n = 0; n < count; n++) {
+		/* Tell the devices apart when there are several. */
+		snprintf(version, sizeof(version), "#%" PRIu64, n + 1);
+		sdi = sr_dev_inst_new(LOGIC, n, SR_ST_ACTIVE, DEMONAME, NULL,
+				      count > 1 ? version : NULL);
+		if (!sdi) {
+			sr_err("Device instance creation failed.");
+			return devices;
+		}
+		sdi->driver = di;
 
-	devices = g_slist_append(devices, sdi);
-	drvc->instances = g_slist_append(drvc->instances, sdi);
+		devices = g_slist_append(devices, sdi);
+		drvc->instances = g_slist_append(drvc->instances, sdi);
 
-	if (!(devc = g_try_malloc(sizeof(struct dev_context)))) {
-		sr_err("Device context malloc failed.");
-		return NULL;
-	}
+		if (!(devc = g_try_malloc0(sizeof(struct dev_context)))) {
+			sr_err("Device context malloc failed.");
+			return devices;
+		}
 
-	devc->sdi = sdi;
-    devc->cur_samplerate = SR_MHZ(1);
-    devc->limit_samples = SR_MB(1);
-	devc->limit_msec = 0;
-    devc->sample_generator = PATTERN_SINE;
-    devc->timebase = 200;
-    devc->data_lock = FALSE;
-    devc->max_height = 1;
-
-	sdi->priv = devc;
-
-    if (sdi->mode == LOGIC) {
-        for (i = 0; probe_names[i]; i++) {
-            if (!(probe = sr_channel_new(i, SR_CHANNEL_LOGIC, TRUE,
-                    probe_names[i])))
-                return NULL;
-            sdi->channels = g_slist_append(sdi->channels, probe);
-        }
-    } else if (sdi->mode == DSO) {
-        for (i = 0; i < DS_MAX_DSO_PROBES_NUM; i++) {
-            if (!(probe = sr_channel_new(i, SR_CHANNEL_DSO, TRUE,
-                    probe_names[i])))
-                return NULL;
-            sdi->channels = g_slist_append(sdi->channels, probe);
-        }
-    } else if (sdi->mode == ANALOG) {
-        for (i = 0; i < DS_MAX_ANALOG_PROBES_NUM; i++) {
-            if (!(probe = sr_channel_new(i, SR_CHANNEL_ANALOG, TRUE,
-                    probe_names[i])))
-                return NULL;
-            sdi->channels = g_slist_append(sdi->channels, probe);
-        }
-    }
+		devc->sdi = sdi;
+		devc->cur_samplerate = SR_MHZ(1);
+		devc->limit_samples = SR_MB(1);
+		devc->limit_msec = 0;
+		devc->sample_generator = PATTERN_SINE;
+		devc->pattern_bitrate = SR_MHZ(1);
+		devc->pattern_seed = 1;
+		devc->timebase = 200;
+		devc->data_lock = FALSE;
+		devc->max_height = 1;
+
+		sdi->priv = devc;
+
+		if (sdi->mode == LOGIC) {
+			for (i = 0; probe_names[i]; i++) {
+				if (!(probe = sr_channel_new(i, SR_CHANNEL_LOGIC, TRUE,
+						probe_names[i])))
+					return devices;
+				sdi->channels = g_slist_append(sdi->channels, probe);
+			}
+		} else if (sdi->mode == DSO) {
+			for (i = 0; i < DS_MAX_DSO_PROBES_NUM; i++) {
+				if (!(probe = sr_channel_new(i, SR_CHANNEL_DSO, TRUE,
+						probe_names[i])))
+					return devices;
+				sdi->channels = g_slist_append(sdi->channels, probe);
+			}
+		} else if (sdi->mode == ANALOG) {
+			for (i = 0; i < DS_MAX_ANALOG_PROBES_NUM; i++) {
+				if (!(probe = sr_channel_new(i, SR_CHANNEL_ANALOG, TRUE,
+						probe_names[i])))
+					return devices;
+				sdi->channels = g_slist_append(sdi->channels, probe);
+			}
+		}
+	}
 
 	return devices;
 }
@@ -459,6 +506,15 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
     case SR_CONF_PATTERN_MODE:
         *data = g_variant_new_string(pattern_strings[devc->sample_generator]);
 		break;
+    case SR_CONF_PATTERN_BITRATE:
+        *data = g_variant_new_uint64(devc->pattern_bitrate);
+        break;
+    case SR_CONF_PATTERN_SEED:
+        *data = g_variant_new_uint64(devc->pattern_seed);
+        break;
+    case SR_CONF_BENCHMARK:
+        *data = g_variant_new_boolean(devc->benchmark);
+        break;
     case SR_CONF_MAX_HEIGHT:
         *data = g_variant_new_string(maxHeights[devc->max_height]);
         break;
@@ -590,22 +646,36 @@ static int config_set(int id, GVariant *data, struct sr_dev_inst *sdi,
         sr_dbg("%s: setting mode to %d", __func__, sdi->mode);
     }else if (id == SR_CONF_PATTERN_MODE) {
         stropt = g_variant_get_string(data, NULL);
-        ret = SR_OK;
-        if (!strcmp(stropt, pattern_strings[PATTERN_SINE])) {
-            devc->sample_generator = PATTERN_SINE;
-        } else if (!strcmp(stropt, pattern_strings[PATTERN_SQUARE])) {
-            devc->sample_generator = PATTERN_SQUARE;
-        } else if (!strcmp(stropt, pattern_strings[PATTERN_TRIANGLE])) {
-            devc->sample_generator = PATTERN_TRIANGLE;
-        } else if (!strcmp(stropt, pattern_strings[PATTERN_SAWTOOTH])) {
-            devc->sample_generator = PATTERN_SAWTOOTH;
-        } else if (!strcmp(stropt, pattern_strings[PATTERN_RANDOM])) {
-            devc->sample_generator = PATTERN_RANDOM;
-		} else {
-            ret = SR_ERR;
-		}
+        ret = SR_ERR;
+        for (i = 0; i < ARRAY_SIZE(pattern_strings); i++) {
+            if (!strcmp(stropt, pattern_strings[i])) {
+                devc->sample_generator = i;
+                ret = SR_OK;
+                break;
+            }
+        }
         sr_dbg("%s: setting pattern to %d",
 			__func__, devc->sample_generator);
+    } else if (id == SR_CONF_PATTERN_BITRATE) {
+        tmp_u64 = g_variant_get_uint64(data);
+        if (tmp_u64 == 0) {
+            ret = SR_ERR_ARG;
+        } else {
+            devc->pattern_bitrate = tmp_u64;
+            sr_dbg("%s: setting pattern bit rate to %" PRIu64, __func__,
+                   devc->pattern_bitrate);
+            ret = SR_OK;
+        }
+    } else if (id == SR_CONF_PATTERN_SEED) {
+        devc->pattern_seed = g_variant_get_uint64(data);
+        sr_dbg("%s: setting pattern seed to %" PRIu64, __func__,
+               devc->pattern_seed);
+        ret = SR_OK;
+    } else if (id == SR_CONF_BENCHMARK) {
+        devc->benchmark = g_variant_get_boolean(data);
+        sr_dbg("%s: setting benchmark mode to %d", __func__,
+               devc->benchmark);
+        ret = SR_OK;
     } else if (id == SR_CONF_MAX_HEIGHT) {
         stropt = g_variant_get_string(data, NULL);
         ret = SR_OK;
@@ -680,6 +750,10 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
     (void)cg;
 
 	switch (key) {
+    case SR_CONF_SCAN_OPTIONS:
+        *data = g_variant_new_from_data(G_VARIANT_TYPE("ai"),
+                scanopts, ARRAY_SIZE(scanopts)*sizeof(int32_t), TRUE, NULL, NULL);
+        break;
     case SR_CONF_DEVICE_OPTIONS:
 //		*data = g_variant_new_fixed_array(G_VARIANT_TYPE_INT32,
 //				hwcaps, ARRAY_SIZE(hwcaps), sizeof(int32_t));
@@ -725,6 +799,209 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
     return SR_OK;
 }
 
+/*
+ * The logic patterns. They don't depend on the wall clock or on rand(),
+ * the same seed and settings always give the same samples.
+ */
+
+/* A well-mixed 64 bit value for each input, for the data of a frame. */
+static uint64_t splitmix64(uint64_t x)
+{
+    x += UINT64_C(0x9E3779B97F4A7C15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+/*
+ * A bus pattern is a sequence of frames of bit slots, which are split in
+ * phases for the clock edges. The sample of a phase only depends on the
+ * random data of its frame, so a phase is filled with one value at once.
+ */
+struct bus_pattern {
+    unsigned int slots;
+    unsigned int phases;
+    uint16_t (*sample)(uint64_t data, unsigned int slot, unsigned int phase);
+};
+
+/* A new random sample for every bit. */
+static uint16_t prbs_sample(uint64_t data, unsigned int slot,
+                            unsigned int phase)
+{
+    (void)slot;
+    (void)phase;
+
+    return data;
+}
+
+/* SCLK, MOSI, MISO and CS# on probes 0 to 3, 4 bytes a frame. */
+static uint16_t spi_sample(uint64_t data, unsigned int slot,
+                           unsigned int phase)
+{
+    unsigned int bit;
+
+    if (slot == 0 || slot > 32)
+        return 1 << 3;
+
+    /* MSB first, sampled on the rising edge. */
+    bit = 32 - slot;
+    return phase | (((data >> bit) & 1) << 1) |
+           (((data >> (32 + bit)) & 1) << 2);
+}
+
+static uint16_t uart_bit(uint64_t data, unsigned int slot)
+{
+    const unsigned int byte = slot / 10;
+    const unsigned int bit = slot % 10;
+
+    /* Idle and the stop bit are high, the start bit is low. */
+    if (byte >= 4 || bit == 9)
+        return 1;
+    if (bit == 0)
+        return 0;
+    return (data >> (byte * 8 + bit - 1)) & 1;
+}
+
+/* TX and RX on probes 0 and 1, 4 bytes of 8N1 each a frame. */
+static uint16_t uart_sample(uint64_t data, unsigned int slot,
+                            unsigned int phase)
+{
+    (void)phase;
+
+    return uart_bit(data, slot) | (uart_bit(data >> 32, slot) << 1);
+}
+
+/*
+ * SCL and SDA on probes 0 and 1, a frame writes 2 bytes to an address.
+ * SDA changes while SCL is low, in the first and the last phase.
+ */
+static uint16_t i2c_sample(uint64_t data, unsigned int slot,
+                           unsigned int phase)
+{
+    static const uint16_t start[4] = {3, 3, 1, 0};
+    static const uint16_t stop[4] = {0, 1, 3, 3};
+    unsigned int byte, bit, sda;
+
+    if (slot == 0)
+        return start[phase];
+    if (slot == 28)
+        return stop[phase];
+    if (slot > 28)
+        return 3;
+
+    /* The address and R/W#, then the data, each acknowledged. */
+    byte = (slot - 1) / 9;
+    bit = (slot - 1) % 9;
+    if (bit == 8)
+        sda = 0;
+    else if (byte == 0)
+        sda = ((data & 0xfe) >> (7 - bit)) & 1;
+    else
+        sda = ((data >> (8 * byte)) >> (7 - bit)) & 1;
+
+    return (phase == 1 || phase == 2) | (sda << 1);
+}
+
+/* Idle but for a burst of 4 random samples every 256 bits. */
+static uint16_t burst_sample(uint64_t data, unsigned int slot,
+                             unsigned int phase)
+{
+    (void)phase;
+
+    return slot < 4 ? (uint16_t)(data >> (16 * slot)) : 0;
+}
+
+static const struct bus_pattern bus_patterns[] = {
+    [PATTERN_PRBS - PATTERN_PRBS] = {1, 1, prbs_sample},
+    [PATTERN_SPI - PATTERN_PRBS] = {34, 2, spi_sample},
+    [PATTERN_UART - PATTERN_PRBS] = {42, 1, uart_sample},
+    [PATTERN_I2C - PATTERN_PRBS] = {30, 4, i2c_sample},
+    [PATTERN_BURST - PATTERN_PRBS] = {256, 1, burst_sample},
+};
+
+static void bus_generator(uint16_t *buf, uint64_t size,
+                          struct dev_context *devc,
+                          const struct bus_pattern *bus)
+{
+    const uint64_t bit_len = MAX(devc->cur_samplerate /
+                                 devc->pattern_bitrate, bus->phases);
+    uint64_t pos, slot, frame, offset, end, run, i;
+    unsigned int phase;
+    uint16_t value;
+
+    pos = devc->pattern_pos;
+    while (size > 0) {
+        slot = pos / bit_len;
+        offset = pos % bit_len;
+        frame = slot / bus->slots;
+        slot %= bus->slots;
+        for (phase = 0; phase + 1 < bus->phases &&
+             offset >= (phase + 1) * bit_len / bus->phases; phase++);
+        end = (phase + 1) * bit_len / bus->phases;
+
+        run = MIN(end - offset, size);
+        value = bus->sample(splitmix64(devc->pattern_seed ^
+                                       splitmix64(frame)), slot, phase);
+        for (i = 0; i < run; i++)
+            buf[i] = value;
+
+        buf += run;
+        pos += run;
+        size -= run;
+    }
+    devc->pattern_pos = pos;
+}
+
+/*
+ * Random samples at the samplerate. The xorshift generators of the lanes
+ * don't depend on each other, which lets the compiler vectorize the loop.
+ */
+static void prbs_generator(uint16_t *buf, uint64_t size,
+                           struct dev_context *devc)
+{
+    uint64_t x[PRBS_LANES];
+    uint64_t i;
+    unsigned int j;
+
+    memcpy(x, devc->prbs, sizeof(x));
+    for (i = 0; i + 4 * PRBS_LANES <= size; i += 4 * PRBS_LANES) {
+        for (j = 0; j < PRBS_LANES; j++) {
+            x[j] ^= x[j] << 13;
+            x[j] ^= x[j] >> 7;
+            x[j] ^= x[j] << 17;
+        }
+        memcpy(buf + i, x, sizeof(x));
+    }
+    for (; i < size; i++) {
+        x[0] ^= x[0] << 13;
+        x[0] ^= x[0] >> 7;
+        x[0] ^= x[0] << 17;
+        buf[i] = x[0];
+    }
+    memcpy(devc->prbs, x, sizeof(x));
+}
+
+static void pattern_generator(uint16_t *buf, uint64_t size,
+                              struct dev_context *devc)
+{
+    if (devc->sample_generator == PATTERN_PRBS &&
+        devc->pattern_bitrate >= devc->cur_samplerate)
+        prbs_generator(buf, size, devc);
+    else
+        bus_generator(buf, size, devc,
+                      &bus_patterns[devc->sample_generator - PATTERN_PRBS]);
+}
+
+static void pattern_reset(struct dev_context *devc)
+{
+    unsigned int j;
+
+    devc->pattern_pos = 0;
+    /* Xorshift never leaves zero. */
+    for (j = 0; j < PRBS_LANES; j++)
+        devc->prbs[j] = splitmix64(devc->pattern_seed + j) | 1;
+}
+
 static void samples_generator(uint16_t *buf, uint64_t size,
                               const struct sr_dev_inst *sdi,
                               struct dev_context *devc)
@@ -736,8 +1013,14 @@ static void samples_generator(uint16_t *buf, uint64_t size,
     int start_rand;
     const uint64_t span = DEMO_MAX_DSO_SAMPLERATE / devc->cur_samplerate;
     const uint64_t len = ARRAY_SIZE(sinx) - 1;
+    const uint64_t num_probes = g_slist_length(sdi->channels);
     int *pre_buf;
 
+    if (sdi->mode == LOGIC && devc->sample_generator >= PATTERN_PRBS) {
+        pattern_generator(buf, size, devc);
+        return;
+    }
+
     switch (devc->sample_generator) {
     case PATTERN_SINE: /* Sine */
         pre_buf = sinx;
@@ -766,7 +1049,7 @@ static void samples_generator(uint16_t *buf, uint64_t size,
     } else if (sdi->mode != DSO) {
         start_rand = rand()%len;
         for (i = 0; i < size; i++) {
-            index = (i/g_slist_length(sdi->channels)+start_rand)%len;
+            index = (i/num_probes+start_rand)%len;
             *(buf + i) = (uint16_t)(((const_dc+pre_buf[index]) << 8) + (const_dc+pre_buf[index]));
         }
     } else {
@@ -841,22 +1124,27 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
     struct sr_datafeed_analog analog;
 	static uint64_t samples_to_send, expected_samplenum, sending_now;
 	int64_t time, elapsed;
-    static uint16_t last_sample = 0;
+    const uint64_t num_probes = g_slist_length(sdi->channels);
     uint16_t cur_sample;
     int i;
 
 	(void)fd;
 	(void)revents;
 
-	/* How many "virtual" samples should we have collected by now? */
-	time = g_get_monotonic_time();
-	elapsed = time - devc->starttime;
-    devc->starttime = time;
-    //expected_samplenum = ceil(elapsed / 1000000.0 * devc->cur_samplerate);
-	/* Of those, how many do we still have to send? */
-    //samples_to_send = (expected_samplenum - devc->samples_counter) / CONST_LEN * CONST_LEN;
-    //samples_to_send = expected_samplenum / CONST_LEN * CONST_LEN;
-    samples_to_send = ceil(elapsed / 1000000.0 * devc->cur_samplerate);
+    if (devc->benchmark) {
+        /* A buffer each time the session loop comes round. */
+        samples_to_send = BUFSIZE;
+    } else {
+        /* How many "virtual" samples should we have collected by now? */
+        time = g_get_monotonic_time();
+        elapsed = time - devc->starttime;
+        devc->starttime = time;
+        //expected_samplenum = ceil(elapsed / 1000000.0 * devc->cur_samplerate);
+        /* Of those, how many do we still have to send? */
+        //samples_to_send = (expected_samplenum - devc->samples_counter) / CONST_LEN * CONST_LEN;
+        //samples_to_send = expected_samplenum / CONST_LEN * CONST_LEN;
+        samples_to_send = ceil(elapsed / 1000000.0 * devc->cur_samplerate);
+    }
 
     if (devc->limit_samples) {
         if ((sdi->mode == DSO && !devc->instant) || sdi->mode == ANALOG)
@@ -881,7 +1169,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
                     }
                 } else {
                     cur_sample = *(devc->buf + i);
-                    if (((last_sample & devc->trigger_edge) ==
+                    if (((devc->last_sample & devc->trigger_edge) ==
                          (~devc->trigger_value & devc->trigger_edge)) &&
                         ((cur_sample | devc->trigger_mask) ==
                          (devc->trigger_value | devc->trigger_mask)) &&
@@ -890,7 +1178,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
                         devc->trigger_stage = 0;
                         break;
                     }
-                    last_sample = cur_sample;
+                    devc->last_sample = cur_sample;
                 }
             }
             if (devc->trigger_stage == 0) {
@@ -903,7 +1191,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
         }
 
         if (sdi->mode == ANALOG)
-            devc->samples_counter += sending_now/g_slist_length(sdi->channels);
+            devc->samples_counter += sending_now/num_probes;
         else
             devc->samples_counter += sending_now;
         if (sdi->mode == DSO && !devc->instant &&
@@ -934,7 +1222,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *sdi)
                 packet.type = SR_DF_ANALOG;
                 packet.payload = &analog;
                 analog.probes = sdi->channels;
-                analog.num_samples = sending_now / g_slist_length(sdi->channels);
+                analog.num_samples = sending_now / num_probes;
                 analog.mq = SR_MQ_VOLTAGE;
                 analog.unit = SR_UNIT_VOLT;
                 analog.mqflags = SR_MQFLAG_AC;
@@ -988,6 +1276,8 @@ static int hw_dev_acquisition_start(const struct sr_dev_inst *sdi,
     devc->mstatus.captured_cnt2 = 0;
     devc->mstatus.captured_cnt3 = 0;
     devc->stop = FALSE;
+    devc->last_sample = 0;
+    pattern_reset(devc);
 
     /*
      * trigger setting
@@ -1027,6 +1317,15 @@ static int hw_dev_acquisition_start(const struct sr_dev_inst *sdi,
 	/* Make channels to unbuffered. */
 	g_io_channel_set_buffered(devc->channel, FALSE);
 
+    /*
+     * A benchmark isn't paced by the timeout, the byte in the pipe keeps
+     * the channel readable and the session loop calling receive_data().
+     */
+    if (devc->benchmark && write(devc->pipe_fds[1], "", 1) != 1) {
+        sr_err("%s: write() failed", __func__);
+        return SR_ERR;
+    }
+
     sr_session_source_add_channel(devc->channel, G_IO_IN | G_IO_ERR,
             100, receive_data, sdi);
 
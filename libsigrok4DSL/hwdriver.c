@@ -55,6 +55,8 @@ static struct sr_config_info sr_config_info_data[] = {
         "Connection", "Connection", NULL},
 	{SR_CONF_SERIALCOMM, SR_T_CHAR, "serialcomm",
         "Serial communication", "Serial communication", NULL},
+    {SR_CONF_DEVICE_COUNT, SR_T_UINT64, "device_count",
+        "Device count", "Device count", NULL},
 	{SR_CONF_SAMPLERATE, SR_T_UINT64, "samplerate",
         "Sample rate", "Sample rate", NULL},
     {SR_CONF_LIMIT_SAMPLES, SR_T_UINT64, "samplecount",
@@ -69,6 +71,12 @@ static struct sr_config_info sr_config_info_data[] = {
         "Pre-trigger capture ratio", "Pre-trigger capture ratio", NULL},
     {SR_CONF_PATTERN_MODE, SR_T_CHAR, "pattern",
         "Pattern mode", "Pattern mode", NULL},
+    {SR_CONF_PATTERN_BITRATE, SR_T_UINT64, "bitrate",
+        "Bit rate", "Bit rate", NULL},
+    {SR_CONF_PATTERN_SEED, SR_T_UINT64, "seed",
+        "Seed", "Seed", NULL},
+    {SR_CONF_BENCHMARK, SR_T_BOOL, "benchmark",
+        "Benchmark", "Benchmark", NULL},
     {SR_CONF_TRIGGER_TYPE, SR_T_CHAR, "triggertype",
         "Trigger types", "Trigger types", NULL},
 	{SR_CONF_RLE, SR_T_BOOL, "rle",
@@ -107,6 +115,12 @@ static struct sr_config_info sr_config_info_data[] = {
         "Threshold Level", "Threshold Level", NULL},
     {SR_CONF_VTH, SR_T_FLOAT, "threshold",
         "Threshold Level", "Threshold Level", NULL},
+    {SR_CONF_USB_TRANSFER_SIZE, SR_T_UINT64, "transfersize",
+        "USB transfer size", "USB transfer size", NULL},
+    {SR_CONF_USB_TRANSFERS, SR_T_UINT64, "transfers",
+        "USB transfers in flight", "USB transfers in flight", NULL},
+    {SR_CONF_USB_OVERFLOW_MARGIN, SR_T_FLOAT, "overflowmargin",
+        "USB overflow margin", "USB overflow margin", NULL},
     {0, 0, NULL, NULL, NULL, NULL},
 };
 
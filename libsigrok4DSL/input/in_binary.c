@@ -103,7 +103,10 @@ static int loadfile(struct sr_input *in, const char *filename)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_map logic_map;
 	struct sr_config *src;
+	struct sr_file_map *map;
+	struct stat st;
 	unsigned char buffer[CHUNKSIZE];
 	int fd, size, num_probes;
 	struct context *ctx;
@@ -128,14 +131,29 @@ static int loadfile(struct sr_input *in, const char *filename)
 		sr_config_free(src);
 	}
 
-	/* Chop up the input file into chunks & send it to the session bus. */
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = (num_probes + 7) / 8;
-	logic.data = buffer;
-	while ((size = read(fd, buffer, CHUNKSIZE)) > 0) {
-		logic.length = size;
+	/* Hand the whole file to the session bus as a mapping, so the
+	 * samples are used in place. */
+	logic_map.unitsize = (num_probes + 7) / 8;
+	map = NULL;
+	if (fstat(fd, &st) == 0 && st.st_size >= logic_map.unitsize &&
+	    sr_file_map_new(filename, 0, st.st_size - st.st_size %
+			    logic_map.unitsize, &map) == SR_OK) {
+		packet.type = SR_DF_LOGIC_MAP;
+		packet.payload = &logic_map;
+		logic_map.map = map;
 		sr_session_send(in->sdi, &packet);
+		sr_file_map_unref(map);
+	} else {
+		/* Chop up the input file into chunks & send it to the session bus. */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = (num_probes + 7) / 8;
+		logic.data_error = 0;
+		logic.data = buffer;
+		while ((size = read(fd, buffer, CHUNKSIZE)) > 0) {
+			logic.length = size;
+			sr_session_send(in->sdi, &packet);
+		}
 	}
 	close(fd);
 
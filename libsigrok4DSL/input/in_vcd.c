@@ -75,85 +75,195 @@
 
 #define DEFAULT_NUM_PROBES 8
 
-/* Read until specific type of character occurs in file.
- * Skip input if dest is NULL.
- * Modes:
- * 'W' read until whitespace
- * 'N' read until non-whitespace, and ungetc() the character
- * '$' read until $end
+/* The sample values are kept in an uint64_t while parsing. */
+#define MAX_NUM_PROBES 64
+
+/* Size of the blocks read from the file. */
+#define READ_BLOCK_SIZE (1024 * 1024)
+
+/* Size of the SR_DF_LOGIC packets sent to the session bus. */
+#define SAMPLE_BUFSIZE (1024 * 1024)
+
+/* Block-buffered reader, tokens are handed out as pointers into
+ * the buffer, so the hot path neither copies nor calls into stdio.
  */
-static gboolean read_until(FILE *file, GString *dest, char mode)
+struct reader
 {
-	char prev[4] = "";
-	long startpos = ftell(file);
-	for(;;)
-	{
-		int c = fgetc(file);
+	FILE *file;
+	char *buf;
+	size_t size;
+	size_t pos;
+	gboolean eof;
+	uint64_t offset;
+};
 
-		if (c == EOF)
-		{
-			if (mode == '$')
-				sr_err("Unexpected EOF, read started at %ld.", startpos);
-			return FALSE;
-		}
-		
-		if (mode == 'W' && g_ascii_isspace(c))
-			return TRUE;
-		
-		if (mode == 'N' && !g_ascii_isspace(c))
-		{
-			ungetc(c, file);
+static gboolean reader_open(struct reader *r, const char *filename)
+{
+	memset(r, 0, sizeof(*r));
+
+	if ((r->file = g_fopen(filename, "rb")) == NULL)
+		return FALSE;
+
+	if (!(r->buf = g_try_malloc(READ_BLOCK_SIZE))) {
+		sr_err("Read buffer malloc failed.");
+		fclose(r->file);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void reader_close(struct reader *r)
+{
+	g_free(r->buf);
+	fclose(r->file);
+}
+
+/* Move the unread bytes to the start of the buffer and read more.
+ * Returns FALSE if no more bytes could be read.
+ */
+static gboolean reader_fill(struct reader *r)
+{
+	size_t n;
+
+	if (r->eof)
+		return FALSE;
+
+	if (r->pos > 0) {
+		memmove(r->buf, r->buf + r->pos, r->size - r->pos);
+		r->offset += r->pos;
+		r->size -= r->pos;
+		r->pos = 0;
+	}
+
+	if (r->size == READ_BLOCK_SIZE)
+		return FALSE;
+
+	n = fread(r->buf + r->size, 1, READ_BLOCK_SIZE - r->size, r->file);
+	if (n == 0)
+		r->eof = TRUE;
+	r->size += n;
+
+	return n > 0;
+}
+
+/* Skip white-space, returns FALSE at end of file. */
+static gboolean skip_space(struct reader *r)
+{
+	for (;;) {
+		while (r->pos < r->size && g_ascii_isspace(r->buf[r->pos]))
+			r->pos++;
+		if (r->pos < r->size)
 			return TRUE;
+		if (!reader_fill(r))
+			return FALSE;
+	}
+}
+
+/* Read one white-space delimited token. The token stays valid until
+ * the next call on the reader.
+ */
+static gboolean read_token(struct reader *r, const char **token, size_t *len)
+{
+	size_t end;
+
+	if (!skip_space(r))
+		return FALSE;
+
+	end = r->pos;
+	for (;;) {
+		while (end < r->size && !g_ascii_isspace(r->buf[end]))
+			end++;
+		/* A token longer than the buffer is cut at the buffer end. */
+		if (end < r->size || r->eof)
+			break;
+		end -= r->pos;
+		if (!reader_fill(r)) {
+			end += r->pos;
+			break;
 		}
-		
-		if (mode == '$')
-		{
-			prev[0] = prev[1]; prev[1] = prev[2]; prev[2] = prev[3]; prev[3] = c;
-			if (prev[0] == '$' && prev[1] == 'e' && prev[2] == 'n' && prev[3] == 'd')
-			{
-				if (dest != NULL)
-					g_string_truncate(dest, dest->len - 3);
-					
+		end += r->pos;
+	}
+
+	*token = r->buf + r->pos;
+	*len = end - r->pos;
+	r->pos = end;
+
+	return TRUE;
+}
+
+/* Read until $end, which is consumed. The text before it is appended
+ * to dest unless dest is NULL.
+ */
+static gboolean read_until_end(struct reader *r, GString *dest)
+{
+	const char *p;
+	size_t n;
+	uint64_t startpos = r->offset + r->pos;
+
+	for (;;) {
+		p = memchr(r->buf + r->pos, '$', r->size - r->pos);
+		n = (p ? (size_t)(p - r->buf) : r->size) - r->pos;
+		if (dest != NULL)
+			g_string_append_len(dest, r->buf + r->pos, n);
+		r->pos += n;
+
+		if (p) {
+			/* Need the whole tag to decide */
+			if (r->size - r->pos < 4 && reader_fill(r))
+				continue;
+			if (r->size - r->pos >= 4 &&
+			    memcmp(r->buf + r->pos, "$end", 4) == 0) {
+				r->pos += 4;
 				return TRUE;
 			}
+			if (r->pos < r->size) {
+				if (dest != NULL)
+					g_string_append_c(dest, '$');
+				r->pos++;
+				continue;
+			}
 		}
 
-		if (dest != NULL)
-			g_string_append_c(dest, c);
+		if (!reader_fill(r)) {
+			sr_err("Unexpected EOF, read started at %" PRIu64 ".", startpos);
+			return FALSE;
+		}
 	}
 }
 
 /* Reads a single VCD section from input file and parses it to structure.
  * e.g. $timescale 1ps $end  => "timescale" "1ps"
  */
-static gboolean parse_section(FILE *file, gchar **name, gchar **contents)
+static gboolean parse_section(struct reader *r, gchar **name, gchar **contents)
 {
 	gboolean status;
 	GString *sname, *scontents;
-	
-	/* Skip any initial white-space */
-	if (!read_until(file, NULL, 'N')) return FALSE;
-	
+	const char *token;
+	size_t len;
+
+	/* Read the section tag */
+	if (!read_token(r, &token, &len))
+		return FALSE;
+
 	/* Section tag should start with $. */
-	if (fgetc(file) != '$')
+	if (token[0] != '$')
 	{
 		sr_err("Expected $ at beginning of section.");
 		return FALSE;
 	}
-	
-	/* Read the section tag */	
-	sname = g_string_sized_new(32);
-	status = read_until(file, sname, 'W');
-	
+
+	sname = g_string_new_len(token + 1, len - 1);
+
 	/* Skip whitespace before content */
-	status = status && read_until(file, NULL, 'N');
-	
+	status = skip_space(r);
+
 	/* Read the content */
 	scontents = g_string_sized_new(128);
-	status = status && read_until(file, scontents, '$');
+	status = status && read_until_end(r, scontents);
 	g_strchomp(scontents->str);
 
-	/* Release strings if status is FALSE, return them if status is TRUE */	
+	/* Release strings if status is FALSE, return them if status is TRUE */
 	*name = g_string_free(sname, !status);
 	*contents = g_string_free(scontents, !status);
 	return status;
@@ -174,6 +284,13 @@ struct context
 	unsigned compress;
 	int64_t skip;
 	GSList *probes;
+	/* Maps an identifier to its probe index + 1 */
+	GHashTable *identifiers;
+	GString *key;
+	/* Samples not sent yet */
+	unsigned int unitsize;
+	uint8_t *buffer;
+	uint64_t buffered;
 };
 
 static void free_probe(void *data)
@@ -186,6 +303,11 @@ static void free_probe(void *data)
 
 static void release_context(struct context *ctx)
 {
+	if (ctx->identifiers)
+		g_hash_table_destroy(ctx->identifiers);
+	if (ctx->key)
+		g_string_free(ctx->key, TRUE);
+	g_free(ctx->buffer);
 	g_slist_free_full(ctx->probes, free_probe);
 	g_free(ctx);
 }
@@ -211,14 +333,14 @@ static void remove_empty_parts(gchar **parts)
 /* Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
  */
-static gboolean parse_header(FILE *file, struct context *ctx)
+static gboolean parse_header(struct reader *r, struct context *ctx)
 {
 	uint64_t p, q;
 	gchar *name = NULL, *contents = NULL;
 	gboolean status = FALSE;
 	struct probe *probe;
 
-	while (parse_section(file, &name, &contents))
+	while (parse_section(r, &name, &contents))
 	{
 		sr_dbg("Section '%s', contents '%s'.", name, contents);
 	
@@ -278,6 +400,11 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 				probe->name = g_strdup(parts[3]);
 				ctx->probes = g_slist_append(ctx->probes, probe);
 				ctx->probecount++;
+
+				/* The first probe of an identifier receives its values */
+				if (!g_hash_table_lookup(ctx->identifiers, probe->identifier))
+					g_hash_table_insert(ctx->identifiers, probe->identifier,
+						GINT_TO_POINTER(ctx->probecount));
 			}
 			
 			g_strfreev(parts);
@@ -295,23 +422,22 @@ static gboolean parse_header(FILE *file, struct context *ctx)
 
 static int format_match(const char *filename)
 {
-	FILE *file;
+	struct reader r;
 	gchar *name = NULL, *contents = NULL;
 	gboolean status;
-	
-    file = g_fopen(filename, "r");
-	if (file == NULL)
+
+	if (!reader_open(&r, filename))
 		return FALSE;
 
 	/* If we can parse the first section correctly,
 	 * then it is assumed to be a VCD file.
 	 */
-	status = parse_section(file, &name, &contents);
+	status = parse_section(&r, &name, &contents);
 	status = status && (*name != '\0');
-	
+
 	g_free(name);
 	g_free(contents);
-	fclose(file);
+	reader_close(&r);
 	
 	return status;
 }
@@ -367,9 +493,19 @@ static int init(struct sr_input *in, const char *filename)
 		}
 	}
 	
+	if (num_probes > MAX_NUM_PROBES) {
+		sr_warn("Only %d probes are supported.", MAX_NUM_PROBES);
+		num_probes = MAX_NUM_PROBES;
+	}
+
 	/* Maximum number of probes to parse from the VCD */
 	ctx->maxprobes = num_probes;
 
+	/* Samples are sent with the smallest unit that holds all probes */
+	ctx->unitsize = (num_probes + 7) / 8;
+	ctx->identifiers = g_hash_table_new(g_str_hash, g_str_equal);
+	ctx->key = g_string_sized_new(32);
+
 	/* Create a virtual device. */
 	in->sdi = sr_dev_inst_new(LOGIC, 0, SR_ST_ACTIVE, NULL, NULL, NULL);
 	in->internal = ctx;
@@ -389,58 +525,89 @@ static int init(struct sr_input *in, const char *filename)
 	return SR_OK;
 }
 
-#define CHUNKSIZE 1024
-
-/* Send N samples of the given value. */
-static void send_samples(const struct sr_dev_inst *sdi, uint64_t sample, uint64_t count)
+/* Send the buffered samples to the session bus. */
+static void flush_samples(const struct sr_dev_inst *sdi, struct context *ctx)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint64_t buffer[CHUNKSIZE];
-	uint64_t i;
-	unsigned chunksize = CHUNKSIZE;
-		
-	if (count < chunksize)
-		chunksize = count;
 
-	for (i = 0; i < chunksize; i++)
-	{
-		buffer[i] = sample;
-	}
-	
+	if (ctx->buffered == 0)
+		return;
+
 	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;	
-	logic.unitsize = sizeof(uint64_t);
-	logic.data = buffer;
-	
+	packet.payload = &logic;
+	logic.unitsize = ctx->unitsize;
+	logic.length = ctx->buffered * ctx->unitsize;
+	logic.data = ctx->buffer;
+	logic.data_error = 0;
+	sr_session_send(sdi, &packet);
+
+	ctx->buffered = 0;
+}
+
+/* Append N samples of the given value. Runs of all lengths, from the
+ * single steps of a busy bus up to long idle periods, share the same
+ * packet buffer, so a packet is only sent once the buffer is full.
+ */
+static void send_samples(const struct sr_dev_inst *sdi, struct context *ctx,
+		uint64_t sample, uint64_t count)
+{
+	const uint64_t capacity = SAMPLE_BUFSIZE / ctx->unitsize;
+	uint64_t n, done;
+	uint8_t *dest;
+	unsigned int i;
+
 	while (count)
 	{
-		if (count < chunksize)
-			chunksize = count;
-	
-		logic.length = sizeof(uint64_t) * chunksize;
-	
-		sr_session_send(sdi, &packet);
-		count -= chunksize;
+		n = MIN(count, capacity - ctx->buffered);
+		dest = ctx->buffer + ctx->buffered * ctx->unitsize;
+
+		if (ctx->unitsize == 1) {
+			memset(dest, (uint8_t)sample, n);
+		} else {
+			/* Store one sample, then double the filled part */
+			for (i = 0; i < ctx->unitsize; i++)
+				dest[i] = sample >> (8 * i);
+			for (done = 1; done < n; done *= 2)
+				memcpy(dest + done * ctx->unitsize, dest,
+					MIN(done, n - done) * ctx->unitsize);
+		}
+
+		ctx->buffered += n;
+		count -= n;
+
+		if (ctx->buffered == capacity)
+			flush_samples(sdi, ctx);
 	}
 }
 
+/* Parse an unsigned decimal number which is not NUL-terminated. */
+static uint64_t parse_uint(const char *str, size_t len)
+{
+	uint64_t value = 0;
+
+	while (len-- && g_ascii_isdigit(*str))
+		value = value * 10 + (*str++ - '0');
+
+	return value;
+}
+
 /* Parse the data section of VCD */
-static void parse_contents(FILE *file, const struct sr_dev_inst *sdi, struct context *ctx)
+static void parse_contents(struct reader *r, const struct sr_dev_inst *sdi, struct context *ctx)
 {
-	GString *token = g_string_sized_new(32);
-	
+	const char *token;
+	size_t len;
 	uint64_t prev_timestamp = 0;
 	uint64_t prev_values = 0;
 	
 	/* Read one space-delimited token at a time. */
-	while (read_until(file, NULL, 'N') && read_until(file, token, 'W'))
+	while (read_token(r, &token, &len))
 	{
-		if (token->str[0] == '#' && g_ascii_isdigit(token->str[1]))
+		if (token[0] == '#' && len > 1 && g_ascii_isdigit(token[1]))
 		{
 			/* Numeric value beginning with # is a new timestamp value */
 			uint64_t timestamp;
-			timestamp = strtoull(token->str + 1, NULL, 10);
+			timestamp = parse_uint(token + 1, len - 1);
 			
 			if (ctx->downsample > 1)
 				timestamp /= ctx->downsample;
@@ -470,87 +637,82 @@ static void parse_contents(FILE *file, const struct sr_dev_inst *sdi, struct con
 					prev_timestamp = timestamp - ctx->compress;
 				}
 			
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
+				sr_spew("New timestamp: %" PRIu64, timestamp);
 			
 				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				send_samples(sdi, prev_values, timestamp - prev_timestamp);
+				send_samples(sdi, ctx, prev_values, timestamp - prev_timestamp);
 				prev_timestamp = timestamp;
 			}
 		}
-		else if (token->str[0] == '$' && token->len > 1)
+		else if (token[0] == '$' && len > 1)
 		{
 			/* This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data, but other tags will be skipped until $end. */
-			if (g_strcmp0(token->str, "$dumpvars") == 0 ||
-			    g_strcmp0(token->str, "$dumpon") == 0 ||
-			    g_strcmp0(token->str, "$dumpoff") == 0 ||
-			    g_strcmp0(token->str, "$end") == 0)
+			if ((len == 9 && memcmp(token, "$dumpvars", 9) == 0) ||
+			    (len == 7 && memcmp(token, "$dumpon", 7) == 0) ||
+			    (len == 8 && memcmp(token, "$dumpoff", 8) == 0) ||
+			    (len == 4 && memcmp(token, "$end", 4) == 0))
 			{
 				/* Ignore, parse contents as normally. */
 			}
 			else
 			{
 				/* Skip until $end */
-				read_until(file, NULL, '$');
+				read_until_end(r, NULL);
 			}
 		}
-		else if (strchr("bBrR", token->str[0]) != NULL)
+		else if (strchr("bBrR", token[0]) != NULL)
 		{
 			/* A vector value. Skip it and also the following identifier. */
-			read_until(file, NULL, 'N');
-			read_until(file, NULL, 'W');
+			read_token(r, &token, &len);
 		}
-		else if (strchr("01xXzZ", token->str[0]) != NULL)
+		else if (strchr("01xXzZ", token[0]) != NULL)
 		{
 			/* A new 1-bit sample value */
 			int i, bit;
-			GSList *l;
-			struct probe *probe;
 
-			bit = (token->str[0] == '1');
+			bit = (token[0] == '1');
 		
-			g_string_erase(token, 0, 1);
-			if (token->len == 0)
+			token++;
+			len--;
+			if (len == 0)
 			{
 				/* There was a space between value and identifier.
 				 * Read in the rest.
 				 */
-				read_until(file, NULL, 'N');
-				read_until(file, token, 'W');
+				if (!read_token(r, &token, &len))
+					break;
 			}
-			
-			for (i = 0, l = ctx->probes; i < ctx->probecount && l; i++, l = l->next)
+
+			g_string_truncate(ctx->key, 0);
+			g_string_append_len(ctx->key, token, len);
+			i = GPOINTER_TO_INT(g_hash_table_lookup(ctx->identifiers,
+				ctx->key->str)) - 1;
+
+			if (i >= 0)
 			{
-				probe = l->data;
+				sr_spew("Probe %d new value %d.", i, bit);
 
-				if (g_strcmp0(token->str, probe->identifier) == 0)
-				{
-					sr_dbg("Probe %d new value %d.", i, bit);
-				
-					/* Found our probe */
-					if (bit)
-						prev_values |= (1 << i);
-					else
-						prev_values &= ~(1 << i);
-					
-					break;
-				}
+				/* Found our probe */
+				if (bit)
+					prev_values |= UINT64_C(1) << i;
+				else
+					prev_values &= ~(UINT64_C(1) << i);
 			}
-			
-			if (i == ctx->probecount)
+			else
 			{
-				sr_dbg("Did not find probe for identifier '%s'.", token->str);
+				sr_dbg("Did not find probe for identifier '%s'.", ctx->key->str);
 			}
 		}
 		else
 		{
-			sr_warn("Skipping unknown token '%s'.", token->str);
+			g_string_truncate(ctx->key, 0);
+			g_string_append_len(ctx->key, token, len);
+			sr_warn("Skipping unknown token '%s'.", ctx->key->str);
 		}
-		
-		g_string_truncate(token, 0);
 	}
-	
-	g_string_free(token, TRUE);
+
+	flush_samples(sdi, ctx);
 }
 
 static int loadfile(struct sr_input *in, const char *filename)
@@ -558,22 +720,28 @@ static int loadfile(struct sr_input *in, const char *filename)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	FILE *file;
+	struct reader r;
 	struct context *ctx;
 	uint64_t samplerate;
 
 	ctx = in->internal;
 
-    if ((file = g_fopen(filename, "r")) == NULL)
+	if (!reader_open(&r, filename))
 		return SR_ERR;
 
-	if (!parse_header(file, ctx))
+	if (!parse_header(&r, ctx))
 	{
 		sr_err("VCD parsing failed");
-		fclose(file);
+		reader_close(&r);
 		return SR_ERR;
 	}
 
+	if (!(ctx->buffer = g_try_malloc(SAMPLE_BUFSIZE))) {
+		sr_err("Sample buffer malloc failed.");
+		reader_close(&r);
+		return SR_ERR_MALLOC;
+	}
+
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(in->sdi, LOG_PREFIX);
 
@@ -587,13 +755,13 @@ static int loadfile(struct sr_input *in, const char *filename)
 	sr_config_free(src);
 
 	/* Parse the contents of the VCD file */
-	parse_contents(file, in->sdi, ctx);
+	parse_contents(&r, in->sdi, ctx);
 	
 	/* Send end packet to the session bus. */
 	packet.type = SR_DF_END;
 	sr_session_send(in->sdi, &packet);
 
-	fclose(file);
+	reader_close(&r);
 	release_context(ctx);
 	in->internal = NULL;
 
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -34,16 +35,66 @@
 #define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
 #define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
 
-#define CHUNK_SIZE 4096
+/* Frames read at once when the file can not be mapped. */
+#define CHUNK_FRAMES (64 * 1024)
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
 
 struct context {
 	uint64_t samplerate;
-	int samplesize;
+	/* One of SR_PCM_*. */
+	int format;
 	int num_channels;
+	/* The samples of the "data" chunk. */
+	uint64_t data_offset;
+	uint64_t data_length;
 };
 
-static int get_wav_header(const char *filename, char *buf)
+static int parse_fmt(struct context *ctx, const uint8_t *fmt, uint32_t size)
+{
+	unsigned int tag, bits;
+
+	if (size < 16)
+		return SR_ERR;
+
+	tag = fmt[0] | fmt[1] << 8;
+	ctx->num_channels = fmt[2] | fmt[3] << 8;
+	ctx->samplerate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 |
+		(uint32_t)fmt[7] << 24;
+	bits = fmt[14] | fmt[15] << 8;
+
+	/* The actual format is the first word of the sub format GUID. */
+	if (tag == WAVE_FORMAT_EXTENSIBLE) {
+		if (size < 26)
+			return SR_ERR;
+		tag = fmt[24] | fmt[25] << 8;
+	}
+
+	if (tag == WAVE_FORMAT_PCM && bits == 8)
+		ctx->format = SR_PCM_U8;
+	else if (tag == WAVE_FORMAT_PCM && bits == 16)
+		ctx->format = SR_PCM_S16LE;
+	else if (tag == WAVE_FORMAT_PCM && bits == 24)
+		ctx->format = SR_PCM_S24LE;
+	else if (tag == WAVE_FORMAT_PCM && bits == 32)
+		ctx->format = SR_PCM_S32LE;
+	else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32)
+		ctx->format = SR_PCM_FLOAT_LE;
+	else
+		return SR_ERR;
+
+	return SR_OK;
+}
+
+/* Walk the chunks up to the samples, other chunks are skipped. */
+static int parse_header(const char *filename, struct context *ctx)
 {
+	uint8_t buf[40];
+	uint64_t pos, file_size, frame_size;
+	uint32_t size;
+	gboolean have_fmt;
 	struct stat st;
 	int fd, l;
 
@@ -51,77 +102,86 @@ static int get_wav_header(const char *filename, char *buf)
 	if (l <= 4 || strcasecmp(filename + l - 4, ".wav"))
 		return SR_ERR;
 
-	if (stat(filename, &st) == -1)
+	if ((fd = open(filename, O_RDONLY)) == -1)
 		return SR_ERR;
-	if (st.st_size <= 45)
-		/* Minimum size of header + 1 8-bit mono PCM sample. */
+	if (fstat(fd, &st) == -1 || read(fd, buf, 12) != 12 ||
+	    strncmp((char *)buf, "RIFF", 4) ||
+	    strncmp((char *)buf + 8, "WAVE", 4)) {
+		close(fd);
 		return SR_ERR;
+	}
+	file_size = st.st_size;
 
-	if ((fd = open(filename, O_RDONLY)) == -1)
-		return SR_ERR;
+	have_fmt = FALSE;
+	for (pos = 12; pos + 8 <= file_size; pos += 8 + size + (size & 1)) {
+		if (lseek(fd, pos, SEEK_SET) == -1 || read(fd, buf, 8) != 8)
+			break;
+		size = buf[4] | buf[5] << 8 | buf[6] << 16 |
+			(uint32_t)buf[7] << 24;
+
+		if (!strncmp((char *)buf, "fmt ", 4)) {
+			l = MIN(size, sizeof(buf));
+			if (read(fd, buf, l) != l || parse_fmt(ctx, buf, l) != SR_OK)
+				break;
+			have_fmt = TRUE;
+		} else if (!strncmp((char *)buf, "data", 4)) {
+			if (!have_fmt || ctx->num_channels < 1)
+				break;
+			close(fd);
+
+			/* Streamed files may not have the size filled in. */
+			ctx->data_offset = pos + 8;
+			ctx->data_length = MIN(size, file_size - ctx->data_offset);
+			frame_size = sr_pcm_sample_size(ctx->format) *
+				ctx->num_channels;
+			ctx->data_length -= ctx->data_length % frame_size;
+
+			return ctx->data_length ? SR_OK : SR_ERR;
+		}
+	}
 
-	l = read(fd, buf, 40);
 	close(fd);
-	if (l != 40)
-		return SR_ERR;
 
-	return SR_OK;
+	return SR_ERR;
 }
 
 static int format_match(const char *filename)
 {
-	char buf[40];
-
-	if (get_wav_header(filename, buf) != SR_OK)
-		return FALSE;
-
-	if (strncmp(buf, "RIFF", 4))
-		return FALSE;
-	if (strncmp(buf + 8, "WAVE", 4))
-		return FALSE;
-	if (strncmp(buf + 12, "fmt ", 4))
-		return FALSE;
-	if (GUINT16_FROM_LE(*(uint16_t *)(buf + 20)) != 1)
-		/* Not PCM. */
-		return FALSE;
-	if (strncmp(buf + 36, "data", 4))
-		return FALSE;
-
-	return TRUE;
+	struct context ctx;
+
+	return parse_header(filename, &ctx) == SR_OK;
 }
 
 static int init(struct sr_input *in, const char *filename)
 {
 	struct sr_channel *probe;
 	struct context *ctx;
-	char buf[40], probename[8];
+	char probename[8];
 	int i;
 
-	if (get_wav_header(filename, buf) != SR_OK)
-		return SR_ERR;
-
 	if (!(ctx = g_try_malloc0(sizeof(struct context))))
 		return SR_ERR_MALLOC;
 
-	/* Create a virtual device. */
-	in->sdi = sr_dev_inst_new(LOGIC, 0, SR_ST_ACTIVE, NULL, NULL, NULL);
-	in->sdi->priv = ctx;
-
-   	ctx->samplerate = GUINT32_FROM_LE(*(uint32_t *)(buf + 24));
-	ctx->samplesize = GUINT16_FROM_LE(*(uint16_t *)(buf + 34)) / 8;
-	if (ctx->samplesize != 1 && ctx->samplesize != 2 && ctx->samplesize != 4) {
-		sr_err("only 8, 16 or 32 bits per sample supported.");
+	if (parse_header(filename, ctx) != SR_OK) {
+		sr_err("Unsupported WAV file, only 8, 16, 24 or 32 bit PCM and "
+		       "32 bit float are supported.");
+		g_free(ctx);
 		return SR_ERR;
 	}
 
-	if ((ctx->num_channels = GUINT16_FROM_LE(*(uint16_t *)(buf + 22))) > 20) {
+	if (ctx->num_channels > DS_MAX_ANALOG_PROBES_NUM) {
 		sr_err("%d channels seems crazy.", ctx->num_channels);
+		g_free(ctx);
 		return SR_ERR;
 	}
 
+	/* Create a virtual device. */
+	in->sdi = sr_dev_inst_new(ANALOG, 0, SR_ST_ACTIVE, NULL, NULL, NULL);
+	in->internal = ctx;
+
 	for (i = 0; i < ctx->num_channels; i++) {
 		snprintf(probename, 8, "CH%d", i + 1);
-		if (!(probe = sr_channel_new(0, SR_CHANNEL_ANALOG, TRUE, probename)))
+		if (!(probe = sr_channel_new(i, SR_CHANNEL_ANALOG, TRUE, probename)))
 			return SR_ERR;
 		in->sdi->channels = g_slist_append(in->sdi->channels, probe);
 	}
@@ -129,19 +189,77 @@ static int init(struct sr_input *in, const char *filename)
 	return SR_OK;
 }
 
+/* Convert chunks into a buffer, where the file can not be mapped. */
+static int load_chunks(struct sr_input *in, const char *filename,
+		       struct context *ctx)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	uint64_t remaining;
+	uint16_t *samples;
+	uint8_t *buf;
+	int frame_size, frames, fd, ret;
+	ssize_t l;
+
+	frame_size = sr_pcm_sample_size(ctx->format) * ctx->num_channels;
+	buf = g_try_malloc(CHUNK_FRAMES * frame_size);
+	samples = g_try_malloc(CHUNK_FRAMES * ctx->num_channels *
+			       sizeof(uint16_t));
+	if (!buf || !samples) {
+		g_free(buf);
+		g_free(samples);
+		return SR_ERR_MALLOC;
+	}
+
+	if ((fd = open(filename, O_RDONLY)) == -1 ||
+	    lseek(fd, ctx->data_offset, SEEK_SET) == -1) {
+		if (fd != -1)
+			close(fd);
+		g_free(buf);
+		g_free(samples);
+		return SR_ERR;
+	}
+
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	analog.probes = in->sdi->channels;
+	analog.mq = 0;
+	analog.unit = 0;
+	analog.mqflags = 0;
+	analog.data = (float *)samples;
+
+	ret = SR_OK;
+	for (remaining = ctx->data_length; remaining > 0; remaining -= l) {
+		l = read(fd, buf, MIN(remaining, (uint64_t)CHUNK_FRAMES * frame_size));
+		if (l <= 0 || l % frame_size) {
+			ret = SR_ERR;
+			break;
+		}
+		frames = l / frame_size;
+		sr_pcm_to_analog(ctx->format, buf, samples,
+				 (uint64_t)frames * ctx->num_channels);
+		analog.num_samples = frames;
+		sr_session_send(in->sdi, &packet);
+	}
+
+	close(fd);
+	g_free(buf);
+	g_free(samples);
+
+	return ret;
+}
+
 static int loadfile(struct sr_input *in, const char *filename)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
-	struct sr_datafeed_analog analog;
+	struct sr_datafeed_analog_pcm pcm;
 	struct sr_config *src;
+	struct sr_file_map *map;
 	struct context *ctx;
-	float fdata[CHUNK_SIZE];
-	uint64_t sample;
-	int num_samples, chunk_samples, s, c, fd, l;
-	char buf[CHUNK_SIZE];
+	int ret;
 
-	ctx = in->sdi->priv;
+	ctx = in->internal;
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(in->sdi, LOG_PREFIX);
@@ -153,51 +271,33 @@ static int loadfile(struct sr_input *in, const char *filename)
 	meta.config = g_slist_append(NULL, src);
 	sr_session_send(in->sdi, &packet);
 	sr_config_free(src);
-
-	if ((fd = open(filename, O_RDONLY)) == -1)
-		return SR_ERR;
-
-	lseek(fd, 40, SEEK_SET);
-	l = read(fd, buf, 4);
-	num_samples = GUINT32_FROM_LE((uint32_t)*(buf));
-	num_samples /= ctx->samplesize / ctx->num_channels;
-	while (TRUE) {
-		if ((l = read(fd, buf, CHUNK_SIZE)) < 1)
-			break;
-		chunk_samples = l / ctx->samplesize / ctx->num_channels;
-		for (s = 0; s < chunk_samples; s++) {
-			for (c = 0; c < ctx->num_channels; c++) {
-				sample = 0;
-				memcpy(&sample, buf + s * ctx->samplesize + c, ctx->samplesize);
-				switch (ctx->samplesize) {
-				case 1:
-					/* 8-bit PCM samples are unsigned. */
-					fdata[s + c] = (uint8_t)sample / 255.0;
-					break;
-				case 2:
-					fdata[s + c] = GINT16_FROM_LE(sample) / 32767.0;
-					break;
-				case 4:
-					fdata[s + c] = GINT32_FROM_LE(sample) / 65535.0;
-					break;
-				}
-			}
-		}
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		analog.probes = in->sdi->channels;
-		analog.num_samples = chunk_samples;
-		analog.mq = 0;
-		analog.unit = 0;
-		analog.data = fdata;
+	g_slist_free(meta.config);
+
+	/* The receiver converts the mapped samples into its own buffer,
+	 * without another copy in between. */
+	ret = SR_OK;
+	if (sr_file_map_new(filename, ctx->data_offset, ctx->data_length,
+			    &map) == SR_OK) {
+		packet.type = SR_DF_ANALOG_PCM;
+		packet.payload = &pcm;
+		pcm.probes = in->sdi->channels;
+		pcm.format = ctx->format;
+		pcm.num_samples = ctx->data_length /
+			(sr_pcm_sample_size(ctx->format) * ctx->num_channels);
+		pcm.map = map;
 		sr_session_send(in->sdi, &packet);
+		sr_file_map_unref(map);
+	} else {
+		ret = load_chunks(in, filename, ctx);
 	}
 
-	close(fd);
 	packet.type = SR_DF_END;
 	sr_session_send(in->sdi, &packet);
 
-	return SR_OK;
+	g_free(ctx);
+	in->internal = NULL;
+
+	return ret;
 }
 
 
@@ -208,4 +308,3 @@ SR_PRIV struct sr_input_format input_wav = {
 	.init = init,
 	.loadfile = loadfile,
 };
-
@@ -120,6 +120,30 @@ SR_PRIV int sr_source_add(int fd, int events, int timeout,
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
 SR_PRIV int sr_session_stop_sync(void);
+#ifdef HAVE_LIBUSB_1_0
+SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
+		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi);
+SR_PRIV int usb_source_remove(struct sr_context *ctx,
+		const struct sr_dev_inst *sdi);
+#endif
+
+/*--- session_bus.c ---------------------------------------------------------*/
+
+struct bus_packet;
+struct bus_subscriber;
+
+SR_PRIV struct bus_packet *bus_packet_new(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+SR_PRIV void bus_packet_unref(struct bus_packet *p);
+SR_PRIV struct bus_subscriber *bus_subscriber_new(sr_datafeed_callback_t cb,
+		void *cb_data, unsigned int queue_size, int policy);
+SR_PRIV void bus_subscriber_free(struct bus_subscriber *sub);
+SR_PRIV void bus_subscriber_push(struct bus_subscriber *sub,
+		struct bus_packet *p);
+SR_PRIV void bus_subscriber_call(struct bus_subscriber *sub,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+SR_PRIV void bus_subscriber_flush(struct bus_subscriber *sub);
 
 /*--- std.c -----------------------------------------------------------------*/
 
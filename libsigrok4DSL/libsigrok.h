@@ -177,6 +177,9 @@ enum {
 	SR_DF_FRAME_BEGIN,
 	SR_DF_FRAME_END,
     SR_DF_ABANDON,
+	SR_DF_LOGIC_MAP,
+	SR_DF_LOGIC_BLOCKS,
+	SR_DF_ANALOG_PCM,
 };
 
 /** Values for sr_datafeed_analog.mq. */
@@ -309,6 +312,49 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Logic samples in a file mapping, which the receiver may keep by
+ * taking a reference with sr_file_map_ref() instead of copying them.
+ */
+struct sr_datafeed_logic_map {
+	uint16_t unitsize;
+	struct sr_file_map *map;
+};
+
+/**
+ * Logic samples in the blocks of an indexed session file, which the
+ * receiver may keep by taking a reference with sr_session_blocks_ref()
+ * and read on demand.
+ */
+struct sr_datafeed_logic_blocks {
+	uint16_t unitsize;
+	struct sr_session_blocks *blocks;
+};
+
+/** Sample formats of PCM audio, see sr_pcm_to_analog(). */
+enum {
+	SR_PCM_U8 = 1,
+	SR_PCM_S16LE,
+	SR_PCM_S24LE,
+	SR_PCM_S32LE,
+	SR_PCM_FLOAT_LE,
+};
+
+/**
+ * Interleaved PCM samples in a file mapping, which the receiver converts
+ * with sr_pcm_to_analog() straight into its own sample buffer instead of
+ * receiving converted copies.
+ */
+struct sr_datafeed_analog_pcm {
+	/** The probes for which data is included in this packet. */
+	GSList *probes;
+	/** The sample format, one of SR_PCM_*. */
+	int format;
+	/** The number of samples of each probe. */
+	uint64_t num_samples;
+	struct sr_file_map *map;
+};
+
 struct sr_datafeed_trigger {
 
 };
@@ -705,6 +751,13 @@ enum {
 	 */
 	SR_CONF_SERIALCOMM,
 
+	/**
+	 * The number of devices a scan finds, for drivers which simulate
+	 * them. Used to capture with several devices at once without the
+	 * hardware.
+	 */
+	SR_CONF_DEVICE_COUNT,
+
 	/*--- Device configuration ------------------------------------------*/
 
 	/** The device supports setting its samplerate, in Hz. */
@@ -721,6 +774,18 @@ enum {
 	/** The device supports setting a pattern (pattern generator mode). */
 	SR_CONF_PATTERN_MODE,
 
+	/** Bit rate of the bus patterns, in Hz. */
+	SR_CONF_PATTERN_BITRATE,
+
+	/** Seed of the pseudo-random data of the patterns. */
+	SR_CONF_PATTERN_SEED,
+
+	/**
+	 * Generate the samples as fast as the frontend takes them, instead
+	 * of at the samplerate.
+	 */
+	SR_CONF_BENCHMARK,
+
 	/** The device supports Run Length Encoding. */
 	SR_CONF_RLE,
 
@@ -829,6 +894,11 @@ enum {
     SR_CONF_MAX_LOGIC_SAMPLELIMITS,
     SR_CONF_RLE_SAMPLELIMITS,
 
+    /** USB transfer statistics */
+    SR_CONF_USB_TRANSFER_SIZE,
+    SR_CONF_USB_TRANSFERS,
+    SR_CONF_USB_OVERFLOW_MARGIN,
+
 	/*--- Special stuff -------------------------------------------------*/
 
 	/** Scan options supported by the driver. */
@@ -853,6 +923,10 @@ enum {
 	/** The device supports setting the number of probes. */
 	SR_CONF_CAPTURE_NUM_PROBES,
 
+	/** The container revision of the capturefile, see
+	 * SR_SESSION_CONTAINER_ENTRY. */
+	SR_CONF_CAPTURE_CONTAINER,
+
 	/*--- Acquisition modes ---------------------------------------------*/
 
 	/**
@@ -1028,7 +1102,7 @@ struct sr_dev_driver {
 struct sr_session {
 	/** List of struct sr_dev pointers. */
 	GSList *devs;
-	/** List of struct datafeed_callback pointers. */
+	/** List of struct sr_datafeed_subscription pointers. */
 	GSList *datafeed_callbacks;
 	GTimeVal starttime;
 	gboolean running;
@@ -1045,6 +1119,20 @@ struct sr_session {
 	GPollFD *pollfds;
 	int source_timeout;
 
+	/*
+	 * The USB event source. The callbacks of the devices polling libusb
+	 * run once per iteration when any of the libusb poll descriptors is
+	 * ready, when a libusb timeout expires, or when "usb_wakeup" is set.
+	 * libusb may change its poll descriptors from any thread, it only
+	 * sets "usb_changed" and the session thread updates the sources.
+	 */
+	struct sr_context *usb_ctx;
+	/** List of struct usb_source_dev pointers, one per device. */
+	GSList *usb_devs;
+	int usb_timeout;
+	volatile gint usb_changed;
+	volatile gint usb_wakeup;
+
 	/*
 	 * These are our synchronization primitives for stopping the session in
 	 * an async fashion. We need to make sure the session is stopped from
@@ -1093,6 +1181,169 @@ struct ds_trigger_pos {
     unsigned char first_block[500];
 };
 
+/** Methods used by sr_bitgather_run(). */
+enum {
+	/** Pick the fastest method for the mask and the CPU. */
+	SR_BITGATHER_AUTO = 0,
+	/** Shift and mask every run of adjacent bits, SIMD batched. */
+	SR_BITGATHER_SHIFT,
+	/** One lookup table per input byte. */
+	SR_BITGATHER_TABLE,
+	/** BMI2 parallel bit extract (PEXT). */
+	SR_BITGATHER_PEXT,
+};
+
+#define SR_BITGATHER_MAX_RUNS 32
+
+/**
+ * Gathers the bits selected by a mask into the low bits of each sample,
+ * keeping their order. See sr_bitgather_init().
+ */
+struct sr_bitgather {
+	int method;
+	unsigned int in_unitsize;
+	unsigned int out_unitsize;
+	uint64_t mask;
+	/* Runs of adjacent mask bits, each moved by a single shift. */
+	unsigned int num_runs;
+	uint64_t run_mask[SR_BITGATHER_MAX_RUNS];
+	unsigned int run_shift[SR_BITGATHER_MAX_RUNS];
+	/* in_unitsize * 256 entries, SR_BITGATHER_TABLE only. */
+	uint64_t *table;
+};
+
+/**
+ * A read-only mapping of a file region, shared with the page cache.
+ * See sr_file_map_new().
+ */
+struct sr_file_map {
+	/** The start of the region. */
+	const uint8_t *data;
+	/** The length of the region in bytes, at least 8 readable
+	 * zero bytes follow it. */
+	uint64_t length;
+	/* The whole mapping, from a page boundary. */
+	void *addr;
+	size_t size;
+	int refcount;
+};
+
+/** Samples covered by one transition summary entry of a session file. */
+#define SR_SESSION_SUMMARY_SAMPLES 4096
+
+/**
+ * Container revisions of a capture in a session file, given by the
+ * "container" key of its header. Files without the key hold the capture
+ * in a single entry.
+ */
+enum {
+	/** The samples in the entry named by the capturefile. */
+	SR_SESSION_CONTAINER_ENTRY = 1,
+	/** Blocks with an index and a summary, see sr_session_blocks_open(). */
+	SR_SESSION_CONTAINER_BLOCKS = 2,
+};
+
+struct zip;
+
+/**
+ * Random access to a logic capture saved as independently compressed
+ * blocks. See sr_session_blocks_open().
+ */
+struct sr_session_blocks {
+	uint16_t unitsize;
+	uint64_t total_samples;
+	/** The samples in each block but the last one, a multiple of
+	 * SR_SESSION_SUMMARY_SAMPLES. */
+	uint64_t block_samples;
+	uint64_t num_blocks;
+	/** The last sample of each block, num_blocks * unitsize bytes. */
+	uint8_t *block_last;
+	/** The channels which toggled in each full run of
+	 * SR_SESSION_SUMMARY_SAMPLES samples, including the edge from the
+	 * sample before, which is 0 before the first one.
+	 * total_samples / SR_SESSION_SUMMARY_SAMPLES * unitsize bytes. */
+	uint8_t *summary;
+	/* Private */
+	struct zip *archive;
+	char *filename;
+	char *capturefile;
+	int refcount;
+};
+
+/**
+ * A datafeed callback of the session.
+ * See sr_session_datafeed_subscribe_dev().
+ */
+struct sr_datafeed_subscription;
+
+/**
+ * A logic capture being saved while it is acquired.
+ * See sr_session_writer_new().
+ */
+struct sr_session_writer;
+
+/** The stages of the acquisition pipeline which are measured. */
+enum {
+	/** Bytes received from USB. */
+	SR_METRIC_USB_BYTES = 0,
+	/** USB transfers completed. */
+	SR_METRIC_USB_TRANSFERS,
+	/** USB transfers completed without data or with an error. */
+	SR_METRIC_USB_EMPTY,
+	/** Time in the transfer completion callback, in µs. */
+	SR_METRIC_USB_CALLBACK,
+	/** Time between two transfers being resubmitted, in µs. */
+	SR_METRIC_USB_RESUBMIT_GAP,
+	/** Time sr_session_send() spends in the datafeed callbacks, in µs. */
+	SR_METRIC_SESSION_SEND,
+	/** Time the frontend waits for its data lock, in µs. */
+	SR_METRIC_FEED_LOCK_WAIT,
+	/** Time the frontend copies a packet into its snapshot, in µs. */
+	SR_METRIC_FEED_APPEND,
+	/** Time the frontend builds the mip-maps of a packet, in µs. */
+	SR_METRIC_FEED_MIPMAP,
+	/** Time sr_session_send() waits for a full subscriber queue, in µs. */
+	SR_METRIC_BUS_WAIT,
+	/** Packets dropped for SR_BUS_DROP subscribers. */
+	SR_METRIC_BUS_DROPPED,
+	/** Packets merged into queued ones for SR_BUS_COALESCE subscribers. */
+	SR_METRIC_BUS_COALESCED,
+	SR_METRIC_COUNT,
+};
+
+/** Metric types. */
+enum {
+	/** A total, only count is used. */
+	SR_METRIC_COUNTER,
+	/** A distribution of values. */
+	SR_METRIC_HISTOGRAM,
+};
+
+/** Histogram buckets, bucket n > 0 counts the values in [2^(n-1), 2^n). */
+#define SR_METRIC_BUCKETS 24
+
+/** A copy of a metric, see sr_metrics_get(). */
+struct sr_metric {
+	const char *name;
+	int type;
+	/** The total of a counter, the number of values of a histogram. */
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[SR_METRIC_BUCKETS];
+};
+
+/** What sr_session_send() does when a subscriber's queue is full. */
+enum {
+	/** Wait for the subscriber to take a packet. */
+	SR_BUS_BLOCK = 0,
+	/** Drop logic packets, wait for the others. */
+	SR_BUS_DROP,
+	/** Append logic packets to the last queued one, up to a limit,
+	 * wait for the others. */
+	SR_BUS_COALESCE,
+};
+
 #include "proto.h"
 #include "version.h"
 
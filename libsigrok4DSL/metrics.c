@@ -0,0 +1,248 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+/**
+ * @file
+ *
+ * Counters and latency histograms of the acquisition pipeline.
+ */
+
+/**
+ * @defgroup grp_metrics Metrics
+ *
+ * Counters and latency histograms of the acquisition pipeline.
+ *
+ * The driver, the session and the frontend update the metrics from the
+ * acquisition thread while the frontend reads them from its own, so every
+ * update is a single atomic operation and nothing is locked. Readers take
+ * copies with sr_metrics_get() and work out rates from the difference of
+ * two of them.
+ *
+ * @{
+ */
+
+struct metric {
+	const char *name;
+	int type;
+	volatile uint64_t count;	/* Counters only. */
+	volatile uint64_t sum;
+	volatile uint64_t max;
+	volatile uint64_t buckets[SR_METRIC_BUCKETS];
+};
+
+static struct metric metrics[SR_METRIC_COUNT] = {
+	[SR_METRIC_USB_BYTES] = {"usb.bytes", SR_METRIC_COUNTER},
+	[SR_METRIC_USB_TRANSFERS] = {"usb.transfers", SR_METRIC_COUNTER},
+	[SR_METRIC_USB_EMPTY] = {"usb.empty", SR_METRIC_COUNTER},
+	[SR_METRIC_USB_CALLBACK] = {"usb.callback_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_USB_RESUBMIT_GAP] = {"usb.resubmit_gap_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_SESSION_SEND] = {"session.send_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_FEED_LOCK_WAIT] = {"feed.lock_wait_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_FEED_APPEND] = {"feed.append_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_FEED_MIPMAP] = {"feed.mipmap_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_BUS_WAIT] = {"bus.wait_us", SR_METRIC_HISTOGRAM},
+	[SR_METRIC_BUS_DROPPED] = {"bus.dropped", SR_METRIC_COUNTER},
+	[SR_METRIC_BUS_COALESCED] = {"bus.coalesced", SR_METRIC_COUNTER},
+};
+
+static uint64_t atomic_get(volatile uint64_t *p)
+{
+	return __sync_fetch_and_add(p, 0);
+}
+
+static uint64_t atomic_clear(volatile uint64_t *p)
+{
+	return __sync_fetch_and_and(p, 0);
+}
+
+/**
+ * Add to a counter.
+ *
+ * @param id One of SR_METRIC_*.
+ * @param n The amount to add.
+ */
+SR_API void sr_metric_add(int id, uint64_t n)
+{
+	if (id < 0 || id >= SR_METRIC_COUNT)
+		return;
+
+	__sync_fetch_and_add(&metrics[id].count, n);
+}
+
+/**
+ * Record a value in a histogram.
+ *
+ * @param id One of SR_METRIC_*.
+ * @param value The value, usually a time in µs.
+ */
+SR_API void sr_metric_observe(int id, uint64_t value)
+{
+	struct metric *m;
+	uint64_t max;
+	int bucket;
+
+	if (id < 0 || id >= SR_METRIC_COUNT)
+		return;
+
+	m = &metrics[id];
+	bucket = value ? 64 - __builtin_clzll(value) : 0;
+	if (bucket >= SR_METRIC_BUCKETS)
+		bucket = SR_METRIC_BUCKETS - 1;
+
+	/* The number of values is that of the buckets. */
+	__sync_fetch_and_add(&m->sum, value);
+	__sync_fetch_and_add(&m->buckets[bucket], 1);
+	max = m->max;
+	while (value > max && !__sync_bool_compare_and_swap(&m->max, max, value))
+		max = m->max;
+}
+
+/**
+ * Copy the metrics.
+ *
+ * The fields of a metric are read one after the other, a copy taken
+ * during an update may be off by that update.
+ *
+ * @param copies Where to copy them to, indexed by SR_METRIC_*.
+ * @param count The size of copies.
+ *
+ * @return The number of metrics copied.
+ */
+SR_API int sr_metrics_get(struct sr_metric *copies, int count)
+{
+	struct metric *m;
+	int i, b;
+
+	if (!copies || count <= 0)
+		return 0;
+
+	count = MIN(count, SR_METRIC_COUNT);
+	for (i = 0; i < count; i++) {
+		m = &metrics[i];
+		copies[i].name = m->name;
+		copies[i].type = m->type;
+		copies[i].count = atomic_get(&m->count);
+		copies[i].sum = atomic_get(&m->sum);
+		copies[i].max = atomic_get(&m->max);
+		for (b = 0; b < SR_METRIC_BUCKETS; b++) {
+			copies[i].buckets[b] = atomic_get(&m->buckets[b]);
+			if (m->type == SR_METRIC_HISTOGRAM)
+				copies[i].count += copies[i].buckets[b];
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Estimate a percentile of a histogram.
+ *
+ * @param metric A copy taken by sr_metrics_get().
+ * @param fraction The fraction of values, 0.99 for the 99th percentile.
+ *
+ * @return The upper bound of the bucket the percentile falls into, at
+ *         most the largest value.
+ */
+SR_API uint64_t sr_metric_percentile(const struct sr_metric *metric,
+				     double fraction)
+{
+	uint64_t total, rank;
+	int b;
+
+	if (!metric || metric->type != SR_METRIC_HISTOGRAM)
+		return 0;
+
+	for (total = 0, b = 0; b < SR_METRIC_BUCKETS; b++)
+		total += metric->buckets[b];
+	if (total == 0)
+		return 0;
+
+	rank = (uint64_t)(fraction * total + 0.5);
+	rank = MAX(rank, 1);
+	for (b = 0; b < SR_METRIC_BUCKETS - 1; b++) {
+		if (metric->buckets[b] >= rank)
+			break;
+		rank -= metric->buckets[b];
+	}
+
+	if (b == 0)
+		return 0;
+	return MIN((UINT64_C(1) << b) - 1, metric->max);
+}
+
+/**
+ * Set all metrics back to zero.
+ */
+SR_API void sr_metrics_reset(void)
+{
+	struct metric *m;
+	int i, b;
+
+	for (i = 0; i < SR_METRIC_COUNT; i++) {
+		m = &metrics[i];
+		atomic_clear(&m->count);
+		atomic_clear(&m->sum);
+		atomic_clear(&m->max);
+		for (b = 0; b < SR_METRIC_BUCKETS; b++)
+			atomic_clear(&m->buckets[b]);
+	}
+}
+
+/**
+ * Describe the metrics, one line each.
+ *
+ * Counters are written as their total, histograms as their number of
+ * values, mean, median, 99th percentile and maximum.
+ *
+ * @return A newly allocated string, to be freed with g_free().
+ */
+SR_API char *sr_metrics_dump(void)
+{
+	struct sr_metric copies[SR_METRIC_COUNT];
+	const struct sr_metric *m;
+	GString *s;
+	int i;
+
+	sr_metrics_get(copies, SR_METRIC_COUNT);
+	s = g_string_sized_new(SR_METRIC_COUNT * 80);
+	for (i = 0; i < SR_METRIC_COUNT; i++) {
+		m = &copies[i];
+		if (m->type == SR_METRIC_COUNTER) {
+			g_string_append_printf(s, "%s %" PRIu64 "\n",
+					       m->name, m->count);
+			continue;
+		}
+		g_string_append_printf(s, "%s count=%" PRIu64 " mean=%" PRIu64
+				       " p50=%" PRIu64 " p99=%" PRIu64
+				       " max=%" PRIu64 "\n", m->name, m->count,
+				       m->count ? m->sum / m->count : 0,
+				       sr_metric_percentile(m, 0.5),
+				       sr_metric_percentile(m, 0.99), m->max);
+	}
+
+	return g_string_free(s, FALSE);
+}
+
+/** @} */
@@ -25,8 +25,15 @@
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define LOG_PREFIX "output/csv"
 
+/* Longest row prefix: a 20 digit count, a point and 19 decimals. */
+#define TIMESTAMP_MAX 48
+
 struct context {
 	unsigned int num_enabled_channels;
 	uint64_t samplerate;
@@ -40,6 +47,18 @@ struct context {
     uint64_t pre_data;
     uint64_t index;
     int type;
+    /* Rows start with the sample number instead of the time. */
+    gboolean sample_numbers;
+    /* Times are printed with this many decimals, fraction of a second
+     * = (sample % samplerate) * time_num / time_den. */
+    int time_digits;
+    uint64_t time_num;
+    uint64_t time_den;
+    unsigned int unitsize;
+    /* The bytes of mask and pre_data, repeated to 16 bytes. */
+    uint8_t mask_bytes[16];
+    uint8_t pre_bytes[16];
+    char *row;
 };
 
 /*
@@ -48,7 +67,6 @@ struct context {
  *  - Option to (not) print metadata as comments.
  *  - Option to specify the comment character(s), e.g. # or ; or C/C++-style.
  *  - Option to (not) print samplenumber / time as extra column.
- *  - Option to "compress" output (only print changed samples, VCD-like).
  *  - Option to print comma-separated bits, or whole bytes/words (for 8/16
  *    channel LAs) as ASCII/hex etc. etc.
  *  - Trigger support.
@@ -58,6 +76,7 @@ static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
+	GVariant *gvar;
 	GSList *l;
 	int i;
 
@@ -69,8 +88,14 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->separator = ',';
     ctx->mask = 0;
     ctx->index = 0;
-    ctx->type = g_variant_get_int16(g_hash_table_lookup(options, "type"));
-    ctx->timebase = g_variant_get_uint64(g_hash_table_lookup(options, "timebase"));
+    /* DSView passes the options straight to init(), only those it knows. */
+    gvar = options ? g_hash_table_lookup(options, "type") : NULL;
+    ctx->type = gvar ? g_variant_get_int16(gvar) : SR_CHANNEL_LOGIC;
+    gvar = options ? g_hash_table_lookup(options, "timebase") : NULL;
+    ctx->timebase = gvar ? g_variant_get_uint64(gvar) : 0;
+    gvar = options ? g_hash_table_lookup(options, "timestamp") : NULL;
+    ctx->sample_numbers = gvar &&
+        !strcmp(g_variant_get_string(gvar, NULL), "samples");
 
 	/* Get the number of channels, and the unitsize. */
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -84,6 +109,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_index = g_malloc(sizeof(int) * ctx->num_enabled_channels);
     ctx->channel_vdiv = g_malloc(sizeof(float) * ctx->num_enabled_channels);
     ctx->channel_vpos = g_malloc(sizeof(double) * ctx->num_enabled_channels);
+    ctx->row = g_malloc(TIMESTAMP_MAX + 2 * ctx->num_enabled_channels + 1);
 
 	/* Once more to map the enabled channels. */
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
@@ -93,7 +119,7 @@ static int init(struct sr_output *o, GHashTable *options)
 		if (!ch->enabled)
 			continue;
         ctx->channel_index[i] = ch->index;
-        ctx->mask |= (1 << ch->index);
+        ctx->mask |= UINT64_C(1) << ch->index;
         ctx->channel_vdiv[i] = ch->vdiv * ch->vfactor >= 500 ? ch->vdiv * ch->vfactor / 100.0f : ch->vdiv * ch->vfactor * 10.0f;
         ctx->channel_vpos[i] = ch->vdiv * ch->vfactor >= 500 ? ch->vpos / 1000 : ch->vpos;
         i++;
@@ -151,7 +177,8 @@ static GString *gen_header(const struct sr_output *o)
     }
 
     if (ctx->type == SR_CHANNEL_LOGIC)
-        g_string_append_printf(header, "Time(s),");
+        g_string_append_printf(header, ctx->sample_numbers ||
+            !ctx->samplerate ? "Sample," : "Time(s),");
     for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
         ch = l->data;
         if (ch->type != ctx->type)
@@ -173,6 +200,188 @@ static GString *gen_header(const struct sr_output *o)
 	return header;
 }
 
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+	uint64_t t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/*
+ * Times get enough decimals to tell single samples apart. The fraction
+ * is computed in integers, as a reduced ratio of the power of ten and
+ * the samplerate.
+ */
+static void set_timescale(struct context *ctx)
+{
+	uint64_t scale;
+
+	ctx->time_digits = 0;
+	if (!ctx->samplerate)
+		return;
+	for (scale = 1; scale < ctx->samplerate && ctx->time_digits < 18;
+	     scale *= 10)
+		ctx->time_digits++;
+	while (ctx->time_digits > 0 && scale / gcd(scale, ctx->samplerate) >
+	       UINT64_MAX / ctx->samplerate) {
+		scale /= 10;
+		ctx->time_digits--;
+	}
+	ctx->time_num = scale / gcd(scale, ctx->samplerate);
+	ctx->time_den = ctx->samplerate / gcd(scale, ctx->samplerate);
+}
+
+/* Decimal digits of v, zero padded to at least width. */
+static char *format_u64(char *p, uint64_t v, int width)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (width-- > n)
+		*p++ = '0';
+	while (n)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+static char *format_timestamp(const struct context *ctx, char *p,
+			      uint64_t sample)
+{
+	if (ctx->sample_numbers || !ctx->samplerate)
+		return format_u64(p, sample, 1);
+
+	p = format_u64(p, sample / ctx->samplerate, 1);
+	if (ctx->time_digits) {
+		*p++ = '.';
+		p = format_u64(p, sample % ctx->samplerate * ctx->time_num /
+			       ctx->time_den, ctx->time_digits);
+	}
+
+	return p;
+}
+
+static inline uint64_t load_sample(const uint8_t *p, unsigned int unitsize)
+{
+	uint64_t v = 0;
+
+	memcpy(&v, p, unitsize);
+	return v;
+}
+
+/* Keep the byte patterns of the vector compare in step with pre_data. */
+static void set_pre_data(struct context *ctx, uint64_t value)
+{
+	unsigned int i;
+
+	ctx->pre_data = value;
+	for (i = 0; i + ctx->unitsize <= sizeof(ctx->pre_bytes);
+	     i += ctx->unitsize)
+		memcpy(ctx->pre_bytes + i, &value, ctx->unitsize);
+}
+
+static void set_unitsize(struct context *ctx, unsigned int unitsize)
+{
+	unsigned int i;
+
+	ctx->unitsize = unitsize;
+	if (unitsize < 8)
+		ctx->mask &= (UINT64_C(1) << (unitsize * 8)) - 1;
+	for (i = 0; i + unitsize <= sizeof(ctx->mask_bytes); i += unitsize)
+		memcpy(ctx->mask_bytes + i, &ctx->mask, unitsize);
+	set_pre_data(ctx, ctx->pre_data & ctx->mask);
+}
+
+/*
+ * The number of leading samples which equal pre_data in the enabled
+ * channels. A vector holds a whole number of samples for unit sizes of
+ * 1, 2, 4 and 8, so all its bytes match exactly when its samples do.
+ */
+static uint64_t skip_unchanged(const struct context *ctx,
+			       const uint8_t *data, uint64_t count)
+{
+	const unsigned int unitsize = ctx->unitsize;
+	uint64_t i = 0;
+
+#ifdef __SSE2__
+	if (16 % unitsize == 0) {
+		const __m128i mask = _mm_loadu_si128(
+			(const __m128i *)ctx->mask_bytes);
+		const __m128i pre = _mm_loadu_si128(
+			(const __m128i *)ctx->pre_bytes);
+		const uint64_t step = 16 / unitsize;
+		unsigned int m;
+		__m128i v;
+
+		for (; i + step <= count; i += step) {
+			v = _mm_and_si128(_mm_loadu_si128(
+				(const __m128i *)(data + i * unitsize)), mask);
+			m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pre)) ^ 0xffff;
+			if (m)
+				return i + __builtin_ctz(m) / unitsize;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+		if ((load_sample(data + i * unitsize, unitsize) & ctx->mask) !=
+		    ctx->pre_data)
+			break;
+
+	return i;
+}
+
+/* One row for the first sample and for every sample that differs from
+ * the one before, so the work follows the number of changes. */
+static void logic_rows(struct context *ctx,
+		       const struct sr_datafeed_logic *logic, GString *out)
+{
+	const uint8_t *data = logic->data;
+	const uint64_t count = logic->length / logic->unitsize;
+	const uint8_t *sample;
+	uint64_t i;
+	unsigned int j;
+	char *p;
+	int idx;
+
+	if (ctx->unitsize != logic->unitsize)
+		set_unitsize(ctx, logic->unitsize);
+
+	for (i = 0; i < count; i++) {
+		if (ctx->index + i > 0) {
+			i += skip_unchanged(ctx, data + i * ctx->unitsize,
+					    count - i);
+			if (i == count)
+				break;
+		}
+
+		sample = data + i * ctx->unitsize;
+		set_pre_data(ctx, load_sample(sample, ctx->unitsize) &
+			     ctx->mask);
+
+		p = format_timestamp(ctx, ctx->row, ctx->index + i);
+		for (j = 0; j < ctx->num_enabled_channels; j++) {
+			idx = ctx->channel_index[j];
+			*p++ = ctx->separator;
+			*p++ = (sample[idx / 8] & (1 << (idx % 8))) ? '1' : '0';
+		}
+		*p++ = '\n';
+		g_string_append_len(out, ctx->row, p - ctx->row);
+	}
+
+	ctx->index += count;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -184,7 +393,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	struct context *ctx;
 	int idx;
 	uint64_t i, j;
-    unsigned char *p, c;
+    unsigned char *p;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -206,26 +415,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		logic = packet->payload;
 		if (!ctx->header_done) {
 			*out = gen_header(o);
+			set_timescale(ctx);
 			ctx->header_done = TRUE;
 		} else {
 			*out = g_string_sized_new(512);
 		}
 
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-            ctx->index++;
-            if (ctx->index > 1 && (*(uint64_t *)(logic->data + i) & ctx->mask) == ctx->pre_data)
-                continue;
-            g_string_append_printf(*out, "%0.10g", (ctx->index-1)*1.0/ctx->samplerate);
-            for (j = 0; j < ctx->num_enabled_channels; j++) {
-				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				c = *p & (1 << (idx % 8));
-                g_string_append_c(*out, ctx->separator);
-                g_string_append_c(*out, c ? '1' : '0');
-			}
-			g_string_append_printf(*out, "\n");
-            ctx->pre_data = (*(uint64_t *)(logic->data + i) & ctx->mask);
-		}
+		logic_rows(ctx, logic, *out);
 		break;
      case SR_DF_DSO:
         dso = packet->payload;
@@ -264,6 +460,9 @@ static int cleanup(struct sr_output *o)
 	if (o->priv) {
 		ctx = o->priv;
 		g_free(ctx->channel_index);
+		g_free(ctx->channel_vdiv);
+		g_free(ctx->channel_vpos);
+		g_free(ctx->row);
 		g_free(o->priv);
 		o->priv = NULL;
 	}
@@ -271,12 +470,36 @@ static int cleanup(struct sr_output *o)
 	return SR_OK;
 }
 
+static struct sr_option options[] = {
+	{ "type", "Type", "Channel type to export", NULL, NULL },
+	{ "timebase", "Timebase", "Timebase of the DSO channels", NULL, NULL },
+	{ "timestamp", "Timestamp", "Time in seconds, or sample numbers",
+	  NULL, NULL },
+	{0}
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(
+			g_variant_new_int16(SR_CHANNEL_LOGIC));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint64(0));
+		options[2].def = g_variant_ref_sink(g_variant_new_string("time"));
+		options[2].values = g_slist_append(options[2].values,
+			g_variant_ref_sink(g_variant_new_string("time")));
+		options[2].values = g_slist_append(options[2].values,
+			g_variant_ref_sink(g_variant_new_string("samples")));
+	}
+
+	return options;
+}
+
 SR_PRIV struct sr_output_module output_csv = {
 	.id = "csv",
 	.name = "CSV",
 	.desc = "Comma-separated values",
 	.exts = (const char*[]){"csv", NULL},
-	.options = NULL,
+	.options = get_options,
 	.init = init,
 	.receive = receive,
 	.cleanup = cleanup,
@@ -63,6 +63,7 @@ extern SR_PRIV struct sr_output_module output_chronovu_la8;
 extern SR_PRIV struct sr_output_module output_csv;
 extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
+extern SR_PRIV struct sr_output_module output_planes;
 extern SR_PRIV struct sr_output_module output_wav;
 /* @endcond */
 
@@ -71,6 +72,7 @@ static const struct sr_output_module *output_module_list[] = {
 	&output_vcd,
 	&output_gnuplot,
 	&output_srzip,
+	&output_planes,
 	/*&output_ascii,
 	&output_binary,
 	&output_bits,
@@ -0,0 +1,437 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define LOG_PREFIX "output/planes"
+
+/*
+ * Logic samples stored one bit plane per channel, for tools which map
+ * the file and read single channels. All values are little endian.
+ *
+ * Header, PLANES_HEADER_SIZE bytes:
+ *   0  "DSPLANES"
+ *   8  u32 format version, 1
+ *  12  u32 number of channels
+ *  16  u64 samplerate, 0 if unknown
+ *  24  u32 samples per block, a multiple of 64
+ *  28  u32 size of the header and the channel table
+ * Channel table, PLANES_CHANNEL_SIZE bytes per enabled logic channel:
+ *   0  u32 probe index
+ *   4  name, NUL padded
+ * Blocks, one per PLANES_BLOCK_SAMPLES samples, the last one zero padded:
+ *   the bit planes of the channels in table order, samples/8 bytes each,
+ *   bit i of byte j is sample 8 * j + i.
+ * Block index, 16 bytes per block:
+ *   0  u64 channels (bit n for table entry n) which change in the block
+ *   8  u64 channel levels at the first sample of the block
+ * Footer, 24 bytes:
+ *   0  u64 number of samples
+ *   8  u64 number of blocks
+ *  16  "PLANEIDX"
+ *
+ * With numpy, channel n of a file with c channels is
+ *   np.memmap(f, np.uint8, 'r', header_size, (blocks, c, block_samples // 8))
+ * indexed [:, n, :], then np.unpackbits(..., bitorder='little').
+ */
+#define PLANES_VERSION 1
+#define PLANES_HEADER_SIZE 32
+#define PLANES_CHANNEL_SIZE 32
+#define PLANES_BLOCK_SAMPLES (64 * 1024)
+#define PLANES_FOOTER_SIZE 24
+
+struct context {
+	unsigned int num_channels;
+	int *channel_index;
+	uint64_t samplerate;
+	gboolean header_done;
+	/* Gathers the enabled channels into packed samples. */
+	struct sr_bitgather bg;
+	unsigned int unitsize;
+	unsigned int packed_size;
+	/* The packed samples of the current block. */
+	uint8_t *block;
+	uint64_t block_fill;
+	uint8_t *planes;
+	GString *index;
+	uint64_t num_samples;
+	uint64_t num_blocks;
+};
+
+static void append_le32(GString *s, uint32_t v)
+{
+	uint8_t b[4];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		b[i] = v >> (8 * i);
+	g_string_append_len(s, (const gchar *)b, sizeof(b));
+}
+
+static void append_le64(GString *s, uint64_t v)
+{
+	uint8_t b[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		b[i] = v >> (8 * i);
+	g_string_append_len(s, (const gchar *)b, sizeof(b));
+}
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GSList *l;
+	unsigned int num_channels, i;
+
+	(void)options;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	num_channels = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		if (ch->index >= 64) {
+			sr_err("Bit planes only support probes 0 - 63.");
+			return SR_ERR;
+		}
+		num_channels++;
+	}
+
+	ctx = g_malloc0(sizeof(struct context));
+	o->priv = ctx;
+	ctx->num_channels = num_channels;
+	ctx->channel_index = g_malloc(sizeof(int) * MAX(num_channels, 1));
+	ctx->packed_size = MAX((num_channels + 7) / 8, 1);
+	ctx->block = g_malloc0(PLANES_BLOCK_SAMPLES * ctx->packed_size);
+	ctx->planes = g_malloc(PLANES_BLOCK_SAMPLES / 8 * MAX(num_channels, 1));
+	ctx->index = g_string_sized_new(512);
+
+	for (i = 0, l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		ctx->channel_index[i++] = ch->index;
+	}
+
+	return SR_OK;
+}
+
+static GString *gen_header(const struct sr_output *o)
+{
+	struct context *ctx;
+	struct sr_channel *ch;
+	GVariant *gvar;
+	GString *header;
+	GSList *l;
+	char name[PLANES_CHANNEL_SIZE - 4];
+
+	ctx = o->priv;
+	if (ctx->samplerate == 0) {
+		if (sr_config_get(o->sdi->driver, o->sdi, NULL, NULL,
+				SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+			ctx->samplerate = g_variant_get_uint64(gvar);
+			g_variant_unref(gvar);
+		}
+	}
+
+	header = g_string_sized_new(PLANES_HEADER_SIZE +
+			PLANES_CHANNEL_SIZE * ctx->num_channels);
+	g_string_append_len(header, "DSPLANES", 8);
+	append_le32(header, PLANES_VERSION);
+	append_le32(header, ctx->num_channels);
+	append_le64(header, ctx->samplerate);
+	append_le32(header, PLANES_BLOCK_SAMPLES);
+	append_le32(header, PLANES_HEADER_SIZE +
+			PLANES_CHANNEL_SIZE * ctx->num_channels);
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		append_le32(header, ch->index);
+		memset(name, 0, sizeof(name));
+		if (ch->name)
+			strncpy(name, ch->name, sizeof(name) - 1);
+		g_string_append_len(header, name, sizeof(name));
+	}
+
+	return header;
+}
+
+/*
+ * Swap the bit at 8 * i + j with the one at 8 * j + i, turning a byte per
+ * sample into a byte per channel.
+ */
+static inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & UINT64_C(0x00AA00AA00AA00AA);
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & UINT64_C(0x0000CCCC0000CCCC);
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & UINT64_C(0x00000000F0F0F0F0);
+	x = x ^ t ^ (t << 28);
+
+	return x;
+}
+
+static void transpose_scalar(struct context *ctx)
+{
+	const unsigned int p = ctx->packed_size;
+	const unsigned int plane_size = PLANES_BLOCK_SAMPLES / 8;
+	uint64_t x, s;
+	unsigned int k, i, b, n;
+
+	for (s = 0; s < plane_size; s++) {
+		for (k = 0; k < p; k++) {
+			x = 0;
+			for (i = 0; i < 8; i++)
+				x |= (uint64_t)ctx->block[(s * 8 + i) * p + k] <<
+					(8 * i);
+			x = transpose8(x);
+			for (b = 0; b < 8; b++) {
+				n = k * 8 + b;
+				if (n < ctx->num_channels)
+					ctx->planes[n * plane_size + s] = x >> (8 * b);
+			}
+		}
+	}
+}
+
+#ifdef __SSE2__
+/*
+ * Byte lanes of 16 samples to two bytes of up to 8 planes: doubling the
+ * bytes moves the next lower bit into the sign bits picked by movemask.
+ */
+static inline void lanes_to_planes(uint8_t *planes, __m128i v,
+				   unsigned int first, unsigned int count)
+{
+	const unsigned int plane_size = PLANES_BLOCK_SAMPLES / 8;
+	unsigned int bit, m;
+
+	for (bit = 8; bit-- > 0; v = _mm_add_epi8(v, v)) {
+		if (bit >= count)
+			continue;
+		m = _mm_movemask_epi8(v);
+		planes[(first + bit) * plane_size] = m;
+		planes[(first + bit) * plane_size + 1] = m >> 8;
+	}
+}
+
+static void transpose_sse2(struct context *ctx)
+{
+	const __m128i low = _mm_set1_epi16(0x00ff);
+	const uint8_t *src = ctx->block;
+	const unsigned int n = ctx->num_channels;
+	uint8_t *planes = ctx->planes;
+	__m128i v0, v1;
+	uint64_t s;
+
+	for (s = 0; s < PLANES_BLOCK_SAMPLES; s += 16, planes += 2) {
+		if (ctx->packed_size == 1) {
+			v0 = _mm_loadu_si128((const __m128i *)(src + s));
+			lanes_to_planes(planes, v0, 0, n);
+		} else {
+			v0 = _mm_loadu_si128((const __m128i *)(src + s * 2));
+			v1 = _mm_loadu_si128((const __m128i *)(src + s * 2 + 16));
+			lanes_to_planes(planes, _mm_packus_epi16(
+				_mm_and_si128(v0, low), _mm_and_si128(v1, low)),
+				0, 8);
+			lanes_to_planes(planes, _mm_packus_epi16(
+				_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8)),
+				8, n - 8);
+		}
+	}
+}
+#endif
+
+/* Write out the current block and add its index entry. */
+static void flush_block(struct context *ctx, GString *out)
+{
+	const unsigned int plane_size = PLANES_BLOCK_SAMPLES / 8;
+	const uint8_t *plane;
+	uint64_t toggles, levels, full, j;
+	uint8_t fill, last_mask;
+	unsigned int n;
+
+	memset(ctx->block + ctx->block_fill * ctx->packed_size, 0,
+	       (PLANES_BLOCK_SAMPLES - ctx->block_fill) * ctx->packed_size);
+
+#ifdef __SSE2__
+	if (ctx->packed_size <= 2)
+		transpose_sse2(ctx);
+	else
+#endif
+		transpose_scalar(ctx);
+
+	g_string_append_len(out, (const gchar *)ctx->planes,
+			    plane_size * ctx->num_channels);
+
+	/* The padding of the last block does not count as a change. */
+	full = ctx->block_fill / 8;
+	last_mask = (1 << (ctx->block_fill % 8)) - 1;
+	toggles = levels = 0;
+	for (n = 0; n < ctx->num_channels; n++) {
+		plane = ctx->planes + n * plane_size;
+		fill = (plane[0] & 1) ? 0xff : 0x00;
+		if (fill)
+			levels |= UINT64_C(1) << n;
+		for (j = 0; j < full && plane[j] == fill; j++)
+			;
+		if (j < full || (last_mask &&
+				 ((plane[full] ^ fill) & last_mask)))
+			toggles |= UINT64_C(1) << n;
+	}
+	append_le64(ctx->index, toggles);
+	append_le64(ctx->index, levels);
+
+	ctx->num_blocks++;
+	ctx->block_fill = 0;
+}
+
+static int receive(const struct sr_output *o,
+		   const struct sr_datafeed_packet *packet, GString **out)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	const uint8_t *data;
+	struct context *ctx;
+	uint64_t mask, samples, n;
+	unsigned int i;
+	GSList *l;
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	if (!(ctx = o->priv))
+		return SR_ERR_ARG;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_SAMPLERATE)
+				continue;
+			ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (!ctx->header_done) {
+			*out = gen_header(o);
+			ctx->header_done = TRUE;
+		} else {
+			*out = g_string_sized_new(PLANES_BLOCK_SAMPLES / 8 *
+						  ctx->num_channels);
+		}
+
+		if (ctx->unitsize != logic->unitsize) {
+			if (ctx->unitsize)
+				sr_bitgather_cleanup(&ctx->bg);
+			ctx->unitsize = 0;
+			mask = 0;
+			for (i = 0; i < ctx->num_channels; i++)
+				mask |= UINT64_C(1) << ctx->channel_index[i];
+			if ((ret = sr_bitgather_init(&ctx->bg, mask,
+					logic->unitsize, ctx->packed_size,
+					SR_BITGATHER_AUTO)) != SR_OK)
+				return ret;
+			ctx->unitsize = logic->unitsize;
+		}
+
+		data = logic->data;
+		samples = logic->length / logic->unitsize;
+		ctx->num_samples += samples;
+		while (samples > 0) {
+			n = MIN(samples, PLANES_BLOCK_SAMPLES - ctx->block_fill);
+			sr_bitgather_run(&ctx->bg, data, ctx->block +
+					 ctx->block_fill * ctx->packed_size, n);
+			ctx->block_fill += n;
+			data += n * logic->unitsize;
+			samples -= n;
+			if (ctx->block_fill == PLANES_BLOCK_SAMPLES)
+				flush_block(ctx, *out);
+		}
+		break;
+	case SR_DF_END:
+		*out = ctx->header_done ? g_string_sized_new(
+			PLANES_BLOCK_SAMPLES / 8 * ctx->num_channels) : gen_header(o);
+		ctx->header_done = TRUE;
+		if (ctx->block_fill > 0)
+			flush_block(ctx, *out);
+		g_string_append_len(*out, ctx->index->str, ctx->index->len);
+		append_le64(*out, ctx->num_samples);
+		append_le64(*out, ctx->num_blocks);
+		g_string_append_len(*out, "PLANEIDX", 8);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	if (o->priv) {
+		ctx = o->priv;
+		if (ctx->unitsize)
+			sr_bitgather_cleanup(&ctx->bg);
+		g_free(ctx->channel_index);
+		g_free(ctx->block);
+		g_free(ctx->planes);
+		g_string_free(ctx->index, TRUE);
+		g_free(o->priv);
+		o->priv = NULL;
+	}
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_planes = {
+	.id = "planes",
+	.name = "Bit planes",
+	.desc = "Binary logic bit planes",
+	.exts = (const char*[]){"planes", NULL},
+	.options = NULL,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
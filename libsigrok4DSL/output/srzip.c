@@ -38,10 +38,17 @@ struct out_context {
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
+	GVariant *gvar;
 
 	outc = g_malloc0(sizeof(struct out_context));
 	o->priv = outc;
-    outc->filename = g_strdup(g_variant_get_bytestring(g_hash_table_lookup(options, "filename")));
+	/* sr_output_new() checks the option against the string default,
+	 * the GUI passes a bytestring straight to init(). */
+	gvar = g_hash_table_lookup(options, "filename");
+	if (g_variant_is_of_type(gvar, G_VARIANT_TYPE_STRING))
+		outc->filename = g_strdup(g_variant_get_string(gvar, NULL));
+	else
+		outc->filename = g_strdup(g_variant_get_bytestring(gvar));
 	if (strlen(outc->filename) == 0)
 		return SR_ERR_ARG;
 
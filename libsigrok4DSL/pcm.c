@@ -0,0 +1,234 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @file
+ *
+ * Conversion of PCM audio samples to the analog sample format.
+ */
+
+/**
+ * @defgroup grp_pcm PCM conversion
+ *
+ * Conversion of PCM audio samples to the analog sample format.
+ *
+ * Analog samples are unsigned 16 bit values spanning the full scale,
+ * with the zero level at 0x8000. The conversion keeps the interleaving
+ * of the channels, which is also that of the analog sample buffers.
+ *
+ * @{
+ */
+
+/**
+ * Get the size of a PCM sample.
+ *
+ * @param format The sample format, one of SR_PCM_*.
+ *
+ * @return The size in bytes, or 0 for an unknown format.
+ */
+SR_API int sr_pcm_sample_size(int format)
+{
+	switch (format) {
+	case SR_PCM_U8:
+		return 1;
+	case SR_PCM_S16LE:
+		return 2;
+	case SR_PCM_S24LE:
+		return 3;
+	case SR_PCM_S32LE:
+	case SR_PCM_FLOAT_LE:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static void convert_u8(const uint8_t *src, uint16_t *dst, uint64_t count)
+{
+	uint64_t i = 0;
+
+#ifdef __SSE2__
+	/* The samples become the high bytes of the 16 bit lanes. */
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= count; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi8(zero, v));
+		_mm_storeu_si128((__m128i *)(dst + i + 8),
+				 _mm_unpackhi_epi8(zero, v));
+	}
+#endif
+
+	for (; i < count; i++)
+		dst[i] = src[i] << 8;
+}
+
+static void convert_s16(const uint8_t *src, uint16_t *dst, uint64_t count)
+{
+	uint64_t i = 0;
+
+#ifdef __SSE2__
+	/* Flipping the sign bit turns two's complement into offset binary. */
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	for (; i + 16 <= count; i += 16) {
+		const __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i * 2));
+		const __m128i v1 = _mm_loadu_si128(
+			(const __m128i *)(src + i * 2 + 16));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v0, sign));
+		_mm_storeu_si128((__m128i *)(dst + i + 8), _mm_xor_si128(v1, sign));
+	}
+#endif
+
+	for (; i < count; i++)
+		dst[i] = (src[i * 2] | src[i * 2 + 1] << 8) ^ 0x8000;
+}
+
+static void convert_s24(const uint8_t *src, uint16_t *dst, uint64_t count)
+{
+	uint64_t i;
+
+	/* The low byte is dropped, the samples are not aligned to vector
+	 * lanes and this loop is bound by memory anyway. */
+	for (i = 0; i < count; i++, src += 3)
+		dst[i] = (src[1] | src[2] << 8) ^ 0x8000;
+}
+
+static void convert_s32(const uint8_t *src, uint16_t *dst, uint64_t count)
+{
+	uint64_t i = 0;
+
+#ifdef __SSE2__
+	/* The high halves always fit the signed saturation of the pack. */
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	for (; i + 8 <= count; i += 8) {
+		const __m128i v0 = _mm_srai_epi32(_mm_loadu_si128(
+			(const __m128i *)(src + i * 4)), 16);
+		const __m128i v1 = _mm_srai_epi32(_mm_loadu_si128(
+			(const __m128i *)(src + i * 4 + 16)), 16);
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_xor_si128(_mm_packs_epi32(v0, v1), sign));
+	}
+#endif
+
+	for (; i < count; i++)
+		dst[i] = (src[i * 4 + 2] | src[i * 4 + 3] << 8) ^ 0x8000;
+}
+
+static void convert_float(const uint8_t *src, uint16_t *dst, uint64_t count)
+{
+	uint64_t i = 0;
+	uint32_t bits;
+	float f;
+
+#ifdef __SSE2__
+	/*
+	 * Samples are clipped to -1..1 and scaled to -32767.5..32767.5, then
+	 * rounded, biased back by 0x8000 after the signed pack. A NaN ends up
+	 * as -1, as in the loop below.
+	 */
+	const __m128 lo = _mm_set1_ps(-1.0f);
+	const __m128 hi = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(32767.5f);
+	const __m128i half = _mm_set1_epi32(32768);
+	const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 f0 = _mm_loadu_ps((const float *)(src + i * 4));
+		__m128 f1 = _mm_loadu_ps((const float *)(src + i * 4 + 16));
+		__m128i v0, v1;
+
+		f0 = _mm_min_ps(_mm_max_ps(f0, lo), hi);
+		f1 = _mm_min_ps(_mm_max_ps(f1, lo), hi);
+		v0 = _mm_sub_epi32(_mm_cvtps_epi32(_mm_add_ps(
+			_mm_mul_ps(f0, scale), scale)), half);
+		v1 = _mm_sub_epi32(_mm_cvtps_epi32(_mm_add_ps(
+			_mm_mul_ps(f1, scale), scale)), half);
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_xor_si128(_mm_packs_epi32(v0, v1), sign));
+	}
+#endif
+
+	for (; i < count; i++) {
+		bits = src[i * 4] | src[i * 4 + 1] << 8 | src[i * 4 + 2] << 16 |
+			(uint32_t)src[i * 4 + 3] << 24;
+		memcpy(&f, &bits, sizeof(f));
+		f = f > -1.0f ? f : -1.0f;
+		f = f < 1.0f ? f : 1.0f;
+		dst[i] = (uint16_t)lrintf(f * 32767.5f + 32767.5f);
+	}
+}
+
+/**
+ * Convert PCM samples to analog samples.
+ *
+ * The samples of all channels are converted in one pass, in the order
+ * they are stored, so interleaved frames stay interleaved.
+ *
+ * @param format The sample format of the input, one of SR_PCM_*.
+ * @param src The little endian input samples.
+ * @param dst The output, room for @a count samples.
+ * @param count The number of samples, counting every channel.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG for an unknown format.
+ */
+SR_API int sr_pcm_to_analog(int format, const void *src, uint16_t *dst,
+			    uint64_t count)
+{
+	switch (format) {
+	case SR_PCM_U8:
+		convert_u8(src, dst, count);
+		break;
+	case SR_PCM_S16LE:
+		convert_s16(src, dst, count);
+		break;
+	case SR_PCM_S24LE:
+		convert_s24(src, dst, count);
+		break;
+	case SR_PCM_S32LE:
+		convert_s32(src, dst, count);
+		break;
+	case SR_PCM_FLOAT_LE:
+		convert_float(src, dst, count);
+		break;
+	default:
+		return SR_ERR_ARG;
+	}
+
+	return SR_OK;
+}
+
+/** @} */
@@ -64,6 +64,36 @@ SR_API int sr_filter_probes(unsigned int in_unitsize, unsigned int out_unitsize,
 			    const GArray *probe_array, const uint8_t *data_in,
 			    uint64_t length_in, uint8_t **data_out,
 			    uint64_t *length_out);
+SR_API int sr_bitgather_init(struct sr_bitgather *bg, uint64_t mask,
+			     unsigned int in_unitsize, unsigned int out_unitsize,
+			     int method);
+SR_API void sr_bitgather_cleanup(struct sr_bitgather *bg);
+SR_API void sr_bitgather_run(const struct sr_bitgather *bg,
+			     const uint8_t *data_in, uint8_t *data_out,
+			     uint64_t samples);
+
+/*--- filemap.c -------------------------------------------------------------*/
+
+SR_API int sr_file_map_new(const char *filename, uint64_t offset,
+			   uint64_t length, struct sr_file_map **map);
+SR_API struct sr_file_map *sr_file_map_ref(struct sr_file_map *map);
+SR_API void sr_file_map_unref(struct sr_file_map *map);
+
+/*--- metrics.c -------------------------------------------------------------*/
+
+SR_API void sr_metric_add(int id, uint64_t n);
+SR_API void sr_metric_observe(int id, uint64_t value);
+SR_API int sr_metrics_get(struct sr_metric *copies, int count);
+SR_API uint64_t sr_metric_percentile(const struct sr_metric *metric,
+				     double fraction);
+SR_API void sr_metrics_reset(void);
+SR_API char *sr_metrics_dump(void);
+
+/*--- pcm.c -----------------------------------------------------------------*/
+
+SR_API int sr_pcm_sample_size(int format);
+SR_API int sr_pcm_to_analog(int format, const void *src, uint16_t *dst,
+			    uint64_t count);
 
 /*--- hwdriver.c ------------------------------------------------------------*/
 
@@ -99,23 +129,49 @@ SR_API struct sr_session *sr_session_new(void);
 SR_API int sr_session_destroy(void);
 SR_API int sr_session_dev_remove_all(void);
 SR_API int sr_session_dev_add(const struct sr_dev_inst *sdi);
+SR_API int sr_session_dev_remove(const struct sr_dev_inst *sdi);
 SR_API int sr_session_dev_list(GSList **devlist);
 
 /* Datafeed setup */
 SR_API int sr_session_datafeed_callback_remove_all(void);
 SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb,
 		void *cb_data);
+SR_API int sr_session_datafeed_subscribe(sr_datafeed_callback_t cb,
+		void *cb_data, unsigned int queue_size, int policy);
+SR_API int sr_session_datafeed_subscribe_dev(const struct sr_dev_inst *sdi,
+		sr_datafeed_callback_t cb, void *cb_data, unsigned int queue_size,
+		int policy, struct sr_datafeed_subscription **subscription);
+SR_API int sr_session_datafeed_unsubscribe(
+		struct sr_datafeed_subscription *subscription);
 
 /* Session control */
 SR_API int sr_session_start(void);
 SR_API int sr_session_run(void);
 SR_API int sr_session_stop(void);
 SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
-		unsigned char *buf, int unitsize, int units);
+		unsigned char *buf, int unitsize, uint64_t units);
 SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
         char **channels);
 SR_API int sr_session_append(const char *filename, unsigned char *buf,
         int unitsize, int units);
+SR_API int sr_session_blocks_open(const char *filename,
+		const char *capturefile, struct sr_session_blocks **blocks);
+SR_API int sr_session_blocks_read(struct sr_session_blocks *blocks,
+		uint64_t block, void *buf);
+SR_API int sr_session_blocks_load(struct sr_session_blocks *blocks,
+		uint64_t first, uint64_t count, void *buf, int num_threads);
+SR_API struct sr_session_blocks *sr_session_blocks_ref(
+		struct sr_session_blocks *blocks);
+SR_API void sr_session_blocks_unref(struct sr_session_blocks *blocks);
+SR_API int sr_session_writer_new(const char *filename,
+		const struct sr_dev_inst *sdi, int unitsize,
+		struct sr_session_writer **writer);
+SR_API int sr_session_writer_set_compress(struct sr_session_writer *writer,
+		gboolean compress);
+SR_API int sr_session_writer_append(struct sr_session_writer *writer,
+		const uint8_t *buf, uint64_t units);
+SR_API int sr_session_writer_finish(struct sr_session_writer *writer);
+SR_API void sr_session_writer_abort(struct sr_session_writer *writer);
 SR_API int sr_session_source_add(int fd, int events, int timeout,
 		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi);
 SR_API int sr_session_source_add_pollfd(GPollFD *pollfd, int timeout,
@@ -133,6 +189,19 @@ SR_API struct sr_input_format **sr_input_list(void);
 /*--- output/output.c -------------------------------------------------------*/
 
 SR_API const struct sr_output_module **sr_output_list(void);
+SR_API const char *sr_output_id_get(const struct sr_output_module *omod);
+SR_API const char *sr_output_name_get(const struct sr_output_module *omod);
+SR_API const char *sr_output_description_get(const struct sr_output_module *omod);
+SR_API const char *const *sr_output_extensions_get(
+		const struct sr_output_module *omod);
+SR_API const struct sr_output_module *sr_output_find(char *id);
+SR_API const struct sr_option **sr_output_options_get(const struct sr_output_module *omod);
+SR_API void sr_output_options_free(const struct sr_option **options);
+SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod,
+		GHashTable *options, const struct sr_dev_inst *sdi);
+SR_API int sr_output_send(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_free(const struct sr_output *o);
 
 /*--- strutil.c -------------------------------------------------------------*/
 
@@ -34,6 +34,15 @@
 #define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
 #define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
 
+#if defined(HAVE_LIBUSB_1_0) && defined(LIBUSB_API_VERSION) && \
+    LIBUSB_API_VERSION >= 0x01000105
+/* sr_session_stop() wakes up the session with libusb_interrupt_event_handler(). */
+#define USB_INTERRUPT
+#else
+/* Longest time in ms before a USB session notices a stop request. */
+#define USB_STOP_TIMEOUT 100
+#endif
+
 /**
  * @file
  *
@@ -57,11 +66,24 @@ struct source {
 	 * being polled and will be used to match the source when removing it again.
 	 */
 	gintptr poll_object;
+
+	/* One of libusb's poll descriptors, see usb_source_add(). */
+	gboolean usb;
+};
+
+/* A device polling libusb, see usb_source_add(). */
+struct usb_source_dev {
+	sr_receive_data_callback_t cb;
+	const struct sr_dev_inst *sdi;
 };
 
-struct datafeed_callback {
+struct sr_datafeed_subscription {
 	sr_datafeed_callback_t cb;
 	void *cb_data;
+	/* NULL for a callback which is called from sr_session_send(). */
+	struct bus_subscriber *sub;
+	/* The device whose packets the callback takes, NULL for all. */
+	const struct sr_dev_inst *sdi;
 };
 
 /* There can only be one session at a time. */
@@ -119,6 +141,9 @@ SR_API int sr_session_destroy(void)
         session->pollfds = NULL;
     }
 
+    g_slist_free_full(session->usb_devs, g_free);
+    session->usb_devs = NULL;
+
 	/* TODO: Error checks needed? */
 
 //	g_mutex_clear(&session->stop_mutex);
@@ -178,6 +203,33 @@ SR_API int sr_session_dev_remove_all(void)
 	return SR_OK;
 }
 
+/**
+ * Remove a device instance from the current session.
+ *
+ * The device must not be acquiring, it isn't closed.
+ *
+ * @param sdi The device instance to remove. Must not be NULL.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_BUG if no session exists.
+ */
+SR_API int sr_session_dev_remove(const struct sr_dev_inst *sdi)
+{
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	session->devs = g_slist_remove(session->devs, sdi);
+
+	return SR_OK;
+}
+
 /**
  * Add a device instance to the current session.
  *
@@ -230,9 +282,17 @@ SR_API int sr_session_dev_add(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static void datafeed_callback_free(struct sr_datafeed_subscription *cb_struct)
+{
+	bus_subscriber_free(cb_struct->sub);
+	g_free(cb_struct);
+}
+
 /**
  * Remove all datafeed callbacks in the current session.
  *
+ * The subscribers take the packets which are queued for them first.
+ *
  * @return SR_OK upon success, SR_ERR_BUG if no session exists.
  */
 SR_API int sr_session_datafeed_callback_remove_all(void)
@@ -242,7 +302,8 @@ SR_API int sr_session_datafeed_callback_remove_all(void)
 		return SR_ERR_BUG;
 	}
 
-	g_slist_free_full(session->datafeed_callbacks, g_free);
+	g_slist_free_full(session->datafeed_callbacks,
+			  (GDestroyNotify)datafeed_callback_free);
 	session->datafeed_callbacks = NULL;
 
 	return SR_OK;
@@ -259,7 +320,7 @@ SR_API int sr_session_datafeed_callback_remove_all(void)
  */
 SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_data)
 {
-	struct datafeed_callback *cb_struct;
+	struct sr_datafeed_subscription *cb_struct;
 
 	if (!session) {
 		sr_err("%s: session was NULL", __func__);
@@ -271,7 +332,8 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
 		return SR_ERR_ARG;
 	}
 
-	if (!(cb_struct = g_try_malloc0(sizeof(struct datafeed_callback))))
+	if (!(cb_struct = g_try_malloc0(
+			sizeof(struct sr_datafeed_subscription))))
 		return SR_ERR_MALLOC;
 
 	cb_struct->cb = cb;
@@ -283,6 +345,205 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
 	return SR_OK;
 }
 
+/**
+ * Add a datafeed callback which runs in a thread of its own.
+ *
+ * sr_session_send() queues the packets for it and returns, it doesn't
+ * wait for the callback unless the queue is full and the policy says so.
+ * The packets are copies which are valid until the callback returns, the
+ * subscribers share them. A packet without a known payload size (DSO
+ * and analog ones) is handed to the callback from the sending thread once
+ * it has taken the packets before it. sr_session_run() returns when all
+ * subscribers have taken all packets.
+ *
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ * @param queue_size The number of packets the callback may be behind.
+ * @param policy What to do with a packet when the queue is full, one of
+ *               SR_BUS_*.
+ *
+ * @return SR_OK upon success, SR_ERR_BUG if no session exists, SR_ERR_ARG
+ *         upon invalid arguments, SR_ERR if the thread can't be started.
+ */
+SR_API int sr_session_datafeed_subscribe(sr_datafeed_callback_t cb,
+		void *cb_data, unsigned int queue_size, int policy)
+{
+	return sr_session_datafeed_subscribe_dev(NULL, cb, cb_data,
+						 queue_size, policy, NULL);
+}
+
+/**
+ * Add a datafeed callback for one device which runs in a thread of its own.
+ *
+ * Like sr_session_datafeed_subscribe(), but the callback only takes the
+ * packets of the given device. With a subscriber for each device of the
+ * session, the devices' data is taken in on as many threads.
+ *
+ * @param sdi The device whose packets the callback takes, NULL for all.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ * @param queue_size The number of packets the callback may be behind.
+ * @param policy What to do with a packet when the queue is full, one of
+ *               SR_BUS_*.
+ * @param subscription Where to store the handle of the subscription for
+ *                     sr_session_datafeed_unsubscribe(), may be NULL.
+ *
+ * @return SR_OK upon success, SR_ERR_BUG if no session exists, SR_ERR_ARG
+ *         upon invalid arguments, SR_ERR if the thread can't be started.
+ */
+SR_API int sr_session_datafeed_subscribe_dev(const struct sr_dev_inst *sdi,
+		sr_datafeed_callback_t cb, void *cb_data,
+		unsigned int queue_size, int policy,
+		struct sr_datafeed_subscription **subscription)
+{
+	struct sr_datafeed_subscription *cb_struct;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!cb || policy < SR_BUS_BLOCK || policy > SR_BUS_COALESCE) {
+		sr_err("%s: invalid arguments", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!(cb_struct = g_try_malloc0(
+			sizeof(struct sr_datafeed_subscription))))
+		return SR_ERR_MALLOC;
+
+	cb_struct->cb = cb;
+	cb_struct->cb_data = cb_data;
+	cb_struct->sdi = sdi;
+	if (!(cb_struct->sub = bus_subscriber_new(cb, cb_data, queue_size,
+						  policy))) {
+		g_free(cb_struct);
+		return SR_ERR;
+	}
+
+	session->datafeed_callbacks =
+	    g_slist_append(session->datafeed_callbacks, cb_struct);
+	if (subscription)
+		*subscription = cb_struct;
+
+	return SR_OK;
+}
+
+/**
+ * Remove a datafeed callback added by sr_session_datafeed_subscribe_dev().
+ *
+ * The subscriber takes the packets which are queued for it first. The
+ * other callbacks of the session are left as they are.
+ *
+ * @param subscription The handle of the subscription.
+ *
+ * @return SR_OK upon success, SR_ERR_BUG if no session exists, SR_ERR_ARG
+ *         if the subscription is not one of the session.
+ */
+SR_API int sr_session_datafeed_unsubscribe(
+		struct sr_datafeed_subscription *subscription)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!subscription ||
+	    !g_slist_find(session->datafeed_callbacks, subscription)) {
+		sr_err("%s: invalid subscription", __func__);
+		return SR_ERR_ARG;
+	}
+
+	session->datafeed_callbacks =
+	    g_slist_remove(session->datafeed_callbacks, subscription);
+	datafeed_callback_free(subscription);
+
+	return SR_OK;
+}
+
+static int _sr_session_source_add(GPollFD *pollfd, int timeout,
+	sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi,
+	gintptr poll_object, gboolean usb);
+static int _sr_session_source_remove(gintptr poll_object);
+
+#ifdef HAVE_LIBUSB_1_0
+/*
+ * The callback of libusb's poll descriptors, it runs the callback of
+ * every device polling libusb. Each one handles the stop of its device
+ * and the pending events of the whole libusb context, which may finish
+ * the acquisition of another device and remove that one's callback.
+ */
+static int usb_sources_dispatch(int fd, int revents,
+		const struct sr_dev_inst *sdi)
+{
+	struct usb_source_dev *dev;
+	GSList *devs, *l;
+
+	(void)sdi;
+
+	devs = g_slist_copy(session->usb_devs);
+	for (l = devs; l; l = l->next) {
+		dev = l->data;
+		if (!g_slist_find(session->usb_devs, dev))
+			continue;
+		if (!dev->cb(fd, revents, dev->sdi))
+			usb_source_remove(session->usb_ctx, dev->sdi);
+	}
+	g_slist_free(devs);
+
+	return TRUE;
+}
+
+/* Replace the USB sources by libusb's current poll descriptors. */
+static int usb_sources_update(void)
+{
+	const struct libusb_pollfd **lupfd;
+	GPollFD p;
+	unsigned int i;
+	int ret;
+
+	for (i = session->num_sources; i > 0; i--)
+		if (session->sources[i - 1].usb)
+			_sr_session_source_remove(session->sources[i - 1].poll_object);
+
+	if (!(lupfd = libusb_get_pollfds(session->usb_ctx->libusb_ctx))) {
+		sr_err("%s: libusb has no poll descriptors", __func__);
+		return SR_ERR;
+	}
+
+	ret = SR_OK;
+	for (i = 0; lupfd[i] && ret == SR_OK; i++) {
+		p.fd = lupfd[i]->fd;
+		p.events = lupfd[i]->events;
+		ret = _sr_session_source_add(&p, session->usb_timeout,
+				usb_sources_dispatch, NULL,
+				(gintptr)lupfd[i]->fd, TRUE);
+	}
+	free(lupfd);
+
+	return ret;
+}
+
+/*
+ * Milliseconds until the next libusb transfer timeout, or -1 if there is
+ * none or libusb handles its timeouts through a poll descriptor.
+ */
+static int usb_next_timeout(void)
+{
+	libusb_context *ctx;
+	struct timeval tv;
+
+	ctx = session->usb_ctx->libusb_ctx;
+	if (libusb_pollfds_handle_timeouts(ctx) ||
+	    libusb_get_next_timeout(ctx, &tv) != 1)
+		return -1;
+
+	return tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000;
+}
+#endif
+
 /**
  * Call every device in the session's callback.
  *
@@ -302,12 +563,49 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
 static int sr_session_iteration(gboolean block)
 {
 	unsigned int i;
-	int ret;
+	int ret, timeout, usb_timeout;
+	gboolean timed_out, usb_due;
+
+	timeout = block ? session->source_timeout : 0;
+	usb_timeout = -1;
+#ifdef HAVE_LIBUSB_1_0
+	if (session->usb_devs) {
+		if (g_atomic_int_compare_and_exchange(&session->usb_changed,
+						      TRUE, FALSE))
+			usb_sources_update();
+		if (g_atomic_int_get(&session->usb_wakeup))
+			timeout = 0;
+		else if ((usb_timeout = usb_next_timeout()) >= 0 &&
+			 (timeout < 0 || usb_timeout < timeout))
+			timeout = usb_timeout;
+	}
+#endif
+
+	ret = g_poll(session->pollfds, session->num_sources, timeout);
+	timed_out = ret == 0 && timeout == session->source_timeout;
+
+	/*
+	 * The USB callbacks handle the events of all of libusb's poll
+	 * descriptors at once, so they run once for all of them.
+	 */
+	usb_due = g_atomic_int_compare_and_exchange(&session->usb_wakeup,
+						    TRUE, FALSE) ||
+		(ret == 0 && usb_timeout >= 0 && timeout == usb_timeout);
+	for (i = 0; i < session->num_sources; i++)
+		if (session->sources[i].usb &&
+		    (session->pollfds[i].revents > 0 || (timed_out &&
+		     session->source_timeout == session->sources[i].timeout)))
+			usb_due = TRUE;
 
-	ret = g_poll(session->pollfds, session->num_sources,
-			block ? session->source_timeout : 0);
 	for (i = 0; i < session->num_sources; i++) {
-		if (session->pollfds[i].revents > 0 || (ret == 0
+		if (session->sources[i].usb) {
+			if (usb_due) {
+				usb_due = FALSE;
+				session->sources[i].cb(session->pollfds[i].fd,
+						session->pollfds[i].revents,
+						session->sources[i].cb_data);
+			}
+		} else if (session->pollfds[i].revents > 0 || (timed_out
 			&& session->source_timeout == session->sources[i].timeout)) {
 			/*
 			 * Invoke the source's callback on an event,
@@ -386,6 +684,9 @@ SR_API int sr_session_start(void)
  */
 SR_API int sr_session_run(void)
 {
+	struct sr_datafeed_subscription *cb_struct;
+	GSList *l;
+
 	if (!session) {
 		sr_err("%s: session was NULL; a session must be "
 		       "created first, before running it.", __func__);
@@ -414,6 +715,12 @@ SR_API int sr_session_run(void)
 			sr_session_iteration(TRUE);
 	}
 
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->sub)
+			bus_subscriber_flush(cb_struct->sub);
+	}
+
 	return SR_OK;
 }
 
@@ -449,6 +756,9 @@ SR_PRIV int sr_session_stop_sync(void)
 	}
         session->running = FALSE;
 
+	/* Let the USB callback see the stop without waiting for an event. */
+	g_atomic_int_set(&session->usb_wakeup, TRUE);
+
 	return SR_OK;
 }
 
@@ -476,6 +786,12 @@ SR_API int sr_session_stop(void)
 	session->abort_session = TRUE;
 //	g_mutex_unlock(&session->stop_mutex);
 
+#ifdef USB_INTERRUPT
+	/* The session thread may be sleeping on libusb's poll descriptors. */
+	if (session->usb_ctx)
+		libusb_interrupt_event_handler(session->usb_ctx->libusb_ctx);
+#endif
+
 	return SR_OK;
 }
 
@@ -546,7 +862,10 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 			    const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
-	struct datafeed_callback *cb_struct;
+	struct sr_datafeed_subscription *cb_struct;
+	struct bus_packet *shared;
+	gboolean copied, timed;
+	int64_t start;
 
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
@@ -558,12 +877,38 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_ARG;
 	}
 
+	/* The end of a capture may wait for the frontend to save it. */
+	timed = packet->type == SR_DF_LOGIC || packet->type == SR_DF_DSO ||
+		packet->type == SR_DF_ANALOG;
+	start = timed ? g_get_monotonic_time() : 0;
+
+	shared = NULL;
+	copied = FALSE;
 	for (l = session->datafeed_callbacks; l; l = l->next) {
 		if (sr_log_loglevel_get() >= SR_LOG_DBG)
 			datafeed_dump(packet);
 		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+		if (cb_struct->sdi && cb_struct->sdi != sdi)
+			continue;
+		if (!cb_struct->sub) {
+			cb_struct->cb(sdi, packet, cb_struct->cb_data);
+			continue;
+		}
+		/* One copy for all subscribers. */
+		if (!copied) {
+			shared = bus_packet_new(sdi, packet);
+			copied = TRUE;
+		}
+		if (shared)
+			bus_subscriber_push(cb_struct->sub, shared);
+		else
+			bus_subscriber_call(cb_struct->sub, sdi, packet);
 	}
+	bus_packet_unref(shared);
+
+	if (timed)
+		sr_metric_observe(SR_METRIC_SESSION_SEND,
+				  g_get_monotonic_time() - start);
 
 	return SR_OK;
 }
@@ -576,12 +921,14 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
  * @param cb Callback function to add. Must not be NULL.
  * @param cb_data Data for the callback function. Can be NULL.
  * @param poll_object TODO.
+ * @param usb TRUE for one of libusb's poll descriptors.
  *
  * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or
  *         SR_ERR_MALLOC upon memory allocation errors.
  */
 static int _sr_session_source_add(GPollFD *pollfd, int timeout,
-    sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi, gintptr poll_object)
+	sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi,
+	gintptr poll_object, gboolean usb)
 {
 	struct source *new_sources, *s;
 	GPollFD *new_pollfds;
@@ -613,6 +960,7 @@ static int _sr_session_source_add(GPollFD *pollfd, int timeout,
 	s->cb = cb;
 	s->cb_data = sdi;
 	s->poll_object = poll_object;
+	s->usb = usb;
 	session->pollfds = new_pollfds;
 	session->sources = new_sources;
 
@@ -643,7 +991,7 @@ SR_API int sr_session_source_add(int fd, int events, int timeout,
 	p.fd = fd;
 	p.events = events;
 
-    return _sr_session_source_add(&p, timeout, cb, sdi, (gintptr)fd);
+    return _sr_session_source_add(&p, timeout, cb, sdi, (gintptr)fd, FALSE);
 }
 
 /**
@@ -661,7 +1009,7 @@ SR_API int sr_session_source_add_pollfd(GPollFD *pollfd, int timeout,
 		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi)
 {
     return _sr_session_source_add(pollfd, timeout, cb,
-                      sdi, (gintptr)pollfd);
+                      sdi, (gintptr)pollfd, FALSE);
 }
 
 /**
@@ -688,7 +1036,7 @@ SR_API int sr_session_source_add_channel(GIOChannel *channel, int events,
 	p.events = events;
 #endif
 
-    return _sr_session_source_add(&p, timeout, cb, sdi, (gintptr)channel);
+    return _sr_session_source_add(&p, timeout, cb, sdi, (gintptr)channel, FALSE);
 }
 
 /**
@@ -791,4 +1139,147 @@ SR_API int sr_session_source_remove_channel(GIOChannel *channel)
 	return _sr_session_source_remove((gintptr)channel);
 }
 
+#ifdef HAVE_LIBUSB_1_0
+static void usb_pollfd_added(int fd, short events, void *user_data)
+{
+	(void)fd;
+	(void)events;
+	(void)user_data;
+
+	g_atomic_int_set(&session->usb_changed, TRUE);
+}
+
+static void usb_pollfd_removed(int fd, void *user_data)
+{
+	(void)fd;
+	(void)user_data;
+
+	g_atomic_int_set(&session->usb_changed, TRUE);
+}
+
+static struct usb_source_dev *usb_source_find(const struct sr_dev_inst *sdi)
+{
+	GSList *l;
+
+	for (l = session->usb_devs; l; l = l->next)
+		if (((struct usb_source_dev *)l->data)->sdi == sdi)
+			return l->data;
+
+	return NULL;
+}
+
+/**
+ * Add an event source for libusb.
+ *
+ * The source polls all of libusb's file descriptors and follows libusb
+ * adding or removing some. It is shared by the devices of a session,
+ * each device adds its callback once and removes it again with
+ * usb_source_remove(). The callbacks run once when any descriptor is
+ * ready, a transfer timeout expires or the session is being stopped, and
+ * are expected to handle the pending libusb events without blocking.
+ *
+ * @param ctx The libsigrok context holding the libusb context.
+ * @param timeout Max time to wait before the callback is called, ignored if 0.
+ * @param cb Callback function to add. Must not be NULL.
+ * @param sdi Data for the callback function.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_BUG if the device has a USB source already or another
+ *         libusb context is polled, SR_ERR if libusb can not be polled,
+ *         or SR_ERR_MALLOC upon memory allocation errors.
+ *
+ * @private
+ */
+SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
+		sr_receive_data_callback_t cb, const struct sr_dev_inst *sdi)
+{
+	struct usb_source_dev *dev;
+	int ret;
+
+	if (!cb) {
+		sr_err("%s: cb was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (usb_source_find(sdi)) {
+		sr_err("%s: the device has a USB source already", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (session->usb_devs && session->usb_ctx != ctx) {
+		sr_err("%s: another libusb context is polled", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!(dev = g_try_malloc0(sizeof(struct usb_source_dev)))) {
+		sr_err("%s: dev malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+	dev->cb = cb;
+	dev->sdi = sdi;
+
+#ifdef USB_STOP_TIMEOUT
+	if (timeout <= 0 || timeout > USB_STOP_TIMEOUT)
+		timeout = USB_STOP_TIMEOUT;
+#endif
+
+	if (!session->usb_devs) {
+		session->usb_ctx = ctx;
+		session->usb_timeout = timeout;
+		g_atomic_int_set(&session->usb_changed, FALSE);
+		g_atomic_int_set(&session->usb_wakeup, FALSE);
+		libusb_set_pollfd_notifiers(ctx->libusb_ctx, usb_pollfd_added,
+				usb_pollfd_removed, NULL);
+	} else if (timeout > 0 && (session->usb_timeout <= 0 ||
+				   timeout < session->usb_timeout)) {
+		session->usb_timeout = timeout;
+	}
+	session->usb_devs = g_slist_append(session->usb_devs, dev);
+
+	if (timeout != session->source_timeout && timeout > 0
+	    && (session->source_timeout == -1 || timeout < session->source_timeout))
+		session->source_timeout = timeout;
+
+	if ((ret = usb_sources_update()) != SR_OK)
+		usb_source_remove(ctx, sdi);
+
+	return ret;
+}
+
+/**
+ * Remove the callback of a device from the event source for libusb. The
+ * source itself goes with the callback of the last device.
+ *
+ * @param ctx The libsigrok context holding the libusb context.
+ * @param sdi The device whose callback is removed.
+ *
+ * @return SR_OK upon success.
+ *
+ * @private
+ */
+SR_PRIV int usb_source_remove(struct sr_context *ctx,
+		const struct sr_dev_inst *sdi)
+{
+	struct usb_source_dev *dev;
+	unsigned int i;
+
+	if (!(dev = usb_source_find(sdi)))
+		return SR_OK;
+	session->usb_devs = g_slist_remove(session->usb_devs, dev);
+	g_free(dev);
+	if (session->usb_devs)
+		return SR_OK;
+
+	libusb_set_pollfd_notifiers(ctx->libusb_ctx, NULL, NULL, NULL);
+
+	for (i = session->num_sources; i > 0; i--)
+		if (session->sources[i - 1].usb)
+			_sr_session_source_remove(session->sources[i - 1].poll_object);
+
+	session->usb_ctx = NULL;
+
+	return SR_OK;
+}
+#endif
+
 /** @} */
@@ -0,0 +1,398 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+/* Message logging helpers with subsystem-specific prefix string. */
+#define LOG_PREFIX "session-bus: "
+#define sr_log(l, s, args...) sr_log(l, LOG_PREFIX s, ## args)
+#define sr_spew(s, args...) sr_spew(LOG_PREFIX s, ## args)
+#define sr_dbg(s, args...) sr_dbg(LOG_PREFIX s, ## args)
+#define sr_info(s, args...) sr_info(LOG_PREFIX s, ## args)
+#define sr_warn(s, args...) sr_warn(LOG_PREFIX s, ## args)
+#define sr_err(s, args...) sr_err(LOG_PREFIX s, ## args)
+
+/**
+ * @file
+ *
+ * Datafeed subscribers with their own queue and thread.
+ *
+ * sr_session_send() copies a packet once into a reference counted
+ * bus_packet which all subscribers share, pushes it to their queues and
+ * returns, so a slow subscriber doesn't hold up the driver until its
+ * queue is full. What happens then is the subscriber's policy.
+ *
+ * Logic samples are copied, samples in files are shared by taking a
+ * reference to the file map or blocks. DSO and analog packets don't say
+ * how large their samples are, they are handed to the subscriber from the
+ * sending thread once it has taken all packets queued before them.
+ */
+
+/* The largest logic packet SR_BUS_COALESCE makes, in bytes. */
+#define COALESCE_MAX_LENGTH (16 * 1024 * 1024)
+
+struct bus_packet {
+	gint refcount;
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	union {
+		struct sr_datafeed_header header;
+		struct sr_datafeed_meta meta;
+		struct ds_trigger_pos trigger;
+		struct sr_datafeed_logic logic;
+		struct sr_datafeed_logic_map logic_map;
+		struct sr_datafeed_logic_blocks logic_blocks;
+		struct sr_datafeed_analog_pcm analog_pcm;
+	} payload;
+	/* The size of payload.logic.data. */
+	uint64_t capacity;
+};
+
+struct bus_subscriber {
+	sr_datafeed_callback_t cb;
+	void *cb_data;
+	unsigned int queue_size;
+	int policy;
+
+	/* The lock and the condition cover everything below. */
+	GMutex mutex;
+	GCond cond;
+	GQueue queue;
+	/* The callback is running, from either thread. */
+	gboolean busy;
+	gboolean stop;
+	GThread *thread;
+};
+
+static struct bus_packet *logic_packet_new(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_logic *logic, uint64_t capacity)
+{
+	struct bus_packet *p;
+
+	if (!(p = g_try_malloc0(sizeof(struct bus_packet))))
+		return NULL;
+	p->payload.logic = *logic;
+	if (!(p->payload.logic.data = g_try_malloc(MAX(capacity, 1)))) {
+		g_free(p);
+		return NULL;
+	}
+	memcpy(p->payload.logic.data, logic->data, logic->length);
+	p->capacity = capacity;
+	p->refcount = 1;
+	p->sdi = sdi;
+	p->packet.type = SR_DF_LOGIC;
+	p->packet.payload = &p->payload.logic;
+
+	return p;
+}
+
+/**
+ * Copy a packet for the subscribers to share.
+ *
+ * @return The copy with one reference, NULL if the packet can't be copied
+ *         and has to be handed to the subscribers by bus_subscriber_call().
+ */
+SR_PRIV struct bus_packet *bus_packet_new(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct bus_packet *p;
+	const struct sr_config *src;
+	struct sr_config *cfg;
+	GSList *l;
+
+	if (packet->type == SR_DF_LOGIC)
+		return logic_packet_new(sdi, packet->payload,
+			((const struct sr_datafeed_logic *)packet->payload)->length);
+
+	if (packet->type == SR_DF_DSO || packet->type == SR_DF_ANALOG)
+		return NULL;
+
+	if (!(p = g_try_malloc0(sizeof(struct bus_packet))))
+		return NULL;
+	p->refcount = 1;
+	p->sdi = sdi;
+	p->packet.type = packet->type;
+	p->packet.payload = packet->payload ? &p->payload : NULL;
+	if (!packet->payload)
+		return p;
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		p->payload.header = *(const struct sr_datafeed_header *)packet->payload;
+		break;
+	case SR_DF_META:
+		l = ((const struct sr_datafeed_meta *)packet->payload)->config;
+		for (; l; l = l->next) {
+			src = l->data;
+			if ((cfg = sr_config_new(src->key, src->data)))
+				p->payload.meta.config = g_slist_append(
+					p->payload.meta.config, cfg);
+		}
+		break;
+	case SR_DF_TRIGGER:
+		p->payload.trigger = *(const struct ds_trigger_pos *)packet->payload;
+		break;
+	case SR_DF_LOGIC_MAP:
+		p->payload.logic_map = *(const struct sr_datafeed_logic_map *)packet->payload;
+		sr_file_map_ref(p->payload.logic_map.map);
+		break;
+	case SR_DF_LOGIC_BLOCKS:
+		p->payload.logic_blocks = *(const struct sr_datafeed_logic_blocks *)packet->payload;
+		sr_session_blocks_ref(p->payload.logic_blocks.blocks);
+		break;
+	case SR_DF_ANALOG_PCM:
+		p->payload.analog_pcm = *(const struct sr_datafeed_analog_pcm *)packet->payload;
+		p->payload.analog_pcm.probes = g_slist_copy(p->payload.analog_pcm.probes);
+		sr_file_map_ref(p->payload.analog_pcm.map);
+		break;
+	default:
+		/* Nobody knows what the payload is. */
+		g_free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+SR_PRIV void bus_packet_unref(struct bus_packet *p)
+{
+	if (!p || !g_atomic_int_dec_and_test(&p->refcount))
+		return;
+
+	if (p->packet.payload) {
+		switch (p->packet.type) {
+		case SR_DF_LOGIC:
+			g_free(p->payload.logic.data);
+			break;
+		case SR_DF_META:
+			g_slist_free_full(p->payload.meta.config,
+				(GDestroyNotify)sr_config_free);
+			break;
+		case SR_DF_LOGIC_MAP:
+			sr_file_map_unref(p->payload.logic_map.map);
+			break;
+		case SR_DF_LOGIC_BLOCKS:
+			sr_session_blocks_unref(p->payload.logic_blocks.blocks);
+			break;
+		case SR_DF_ANALOG_PCM:
+			g_slist_free(p->payload.analog_pcm.probes);
+			sr_file_map_unref(p->payload.analog_pcm.map);
+			break;
+		}
+	}
+	g_free(p);
+}
+
+/*
+ * Append a logic packet to the last one in the queue, which is copied
+ * first if another subscriber shares it. Called with the lock held.
+ */
+static gboolean coalesce(struct bus_subscriber *sub, struct bus_packet *p)
+{
+	struct bus_packet *last, *merged;
+	struct sr_datafeed_logic *logic;
+	uint64_t length;
+	void *data;
+
+	if (p->packet.type != SR_DF_LOGIC ||
+	    !(last = g_queue_peek_tail(&sub->queue)) ||
+	    last->packet.type != SR_DF_LOGIC ||
+	    last->payload.logic.unitsize != p->payload.logic.unitsize)
+		return FALSE;
+
+	length = last->payload.logic.length + p->payload.logic.length;
+	if (length > COALESCE_MAX_LENGTH)
+		return FALSE;
+
+	if (g_atomic_int_get(&last->refcount) > 1) {
+		if (!(merged = logic_packet_new(last->sdi, &last->payload.logic,
+						MAX(length, last->capacity))))
+			return FALSE;
+		g_queue_pop_tail(&sub->queue);
+		g_queue_push_tail(&sub->queue, merged);
+		bus_packet_unref(last);
+		last = merged;
+	} else if (length > last->capacity) {
+		if (!(data = g_try_realloc(last->payload.logic.data,
+					   MAX(length, 2 * last->capacity))))
+			return FALSE;
+		last->payload.logic.data = data;
+		last->capacity = MAX(length, 2 * last->capacity);
+	}
+
+	logic = &last->payload.logic;
+	memcpy((uint8_t *)logic->data + logic->length, p->payload.logic.data,
+	       p->payload.logic.length);
+	logic->length = length;
+	logic->data_error |= p->payload.logic.data_error;
+
+	return TRUE;
+}
+
+static gpointer subscriber_thread(gpointer data)
+{
+	struct bus_subscriber *sub;
+	struct bus_packet *p;
+
+	sub = data;
+	g_mutex_lock(&sub->mutex);
+	while (TRUE) {
+		while ((g_queue_is_empty(&sub->queue) && !sub->stop) ||
+		       sub->busy)
+			g_cond_wait(&sub->cond, &sub->mutex);
+		if (!(p = g_queue_pop_head(&sub->queue)))
+			break;
+		sub->busy = TRUE;
+		g_cond_broadcast(&sub->cond);
+		g_mutex_unlock(&sub->mutex);
+
+		sub->cb(p->sdi, &p->packet, sub->cb_data);
+		bus_packet_unref(p);
+
+		g_mutex_lock(&sub->mutex);
+		sub->busy = FALSE;
+		g_cond_broadcast(&sub->cond);
+	}
+	g_mutex_unlock(&sub->mutex);
+
+	return NULL;
+}
+
+/**
+ * Start a subscriber thread.
+ *
+ * @param queue_size The number of packets it may be behind, at least 1.
+ * @param policy One of SR_BUS_*.
+ */
+SR_PRIV struct bus_subscriber *bus_subscriber_new(sr_datafeed_callback_t cb,
+		void *cb_data, unsigned int queue_size, int policy)
+{
+	struct bus_subscriber *sub;
+	GError *error = NULL;
+
+	if (!(sub = g_try_malloc0(sizeof(struct bus_subscriber))))
+		return NULL;
+	sub->cb = cb;
+	sub->cb_data = cb_data;
+	sub->queue_size = MAX(queue_size, 1);
+	sub->policy = policy;
+	g_mutex_init(&sub->mutex);
+	g_cond_init(&sub->cond);
+	g_queue_init(&sub->queue);
+
+	if (!(sub->thread = g_thread_try_new("datafeed", subscriber_thread,
+					     sub, &error))) {
+		sr_err("Failed to start a subscriber thread: %s.",
+		       error->message);
+		g_error_free(error);
+		g_mutex_clear(&sub->mutex);
+		g_cond_clear(&sub->cond);
+		g_free(sub);
+		return NULL;
+	}
+
+	return sub;
+}
+
+/* Let the subscriber take what is queued, then stop its thread. */
+SR_PRIV void bus_subscriber_free(struct bus_subscriber *sub)
+{
+	if (!sub)
+		return;
+
+	g_mutex_lock(&sub->mutex);
+	sub->stop = TRUE;
+	g_cond_broadcast(&sub->cond);
+	g_mutex_unlock(&sub->mutex);
+	g_thread_join(sub->thread);
+
+	g_mutex_clear(&sub->mutex);
+	g_cond_clear(&sub->cond);
+	g_free(sub);
+}
+
+/**
+ * Queue a packet for a subscriber, which takes a reference to it.
+ * When the queue is full, the subscriber's policy applies.
+ */
+SR_PRIV void bus_subscriber_push(struct bus_subscriber *sub,
+		struct bus_packet *p)
+{
+	int64_t start;
+
+	g_mutex_lock(&sub->mutex);
+	if (g_queue_get_length(&sub->queue) >= sub->queue_size) {
+		if (sub->policy == SR_BUS_DROP && p->packet.type == SR_DF_LOGIC) {
+			g_mutex_unlock(&sub->mutex);
+			sr_metric_add(SR_METRIC_BUS_DROPPED, 1);
+			return;
+		}
+		if (sub->policy == SR_BUS_COALESCE && coalesce(sub, p)) {
+			g_mutex_unlock(&sub->mutex);
+			sr_metric_add(SR_METRIC_BUS_COALESCED, 1);
+			return;
+		}
+
+		start = g_get_monotonic_time();
+		while (g_queue_get_length(&sub->queue) >= sub->queue_size)
+			g_cond_wait(&sub->cond, &sub->mutex);
+		sr_metric_observe(SR_METRIC_BUS_WAIT,
+				  g_get_monotonic_time() - start);
+	}
+
+	g_atomic_int_inc(&p->refcount);
+	g_queue_push_tail(&sub->queue, p);
+	g_cond_broadcast(&sub->cond);
+	g_mutex_unlock(&sub->mutex);
+}
+
+/**
+ * Hand a packet which bus_packet_new() can't copy to a subscriber, from
+ * the calling thread, in order with the queued ones.
+ */
+SR_PRIV void bus_subscriber_call(struct bus_subscriber *sub,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	g_mutex_lock(&sub->mutex);
+	while (!g_queue_is_empty(&sub->queue) || sub->busy)
+		g_cond_wait(&sub->cond, &sub->mutex);
+	sub->busy = TRUE;
+	g_mutex_unlock(&sub->mutex);
+
+	sub->cb(sdi, packet, sub->cb_data);
+
+	g_mutex_lock(&sub->mutex);
+	sub->busy = FALSE;
+	g_cond_broadcast(&sub->cond);
+	g_mutex_unlock(&sub->mutex);
+}
+
+/* Wait until the subscriber has taken all queued packets. */
+SR_PRIV void bus_subscriber_flush(struct bus_subscriber *sub)
+{
+	g_mutex_lock(&sub->mutex);
+	while (!g_queue_is_empty(&sub->queue) || sub->busy)
+		g_cond_wait(&sub->cond, &sub->mutex);
+	g_mutex_unlock(&sub->mutex);
+}
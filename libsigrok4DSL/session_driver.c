@@ -22,6 +22,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <stdio.h>
+#include <string.h>
 #include <zip.h>
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
@@ -46,8 +48,11 @@ static uint64_t samplecounts[1];
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
+	int container;
 	struct zip *archive;
 	struct zip_file *capfile;
+	struct sr_file_map *map;
+	struct sr_session_blocks *blocks;
     void *buf;
 	int bytes_read;
 	uint64_t samplerate;
@@ -62,6 +67,7 @@ static GSList *dev_insts = NULL;
 static const int hwcaps[] = {
 	SR_CONF_CAPTUREFILE,
 	SR_CONF_CAPTURE_UNITSIZE,
+	SR_CONF_CAPTURE_CONTAINER,
 	0,
 };
 
@@ -71,6 +77,8 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
 	struct session_vdev *vdev;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_map logic_map;
+	struct sr_datafeed_logic_blocks logic_blocks;
     struct sr_datafeed_dso dso;
     struct sr_datafeed_analog analog;
 	GSList *l;
@@ -88,6 +96,38 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
 			/* already done with this instance */
 			continue;
 
+		if (vdev->map) {
+			/* The whole capture in one packet, used in place */
+			got_data = TRUE;
+			packet.type = SR_DF_LOGIC_MAP;
+			packet.payload = &logic_map;
+			logic_map.unitsize = vdev->unitsize;
+			logic_map.map = vdev->map;
+			vdev->bytes_read += vdev->map->length;
+			sr_session_send(cb_sdi, &packet);
+			sr_file_map_unref(vdev->map);
+			vdev->map = NULL;
+			continue;
+		}
+
+		if (vdev->blocks) {
+			/* The receiver reads the blocks it needs */
+			got_data = TRUE;
+			packet.type = SR_DF_LOGIC_BLOCKS;
+			packet.payload = &logic_blocks;
+			logic_blocks.unitsize = vdev->blocks->unitsize;
+			logic_blocks.blocks = vdev->blocks;
+			vdev->bytes_read += vdev->blocks->total_samples *
+				vdev->blocks->unitsize;
+			sr_session_send(cb_sdi, &packet);
+			sr_session_blocks_unref(vdev->blocks);
+			vdev->blocks = NULL;
+			continue;
+		}
+
+		if (!vdev->capfile)
+			continue;
+
         ret = zip_fread(vdev->capfile, vdev->buf, CHUNKSIZE);
 		if (ret > 0) {
 			got_data = TRUE;
@@ -114,6 +154,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
                 packet.payload = &logic;
                 logic.length = ret;
                 logic.unitsize = vdev->unitsize;
+                logic.data_error = 0;
                 logic.data = vdev->buf;
             }
 			vdev->bytes_read += ret;
@@ -121,6 +162,7 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
 		} else {
 			/* done with this capture file */
 			zip_fclose(vdev->capfile);
+			vdev->capfile = NULL;
             //g_free(vdev->capturefile);
             //g_free(vdev);
             //sdi->priv = NULL;
@@ -136,6 +178,90 @@ static int receive_data(int fd, int revents, const struct sr_dev_inst *cb_sdi)
 	return TRUE;
 }
 
+static uint16_t read_le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t read_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Find where the data of a stored archive entry starts in the file.
+ * libzip does not tell, so the central directory is read directly.
+ * Zip64 archives are not handled, they are read through libzip.
+ */
+static int stored_entry_offset(const char *sessionfile,
+		const char *name, uint64_t *offset)
+{
+	/* End of central directory record with the longest comment */
+	const long max_tail_size = 22 + 0xffff;
+	uint8_t header[30];
+	uint8_t *tail, *dir, *p, *end;
+	uint32_t dir_size, dir_offset, local;
+	long file_size, tail_size, i;
+	size_t name_len;
+	FILE *file;
+	int ret;
+
+	if (!(file = fopen(sessionfile, "rb")))
+		return SR_ERR;
+
+	ret = SR_ERR;
+	tail = dir = NULL;
+	if (fseek(file, 0, SEEK_END) != 0 || (file_size = ftell(file)) < 22)
+		goto done;
+	tail_size = MIN(file_size, max_tail_size);
+	if (!(tail = g_try_malloc(tail_size)) ||
+	    fseek(file, file_size - tail_size, SEEK_SET) != 0 ||
+	    fread(tail, 1, tail_size, file) != (size_t)tail_size)
+		goto done;
+
+	for (i = tail_size - 22; i >= 0; i--)
+		if (read_le32(tail + i) == 0x06054b50)
+			break;
+	if (i < 0)
+		goto done;
+
+	dir_size = read_le32(tail + i + 12);
+	dir_offset = read_le32(tail + i + 16);
+	if (dir_size == 0xffffffff || dir_offset == 0xffffffff ||
+	    (uint64_t)dir_offset + dir_size > (uint64_t)file_size ||
+	    !(dir = g_try_malloc(dir_size)))
+		goto done;
+	if (fseek(file, dir_offset, SEEK_SET) != 0 ||
+	    fread(dir, 1, dir_size, file) != dir_size)
+		goto done;
+
+	name_len = strlen(name);
+	end = dir + dir_size;
+	for (p = dir; p + 46 <= end && read_le32(p) == 0x02014b50;
+	     p += 46 + read_le16(p + 28) + read_le16(p + 30) + read_le16(p + 32)) {
+		if (read_le16(p + 28) != name_len || p + 46 + name_len > end ||
+		    memcmp(p + 46, name, name_len) != 0)
+			continue;
+
+		local = read_le32(p + 42);
+		if (local == 0xffffffff || fseek(file, local, SEEK_SET) != 0 ||
+		    fread(header, 1, sizeof(header), file) != sizeof(header) ||
+		    read_le32(header) != 0x04034b50)
+			break;
+
+		*offset = (uint64_t)local + sizeof(header) +
+			read_le16(header + 26) + read_le16(header + 28);
+		ret = SR_OK;
+		break;
+	}
+
+done:
+	g_free(tail);
+	g_free(dir);
+	fclose(file);
+
+	return ret;
+}
+
 /* driver callbacks */
 static int dev_clear(void);
 
@@ -167,6 +293,8 @@ static int dev_open(struct sr_dev_inst *sdi)
 
     struct session_vdev *vdev;
     vdev = sdi->priv;
+    /* Files without a container revision hold a single entry */
+    vdev->container = SR_SESSION_CONTAINER_ENTRY;
     if (!(vdev->buf = g_try_malloc(CHUNKSIZE))) {
         sr_err("%s: vdev->buf malloc failed", __func__);
         return SR_ERR_MALLOC;
@@ -180,6 +308,8 @@ static int dev_open(struct sr_dev_inst *sdi)
 static int dev_close(struct sr_dev_inst *sdi)
 {
     const struct session_vdev *const vdev = sdi->priv;
+    sr_file_map_unref(vdev->map);
+    sr_session_blocks_unref(vdev->blocks);
     g_free(vdev->sessionfile);
     g_free(vdev->capturefile);
     g_free(vdev->buf);
@@ -294,6 +424,9 @@ static int config_set(int id, GVariant *data, const struct sr_dev_inst *sdi,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		vdev->unitsize = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_CAPTURE_CONTAINER:
+		vdev->container = g_variant_get_uint64(data);
+		break;
     case SR_CONF_LIMIT_SAMPLES:
         vdev->total_samples = g_variant_get_uint64(data);
         samplecounts[0] = vdev->total_samples;
@@ -407,6 +540,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 {
 	struct zip_stat zs;
 	struct session_vdev *vdev;
+	uint64_t offset;
 	int ret;
 
 	vdev = sdi->priv;
@@ -414,6 +548,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
+	/* Logic captures saved as blocks are handed over as a whole and
+	 * only decompressed where they are looked at. */
+	if (vdev->container == SR_SESSION_CONTAINER_BLOCKS) {
+		if (sdi->mode != LOGIC || sr_session_blocks_open(vdev->sessionfile,
+			vdev->capturefile, &vdev->blocks) != SR_OK) {
+			sr_err("Failed to open the blocks of '%s' in session "
+			       "file '%s'.", vdev->capturefile, vdev->sessionfile);
+			return SR_ERR;
+		}
+		std_session_send_df_header(sdi, LOG_PREFIX);
+		sr_session_source_add(-1, 0, 0, receive_data, sdi);
+		return SR_OK;
+	}
+
 	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
 		sr_err("Failed to open session file '%s': "
 		       "zip error %d\n", vdev->sessionfile, ret);
@@ -426,7 +574,17 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 		return SR_ERR;
 	}
 
-	if (!(vdev->capfile = zip_fopen(vdev->archive, vdev->capturefile, 0))) {
+	/* Uncompressed logic captures are mapped and used in place,
+	 * everything else is streamed through libzip. */
+	if (sdi->mode == LOGIC && zs.comp_method == ZIP_CM_STORE &&
+	    zs.encryption_method == ZIP_EM_NONE && zs.size > 0 &&
+	    stored_entry_offset(vdev->sessionfile, vdev->capturefile,
+				&offset) == SR_OK &&
+	    sr_file_map_new(vdev->sessionfile, offset, zs.size,
+			    &vdev->map) == SR_OK) {
+		sr_info("Mapped %" PRIu64 " bytes of capture file '%s'.",
+			(uint64_t)zs.size, vdev->capturefile);
+	} else if (!(vdev->capfile = zip_fopen(vdev->archive, vdev->capturefile, 0))) {
 		sr_err("Failed to open capture file '%s' in "
 		       "session file '%s'.", vdev->capturefile, vdev->sessionfile);
 		return SR_ERR;
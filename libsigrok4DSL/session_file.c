@@ -17,13 +17,17 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <zip.h>
+#include <zlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include "config.h" /* Needed for PACKAGE_VERSION and others. */
@@ -54,6 +58,74 @@
 extern struct sr_session *session;
 extern SR_PRIV struct sr_dev_driver session_driver;
 
+/* Samples per block of a logic capture, see struct sr_session_writer. */
+#define SESSION_BLOCK_SAMPLES (1024 * 1024)
+
+/* Fixed fields at the start of the block index entry. */
+#define SESSION_INDEX_HEADER_SIZE 24
+
+static void write_le64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+static uint64_t read_le64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t load_sample(const uint8_t *p, int unitsize)
+{
+    uint64_t v = 0;
+    int i;
+
+    for (i = unitsize - 1; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void store_sample(uint8_t *p, uint64_t v, int unitsize)
+{
+    int i;
+
+    for (i = 0; i < unitsize; i++)
+        p[i] = v >> (8 * i);
+}
+
+static int read_entry(struct zip *archive, const char *name,
+        uint8_t **buf, uint64_t *size)
+{
+    struct zip_stat zs;
+    struct zip_file *zf;
+
+    if (zip_stat(archive, name, 0, &zs) == -1)
+        return SR_ERR_NA;
+
+    if (!(*buf = g_try_malloc(MAX(zs.size, 1))))
+        return SR_ERR_MALLOC;
+
+    if (!(zf = zip_fopen_index(archive, zs.index, 0)) ||
+        zip_fread(zf, *buf, zs.size) != (zip_int64_t)zs.size) {
+        if (zf)
+            zip_fclose(zf);
+        g_free(*buf);
+        *buf = NULL;
+        return SR_ERR;
+    }
+    zip_fclose(zf);
+    *size = zs.size;
+
+    return SR_OK;
+}
+
 /** @private */
 SR_PRIV int sr_sessionfile_check(const char *filename)
 {
@@ -193,6 +265,17 @@ SR_API int sr_session_load(const char *filename)
 					sdi->driver->config_set(SR_CONF_CAPTUREFILE,
                             g_variant_new_bytestring(val), sdi, NULL, NULL);
 					g_ptr_array_add(capturefiles, val);
+				} else if (!strcmp(keys[j], "container")) {
+					/* The reader of the capture depends on it */
+					tmp_u64 = strtoull(val, NULL, 10);
+					if (tmp_u64 < SR_SESSION_CONTAINER_ENTRY ||
+					    tmp_u64 > SR_SESSION_CONTAINER_BLOCKS) {
+						sr_err("Cannot handle capture container "
+						       "revision %" PRIu64 ".", tmp_u64);
+						return SR_ERR;
+					}
+					sdi->driver->config_set(SR_CONF_CAPTURE_CONTAINER,
+                            g_variant_new_uint64(tmp_u64), sdi, NULL, NULL);
 				} else if (!strcmp(keys[j], "samplerate")) {
 					sr_parse_sizestring(val, &tmp_u64);
 					sdi->driver->config_set(SR_CONF_SAMPLERATE,
@@ -317,131 +400,167 @@ SR_API int sr_session_load(const char *filename)
 	return SR_OK;
 }
 
-/**
- * Save the current session to the specified file.
- *
- * @param filename The name of the filename to save the current session as.
- *                 Must not be NULL.
- * @param sdi The device instance from which the data was captured.
- * @param buf The data to be saved.
- * @param unitsize The number of bytes per sample.
- * @param units The number of samples.
- *
- * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or SR_ERR
- *         upon other errors.
+/*
+ * The "header" entry of a capture, but for its total samples, which the
+ * caller appends once they are known. The container revision tells the
+ * reader how the samples are stored.
  */
-SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
-		unsigned char *buf, int unitsize, int units)
+static GString *session_header(const struct sr_dev_inst *sdi, int unitsize,
+        int container)
 {
     GSList *l;
     GVariant *gvar;
-    FILE *meta;
+    GString *meta;
     struct sr_channel *probe;
-    struct zip *zipfile;
-    struct zip_source *versrc, *metasrc, *logicsrc;
-    int tmpfile, ret, probecnt;
-    uint64_t samplerate, timeBase, tmp_u64;
-    char rawname[16], metafile[32], *s;
+    uint64_t samplerate, timeBase;
+    char *s;
     struct sr_status status;
 
-	if (!filename) {
-		sr_err("%s: filename was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	unlink(filename);
-	if (!(zipfile = zip_open(filename, ZIP_CREATE, &ret)))
-		return SR_ERR;
-
-    /* init "metadata" */
-    strcpy(metafile, "DSView-meta-XXXXXX");
-    if ((tmpfile = g_mkstemp(metafile)) == -1)
-        return SR_ERR;
-    close(tmpfile);
-    meta = g_fopen(metafile, "wb");
-    fprintf(meta, "[version]\n");
-    fprintf(meta, "DSView version = %s\n", PACKAGE_VERSION);
+    meta = g_string_sized_new(1024);
+    g_string_append_printf(meta, "[version]\n");
+    g_string_append_printf(meta, "DSView version = %s\n", PACKAGE_VERSION);
 
     /* metadata */
-    fprintf(meta, "[header]\n");
+    g_string_append_printf(meta, "[header]\n");
     if (sdi->driver) {
-        fprintf(meta, "driver = %s\n", sdi->driver->name);
-        fprintf(meta, "device mode = %d\n", sdi->mode);
+        g_string_append_printf(meta, "driver = %s\n", sdi->driver->name);
+        g_string_append_printf(meta, "device mode = %d\n", sdi->mode);
     }
 
     /* metadata */
-    fprintf(meta, "capturefile = data\n");
-    fprintf(meta, "unitsize = %d\n", unitsize);
-    fprintf(meta, "total samples = %d\n", units);
-    fprintf(meta, "total probes = %d\n", g_slist_length(sdi->channels));
+    g_string_append_printf(meta, "capturefile = data\n");
+    g_string_append_printf(meta, "container = %d\n", container);
+    g_string_append_printf(meta, "unitsize = %d\n", unitsize);
+    g_string_append_printf(meta, "total probes = %d\n",
+        g_slist_length(sdi->channels));
     if (sr_config_get(sdi->driver, sdi, NULL, NULL, SR_CONF_SAMPLERATE,
             &gvar) == SR_OK) {
         samplerate = g_variant_get_uint64(gvar);
         s = sr_samplerate_string(samplerate);
-        fprintf(meta, "samplerate = %s\n", s);
+        g_string_append_printf(meta, "samplerate = %s\n", s);
         g_free(s);
         g_variant_unref(gvar);
     }
     if (sdi->mode == DSO &&
         sr_config_get(sdi->driver, sdi, NULL, NULL, SR_CONF_TIMEBASE, &gvar) == SR_OK) {
         timeBase = g_variant_get_uint64(gvar);
-        fprintf(meta, "hDiv = %d\n", timeBase);
+        g_string_append_printf(meta, "hDiv = %" PRIu64 "\n", timeBase);
         g_variant_unref(gvar);
     }
-    probecnt = 1;
     for (l = sdi->channels; l; l = l->next) {
         probe = l->data;
         if (probe->enabled || sdi->mode == DSO) {
             if (probe->name)
-                fprintf(meta, "probe%d = %s\n", probe->index, probe->name);
+                g_string_append_printf(meta, "probe%d = %s\n", probe->index, probe->name);
             if (probe->trigger)
-                fprintf(meta, " trigger%d = %s\n", probe->index, probe->trigger);
+                g_string_append_printf(meta, " trigger%d = %s\n", probe->index, probe->trigger);
             if (sdi->mode == DSO) {
-                fprintf(meta, " enable%d = %d\n", probe->index, probe->enabled);
-                fprintf(meta, " coupling%d = %d\n", probe->index, probe->coupling);
-                fprintf(meta, " vDiv%d = %d\n", probe->index, probe->vdiv);
-                fprintf(meta, " vFactor%d = %d\n", probe->index, probe->vfactor);
-                fprintf(meta, " vPos%d = %lf\n", probe->index, probe->vpos);
+                g_string_append_printf(meta, " enable%d = %d\n", probe->index, probe->enabled);
+                g_string_append_printf(meta, " coupling%d = %d\n", probe->index, probe->coupling);
+                g_string_append_printf(meta, " vDiv%d = %d\n", probe->index, probe->vdiv);
+                g_string_append_printf(meta, " vFactor%d = %d\n", probe->index, probe->vfactor);
+                g_string_append_printf(meta, " vPos%d = %lf\n", probe->index, probe->vpos);
                 if (sr_status_get(sdi, &status, 0, 0) == SR_OK) {
                     if (probe->index == 0) {
-                        fprintf(meta, " period%d = %d\n", probe->index, status.ch0_period);
-                        fprintf(meta, " pcnt%d = %d\n", probe->index, status.ch0_pcnt);
-                        fprintf(meta, " max%d = %d\n", probe->index, status.ch0_max);
-                        fprintf(meta, " min%d = %d\n", probe->index, status.ch0_min);
+                        g_string_append_printf(meta, " period%d = %d\n", probe->index, status.ch0_period);
+                        g_string_append_printf(meta, " pcnt%d = %d\n", probe->index, status.ch0_pcnt);
+                        g_string_append_printf(meta, " max%d = %d\n", probe->index, status.ch0_max);
+                        g_string_append_printf(meta, " min%d = %d\n", probe->index, status.ch0_min);
                     } else {
-                        fprintf(meta, " period%d = %d\n", probe->index, status.ch1_period);
-                        fprintf(meta, " pcnt%d = %d\n", probe->index, status.ch1_pcnt);
-                        fprintf(meta, " max%d = %d\n", probe->index, status.ch1_max);
-                        fprintf(meta, " min%d = %d\n", probe->index, status.ch1_min);
+                        g_string_append_printf(meta, " period%d = %d\n", probe->index, status.ch1_period);
+                        g_string_append_printf(meta, " pcnt%d = %d\n", probe->index, status.ch1_pcnt);
+                        g_string_append_printf(meta, " max%d = %d\n", probe->index, status.ch1_max);
+                        g_string_append_printf(meta, " min%d = %d\n", probe->index, status.ch1_min);
                     }
                 }
             }
-            probecnt++;
         }
     }
 
+    return meta;
+}
+
+/**
+ * Save the current session to the specified file.
+ *
+ * @param filename The name of the filename to save the current session as.
+ *                 Must not be NULL.
+ * @param sdi The device instance from which the data was captured.
+ * @param buf The data to be saved.
+ * @param unitsize The number of bytes per sample.
+ * @param units The number of samples.
+ *
+ * Logic captures are saved as independently compressed blocks with an
+ * index, see sr_session_writer_new(), other captures as a single entry.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or SR_ERR
+ *         upon other errors.
+ */
+SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
+		unsigned char *buf, int unitsize, uint64_t units)
+{
+    GString *meta;
+    struct sr_session_writer *writer;
+    struct zip *zipfile;
+    struct zip_source *metasrc, *logicsrc;
+    int ret;
+
+	if (!filename) {
+		sr_err("%s: filename was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+    if (sdi->mode == LOGIC) {
+        if ((ret = sr_session_writer_new(filename, sdi, unitsize,
+                &writer)) != SR_OK)
+            return ret;
+        if ((ret = sr_session_writer_append(writer, buf, units)) != SR_OK) {
+            sr_session_writer_abort(writer);
+            return ret;
+        }
+        return sr_session_writer_finish(writer);
+    }
+
+	/* Quietly delete it first, libzip wants replace ops otherwise. */
+	unlink(filename);
+	if (!(zipfile = zip_open(filename, ZIP_CREATE, &ret)))
+		return SR_ERR;
+
+    /* libzip reads the sources in zip_close(), the buffers must stay */
+    meta = session_header(sdi, unitsize, SR_SESSION_CONTAINER_ENTRY);
+    g_string_append_printf(meta, "total samples = %" PRIu64 "\n", units);
+
+    ret = SR_ERR;
     if (!(logicsrc = zip_source_buffer(zipfile, buf,
                units * unitsize, FALSE)))
-        return SR_ERR;
-    snprintf(rawname, 15, "data");
-    if (zip_add(zipfile, rawname, logicsrc) == -1)
-        return SR_ERR;
-    fclose(meta);
+        goto done;
+    if (zip_add(zipfile, "data", logicsrc) == -1) {
+        zip_source_free(logicsrc);
+        goto done;
+    }
 
-    if (!(metasrc = zip_source_file(zipfile, metafile, 0, -1)))
-        return SR_ERR;
-    if (zip_add(zipfile, "header", metasrc) == -1)
-        return SR_ERR;
+    if (!(metasrc = zip_source_buffer(zipfile, meta->str, meta->len, FALSE)))
+        goto done;
+    if (zip_add(zipfile, "header", metasrc) == -1) {
+        zip_source_free(metasrc);
+        goto done;
+    }
 
-    if ((ret = zip_close(zipfile)) == -1) {
+    if (zip_close(zipfile) == -1)
         sr_info("error saving zipfile: %s", zip_strerror(zipfile));
-        return SR_ERR;
-    }
+    else
+        ret = SR_OK;
+    zipfile = NULL;
 
-    unlink(metafile);
+done:
+    if (zipfile) {
+        /* Nothing is written for an archive without entries */
+        zip_unchange_all(zipfile);
+        zip_close(zipfile);
+    }
+    g_string_free(meta, TRUE);
 
-    return SR_OK;
+    return ret;
 }
 
 /**
@@ -462,11 +581,11 @@ SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
 SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
         char **channels)
 {
-    FILE *meta;
+    GString *meta;
     struct zip *zipfile;
     struct zip_source *versrc, *metasrc;
-    int tmpfile, cnt, ret, i;
-    char version[1], metafile[32], *s;
+    int cnt, ret, i;
+    char version[1], *s;
 
     if (!filename) {
         sr_err("%s: filename was NULL", __func__);
@@ -488,49 +607,44 @@ SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
         return SR_ERR;
     }
 
-    /* init "metadata" */
-    strcpy(metafile, "sigrok-meta-XXXXXX");
-    if ((tmpfile = g_mkstemp(metafile)) == -1)
-        return SR_ERR;
-    close(tmpfile);
-    meta = g_fopen(metafile, "wb");
-    fprintf(meta, "[global]\n");
-    fprintf(meta, "sigrok version = %s\n", PACKAGE_VERSION);
+    /* init "metadata", libzip reads it in zip_close() */
+    meta = g_string_sized_new(256);
+    g_string_append_printf(meta, "[global]\n");
+    g_string_append_printf(meta, "sigrok version = %s\n", PACKAGE_VERSION);
 
     /* metadata */
-    fprintf(meta, "[device 1]\n");
+    g_string_append_printf(meta, "[device 1]\n");
 
     /* metadata */
-    fprintf(meta, "capturefile = logic-1\n");
+    g_string_append_printf(meta, "capturefile = logic-1\n");
     cnt = 0;
     for (i = 0; channels[i]; i++)
         cnt++;
-    fprintf(meta, "total probes = %d\n", cnt);
+    g_string_append_printf(meta, "total probes = %d\n", cnt);
     s = sr_samplerate_string(samplerate);
-    fprintf(meta, "samplerate = %s\n", s);
+    g_string_append_printf(meta, "samplerate = %s\n", s);
     g_free(s);
 
     for (i = 0; channels[i]; i++)
-        fprintf(meta, "probe%d = %s\n", i + 1, channels[i]);
-
-    fclose(meta);
+        g_string_append_printf(meta, "probe%d = %s\n", i + 1, channels[i]);
 
-    if (!(metasrc = zip_source_file(zipfile, metafile, 0, -1))) {
-        unlink(metafile);
+    if (!(metasrc = zip_source_buffer(zipfile, meta->str, meta->len, 0))) {
+        g_string_free(meta, TRUE);
         return SR_ERR;
     }
     if (zip_add(zipfile, "metadata", metasrc) == -1) {
-        unlink(metafile);
+        zip_source_free(metasrc);
+        g_string_free(meta, TRUE);
         return SR_ERR;
     }
 
     if ((ret = zip_close(zipfile)) == -1) {
         sr_info("error saving zipfile: %s", zip_strerror(zipfile));
-        unlink(metafile);
+        g_string_free(meta, TRUE);
         return SR_ERR;
     }
 
-    unlink(metafile);
+    g_string_free(meta, TRUE);
 
     return SR_OK;
 }
@@ -564,9 +678,9 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
     GKeyFile *kf;
     GError *error;
     gsize len;
-    int chunk_num, next_chunk_num, tmpfile, ret, i;
+    int chunk_num, next_chunk_num, ret, i;
     const char *entry_name;
-    char *metafile, tmpname[32], chunkname[16];
+    char *metafile, *newmeta, chunkname[16];
 
     if ((ret = sr_sessionfile_check(filename)) != SR_OK)
         return ret;
@@ -593,7 +707,8 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
         return SR_ERR;
     }
     g_free(metafile);
-    tmpname[0] = '\0';
+    /* The new metadata is read by libzip in zip_close() */
+    newmeta = NULL;
     if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
         if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
             sr_err("Failed to check unitsize key: %s", error ? error->message : "?");
@@ -601,30 +716,18 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
         }
         /* Add unitsize field. */
         g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-        metafile = g_key_file_to_data(kf, &len, &error);
-        strcpy(tmpname, "sigrok-meta-XXXXXX");
-        if ((tmpfile = g_mkstemp(tmpname)) == -1)
-            return SR_ERR;
-        if (write(tmpfile, metafile, len) < 0) {
-            sr_dbg("Failed to create new metadata: %s", strerror(errno));
-            g_free(metafile);
-            unlink(tmpname);
-            return SR_ERR;
-        }
-        close(tmpfile);
-        if (!(metasrc = zip_source_file(archive, tmpname, 0, -1))) {
+        newmeta = g_key_file_to_data(kf, &len, &error);
+        if (!(metasrc = zip_source_buffer(archive, newmeta, len, 0))) {
             sr_err("Failed to create zip source for metadata.");
-            g_free(metafile);
-            unlink(tmpname);
+            g_free(newmeta);
             return SR_ERR;
         }
         if (zip_replace(archive, zs.index, metasrc) == -1) {
             sr_err("Failed to replace metadata file.");
-            g_free(metafile);
-            unlink(tmpname);
+            zip_source_free(metasrc);
+            g_free(newmeta);
             return SR_ERR;
         }
-        g_free(metafile);
     }
     g_key_file_free(kf);
 
@@ -639,7 +742,7 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
              * Rename it to "logic-1-1" * and continue with chunk 2. */
             if (zip_rename(archive, i, "logic-1-1") == -1) {
                 sr_err("Failed to rename 'logic-1' to 'logic-1-1'.");
-                unlink(tmpname);
+                g_free(newmeta);
                 return SR_ERR;
             }
             next_chunk_num = 2;
@@ -652,21 +755,837 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
     }
     snprintf(chunkname, 15, "logic-1-%d", next_chunk_num);
     if (!(logicsrc = zip_source_buffer(archive, buf, units * unitsize, FALSE))) {
-        unlink(tmpname);
+        g_free(newmeta);
         return SR_ERR;
     }
     if (zip_add(archive, chunkname, logicsrc) == -1) {
-        unlink(tmpname);
+        zip_source_free(logicsrc);
+        g_free(newmeta);
         return SR_ERR;
     }
     if ((ret = zip_close(archive)) == -1) {
         sr_info("error saving session file: %s", zip_strerror(archive));
-        unlink(tmpname);
+        g_free(newmeta);
+        return SR_ERR;
+    }
+    g_free(newmeta);
+
+    return SR_OK;
+}
+
+/*
+ * A logic capture saved as independently compressed blocks, so that it
+ * can be read back in any order:
+ *
+ * data-<n>       block n, SESSION_BLOCK_SAMPLES samples each but the last
+ * data-index     block size, total samples and unit size as 64-bit
+ *                little-endian values, then the last sample of each block
+ * data-summary   the transitions in each run of SR_SESSION_SUMMARY_SAMPLES
+ *                samples, see struct sr_session_blocks
+ * header         the metadata, as written by sr_session_save(), with the
+ *                container SR_SESSION_CONTAINER_BLOCKS
+ *
+ * The zip central directory locates the blocks, the last samples and the
+ * summary let a reader build an overview and decode any block without
+ * touching the ones before it.
+ *
+ * libzip only writes an archive in zip_close(), from sources which must
+ * all stay around until then, so the zip records are written here: each
+ * block goes to the file as soon as it is full, only the central
+ * directory, the index and the summary are kept in memory.
+ *
+ * The records go to a temp file next to the target, which replaces it
+ * once the capture is complete. The file being replaced may be the one
+ * the capture was loaded from, which is still mapped and read.
+ */
+struct sr_session_writer {
+    FILE *file;
+    char *filename;
+    char *tmpname;
+    int unitsize;
+    int error;
+    gboolean compress;
+    /* Offset of the next entry */
+    uint64_t offset;
+    uint64_t num_entries;
+    GByteArray *central;
+    GString *header;
+    z_stream zs;
+    uint8_t *out;
+    uint64_t out_size;
+    uint16_t dos_time;
+    uint16_t dos_date;
+
+    /* The block being filled */
+    uint8_t *block;
+    uint64_t block_fill;
+    uint64_t num_blocks;
+    uint64_t total_samples;
+
+    /* The last sample of each block */
+    GByteArray *block_last;
+    /* The summary, and the run it has not got to yet */
+    GByteArray *summary;
+    uint64_t prev;
+    uint64_t acc;
+    uint64_t run;
+};
+
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_SIZE 56
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP_VERSION 20
+#define ZIP64_VERSION 45
+#define ZIP_STORE 0
+#define ZIP_DEFLATE 8
+
+/* stdio buffer of the file, so that the zip records and the blocks
+ * reach the disk in large writes. */
+#define SESSION_WRITE_BUFFER (1024 * 1024)
+
+static void put_le(GByteArray *a, uint64_t v, int bytes)
+{
+    uint8_t p[8];
+
+    store_sample(p, v, bytes);
+    g_byte_array_append(a, p, bytes);
+}
+
+static int writer_write(struct sr_session_writer *writer,
+        const void *data, uint64_t size)
+{
+    if (size && fwrite(data, size, 1, writer->file) != 1) {
+        sr_err("Failed to write %s: %s", writer->filename, strerror(errno));
+        return SR_ERR;
+    }
+    writer->offset += size;
+
+    return SR_OK;
+}
+
+/*
+ * Add an entry, deflated unless that would not make it any smaller.
+ * Entries are far below 4 GiB, only their offsets need zip64 records.
+ */
+static int write_entry(struct sr_session_writer *writer, const char *name,
+        const uint8_t *data, uint64_t size)
+{
+    GByteArray *local;
+    const uint8_t *payload;
+    uint64_t bound, csize, offset;
+    uint32_t crc;
+    int method, name_len, ret;
+
+    if (size > G_MAXUINT32 - 1) {
+        sr_err("Entry %s is too large.", name);
         return SR_ERR;
     }
-    unlink(tmpname);
+
+    method = ZIP_STORE;
+    payload = data;
+    csize = size;
+
+    if (writer->compress) {
+        bound = deflateBound(&writer->zs, size);
+        if (bound > writer->out_size) {
+            g_free(writer->out);
+            if (!(writer->out = g_try_malloc(bound))) {
+                writer->out_size = 0;
+                sr_err("%s: deflate buffer malloc failed", __func__);
+                return SR_ERR_MALLOC;
+            }
+            writer->out_size = bound;
+        }
+
+        deflateReset(&writer->zs);
+        writer->zs.next_in = (Bytef *)data;
+        writer->zs.avail_in = size;
+        writer->zs.next_out = writer->out;
+        writer->zs.avail_out = bound;
+        if (deflate(&writer->zs, Z_FINISH) == Z_STREAM_END &&
+            writer->zs.total_out < size) {
+            method = ZIP_DEFLATE;
+            payload = writer->out;
+            csize = writer->zs.total_out;
+        }
+    }
+    crc = crc32(crc32(0, Z_NULL, 0), data, size);
+
+    name_len = strlen(name);
+    offset = writer->offset;
+
+    local = g_byte_array_sized_new(ZIP_LOCAL_HEADER_SIZE + name_len);
+    put_le(local, 0x04034b50, 4);
+    put_le(local, ZIP_VERSION, 2);
+    put_le(local, 0, 2);
+    put_le(local, method, 2);
+    put_le(local, writer->dos_time, 2);
+    put_le(local, writer->dos_date, 2);
+    put_le(local, crc, 4);
+    put_le(local, csize, 4);
+    put_le(local, size, 4);
+    put_le(local, name_len, 2);
+    put_le(local, 0, 2);
+    g_byte_array_append(local, (const guint8 *)name, name_len);
+    ret = writer_write(writer, local->data, local->len);
+    g_byte_array_free(local, TRUE);
+    if (ret != SR_OK || writer_write(writer, payload, csize) != SR_OK)
+        return SR_ERR;
+
+    /* Offsets past 4 GiB move to a zip64 extra field */
+    put_le(writer->central, 0x02014b50, 4);
+    put_le(writer->central, ZIP64_VERSION, 2);
+    put_le(writer->central,
+        offset >= G_MAXUINT32 ? ZIP64_VERSION : ZIP_VERSION, 2);
+    put_le(writer->central, 0, 2);
+    put_le(writer->central, method, 2);
+    put_le(writer->central, writer->dos_time, 2);
+    put_le(writer->central, writer->dos_date, 2);
+    put_le(writer->central, crc, 4);
+    put_le(writer->central, csize, 4);
+    put_le(writer->central, size, 4);
+    put_le(writer->central, name_len, 2);
+    put_le(writer->central, offset >= G_MAXUINT32 ? 12 : 0, 2);
+    put_le(writer->central, 0, 2);
+    put_le(writer->central, 0, 2);
+    put_le(writer->central, 0, 2);
+    put_le(writer->central, 0, 4);
+    put_le(writer->central, MIN(offset, G_MAXUINT32), 4);
+    g_byte_array_append(writer->central, (const guint8 *)name, name_len);
+    if (offset >= G_MAXUINT32) {
+        put_le(writer->central, 0x0001, 2);
+        put_le(writer->central, 8, 2);
+        put_le(writer->central, offset, 8);
+    }
+    writer->num_entries++;
+
+    return SR_OK;
+}
+
+static int write_block(struct sr_session_writer *writer)
+{
+    char entry[64];
+
+    if (writer->block_fill == 0)
+        return SR_OK;
+
+    snprintf(entry, sizeof(entry), "data-%" PRIu64, writer->num_blocks);
+    if (write_entry(writer, entry, writer->block,
+            writer->block_fill * writer->unitsize) != SR_OK)
+        return SR_ERR;
+
+    g_byte_array_append(writer->block_last, writer->block +
+        (writer->block_fill - 1) * writer->unitsize, writer->unitsize);
+    writer->num_blocks++;
+    writer->block_fill = 0;
 
     return SR_OK;
 }
 
+static int write_directory(struct sr_session_writer *writer)
+{
+    GByteArray *end;
+    uint64_t cd_offset, cd_size, eocd64_offset;
+    int zip64, ret;
+
+    cd_offset = writer->offset;
+    cd_size = writer->central->len;
+    if (writer_write(writer, writer->central->data, cd_size) != SR_OK)
+        return SR_ERR;
+
+    zip64 = writer->num_entries >= G_MAXUINT16 ||
+        cd_offset >= G_MAXUINT32 || cd_size >= G_MAXUINT32;
+
+    end = g_byte_array_sized_new(ZIP64_EOCD_SIZE + ZIP64_LOCATOR_SIZE +
+        ZIP_EOCD_SIZE);
+    if (zip64) {
+        eocd64_offset = writer->offset;
+        put_le(end, 0x06064b50, 4);
+        put_le(end, ZIP64_EOCD_SIZE - 12, 8);
+        put_le(end, ZIP64_VERSION, 2);
+        put_le(end, ZIP64_VERSION, 2);
+        put_le(end, 0, 4);
+        put_le(end, 0, 4);
+        put_le(end, writer->num_entries, 8);
+        put_le(end, writer->num_entries, 8);
+        put_le(end, cd_size, 8);
+        put_le(end, cd_offset, 8);
+
+        put_le(end, 0x07064b50, 4);
+        put_le(end, 0, 4);
+        put_le(end, eocd64_offset, 8);
+        put_le(end, 1, 4);
+    }
+    put_le(end, 0x06054b50, 4);
+    put_le(end, 0, 2);
+    put_le(end, 0, 2);
+    put_le(end, MIN(writer->num_entries, G_MAXUINT16), 2);
+    put_le(end, MIN(writer->num_entries, G_MAXUINT16), 2);
+    put_le(end, MIN(cd_size, G_MAXUINT32), 4);
+    put_le(end, MIN(cd_offset, G_MAXUINT32), 4);
+    put_le(end, 0, 2);
+    ret = writer_write(writer, end->data, end->len);
+    g_byte_array_free(end, TRUE);
+
+    return ret;
+}
+
+static void writer_free(struct sr_session_writer *writer)
+{
+    deflateEnd(&writer->zs);
+    g_free(writer->out);
+    g_free(writer->block);
+    g_byte_array_free(writer->central, TRUE);
+    g_byte_array_free(writer->block_last, TRUE);
+    g_byte_array_free(writer->summary, TRUE);
+    g_string_free(writer->header, TRUE);
+    g_free(writer->filename);
+    g_free(writer->tmpname);
+    g_free(writer);
+}
+
+/**
+ * Start saving a logic capture, which can be appended to while it is
+ * still being acquired.
+ *
+ * Each block of samples is compressed and written out as soon as it is
+ * full, the file becomes a valid session file, which
+ * sr_session_blocks_open() and sr_session_load() accept, once
+ * sr_session_writer_finish() has been called.
+ *
+ * @param filename The name of the file, which is replaced when the writer
+ *                 finishes. Must not be NULL.
+ * @param sdi The device instance from which the data is captured. Its
+ *            settings are taken now.
+ * @param unitsize The number of bytes per sample, 1 to 8.
+ * @param writer Will be set to the new writer.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_MALLOC upon memory allocation errors, or SR_ERR if the
+ *         file could not be created.
+ */
+SR_API int sr_session_writer_new(const char *filename,
+        const struct sr_dev_inst *sdi, int unitsize,
+        struct sr_session_writer **writer)
+{
+    struct sr_session_writer *w;
+    struct tm *tm;
+    time_t now;
+    int fd;
+
+    if (!filename || !sdi || !writer || unitsize < 1 || unitsize > 8) {
+        sr_err("%s: invalid arguments", __func__);
+        return SR_ERR_ARG;
+    }
+
+    if (!(w = g_try_malloc0(sizeof(*w))) ||
+        !(w->block = g_try_malloc(SESSION_BLOCK_SAMPLES * unitsize))) {
+        g_free(w);
+        sr_err("%s: writer malloc failed", __func__);
+        return SR_ERR_MALLOC;
+    }
+
+    /* Fast compression, the capture may still be running */
+    if (deflateInit2(&w->zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY) != Z_OK) {
+        sr_err("Failed to initialize deflate.");
+        g_free(w->block);
+        g_free(w);
+        return SR_ERR;
+    }
+
+    w->filename = g_strdup(filename);
+    w->tmpname = g_strconcat(filename, ".XXXXXX", NULL);
+    w->unitsize = unitsize;
+    w->compress = TRUE;
+    w->central = g_byte_array_new();
+    w->block_last = g_byte_array_new();
+    w->summary = g_byte_array_new();
+    w->header = session_header(sdi, unitsize, SR_SESSION_CONTAINER_BLOCKS);
+
+    now = time(NULL);
+    if ((tm = localtime(&now)) && tm->tm_year >= 80) {
+        w->dos_time = tm->tm_hour << 11 | tm->tm_min << 5 | tm->tm_sec / 2;
+        w->dos_date = (tm->tm_year - 80) << 9 | (tm->tm_mon + 1) << 5 |
+            tm->tm_mday;
+    } else {
+        w->dos_date = 1 << 5 | 1;
+    }
+
+    if ((fd = g_mkstemp_full(w->tmpname, O_RDWR, 0666)) < 0) {
+        sr_err("Failed to create %s: %s", w->tmpname, strerror(errno));
+        writer_free(w);
+        return SR_ERR;
+    }
+    if (!(w->file = fdopen(fd, "wb"))) {
+        sr_err("Failed to create %s: %s", w->tmpname, strerror(errno));
+        close(fd);
+        g_unlink(w->tmpname);
+        writer_free(w);
+        return SR_ERR;
+    }
+    setvbuf(w->file, NULL, _IOFBF, SESSION_WRITE_BUFFER);
+
+    *writer = w;
+
+    return SR_OK;
+}
+
+/**
+ * Choose whether the blocks written from now on are compressed.
+ *
+ * Compression is on by default. Without it, saving a fast capture costs
+ * little more than copying it to the disk, at the price of a larger file.
+ *
+ * @param writer The writer.
+ * @param compress TRUE to deflate the blocks, FALSE to store them.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ */
+SR_API int sr_session_writer_set_compress(struct sr_session_writer *writer,
+        gboolean compress)
+{
+    if (!writer) {
+        sr_err("%s: invalid arguments", __func__);
+        return SR_ERR_ARG;
+    }
+
+    writer->compress = compress;
+
+    return SR_OK;
+}
+
+/**
+ * Append samples to a capture being saved.
+ *
+ * @param writer The writer.
+ * @param buf The samples, which are not referenced after the call.
+ * @param units The number of samples.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or
+ *         SR_ERR if the file could not be written, in which case the
+ *         writer can only be aborted.
+ */
+SR_API int sr_session_writer_append(struct sr_session_writer *writer,
+        const uint8_t *buf, uint64_t units)
+{
+    const int unitsize = writer ? writer->unitsize : 0;
+    uint64_t i, n, sample;
+    uint8_t last[8];
+
+    if (!writer || (!buf && units)) {
+        sr_err("%s: invalid arguments", __func__);
+        return SR_ERR_ARG;
+    }
+    if (writer->error)
+        return SR_ERR;
+
+    /* The summary carries over from one call to the next */
+    for (i = 0; i < units; i++) {
+        sample = load_sample(buf + i * unitsize, unitsize);
+        writer->acc |= writer->prev ^ sample;
+        writer->prev = sample;
+        if (++writer->run == SR_SESSION_SUMMARY_SAMPLES) {
+            store_sample(last, writer->acc, unitsize);
+            g_byte_array_append(writer->summary, last, unitsize);
+            writer->acc = 0;
+            writer->run = 0;
+        }
+    }
+
+    while (units > 0) {
+        n = MIN(units, SESSION_BLOCK_SAMPLES - writer->block_fill);
+        memcpy(writer->block + writer->block_fill * unitsize, buf,
+            n * unitsize);
+        writer->block_fill += n;
+        writer->total_samples += n;
+        buf += n * unitsize;
+        units -= n;
+
+        if (writer->block_fill == SESSION_BLOCK_SAMPLES &&
+            write_block(writer) != SR_OK) {
+            writer->error = TRUE;
+            return SR_ERR;
+        }
+    }
+
+    return SR_OK;
+}
+
+/**
+ * Finish saving a capture, and free the writer.
+ *
+ * @param writer The writer.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or
+ *         SR_ERR if the file could not be written, in which case a file
+ *         it would have replaced is left as it was.
+ */
+SR_API int sr_session_writer_finish(struct sr_session_writer *writer)
+{
+    uint8_t header[SESSION_INDEX_HEADER_SIZE];
+    GByteArray *index;
+    int ret;
+
+    if (!writer) {
+        sr_err("%s: invalid arguments", __func__);
+        return SR_ERR_ARG;
+    }
+
+    if (writer->error) {
+        sr_session_writer_abort(writer);
+        return SR_ERR;
+    }
+
+    write_le64(header, SESSION_BLOCK_SAMPLES);
+    write_le64(header + 8, writer->total_samples);
+    write_le64(header + 16, writer->unitsize);
+
+    g_string_append_printf(writer->header, "total samples = %" PRIu64 "\n",
+        writer->total_samples);
+
+    ret = write_block(writer);
+    if (ret == SR_OK) {
+        index = g_byte_array_sized_new(SESSION_INDEX_HEADER_SIZE +
+            writer->block_last->len);
+        g_byte_array_append(index, header, SESSION_INDEX_HEADER_SIZE);
+        g_byte_array_append(index, writer->block_last->data,
+            writer->block_last->len);
+        ret = write_entry(writer, "data-index", index->data, index->len);
+        g_byte_array_free(index, TRUE);
+    }
+    if (ret == SR_OK)
+        ret = write_entry(writer, "data-summary", writer->summary->data,
+            writer->summary->len);
+    if (ret == SR_OK)
+        ret = write_entry(writer, "header",
+            (const uint8_t *)writer->header->str, writer->header->len);
+    if (ret == SR_OK)
+        ret = write_directory(writer);
+
+    if (fclose(writer->file) != 0 && ret == SR_OK) {
+        sr_err("Failed to write %s: %s", writer->tmpname, strerror(errno));
+        ret = SR_ERR;
+    }
+    /* A mapping of the file replaced keeps reading the old contents */
+    if (ret == SR_OK && g_rename(writer->tmpname, writer->filename) != 0) {
+        sr_err("Failed to replace %s: %s", writer->filename,
+            strerror(errno));
+        ret = SR_ERR;
+    }
+    if (ret != SR_OK)
+        g_unlink(writer->tmpname);
+    else
+        sr_dbg("Saved %" PRIu64 " samples in %" PRIu64 " blocks to %s.",
+            writer->total_samples, writer->num_blocks, writer->filename);
+    writer_free(writer);
+
+    return ret == SR_OK ? SR_OK : SR_ERR;
+}
+
+/**
+ * Stop saving a capture, remove what was written and free the writer.
+ * A file it would have replaced is left as it was.
+ *
+ * @param writer The writer, may be NULL.
+ */
+SR_API void sr_session_writer_abort(struct sr_session_writer *writer)
+{
+    if (!writer)
+        return;
+
+    fclose(writer->file);
+    g_unlink(writer->tmpname);
+    writer_free(writer);
+}
+
+/* Shared state of the threads of sr_session_blocks_load(). */
+struct blocks_load {
+    struct sr_session_blocks *blocks;
+    uint64_t first;
+    uint64_t count;
+    uint8_t *buf;
+    gint next;
+    gint error;
+};
+
+static int read_block(struct sr_session_blocks *blocks, struct zip *archive,
+        uint64_t block, void *buf)
+{
+    struct zip_file *zf;
+    uint64_t size;
+    char entry[64];
+
+    size = MIN(blocks->total_samples - block * blocks->block_samples,
+        blocks->block_samples) * blocks->unitsize;
+
+    snprintf(entry, sizeof(entry), "%s-%" PRIu64, blocks->capturefile, block);
+    if (!(zf = zip_fopen(archive, entry, 0))) {
+        sr_err("Failed to open block %" PRIu64 ".", block);
+        return SR_ERR;
+    }
+    if (zip_fread(zf, buf, size) != (zip_int64_t)size) {
+        sr_err("Failed to read block %" PRIu64 ".", block);
+        zip_fclose(zf);
+        return SR_ERR;
+    }
+    zip_fclose(zf);
+
+    return SR_OK;
+}
+
+static gpointer load_thread(gpointer data)
+{
+    struct blocks_load *load = data;
+    struct sr_session_blocks *blocks = load->blocks;
+    struct zip *archive;
+    uint64_t i;
+    int ret;
+
+    /* A libzip archive must not be shared between threads */
+    if (!(archive = zip_open(blocks->filename, 0, &ret))) {
+        g_atomic_int_set(&load->error, SR_ERR);
+        return NULL;
+    }
+
+    while (g_atomic_int_get(&load->error) == SR_OK &&
+           (i = g_atomic_int_add(&load->next, 1)) < load->count) {
+        if (read_block(blocks, archive, load->first + i, load->buf +
+                i * blocks->block_samples * blocks->unitsize) != SR_OK)
+            g_atomic_int_set(&load->error, SR_ERR);
+    }
+    zip_close(archive);
+
+    return NULL;
+}
+
+/**
+ * Open a logic capture of a session file for random access.
+ *
+ * sr_session_save() writes logic captures as independently compressed
+ * blocks, together with the last sample of each block and a summary of
+ * the transitions, which give an overview of the capture without reading
+ * any samples.
+ *
+ * @param filename The name of the session file. Must not be NULL.
+ * @param capturefile The name of the capture in the session file.
+ *                    Must not be NULL.
+ * @param blocks Will be set to the capture, which holds one reference.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_NA if the capture was not saved as blocks,
+ *         SR_ERR_MALLOC upon memory allocation errors, or SR_ERR upon
+ *         other errors.
+ */
+SR_API int sr_session_blocks_open(const char *filename,
+        const char *capturefile, struct sr_session_blocks **blocks)
+{
+    struct sr_session_blocks *b;
+    struct zip *archive;
+    uint8_t *index, *summary;
+    uint64_t index_size, summary_size, block_samples, total_samples;
+    uint64_t unitsize, num_blocks;
+    char entry[64];
+    int ret;
+
+    if (!filename || !capturefile || !blocks) {
+        sr_err("%s: invalid arguments", __func__);
+        return SR_ERR_ARG;
+    }
+
+    if (!(archive = zip_open(filename, 0, &ret))) {
+        sr_dbg("Failed to open session file: zip error %d", ret);
+        return SR_ERR;
+    }
+
+    /* Older session files hold the capture in a single entry */
+    snprintf(entry, sizeof(entry), "%s-index", capturefile);
+    if ((ret = read_entry(archive, entry, &index, &index_size)) != SR_OK) {
+        zip_close(archive);
+        return ret;
+    }
+
+    ret = SR_ERR;
+    summary = NULL;
+    if (index_size < SESSION_INDEX_HEADER_SIZE)
+        goto err;
+    block_samples = read_le64(index);
+    total_samples = read_le64(index + 8);
+    unitsize = read_le64(index + 16);
+    if (block_samples == 0 || block_samples % SR_SESSION_SUMMARY_SAMPLES ||
+        unitsize == 0 || unitsize > 8)
+        goto err;
+    num_blocks = (total_samples + block_samples - 1) / block_samples;
+    if (index_size != SESSION_INDEX_HEADER_SIZE + num_blocks * unitsize)
+        goto err;
+
+    snprintf(entry, sizeof(entry), "%s-summary", capturefile);
+    if (read_entry(archive, entry, &summary, &summary_size) != SR_OK ||
+        summary_size != total_samples / SR_SESSION_SUMMARY_SAMPLES * unitsize)
+        goto err;
+
+    if (!(b = g_try_malloc0(sizeof(*b)))) {
+        ret = SR_ERR_MALLOC;
+        goto err;
+    }
+
+    /* The last samples follow the header, keep them in place */
+    memmove(index, index + SESSION_INDEX_HEADER_SIZE,
+        num_blocks * unitsize);
+    b->unitsize = unitsize;
+    b->total_samples = total_samples;
+    b->block_samples = block_samples;
+    b->num_blocks = num_blocks;
+    b->block_last = index;
+    b->summary = summary;
+    b->archive = archive;
+    b->filename = g_strdup(filename);
+    b->capturefile = g_strdup(capturefile);
+    b->refcount = 1;
+    *blocks = b;
+
+    return SR_OK;
+
+err:
+    sr_err("Invalid block index in session file '%s'.", filename);
+    g_free(index);
+    g_free(summary);
+    zip_close(archive);
+    return ret;
+}
+
+/**
+ * Read and decompress one block of a logic capture.
+ *
+ * Reads of the same capture must not run concurrently.
+ *
+ * @param blocks The capture.
+ * @param block The index of the block.
+ * @param buf Will be filled with the samples of the block, which must
+ *            have room for blocks->block_samples samples.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or SR_ERR
+ *         upon other errors.
+ */
+SR_API int sr_session_blocks_read(struct sr_session_blocks *blocks,
+        uint64_t block, void *buf)
+{
+    if (!blocks || !buf || block >= blocks->num_blocks)
+        return SR_ERR_ARG;
+
+    return read_block(blocks, blocks->archive, block, buf);
+}
+
+/**
+ * Read and decompress consecutive blocks of a logic capture on several
+ * threads.
+ *
+ * Every thread reads through its own handle of the session file, so the
+ * blocks are decompressed in parallel. They are stored in order, as if
+ * read one after the other with sr_session_blocks_read().
+ *
+ * Reads of the same capture must not run concurrently.
+ *
+ * @param blocks The capture.
+ * @param first The index of the first block.
+ * @param count The number of blocks.
+ * @param buf Will be filled with the samples of the blocks, which must
+ *            have room for count * blocks->block_samples samples.
+ * @param num_threads The maximum number of threads to use, including
+ *                    the calling one.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, or SR_ERR
+ *         upon other errors.
+ */
+SR_API int sr_session_blocks_load(struct sr_session_blocks *blocks,
+        uint64_t first, uint64_t count, void *buf, int num_threads)
+{
+    struct blocks_load load;
+    GThread **threads;
+    gint64 start;
+    uint64_t i, bytes;
+    int num;
+
+    if (!blocks || !buf || first > blocks->num_blocks ||
+        count > blocks->num_blocks - first || count > G_MAXINT)
+        return SR_ERR_ARG;
+
+    if (count == 0)
+        return SR_OK;
+
+    start = g_get_monotonic_time();
+    num = MAX(MIN((uint64_t)num_threads, count), 1);
+    if (num == 1) {
+        for (i = 0; i < count; i++)
+            if (read_block(blocks, blocks->archive, first + i,
+                    (uint8_t *)buf + i * blocks->block_samples *
+                    blocks->unitsize) != SR_OK)
+                return SR_ERR;
+    } else {
+        load.blocks = blocks;
+        load.first = first;
+        load.count = count;
+        load.buf = buf;
+        load.next = 0;
+        load.error = SR_OK;
+
+        /* The calling thread takes its share as well */
+        threads = g_new0(GThread *, num - 1);
+        for (i = 0; i < (uint64_t)num - 1; i++)
+            threads[i] = g_thread_try_new("sr-blocks", load_thread, &load,
+                NULL);
+        load_thread(&load);
+        for (i = 0; i < (uint64_t)num - 1; i++)
+            if (threads[i])
+                g_thread_join(threads[i]);
+        g_free(threads);
+
+        if (load.error != SR_OK)
+            return SR_ERR;
+    }
+
+    bytes = (MIN((first + count) * blocks->block_samples,
+        blocks->total_samples) - first * blocks->block_samples) *
+        blocks->unitsize;
+    sr_dbg("Loaded %" PRIu64 " blocks, %.1f MB/s on %d threads.", count,
+        (double)bytes / MAX(g_get_monotonic_time() - start, 1), num);
+
+    return SR_OK;
+}
+
+/**
+ * Take a reference on a logic capture.
+ *
+ * @param blocks The capture.
+ *
+ * @return The capture.
+ */
+SR_API struct sr_session_blocks *sr_session_blocks_ref(
+        struct sr_session_blocks *blocks)
+{
+    g_atomic_int_inc(&blocks->refcount);
+
+    return blocks;
+}
+
+/**
+ * Drop a reference on a logic capture, the last one closes the file.
+ *
+ * @param blocks The capture, may be NULL.
+ */
+SR_API void sr_session_blocks_unref(struct sr_session_blocks *blocks)
+{
+    if (!blocks || !g_atomic_int_dec_and_test(&blocks->refcount))
+        return;
+
+    zip_close(blocks->archive);
+    g_free(blocks->filename);
+    g_free(blocks->capturefile);
+    g_free(blocks->block_last);
+    g_free(blocks->summary);
+    g_free(blocks);
+}
+
 /** @} */
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Throughput of sr_bitgather_run() per method and input unit size.
+ * Not run by "make check", start it by hand: ./bench_bitgather [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define REPEAT 8
+
+static const char *method_names[] = {"auto", "shift", "table", "pext"};
+
+static void bench(const uint8_t *in, uint8_t *out, uint64_t samples,
+		  unsigned int in_unitsize, uint64_t mask, int method)
+{
+	struct sr_bitgather bg;
+	unsigned int out_unitsize, bits, r;
+	uint64_t m;
+	double start, best = 0, t;
+
+	for (bits = 0, m = mask; m; m &= m - 1)
+		bits++;
+	out_unitsize = bits ? (bits + 7) / 8 : 1;
+
+	if (sr_bitgather_init(&bg, mask, in_unitsize, out_unitsize,
+			      method) != SR_OK) {
+		printf("%-6s %2d  0x%016llx       n/a\n", method_names[method],
+		       in_unitsize, (unsigned long long)mask);
+		return;
+	}
+
+	for (r = 0; r < REPEAT; r++) {
+		start = srtest_now();
+		sr_bitgather_run(&bg, in, out, samples);
+		t = srtest_now() - start;
+		if (r == 0 || t < best)
+			best = t;
+	}
+
+	printf("%-6s %2d  0x%016llx  %8.1f Msamples/s  %8.1f MB/s\n",
+	       method_names[bg.method], in_unitsize, (unsigned long long)mask,
+	       samples / best * 1e-6, samples * in_unitsize / best * 1e-6);
+	sr_bitgather_cleanup(&bg);
+}
+
+int main(int argc, char **argv)
+{
+	/* Channel groups with a few holes, as they are typically set up. */
+	static const uint64_t masks[] = {
+		0x000000000000ee77ULL, 0x00000000ee77ee77ULL,
+		0xee77ee77ee77ee77ULL,
+	};
+	static const unsigned int unitsizes[] = {1, 2, 4, 8};
+	uint64_t samples, i, mask, prev_mask;
+	unsigned int u, m;
+	uint8_t *in, *out;
+	int method;
+
+	samples = argc > 1 ? strtoull(argv[1], NULL, 0) : 16 * 1024 * 1024;
+	in = malloc(samples * 8);
+	out = malloc(samples * 8);
+	if (!in || !out) {
+		fprintf(stderr, "Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < samples * 8; i++)
+		in[i] = rand();
+
+	printf("method unit mask                throughput\n");
+	for (u = 0; u < sizeof(unitsizes) / sizeof(unitsizes[0]); u++) {
+		prev_mask = 0;
+		for (m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+			mask = masks[m];
+			if (unitsizes[u] < 8)
+				mask &= (UINT64_C(1) << (unitsizes[u] * 8)) - 1;
+			if (mask == prev_mask)
+				continue;
+			prev_mask = mask;
+			for (method = SR_BITGATHER_SHIFT;
+			     method <= SR_BITGATHER_PEXT; method++)
+				bench(in, out, samples, unitsizes[u], mask, method);
+			bench(in, out, samples, unitsizes[u], mask,
+			      SR_BITGATHER_AUTO);
+		}
+	}
+
+	free(in);
+	free(out);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,165 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Overhead of the pipeline metrics on the handling of a logic packet.
+ * Not run by "make check", start it by hand: ./bench_metrics [MiB]
+ * The clock readings and metric updates which a packet goes through from
+ * the driver to the snapshot are timed on their own, against the time it
+ * takes to copy the packet into a capture buffer and summarise it the way
+ * DSView's first mip-map level does, which is the least work a packet
+ * gets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define UNITSIZE 2
+#define SCALE 16
+#define ROUNDS 5
+
+static const size_t packet_sizes[] = {
+	16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 4096 * 1024,
+};
+
+/* The shortest logic transfer of the DSLogic driver, in ms. */
+#define TRANSFER_TIME 20
+
+/* Copy a packet into the capture and summarise its transitions. */
+static void append(uint8_t *dst, const uint8_t *src, size_t length,
+		   uint16_t *mipmap, uint16_t *last)
+{
+	const uint16_t *s;
+	uint16_t acc;
+	size_t i, j;
+
+	memcpy(dst, src, length);
+	s = (const uint16_t *)dst;
+	for (i = 0; i < length / UNITSIZE / SCALE; i++) {
+		acc = 0;
+		for (j = 0; j < SCALE; j++) {
+			acc |= *last ^ *s;
+			*last = *s++;
+		}
+		mipmap[i] = acc;
+	}
+}
+
+static double run(const uint8_t *src, uint8_t *capture, uint16_t *mipmap,
+		  size_t total, size_t packet_size)
+{
+	uint16_t last;
+	size_t offset;
+	double begin;
+
+	last = 0;
+	begin = srtest_now();
+	for (offset = 0; offset + packet_size <= total; offset += packet_size)
+		append(capture + offset, src + offset, packet_size,
+		       mipmap + offset / UNITSIZE / SCALE, &last);
+
+	return srtest_now() - begin;
+}
+
+/*
+ * What a packet goes through from the driver to the snapshot. The driver
+ * reads the clock for its own statistics already.
+ */
+static double instrument(size_t packet_size, int packets)
+{
+	int64_t start, t, appended;
+	double begin;
+	int i;
+
+	begin = srtest_now();
+	for (i = 0; i < packets; i++) {
+		/* The driver. */
+		sr_metric_add(SR_METRIC_USB_TRANSFERS, 1);
+		sr_metric_add(SR_METRIC_USB_BYTES, packet_size);
+		/* sr_session_send(), the frontend's lock and snapshot. */
+		start = g_get_monotonic_time();
+		t = g_get_monotonic_time();
+		sr_metric_observe(SR_METRIC_FEED_LOCK_WAIT,
+				  g_get_monotonic_time() - t);
+		t = g_get_monotonic_time();
+		appended = g_get_monotonic_time();
+		sr_metric_observe(SR_METRIC_FEED_APPEND, appended - t);
+		sr_metric_observe(SR_METRIC_FEED_MIPMAP,
+				  g_get_monotonic_time() - appended);
+		sr_metric_observe(SR_METRIC_SESSION_SEND,
+				  g_get_monotonic_time() - start);
+		/* The resubmission. */
+		sr_metric_observe(SR_METRIC_USB_CALLBACK, t - start);
+		sr_metric_observe(SR_METRIC_USB_RESUBMIT_GAP, t - start);
+	}
+
+	return (srtest_now() - begin) / packets;
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t *src, *capture;
+	uint16_t *mipmap;
+	size_t total, i;
+	double plain, cost;
+	unsigned int p;
+	int round;
+
+	total = (argc > 1 ? strtoull(argv[1], NULL, 10) : 256) << 20;
+	src = malloc(total);
+	capture = malloc(total);
+	mipmap = malloc(total / UNITSIZE / SCALE * sizeof(uint16_t));
+	if (!src || !capture || !mipmap) {
+		fprintf(stderr, "Failed to allocate %zu bytes.\n", total);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < total; i++)
+		src[i] = rand();
+	/* Fault the capture in before timing. */
+	memset(capture, 0, total);
+
+	cost = 1e9;
+	for (round = 0; round < ROUNDS; round++)
+		cost = MIN(cost, instrument(packet_sizes[0], 1000000));
+	printf("Metrics: %.0f ns per packet, %.4f%% of a core at one "
+	       "transfer per %d ms\n", cost * 1e9,
+	       cost / (TRANSFER_TIME * 1e-3) * 100, TRANSFER_TIME);
+
+	for (p = 0; p < G_N_ELEMENTS(packet_sizes); p++) {
+		plain = 1e9;
+		for (round = 0; round < ROUNDS; round++)
+			plain = MIN(plain, run(src, capture, mipmap, total,
+					       packet_sizes[p]));
+		plain /= total / packet_sizes[p];
+		printf("%7zu byte packets: %8.1f us to append, %.3f%% "
+		       "overhead\n", packet_sizes[p], plain * 1e6,
+		       cost / plain * 100);
+	}
+
+	free(src);
+	free(capture);
+	free(mipmap);
+
+	return EXIT_SUCCESS;
+}
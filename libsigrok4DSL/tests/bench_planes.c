@@ -0,0 +1,184 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Export throughput of the output modules, for a busy and a sparse 16
+ * channel capture.
+ * Not run by "make check", start it by hand: ./bench_planes [samples]
+ * The output is counted, not written, so only the formatting is timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define UNITSIZE 2
+#define PACKET_SAMPLES (1024 * 1024)
+
+static const char *module_ids[] = {"csv", "vcd", "planes"};
+
+/* Channel n toggles about every 2^(n + shift) samples. */
+static uint16_t *generate(uint64_t num_samples, int shift)
+{
+	uint16_t *buf, value;
+	uint64_t i;
+	int ch;
+
+	if (!(buf = malloc(num_samples * UNITSIZE)))
+		return NULL;
+
+	value = 0;
+	for (i = 0; i < num_samples; i++) {
+		for (ch = 0; ch < 16; ch++)
+			if ((rand() & ((1 << (ch + shift)) - 1)) == 0)
+				value ^= 1 << ch;
+		buf[i] = value;
+	}
+
+	return buf;
+}
+
+static int run(const struct sr_output_module *omod, struct sr_dev_inst *sdi,
+	       const uint16_t *buf, uint64_t num_samples, uint64_t *written)
+{
+	struct sr_output o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GHashTable *params;
+	GString *out;
+	uint64_t i;
+	int ret;
+
+	/* Set up the way DSView does for its export. */
+	params = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(params, "type",
+			g_variant_new_int16(SR_CHANNEL_LOGIC));
+	g_hash_table_insert(params, "timebase", g_variant_new_uint64(0));
+	o.module = (struct sr_output_module *)omod;
+	o.sdi = sdi;
+	o.param = NULL;
+	o.priv = NULL;
+	ret = omod->init(&o, params);
+	g_hash_table_destroy(params);
+	if (ret != SR_OK)
+		return ret;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SR_MHZ(100));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	omod->receive(&o, &packet, &out);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	*written = 0;
+	for (i = 0; ret == SR_OK && i <= num_samples; i += PACKET_SAMPLES) {
+		if (i < num_samples) {
+			logic.length = MIN(PACKET_SAMPLES, num_samples - i) *
+				UNITSIZE;
+			logic.unitsize = UNITSIZE;
+			logic.data = (uint16_t *)buf + i;
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+		} else {
+			packet.type = SR_DF_END;
+			packet.payload = NULL;
+		}
+		out = NULL;
+		ret = omod->receive(&o, &packet, &out);
+		if (out) {
+			*written += out->len;
+			g_string_free(out, TRUE);
+		}
+	}
+
+	omod->cleanup(&o);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_dev_inst sdi;
+	struct sr_channel channels[16];
+	const struct sr_output_module *omod;
+	struct sr_context *ctx;
+	uint64_t num_samples, written;
+	uint16_t *buf;
+	double start, t;
+	char names[16][4];
+	unsigned int i;
+	int shift;
+
+	num_samples = argc > 1 ? strtoull(argv[1], NULL, 10) :
+		32 * 1024 * 1024;
+
+	sr_init(&ctx);
+
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	memset(channels, 0, sizeof(channels));
+	for (i = 0; i < 16; i++) {
+		snprintf(names[i], sizeof(names[i]), "%d", i);
+		channels[i].index = i;
+		channels[i].type = SR_CHANNEL_LOGIC;
+		channels[i].enabled = TRUE;
+		channels[i].name = names[i];
+		sdi.channels = g_slist_append(sdi.channels, &channels[i]);
+	}
+
+	for (shift = 0; shift <= 12; shift += 12) {
+		if (!(buf = generate(num_samples, shift))) {
+			fprintf(stderr, "Failed to allocate %" PRIu64 " samples.\n",
+				num_samples);
+			return EXIT_FAILURE;
+		}
+
+		printf("%s capture:\n", shift ? "Sparse" : "Busy");
+		for (i = 0; i < G_N_ELEMENTS(module_ids); i++) {
+			if (!(omod = sr_output_find((char *)module_ids[i])))
+				continue;
+			start = srtest_now();
+			if (run(omod, &sdi, buf, num_samples, &written) != SR_OK) {
+				fprintf(stderr, "%s failed.\n", module_ids[i]);
+				continue;
+			}
+			t = srtest_now() - start;
+			printf("%-8s %8.1f MB/s  %8.1f Msamples/s  %10.1f MB "
+			       "written\n", module_ids[i],
+			       num_samples * UNITSIZE / t * 1e-6,
+			       num_samples / t * 1e-6, written * 1e-6);
+		}
+
+		free(buf);
+	}
+
+	g_slist_free(sdi.channels);
+	sr_exit(ctx);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Load throughput of a logic capture saved as blocks, from one thread up
+ * to one per CPU.
+ * Not run by "make check", start it by hand: ./bench_session [file.dsl]
+ * Without a file, a capture is saved to the temp directory first.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define UNITSIZE 2
+#define NUM_SAMPLES (128 * 1024 * 1024)
+
+/* A bus with a few fast channels and mostly idle slow ones. */
+static int generate(char *filename)
+{
+	struct sr_dev_inst sdi;
+	uint16_t *buf, value;
+	uint64_t i;
+	FILE *file;
+	int ch, ret;
+
+	if (!(file = srtest_tmpfile(filename, 0)))
+		return SR_ERR;
+	fclose(file);
+
+	if (!(buf = malloc(NUM_SAMPLES * UNITSIZE)))
+		return SR_ERR_MALLOC;
+
+	value = 0;
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		for (ch = 0; ch < 16; ch++)
+			if ((rand() & ((2 << ch) - 1)) == 0)
+				value ^= 1 << ch;
+		buf[i] = value;
+	}
+
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	ret = sr_session_save(filename, &sdi, (unsigned char *)buf,
+			UNITSIZE, NUM_SAMPLES);
+	free(buf);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	char filename[] = "/tmp/bench_session_XXXXXX";
+	struct sr_session_blocks *blocks;
+	struct sr_context *ctx;
+	const char *path;
+	double start, t, base;
+	uint8_t *buf;
+	int threads, max_threads, ret;
+
+	sr_init(&ctx);
+
+	if (!(path = srtest_bench_file(argc, argv, filename, generate))) {
+		sr_exit(ctx);
+		return EXIT_FAILURE;
+	}
+
+	if ((ret = sr_session_blocks_open(path, "data", &blocks)) != SR_OK) {
+		fprintf(stderr, "%s has no logic capture saved as blocks.\n",
+			path);
+		goto done;
+	}
+
+	if (!(buf = malloc(blocks->num_blocks * blocks->block_samples *
+			blocks->unitsize))) {
+		ret = SR_ERR_MALLOC;
+		goto close;
+	}
+
+	/* Fault the pages in, so that the first run is not penalized */
+	memset(buf, 0, blocks->num_blocks * blocks->block_samples *
+		blocks->unitsize);
+
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	base = 0;
+	for (threads = 1; ; threads = MIN(threads * 2, max_threads)) {
+		start = srtest_now();
+		ret = sr_session_blocks_load(blocks, 0, blocks->num_blocks, buf,
+				threads);
+		t = srtest_now() - start;
+		if (ret != SR_OK) {
+			fprintf(stderr, "Failed to load %s.\n", path);
+			break;
+		}
+		if (threads == 1)
+			base = t;
+		printf("%3d threads  %8.1f MB/s  %8.1f Msamples/s  x%.2f\n",
+		       threads, blocks->total_samples * blocks->unitsize / t * 1e-6,
+		       blocks->total_samples / t * 1e-6, base / t);
+		if (threads >= max_threads)
+			break;
+	}
+
+	free(buf);
+close:
+	sr_session_blocks_unref(blocks);
+done:
+	sr_exit(ctx);
+	if (path == filename)
+		unlink(filename);
+
+	return ret == SR_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
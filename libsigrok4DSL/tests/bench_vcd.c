@@ -0,0 +1,133 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Import throughput of the VCD input module.
+ * Not run by "make check", start it by hand: ./bench_vcd [file.vcd]
+ * Without a file, a simulator-like dump is generated in the temp directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define NUM_PROBES 16
+#define NUM_STEPS (4 * 1024 * 1024)
+
+static uint64_t samples, packets;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		samples += logic->length / logic->unitsize;
+		packets++;
+	}
+}
+
+/* Mostly single steps with a few idle periods, as written by HDL simulators. */
+static int generate(char *filename)
+{
+	static const unsigned int gaps[] = {1, 1, 1, 2, 5, 1000};
+	uint64_t t = 0;
+	unsigned int i, step;
+	FILE *file;
+
+	if (!(file = srtest_tmpfile(filename, 0)))
+		return -1;
+
+	fprintf(file, "$timescale 1ps $end\n$scope module bench $end\n");
+	for (i = 0; i < NUM_PROBES; i++)
+		fprintf(file, "$var wire 1 %c%c sig%u $end\n",
+			'!' + i, '!' + i, i);
+	fprintf(file, "$upscope $end\n$enddefinitions $end\n");
+
+	for (step = 0; step < NUM_STEPS; step++) {
+		t += gaps[rand() % (sizeof(gaps) / sizeof(gaps[0]))];
+		i = rand() % NUM_PROBES;
+		fprintf(file, "#%llu\n%c%c%c\n", (unsigned long long)t,
+			(rand() & 1) ? '1' : '0', '!' + i, '!' + i);
+	}
+
+	return fclose(file);
+}
+
+int main(int argc, char **argv)
+{
+	char filename[] = "/tmp/bench_vcd_XXXXXX";
+	struct sr_input_format **inputs;
+	struct sr_input in;
+	struct sr_context *ctx;
+	struct stat st;
+	const char *path;
+	double start, t;
+	int i, ret;
+
+	if (!(path = srtest_bench_file(argc, argv, filename, generate)))
+		return EXIT_FAILURE;
+
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "Failed to open %s.\n", path);
+		return EXIT_FAILURE;
+	}
+
+	sr_init(&ctx);
+	sr_session_new();
+	sr_session_datafeed_callback_add(datafeed_in, NULL);
+
+	inputs = sr_input_list();
+	for (i = 0; inputs[i]; i++)
+		if (!strcmp(inputs[i]->id, "vcd"))
+			break;
+
+	memset(&in, 0, sizeof(in));
+	in.format = inputs[i];
+	ret = SR_ERR;
+	if (in.format && in.format->format_match(path) &&
+	    in.format->init(&in, path) == SR_OK) {
+		start = srtest_now();
+		ret = in.format->loadfile(&in, path);
+		t = srtest_now() - start;
+	}
+
+	if (ret == SR_OK)
+		printf("%8.1f MB/s  %8.1f Msamples/s  (%llu samples, %llu packets)\n",
+		       st.st_size / t * 1e-6, samples / t * 1e-6,
+		       (unsigned long long)samples, (unsigned long long)packets);
+	else
+		fprintf(stderr, "Failed to import %s.\n", path);
+
+	sr_session_destroy();
+	sr_exit(ctx);
+	if (path == filename)
+		unlink(filename);
+
+	return ret == SR_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
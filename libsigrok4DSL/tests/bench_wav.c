@@ -0,0 +1,231 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Import throughput of the WAV input module for every sample format, the
+ * samples are converted where the frontend would put them.
+ * Not run by "make check", start it by hand: ./bench_wav [file.wav]
+ * Without a file, a stereo recording of each format is generated in the
+ * temp directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define NUM_CHANNELS 2
+#define NUM_FRAMES (16 * 1024 * 1024)
+
+static const struct {
+	const char *name;
+	int tag;
+	int bits;
+} formats[] = {
+	{"u8", 1, 8},
+	{"s16", 1, 16},
+	{"s24", 1, 24},
+	{"s32", 1, 32},
+	{"f32", 3, 32},
+};
+
+static uint16_t *samples;
+static uint64_t num_samples, capacity;
+
+static void put_le(uint8_t *p, uint64_t v, int size)
+{
+	while (size--) {
+		*p++ = v;
+		v >>= 8;
+	}
+}
+
+/* Like a snapshot of the frontend, keeps the samples of all packets. */
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog_pcm *pcm;
+	const struct sr_datafeed_analog *analog;
+	uint64_t count;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_ANALOG_PCM) {
+		pcm = packet->payload;
+		count = MIN(pcm->num_samples * g_slist_length(pcm->probes),
+			    capacity - num_samples);
+		sr_pcm_to_analog(pcm->format, pcm->map->data,
+				 samples + num_samples, count);
+		num_samples += count;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		count = MIN((uint64_t)analog->num_samples *
+			    g_slist_length(analog->probes), capacity - num_samples);
+		memcpy(samples + num_samples, analog->data,
+		       count * sizeof(uint16_t));
+		num_samples += count;
+	}
+}
+
+/* A sine on every channel, at a different frequency each. */
+static int generate(char *filename, int tag, int bits)
+{
+	const int size = bits / 8;
+	const uint64_t data_length = (uint64_t)NUM_FRAMES * NUM_CHANNELS * size;
+	uint8_t header[44], *buf, *p;
+	uint64_t i;
+	double v;
+	float f;
+	FILE *file;
+	int ch, ret;
+
+	if (!(file = srtest_tmpfile(filename, 4)))
+		return -1;
+
+	memcpy(header, "RIFF", 4);
+	put_le(header + 4, 36 + data_length, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put_le(header + 16, 16, 4);
+	put_le(header + 20, tag, 2);
+	put_le(header + 22, NUM_CHANNELS, 2);
+	put_le(header + 24, 1000000, 4);
+	put_le(header + 28, 1000000 * NUM_CHANNELS * size, 4);
+	put_le(header + 32, NUM_CHANNELS * size, 2);
+	put_le(header + 34, bits, 2);
+	memcpy(header + 36, "data", 4);
+	put_le(header + 40, data_length, 4);
+
+	if (!(buf = malloc(data_length))) {
+		fclose(file);
+		return -1;
+	}
+	for (i = 0, p = buf; i < NUM_FRAMES; i++) {
+		for (ch = 0; ch < NUM_CHANNELS; ch++, p += size) {
+			v = sin(i * 0.001 * (ch + 1)) * 0.9;
+			if (tag == 3) {
+				f = v;
+				memcpy(p, &f, size);
+			} else if (bits == 8) {
+				*p = 128 + (int)(v * 127);
+			} else {
+				put_le(p, (int64_t)(v * (1ULL << (bits - 1))), size);
+			}
+		}
+	}
+
+	ret = fwrite(header, sizeof(header), 1, file) == 1 &&
+		fwrite(buf, data_length, 1, file) == 1 ? 0 : -1;
+	free(buf);
+	if (fclose(file) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+static int import(struct sr_input_format *format, const char *path,
+		  const char *name)
+{
+	struct sr_input in;
+	struct stat st;
+	double start, t;
+	int ret;
+
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "Failed to open %s.\n", path);
+		return SR_ERR;
+	}
+
+	memset(&in, 0, sizeof(in));
+	in.format = format;
+	if (!format->format_match(path) || format->init(&in, path) != SR_OK) {
+		fprintf(stderr, "Unsupported file %s.\n", path);
+		return SR_ERR;
+	}
+
+	num_samples = 0;
+	start = srtest_now();
+	ret = format->loadfile(&in, path);
+	t = srtest_now() - start;
+
+	if (ret == SR_OK)
+		printf("%-4s %8.1f MB/s  %8.1f Msamples/s  (%llu samples)\n",
+		       name, st.st_size / t * 1e-6, num_samples / t * 1e-6,
+		       (unsigned long long)num_samples);
+	else
+		fprintf(stderr, "Failed to import %s.\n", path);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	char filename[] = "/tmp/bench_wav_XXXXXX.wav";
+	struct sr_input_format **inputs;
+	struct sr_context *ctx;
+	unsigned int f;
+	int i, ret;
+
+	/* Fault the pages in, so that the first run is not penalized */
+	capacity = (uint64_t)NUM_FRAMES * NUM_CHANNELS;
+	if (!(samples = malloc(capacity * sizeof(uint16_t))))
+		return EXIT_FAILURE;
+	memset(samples, 0, capacity * sizeof(uint16_t));
+
+	sr_init(&ctx);
+	sr_session_new();
+	sr_session_datafeed_callback_add(datafeed_in, NULL);
+
+	inputs = sr_input_list();
+	for (i = 0; inputs[i]; i++)
+		if (!strcmp(inputs[i]->id, "wav"))
+			break;
+
+	ret = SR_ERR;
+	if (!inputs[i]) {
+		fprintf(stderr, "No WAV input module.\n");
+	} else if (argc > 1) {
+		ret = import(inputs[i], argv[1], "file");
+	} else {
+		for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+			strcpy(filename, "/tmp/bench_wav_XXXXXX.wav");
+			if (generate(filename, formats[f].tag,
+				     formats[f].bits) != 0) {
+				fprintf(stderr, "Failed to write %s.\n", filename);
+				ret = SR_ERR;
+				break;
+			}
+			ret = import(inputs[i], filename, formats[f].name);
+			unlink(filename);
+			if (ret != SR_OK)
+				break;
+		}
+	}
+
+	sr_session_destroy();
+	sr_exit(ctx);
+	free(samples);
+
+	return ret == SR_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "../libsigrok.h"
 #include "lib.h"
@@ -58,6 +59,67 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+/* Check whether the demo driver finds as many devices as it's asked to. */
+START_TEST(test_demo_device_count)
+{
+	struct sr_dev_driver *driver;
+	struct sr_config src;
+	GSList *options, *devices;
+
+	driver = srtest_driver_get("virtual-demo");
+	srtest_driver_init(sr_ctx, driver);
+
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(g_slist_length(devices) == 1);
+	g_slist_free(devices);
+
+	src.key = SR_CONF_DEVICE_COUNT;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(3));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	fail_unless(g_slist_length(devices) == 3);
+	fail_unless(devices->data != devices->next->data);
+	g_slist_free(devices);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+}
+END_TEST
+
+/* Check whether the demo driver's logic patterns can be set up. */
+START_TEST(test_demo_patterns)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	GVariant *gvar;
+
+	driver = srtest_driver_get("virtual-demo");
+	srtest_driver_init(sr_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL);
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	fail_unless(sr_config_set(sdi, NULL, NULL, SR_CONF_PATTERN_MODE,
+			g_variant_new_string("I2C")) == SR_OK);
+	fail_unless(sr_config_set(sdi, NULL, NULL, SR_CONF_PATTERN_MODE,
+			g_variant_new_string("CAN")) != SR_OK);
+	fail_unless(sr_config_get(driver, sdi, NULL, NULL,
+			SR_CONF_PATTERN_MODE, &gvar) == SR_OK);
+	fail_unless(!strcmp(g_variant_get_string(gvar, NULL), "I2C"));
+	g_variant_unref(gvar);
+
+	fail_unless(sr_config_set(sdi, NULL, NULL, SR_CONF_PATTERN_BITRATE,
+			g_variant_new_uint64(0)) != SR_OK);
+	fail_unless(sr_config_set(sdi, NULL, NULL, SR_CONF_PATTERN_SEED,
+			g_variant_new_uint64(42)) == SR_OK);
+	fail_unless(sr_config_get(driver, sdi, NULL, NULL,
+			SR_CONF_PATTERN_SEED, &gvar) == SR_OK);
+	fail_unless(g_variant_get_uint64(gvar) == 42);
+	g_variant_unref(gvar);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -88,6 +150,8 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, setup, teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+	tcase_add_test(tc, test_demo_device_count);
+	tcase_add_test(tc, test_demo_patterns);
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
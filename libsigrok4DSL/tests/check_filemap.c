@@ -0,0 +1,109 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+#define FILE_SIZE (3 * 4096)
+
+static char filename[32];
+
+static void write_file(void)
+{
+	uint8_t buf[FILE_SIZE];
+	int fd, i;
+
+	for (i = 0; i < FILE_SIZE; i++)
+		buf[i] = i * 7;
+
+	strcpy(filename, "/tmp/check_filemap_XXXXXX");
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "Failed to create %s.", filename);
+	fail_unless(write(fd, buf, FILE_SIZE) == FILE_SIZE);
+	close(fd);
+}
+
+/* A region is mapped from any offset, and the bytes past its end can be
+ * read as padding even if the file ends on a page boundary. */
+START_TEST(test_file_map_region)
+{
+	static const uint64_t offsets[] = {0, 1, 100, 4096, 4097};
+	struct sr_file_map *map;
+	uint64_t i, length, pad;
+	unsigned int o;
+	int ret;
+
+	write_file();
+
+	for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+		length = FILE_SIZE - offsets[o];
+		ret = sr_file_map_new(filename, offsets[o], length, &map);
+		fail_unless(ret == SR_OK, "sr_file_map_new() failed: %d.", ret);
+		fail_unless(map->length == length);
+		for (i = 0; i < length; i++)
+			fail_unless(map->data[i] == (uint8_t)((offsets[o] + i) * 7),
+				    "Wrong byte at offset %llu.",
+				    (unsigned long long)(offsets[o] + i));
+		memcpy(&pad, map->data + length, sizeof(pad));
+		fail_unless(pad == 0);
+		fail_unless(map->refcount == 1);
+		fail_unless(sr_file_map_ref(map) == map);
+		sr_file_map_unref(map);
+		sr_file_map_unref(map);
+	}
+
+	unlink(filename);
+}
+END_TEST
+
+START_TEST(test_file_map_invalid)
+{
+	struct sr_file_map *map;
+
+	write_file();
+
+	fail_unless(sr_file_map_new(filename, 0, 0, &map) == SR_ERR_ARG);
+	fail_unless(sr_file_map_new(filename, 1, FILE_SIZE, &map) == SR_ERR);
+	fail_unless(sr_file_map_new(filename, FILE_SIZE + 1, 1, &map) == SR_ERR);
+	fail_unless(sr_file_map_new("/nonexistent", 0, 1, &map) == SR_ERR);
+	sr_file_map_unref(NULL);
+
+	unlink(filename);
+}
+END_TEST
+
+Suite *suite_filemap(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("filemap");
+
+	tc = tcase_create("map");
+	tcase_add_test(tc, test_file_map_region);
+	tcase_add_test(tc, test_file_map_invalid);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,177 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+#define NUM_SAMPLES 1003
+
+static const uint64_t masks[] = {
+	0x1, 0x80, 0xff, 0x0f0f, 0xaaaa, 0x8001, 0x7ffe,
+	0xf0f0f0, 0x80000001, 0xdeadbeef, 0x0123456789abcdefULL,
+	0xffffffffffffffffULL,
+};
+
+static uint64_t gather_ref(uint64_t v, uint64_t mask)
+{
+	uint64_t out = 0;
+	unsigned int bit, out_bit = 0;
+
+	for (bit = 0; bit < 64; bit++)
+		if (mask & (UINT64_C(1) << bit))
+			out |= ((v >> bit) & 1) << out_bit++;
+	return out;
+}
+
+static unsigned int popcount(uint64_t v)
+{
+	unsigned int n = 0;
+
+	for (; v; v &= v - 1)
+		n++;
+	return n;
+}
+
+static void check_method(int method)
+{
+	struct sr_bitgather bg;
+	uint8_t in[NUM_SAMPLES * 8], out[NUM_SAMPLES * 8];
+	unsigned int in_unitsize, out_unitsize, m, i;
+	uint64_t mask, v, o;
+	int ret;
+
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = rand();
+
+	for (in_unitsize = 1; in_unitsize <= 8; in_unitsize++) {
+		for (m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+			mask = masks[m];
+			if (in_unitsize < 8)
+				mask &= (UINT64_C(1) << (in_unitsize * 8)) - 1;
+			out_unitsize = (popcount(mask) + 7) / 8;
+			if (out_unitsize == 0)
+				out_unitsize = 1;
+
+			ret = sr_bitgather_init(&bg, mask, in_unitsize,
+						out_unitsize, method);
+			if (ret == SR_ERR_NA)
+				return;
+			fail_unless(ret == SR_OK, "sr_bitgather_init() failed: %d.", ret);
+
+			memset(out, 0, sizeof(out));
+			sr_bitgather_run(&bg, in, out, NUM_SAMPLES);
+			sr_bitgather_cleanup(&bg);
+
+			for (i = 0; i < NUM_SAMPLES; i++) {
+				v = o = 0;
+				memcpy(&v, in + i * in_unitsize, in_unitsize);
+				memcpy(&o, out + i * out_unitsize, out_unitsize);
+				fail_unless(o == gather_ref(v, mask),
+					    "Method %d, unit size %d, mask 0x%llx: "
+					    "sample %d is 0x%llx.", method,
+					    in_unitsize, (unsigned long long)mask,
+					    i, (unsigned long long)o);
+			}
+		}
+	}
+}
+
+/* Check every method against a bit by bit reference. */
+START_TEST(test_bitgather_methods)
+{
+	check_method(SR_BITGATHER_AUTO);
+	check_method(SR_BITGATHER_SHIFT);
+	check_method(SR_BITGATHER_TABLE);
+	check_method(SR_BITGATHER_PEXT);
+}
+END_TEST
+
+/* Check whether too many bits for the output unit size are rejected. */
+START_TEST(test_bitgather_too_many_bits)
+{
+	struct sr_bitgather bg;
+	int ret;
+
+	ret = sr_log_loglevel_set(SR_LOG_NONE);
+	fail_unless(ret == SR_OK, "sr_log_loglevel_set() failed: %d.", ret);
+
+	ret = sr_bitgather_init(&bg, 0x1ff, 2, 1, SR_BITGATHER_AUTO);
+	fail_unless(ret == SR_ERR_ARG, "sr_bitgather_init() should have failed.");
+}
+END_TEST
+
+/*
+ * Check sr_filter_probes() with probes in ascending order (gathered) and
+ * in any other order (permuted bit by bit).
+ */
+START_TEST(test_filter_probes)
+{
+	static const int ascending[] = {1, 4, 5, 9, 15};
+	static const int permuted[] = {9, 1, 15};
+	const uint16_t in[] = {0x8212, 0xffff, 0x0000, 0x0200};
+	const uint8_t expected_ascending[] = {0x1b, 0x1f, 0x00, 0x08};
+	const uint8_t expected_permuted[] = {0x07, 0x07, 0x00, 0x01};
+	GArray *probes;
+	uint8_t *out;
+	uint64_t length;
+	int ret;
+
+	probes = g_array_new(FALSE, FALSE, sizeof(int));
+	g_array_append_vals(probes, ascending, 5);
+	ret = sr_filter_probes(2, 1, probes, (const uint8_t *)in, sizeof(in),
+			       &out, &length);
+	fail_unless(ret == SR_OK, "sr_filter_probes() failed: %d.", ret);
+	fail_unless(length == 4);
+	fail_unless(!memcmp(out, expected_ascending, 4));
+	g_free(out);
+	g_array_free(probes, TRUE);
+
+	probes = g_array_new(FALSE, FALSE, sizeof(int));
+	g_array_append_vals(probes, permuted, 3);
+	ret = sr_filter_probes(2, 1, probes, (const uint8_t *)in, sizeof(in),
+			       &out, &length);
+	fail_unless(ret == SR_OK, "sr_filter_probes() failed: %d.", ret);
+	fail_unless(length == 4);
+	fail_unless(!memcmp(out, expected_permuted, 4));
+	g_free(out);
+	g_array_free(probes, TRUE);
+}
+END_TEST
+
+Suite *suite_filter(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("filter");
+
+	tc = tcase_create("bitgather");
+	tcase_add_test(tc, test_bitgather_methods);
+	tcase_add_test(tc, test_bitgather_too_many_bits);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("filter_probes");
+	tcase_add_test(tc, test_filter_probes);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
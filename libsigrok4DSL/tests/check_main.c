@@ -24,6 +24,12 @@
 
 Suite *suite_core(void);
 Suite *suite_strutil(void);
+Suite *suite_filter(void);
+Suite *suite_filemap(void);
+Suite *suite_metrics(void);
+Suite *suite_pcm(void);
+Suite *suite_output(void);
+Suite *suite_session(void);
 Suite *suite_driver_all(void);
 
 int main(void)
@@ -38,6 +44,12 @@ int main(void)
 	/* Add all testsuites to the master suite. */
 	srunner_add_suite(srunner, suite_core());
 	srunner_add_suite(srunner, suite_strutil());
+	srunner_add_suite(srunner, suite_filter());
+	srunner_add_suite(srunner, suite_filemap());
+	srunner_add_suite(srunner, suite_metrics());
+	srunner_add_suite(srunner, suite_pcm());
+	srunner_add_suite(srunner, suite_output());
+	srunner_add_suite(srunner, suite_session());
 	srunner_add_suite(srunner, suite_driver_all());
 
 	srunner_run_all(srunner, CK_VERBOSE);
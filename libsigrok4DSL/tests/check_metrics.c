@@ -0,0 +1,176 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+#define NUM_THREADS 4
+#define THREAD_UPDATES 100000
+
+static struct sr_metric get(int id)
+{
+	struct sr_metric m[SR_METRIC_COUNT];
+
+	fail_unless(sr_metrics_get(m, SR_METRIC_COUNT) == SR_METRIC_COUNT);
+	return m[id];
+}
+
+START_TEST(test_counter)
+{
+	struct sr_metric m;
+
+	sr_metrics_reset();
+	sr_metric_add(SR_METRIC_USB_BYTES, 1000);
+	sr_metric_add(SR_METRIC_USB_BYTES, 24);
+	sr_metric_add(SR_METRIC_COUNT, 1);
+	sr_metric_add(-1, 1);
+
+	m = get(SR_METRIC_USB_BYTES);
+	fail_unless(!strcmp(m.name, "usb.bytes"));
+	fail_unless(m.type == SR_METRIC_COUNTER);
+	fail_unless(m.count == 1024);
+	fail_unless(get(SR_METRIC_USB_TRANSFERS).count == 0);
+}
+END_TEST
+
+/* Bucket n > 0 holds [2^(n-1), 2^n), the last one everything above. */
+START_TEST(test_histogram)
+{
+	struct sr_metric m;
+	int i;
+
+	sr_metrics_reset();
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, 0);
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, 1);
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, 2);
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, 3);
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, 4);
+	sr_metric_observe(SR_METRIC_FEED_MIPMAP, UINT64_C(1) << 40);
+
+	m = get(SR_METRIC_FEED_MIPMAP);
+	fail_unless(m.type == SR_METRIC_HISTOGRAM);
+	fail_unless(m.count == 6);
+	fail_unless(m.sum == 10 + (UINT64_C(1) << 40));
+	fail_unless(m.max == UINT64_C(1) << 40);
+	fail_unless(m.buckets[0] == 1);
+	fail_unless(m.buckets[1] == 1);
+	fail_unless(m.buckets[2] == 2);
+	fail_unless(m.buckets[3] == 1);
+	fail_unless(m.buckets[SR_METRIC_BUCKETS - 1] == 1);
+
+	/* 98 values of 100 and 2 of 5000. */
+	sr_metrics_reset();
+	for (i = 0; i < 98; i++)
+		sr_metric_observe(SR_METRIC_USB_CALLBACK, 100);
+	sr_metric_observe(SR_METRIC_USB_CALLBACK, 5000);
+	sr_metric_observe(SR_METRIC_USB_CALLBACK, 5000);
+	m = get(SR_METRIC_USB_CALLBACK);
+	fail_unless(sr_metric_percentile(&m, 0.5) == 127);
+	fail_unless(sr_metric_percentile(&m, 0.98) == 127);
+	fail_unless(sr_metric_percentile(&m, 0.99) == 5000);
+	fail_unless(sr_metric_percentile(&m, 1) == 5000);
+
+	m = get(SR_METRIC_USB_RESUBMIT_GAP);
+	fail_unless(sr_metric_percentile(&m, 0.5) == 0);
+	m = get(SR_METRIC_USB_BYTES);
+	fail_unless(sr_metric_percentile(&m, 0.5) == 0);
+}
+END_TEST
+
+START_TEST(test_reset_dump)
+{
+	char *dump;
+
+	sr_metric_add(SR_METRIC_USB_EMPTY, 3);
+	sr_metric_observe(SR_METRIC_SESSION_SEND, 10);
+	sr_metrics_reset();
+	fail_unless(get(SR_METRIC_USB_EMPTY).count == 0);
+	fail_unless(get(SR_METRIC_SESSION_SEND).max == 0);
+
+	sr_metric_add(SR_METRIC_USB_EMPTY, 3);
+	sr_metric_observe(SR_METRIC_SESSION_SEND, 10);
+	sr_metric_observe(SR_METRIC_SESSION_SEND, 30);
+	dump = sr_metrics_dump();
+	fail_unless(strstr(dump, "usb.empty 3\n") != NULL);
+	fail_unless(strstr(dump, "session.send_us count=2 mean=20 p50=15 "
+			   "p99=30 max=30\n") != NULL, "Got:\n%s", dump);
+	g_free(dump);
+}
+END_TEST
+
+static gpointer update_thread(gpointer data)
+{
+	int i;
+
+	(void)data;
+	for (i = 0; i < THREAD_UPDATES; i++) {
+		sr_metric_add(SR_METRIC_USB_BYTES, 2);
+		sr_metric_observe(SR_METRIC_FEED_LOCK_WAIT, i);
+	}
+
+	return NULL;
+}
+
+/* Updates from several threads at once are all counted. */
+START_TEST(test_threads)
+{
+	GThread *threads[NUM_THREADS];
+	struct sr_metric m;
+	uint64_t total;
+	int i;
+
+	sr_metrics_reset();
+	for (i = 0; i < NUM_THREADS; i++)
+		threads[i] = g_thread_new("metrics", update_thread, NULL);
+	for (i = 0; i < NUM_THREADS; i++)
+		g_thread_join(threads[i]);
+
+	fail_unless(get(SR_METRIC_USB_BYTES).count ==
+		    2 * NUM_THREADS * THREAD_UPDATES);
+	m = get(SR_METRIC_FEED_LOCK_WAIT);
+	fail_unless(m.count == NUM_THREADS * THREAD_UPDATES);
+	fail_unless(m.sum == (uint64_t)NUM_THREADS * THREAD_UPDATES *
+		    (THREAD_UPDATES - 1) / 2);
+	fail_unless(m.max == THREAD_UPDATES - 1);
+	for (total = 0, i = 0; i < SR_METRIC_BUCKETS; i++)
+		total += m.buckets[i];
+	fail_unless(total == m.count);
+}
+END_TEST
+
+Suite *suite_metrics(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("metrics");
+
+	tc = tcase_create("update");
+	tcase_add_test(tc, test_counter);
+	tcase_add_test(tc, test_histogram);
+	tcase_add_test(tc, test_reset_dump);
+	tcase_add_test(tc, test_threads);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
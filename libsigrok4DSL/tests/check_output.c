@@ -0,0 +1,323 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+#define SAMPLERATE 1000000
+#define BLOCK_SAMPLES (64 * 1024)
+/* Two full blocks and a partial one, sent in packets across the blocks. */
+#define NUM_SAMPLES (2 * BLOCK_SAMPLES + 1001)
+#define PACKET_SAMPLES 10007
+
+static uint64_t get_le(const uint8_t *p, int size)
+{
+	uint64_t v = 0;
+
+	while (size--)
+		v = v << 8 | p[size];
+	return v;
+}
+
+static void free_channels(struct sr_dev_inst *sdi)
+{
+	GSList *l;
+
+	for (l = sdi->channels; l; l = l->next)
+		g_free(l->data);
+	g_slist_free(sdi->channels);
+}
+
+/* The probes of a unitsize wide device, those in enabled[] enabled. */
+static void add_channels(struct sr_dev_inst *sdi, unsigned int unitsize,
+			 const int *enabled, int num_enabled)
+{
+	struct sr_channel *ch;
+	unsigned int i;
+	int j;
+
+	memset(sdi, 0, sizeof(struct sr_dev_inst));
+	sdi->mode = LOGIC;
+	for (i = 0; i < unitsize * 8; i++) {
+		ch = g_malloc0(sizeof(struct sr_channel));
+		ch->index = i;
+		ch->type = SR_CHANNEL_LOGIC;
+		ch->name = "P";
+		for (j = 0; j < num_enabled; j++)
+			if (enabled[j] == (int)i)
+				ch->enabled = TRUE;
+		sdi->channels = g_slist_append(sdi->channels, ch);
+	}
+}
+
+/* Channel n toggles about every 2^(n % 12) samples. */
+static uint8_t *gen_samples(unsigned int unitsize)
+{
+	uint8_t *data;
+	uint64_t value, i;
+	unsigned int ch;
+
+	data = g_malloc(NUM_SAMPLES * unitsize);
+	value = 0;
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		for (ch = 0; ch < unitsize * 8; ch++)
+			if ((rand() & ((1 << (ch % 12)) - 1)) == 0)
+				value ^= UINT64_C(1) << ch;
+		memcpy(data + i * unitsize, &value, unitsize);
+	}
+
+	return data;
+}
+
+static GString *run_output(const char *id, GHashTable *options,
+			   const struct sr_dev_inst *sdi, const uint8_t *data,
+			   unsigned int unitsize)
+{
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GString *out, *result;
+	uint64_t i, n;
+
+	fail_unless((omod = sr_output_find((char *)id)) != NULL);
+	fail_unless((o = sr_output_new(omod, options, sdi)) != NULL);
+	result = g_string_new(NULL);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	fail_unless(out == NULL);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	for (i = 0; i < NUM_SAMPLES; i += n) {
+		n = MIN(PACKET_SAMPLES, NUM_SAMPLES - i);
+		logic.length = n * unitsize;
+		logic.unitsize = unitsize;
+		logic.data = (uint8_t *)data + i * unitsize;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+		if (out) {
+			g_string_append_len(result, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	if (out) {
+		g_string_append_len(result, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+	sr_output_free(o);
+
+	return result;
+}
+
+static void check_planes(unsigned int unitsize, const int *enabled,
+			 int num_enabled)
+{
+	struct sr_dev_inst sdi;
+	const uint8_t *p, *plane, *entry;
+	uint8_t *data;
+	uint64_t header_size, num_blocks, b, s, toggles, levels, first, v;
+	GString *out;
+	int n, bit;
+
+	add_channels(&sdi, unitsize, enabled, num_enabled);
+	data = gen_samples(unitsize);
+	out = run_output("planes", NULL, &sdi, data, unitsize);
+	p = (const uint8_t *)out->str;
+
+	num_blocks = (NUM_SAMPLES + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+	header_size = 32 + 32 * num_enabled;
+	fail_unless(out->len == header_size + num_blocks *
+		    (num_enabled * BLOCK_SAMPLES / 8 + 16) + 24,
+		    "Unit size %d: %d bytes written.", unitsize, out->len);
+
+	fail_unless(!memcmp(p, "DSPLANES", 8));
+	fail_unless(get_le(p + 8, 4) == 1);
+	fail_unless(get_le(p + 12, 4) == (uint64_t)num_enabled);
+	fail_unless(get_le(p + 16, 8) == SAMPLERATE);
+	fail_unless(get_le(p + 24, 4) == BLOCK_SAMPLES);
+	fail_unless(get_le(p + 28, 4) == header_size);
+	for (n = 0; n < num_enabled; n++) {
+		fail_unless(get_le(p + 32 + 32 * n, 4) == (uint64_t)enabled[n]);
+		fail_unless(!strcmp((const char *)p + 36 + 32 * n, "P"));
+	}
+
+	for (b = 0; b < num_blocks; b++) {
+		toggles = levels = 0;
+		first = get_le(data + b * BLOCK_SAMPLES * unitsize, unitsize);
+		for (n = 0; n < num_enabled; n++) {
+			plane = p + header_size + (b * num_enabled + n) *
+				BLOCK_SAMPLES / 8;
+			if (first >> enabled[n] & 1)
+				levels |= UINT64_C(1) << n;
+			for (s = 0; s < BLOCK_SAMPLES; s++) {
+				bit = plane[s / 8] >> (s % 8) & 1;
+				if (b * BLOCK_SAMPLES + s >= NUM_SAMPLES) {
+					fail_unless(bit == 0);
+					continue;
+				}
+				v = get_le(data + (b * BLOCK_SAMPLES + s) *
+					   unitsize, unitsize);
+				fail_unless(bit == (int)(v >> enabled[n] & 1),
+					    "Unit size %d, channel %d, sample %d.",
+					    unitsize, n, b * BLOCK_SAMPLES + s);
+				if (bit != (int)(first >> enabled[n] & 1))
+					toggles |= UINT64_C(1) << n;
+			}
+		}
+
+		entry = p + header_size + num_blocks * num_enabled *
+			BLOCK_SAMPLES / 8 + b * 16;
+		fail_unless(get_le(entry, 8) == toggles);
+		fail_unless(get_le(entry + 8, 8) == levels);
+	}
+
+	fail_unless(get_le(p + out->len - 24, 8) == NUM_SAMPLES);
+	fail_unless(get_le(p + out->len - 16, 8) == num_blocks);
+	fail_unless(!memcmp(p + out->len - 8, "PLANEIDX", 8));
+
+	g_string_free(out, TRUE);
+	g_free(data);
+	free_channels(&sdi);
+}
+
+/* The packed samples take the vector paths for up to 16 channels. */
+START_TEST(test_planes)
+{
+	const int few[] = {0, 3, 4, 7, 12};
+	const int some[] = {1, 2, 5, 8, 9, 10, 13, 14, 15, 20, 31};
+	const int many[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+			    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,
+			    27, 28, 29, 30, 31};
+
+	check_planes(2, few, G_N_ELEMENTS(few));
+	check_planes(4, some, G_N_ELEMENTS(some));
+	check_planes(4, many, G_N_ELEMENTS(many));
+	check_planes(1, few, 4);
+}
+END_TEST
+
+/*
+ * Rows are written for the first sample and the changes of the enabled
+ * channels only, at any distance from each other and the packet starts.
+ */
+static void check_csv(gboolean sample_numbers)
+{
+	const int enabled[] = {0, 3, 9};
+	const uint64_t changes[] = {1, 2, 17, 18, 40, 41, 1000, 1001, 5000,
+				    PACKET_SAMPLES, PACKET_SAMPLES + 31,
+				    NUM_SAMPLES - 1};
+	struct sr_dev_inst sdi;
+	GHashTable *options;
+	GString *out, *expected;
+	uint16_t *data, value;
+	uint64_t i;
+	unsigned int c, n;
+	const char *rows;
+
+	add_channels(&sdi, 2, enabled, G_N_ELEMENTS(enabled));
+
+	/* The disabled channels keep toggling. */
+	data = g_malloc(NUM_SAMPLES * sizeof(uint16_t));
+	value = 0x0208;
+	expected = g_string_new(NULL);
+	for (i = 0, c = 0; i < NUM_SAMPLES; i++) {
+		if (c < G_N_ELEMENTS(changes) && changes[c] == i)
+			value ^= 1 << enabled[c++ % G_N_ELEMENTS(enabled)];
+		data[i] = value ^ (i & 0x1f0);
+		if (i > 0 && c == 0)
+			continue;
+		if (i > 0 && changes[c - 1] != i)
+			continue;
+		if (sample_numbers)
+			g_string_append_printf(expected, "%" PRIu64, i);
+		else
+			g_string_append_printf(expected, "%" PRIu64 ".%06" PRIu64,
+					       i / SAMPLERATE, i % SAMPLERATE);
+		for (n = 0; n < G_N_ELEMENTS(enabled); n++)
+			g_string_append_printf(expected, ",%d",
+					       value >> enabled[n] & 1);
+		g_string_append_c(expected, '\n');
+	}
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	if (sample_numbers)
+		g_hash_table_insert(options, g_strdup("timestamp"),
+			g_variant_ref_sink(g_variant_new_string("samples")));
+	out = run_output("csv", options, &sdi, (uint8_t *)data,
+			 sizeof(uint16_t));
+	g_hash_table_destroy(options);
+
+	/* Skip the comments and the column names. */
+	rows = out->str;
+	while (*rows == ';')
+		rows = strchr(rows, '\n') + 1;
+	fail_unless(!strncmp(rows, sample_numbers ? "Sample," : "Time(s),",
+			     sample_numbers ? 7 : 8));
+	rows = strchr(rows, '\n') + 1;
+	fail_unless(!strcmp(rows, expected->str), "Got:\n%s\nExpected:\n%s",
+		    rows, expected->str);
+
+	g_string_free(out, TRUE);
+	g_string_free(expected, TRUE);
+	g_free(data);
+	free_channels(&sdi);
+}
+
+START_TEST(test_csv_transitions)
+{
+	check_csv(FALSE);
+	check_csv(TRUE);
+}
+END_TEST
+
+Suite *suite_output(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output");
+
+	tc = tcase_create("planes");
+	tcase_add_test(tc, test_planes);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("csv");
+	tcase_add_test(tc, test_csv_transitions);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "../libsigrok.h"
+
+/* Long enough for the vector loops, with a tail left for the scalar ones. */
+#define COUNT 37
+
+static void check_format(int format, const uint8_t *src,
+			 const uint16_t *expected)
+{
+	uint16_t dst[COUNT + 1];
+	int i;
+
+	dst[COUNT] = 0x5555;
+	fail_unless(sr_pcm_to_analog(format, src, dst, COUNT) == SR_OK);
+	for (i = 0; i < COUNT; i++)
+		fail_unless(dst[i] == expected[i],
+			    "Format %d, sample %d: 0x%04x, expected 0x%04x.",
+			    format, i, dst[i], expected[i]);
+	fail_unless(dst[COUNT] == 0x5555, "Format %d wrote past the end.",
+		    format);
+}
+
+/* Every format spans the full scale, with the zero level at 0x8000. */
+START_TEST(test_pcm_to_analog)
+{
+	uint8_t src[COUNT * 4];
+	uint16_t expected[COUNT];
+	int32_t v;
+	float f;
+	int i;
+
+	for (i = 0; i < COUNT; i++) {
+		src[i] = i * 7;
+		expected[i] = (i * 7 & 0xFF) << 8;
+	}
+	check_format(SR_PCM_U8, src, expected);
+
+	for (i = 0; i < COUNT; i++) {
+		v = (i - COUNT / 2) * 1771;
+		src[i * 2] = v;
+		src[i * 2 + 1] = v >> 8;
+		expected[i] = (uint16_t)(v + 0x8000);
+	}
+	check_format(SR_PCM_S16LE, src, expected);
+
+	for (i = 0; i < COUNT; i++) {
+		v = (i - COUNT / 2) * 453377;
+		src[i * 3] = v;
+		src[i * 3 + 1] = v >> 8;
+		src[i * 3 + 2] = v >> 16;
+		expected[i] = (uint16_t)((v >> 8) + 0x8000);
+	}
+	check_format(SR_PCM_S24LE, src, expected);
+
+	for (i = 0; i < COUNT; i++) {
+		v = (i - COUNT / 2) * 116064321;
+		src[i * 4] = v;
+		src[i * 4 + 1] = v >> 8;
+		src[i * 4 + 2] = v >> 16;
+		src[i * 4 + 3] = v >> 24;
+		expected[i] = (uint16_t)((v >> 16) + 0x8000);
+	}
+	check_format(SR_PCM_S32LE, src, expected);
+
+	/* Out of range samples are clipped. */
+	for (i = 0; i < COUNT; i++) {
+		f = (i - COUNT / 2) / 16.0f;
+		memcpy(src + i * 4, &f, sizeof(f));
+		if (f <= -1.0f)
+			expected[i] = 0x0000;
+		else if (f >= 1.0f)
+			expected[i] = 0xFFFF;
+		else
+			expected[i] = (uint16_t)(f * 32767.5f + 32768.0f);
+	}
+	check_format(SR_PCM_FLOAT_LE, src, expected);
+}
+END_TEST
+
+START_TEST(test_pcm_sample_size)
+{
+	uint16_t dst[1];
+
+	fail_unless(sr_pcm_sample_size(SR_PCM_U8) == 1);
+	fail_unless(sr_pcm_sample_size(SR_PCM_S16LE) == 2);
+	fail_unless(sr_pcm_sample_size(SR_PCM_S24LE) == 3);
+	fail_unless(sr_pcm_sample_size(SR_PCM_S32LE) == 4);
+	fail_unless(sr_pcm_sample_size(SR_PCM_FLOAT_LE) == 4);
+	fail_unless(sr_pcm_sample_size(0) == 0);
+	fail_unless(sr_pcm_to_analog(0, dst, dst, 1) == SR_ERR_ARG);
+}
+END_TEST
+
+Suite *suite_pcm(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("pcm");
+
+	tc = tcase_create("convert");
+	tcase_add_test(tc, test_pcm_to_analog);
+	tcase_add_test(tc, test_pcm_sample_size);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
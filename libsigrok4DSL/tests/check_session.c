@@ -0,0 +1,345 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2013 DreamSourceLab <support@dreamsourcelab.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+#include <zip.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+
+#define UNITSIZE 3
+#define BLOCK_SAMPLES (1024 * 1024)
+#define NUM_SAMPLES (2 * BLOCK_SAMPLES + 12345)
+
+static uint64_t sample_at(uint64_t i)
+{
+	/* A Gray code, bit n toggles every 2^(n + 1) samples */
+	return (i ^ (i >> 1)) & 0xFFFFFF;
+}
+
+static uint64_t load(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | (uint64_t)p[2] << 16;
+}
+
+/* A capture appended in odd pieces reads back block by block, with the
+ * index and the summary of the whole capture. */
+START_TEST(test_writer_blocks)
+{
+	struct sr_dev_inst sdi;
+	struct sr_session_writer *writer;
+	struct sr_session_blocks *blocks;
+	struct zip *archive;
+	struct zip_file *zf;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	char filename[] = "/tmp/check_session_XXXXXX";
+	char *header;
+	uint8_t *buf;
+	uint64_t i, n, b, acc, prev, last;
+	int fd, ret;
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "Failed to create %s.", filename);
+	close(fd);
+
+	buf = malloc(NUM_SAMPLES * UNITSIZE);
+	fail_unless(buf != NULL);
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		buf[i * UNITSIZE] = sample_at(i);
+		buf[i * UNITSIZE + 1] = sample_at(i) >> 8;
+		buf[i * UNITSIZE + 2] = sample_at(i) >> 16;
+	}
+
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	ret = sr_session_writer_new(filename, &sdi, UNITSIZE, &writer);
+	fail_unless(ret == SR_OK, "sr_session_writer_new() failed: %d.", ret);
+	for (i = 0; i < NUM_SAMPLES; i += n) {
+		n = MIN(NUM_SAMPLES - i, 100003);
+		fail_unless(sr_session_writer_append(writer, buf + i * UNITSIZE,
+				n) == SR_OK);
+	}
+	fail_unless(sr_session_writer_finish(writer) == SR_OK);
+
+	/* The header names the container, which the session driver reads
+	 * the capture by. */
+	archive = zip_open(filename, 0, &ret);
+	fail_unless(archive != NULL, "Failed to open %s.", filename);
+	fail_unless(zip_stat(archive, "header", 0, &zs) == 0);
+	header = g_malloc(zs.size);
+	zf = zip_fopen_index(archive, zs.index, 0);
+	fail_unless(zf != NULL);
+	fail_unless(zip_fread(zf, header, zs.size) == (zip_int64_t)zs.size);
+	zip_fclose(zf);
+	zip_close(archive);
+	kf = g_key_file_new();
+	fail_unless(g_key_file_load_from_data(kf, header, zs.size, 0, NULL));
+	fail_unless(g_key_file_get_integer(kf, "header", "container", NULL) ==
+		    SR_SESSION_CONTAINER_BLOCKS);
+	g_key_file_free(kf);
+	g_free(header);
+
+	ret = sr_session_blocks_open(filename, "data", &blocks);
+	fail_unless(ret == SR_OK, "sr_session_blocks_open() failed: %d.", ret);
+	fail_unless(blocks->unitsize == UNITSIZE);
+	fail_unless(blocks->total_samples == NUM_SAMPLES);
+	fail_unless(blocks->num_blocks == 3);
+
+	memset(buf, 0, NUM_SAMPLES * UNITSIZE);
+	for (b = 0; b < blocks->num_blocks; b++)
+		fail_unless(sr_session_blocks_read(blocks, b,
+				buf + b * blocks->block_samples * UNITSIZE) == SR_OK);
+	for (i = 0; i < NUM_SAMPLES; i++)
+		fail_unless(load(buf + i * UNITSIZE) == sample_at(i),
+			    "Wrong sample %llu.", (unsigned long long)i);
+
+	for (b = 0; b < blocks->num_blocks; b++) {
+		last = MIN((b + 1) * blocks->block_samples, NUM_SAMPLES) - 1;
+		fail_unless(load(blocks->block_last + b * UNITSIZE) ==
+			    sample_at(last));
+	}
+
+	prev = 0;
+	for (i = 0; i < NUM_SAMPLES / SR_SESSION_SUMMARY_SAMPLES; i++) {
+		acc = 0;
+		for (n = 0; n < SR_SESSION_SUMMARY_SAMPLES; n++) {
+			acc |= prev ^ sample_at(i * SR_SESSION_SUMMARY_SAMPLES + n);
+			prev = sample_at(i * SR_SESSION_SUMMARY_SAMPLES + n);
+		}
+		fail_unless(load(blocks->summary + i * UNITSIZE) == acc,
+			    "Wrong summary %llu.", (unsigned long long)i);
+	}
+
+	sr_session_blocks_unref(blocks);
+	free(buf);
+	unlink(filename);
+}
+END_TEST
+
+/* An aborted capture leaves no file behind. */
+START_TEST(test_writer_abort)
+{
+	struct sr_dev_inst sdi;
+	struct sr_session_writer *writer;
+	char filename[] = "/tmp/check_session_XXXXXX";
+	uint8_t buf[UNITSIZE * 16];
+	int fd;
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "Failed to create %s.", filename);
+	close(fd);
+
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	memset(buf, 0x55, sizeof(buf));
+	fail_unless(sr_session_writer_new(filename, &sdi, UNITSIZE,
+			&writer) == SR_OK);
+	fail_unless(sr_session_writer_append(writer, buf, 16) == SR_OK);
+	sr_session_writer_abort(writer);
+	fail_unless(access(filename, F_OK) != 0);
+
+	fail_unless(sr_session_writer_new(filename, &sdi, 0,
+			&writer) == SR_ERR_ARG);
+	fail_unless(sr_session_writer_new(NULL, &sdi, UNITSIZE,
+			&writer) == SR_ERR_ARG);
+	sr_session_writer_abort(NULL);
+}
+END_TEST
+
+/* Saving over a file keeps a mapping of the old contents readable. */
+START_TEST(test_writer_replace)
+{
+	struct sr_dev_inst sdi;
+	struct sr_session_writer *writer;
+	struct sr_session_blocks *blocks;
+	struct sr_file_map *map;
+	char filename[] = "/tmp/check_session_XXXXXX";
+	uint8_t buf[4096];
+	unsigned int i;
+	int fd;
+
+	fd = mkstemp(filename);
+	fail_unless(fd >= 0, "Failed to create %s.", filename);
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7;
+	fail_unless(write(fd, buf, sizeof(buf)) == sizeof(buf));
+	close(fd);
+	fail_unless(sr_file_map_new(filename, 0, sizeof(buf), &map) == SR_OK);
+
+	memset(&sdi, 0, sizeof(sdi));
+	sdi.mode = LOGIC;
+	memset(buf, 0x55, sizeof(buf));
+	fail_unless(sr_session_writer_new(filename, &sdi, UNITSIZE,
+			&writer) == SR_OK);
+	fail_unless(sr_session_writer_append(writer, buf, 16) == SR_OK);
+	fail_unless(sr_session_writer_finish(writer) == SR_OK);
+
+	for (i = 0; i < sizeof(buf); i++)
+		fail_unless(map->data[i] == (uint8_t)(i * 7),
+			    "Wrong byte at offset %u.", i);
+	sr_file_map_unref(map);
+
+	fail_unless(sr_session_blocks_open(filename, "data",
+			&blocks) == SR_OK);
+	fail_unless(blocks->total_samples == 16);
+	sr_session_blocks_unref(blocks);
+	unlink(filename);
+}
+END_TEST
+
+static void datafeed(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+	(void)cb_data;
+}
+
+/* Subscribers start with the policy they ask for and stop when they
+ * unsubscribe or with the session. */
+START_TEST(test_subscribe)
+{
+	struct sr_datafeed_subscription *subscription;
+
+	fail_unless(sr_session_datafeed_subscribe(datafeed, NULL, 4,
+			SR_BUS_BLOCK) == SR_ERR_BUG);
+
+	fail_unless(sr_session_new() != NULL);
+	fail_unless(sr_session_datafeed_subscribe(datafeed, NULL, 4,
+			SR_BUS_BLOCK) == SR_OK);
+	fail_unless(sr_session_datafeed_subscribe(datafeed, NULL, 1,
+			SR_BUS_DROP) == SR_OK);
+	fail_unless(sr_session_datafeed_subscribe(datafeed, NULL, 0,
+			SR_BUS_COALESCE) == SR_OK);
+	fail_unless(sr_session_datafeed_subscribe(NULL, NULL, 4,
+			SR_BUS_BLOCK) == SR_ERR_ARG);
+	fail_unless(sr_session_datafeed_subscribe(datafeed, NULL, 4,
+			SR_BUS_COALESCE + 1) == SR_ERR_ARG);
+	fail_unless(sr_session_datafeed_subscribe_dev(NULL, datafeed, NULL, 4,
+			SR_BUS_BLOCK, NULL) == SR_OK);
+	fail_unless(sr_session_datafeed_subscribe_dev(NULL, datafeed, NULL, 4,
+			SR_BUS_BLOCK, &subscription) == SR_OK);
+	fail_unless(sr_session_datafeed_unsubscribe(subscription) == SR_OK);
+	fail_unless(sr_session_datafeed_unsubscribe(subscription) ==
+		    SR_ERR_ARG);
+	fail_unless(sr_session_datafeed_unsubscribe(NULL) == SR_ERR_ARG);
+	fail_unless(sr_session_datafeed_callback_add(datafeed, NULL) == SR_OK);
+	fail_unless(sr_session_datafeed_callback_remove_all() == SR_OK);
+	fail_unless(sr_session_dev_remove(NULL) == SR_ERR_ARG);
+	fail_unless(sr_session_destroy() == SR_OK);
+}
+END_TEST
+
+#ifdef HAVE_LIBUSB_1_0
+#define USB_CALLS 5
+
+static struct sr_context *usb_sr_ctx;
+
+static int usb_dev_open(struct sr_dev_inst *sdi)
+{
+	(void)sdi;
+	return SR_OK;
+}
+
+/* Device n finishes after (n + 1) * USB_CALLS calls. */
+static int usb_receive(int fd, int revents, const struct sr_dev_inst *sdi)
+{
+	int *const calls = sdi->priv;
+
+	(void)fd;
+	(void)revents;
+
+	return ++*calls < (sdi->index + 1) * USB_CALLS;
+}
+
+static int usb_acquisition_start(const struct sr_dev_inst *sdi,
+		void *cb_data)
+{
+	(void)cb_data;
+	return usb_source_add(usb_sr_ctx, 10, usb_receive, sdi);
+}
+
+/* Devices polling libusb share its source, one of them finishing leaves
+ * it to the others. */
+START_TEST(test_usb_source_shared)
+{
+	struct sr_dev_driver driver;
+	struct sr_dev_inst sdi[2];
+	int calls[2];
+	int i;
+
+	fail_unless(sr_init(&usb_sr_ctx) == SR_OK);
+	fail_unless(sr_session_new() != NULL);
+
+	memset(&driver, 0, sizeof(driver));
+	driver.dev_open = usb_dev_open;
+	driver.dev_acquisition_start = usb_acquisition_start;
+	for (i = 0; i < 2; i++) {
+		memset(&sdi[i], 0, sizeof(sdi[i]));
+		sdi[i].driver = &driver;
+		sdi[i].index = i;
+		sdi[i].mode = LOGIC;
+		sdi[i].priv = &calls[i];
+		calls[i] = 0;
+		fail_unless(sr_session_dev_add(&sdi[i]) == SR_OK);
+	}
+
+	fail_unless(sr_session_start() == SR_OK);
+	fail_unless(sr_session_run() == SR_OK);
+	fail_unless(calls[0] == USB_CALLS, "Device 0 called %d times.",
+		    calls[0]);
+	fail_unless(calls[1] == 2 * USB_CALLS, "Device 1 called %d times.",
+		    calls[1]);
+
+	fail_unless(sr_session_destroy() == SR_OK);
+	fail_unless(sr_exit(usb_sr_ctx) == SR_OK);
+}
+END_TEST
+#endif
+
+Suite *suite_session(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("session");
+
+	tc = tcase_create("writer");
+	tcase_add_test(tc, test_writer_blocks);
+	tcase_add_test(tc, test_writer_abort);
+	tcase_add_test(tc, test_writer_replace);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("bus");
+	tcase_add_test(tc, test_subscribe);
+	suite_add_tcase(s, tc);
+
+#ifdef HAVE_LIBUSB_1_0
+	tc = tcase_create("usb");
+	tcase_add_test(tc, test_usb_source_shared);
+	suite_add_tcase(s, tc);
+#endif
+
+	return s;
+}
@@ -19,9 +19,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <check.h>
 #include "../libsigrok.h"
+#include "lib.h"
 
 /* Get a libsigrok driver by name. */
 struct sr_dev_driver *srtest_driver_get(const char *drivername)
@@ -79,7 +83,7 @@ void srtest_set_samplerate(struct sr_dev_driver *driver, uint64_t samplerate)
 	sdi = g_slist_nth_data(driver->priv, 0);
 
 	gvar = g_variant_new_uint64(samplerate);
-	ret = driver->config_set(SR_CONF_SAMPLERATE, gvar, sdi);
+	ret = driver->config_set(SR_CONF_SAMPLERATE, gvar, sdi, NULL, NULL);
 	g_variant_unref(gvar);
 
 	fail_unless(ret == SR_OK, "%s: Failed to set SR_CONF_SAMPLERATE: %d.",
@@ -96,7 +100,7 @@ uint64_t srtest_get_samplerate(struct sr_dev_driver *driver)
 
 	sdi = g_slist_nth_data(driver->priv, 0);
 
-	ret = driver->config_get(SR_CONF_SAMPLERATE, &gvar, sdi);
+	ret = driver->config_get(SR_CONF_SAMPLERATE, &gvar, sdi, NULL, NULL);
 	samplerate = g_variant_get_uint64(gvar);
 	g_variant_unref(gvar);
 
@@ -120,3 +124,51 @@ void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 	fail_unless(s == samplerate, "%s: Incorrect samplerate: %" PRIu64 ".",
 		    drivername, s);
 }
+
+/* Seconds on the monotonic clock, for timing the benchmarks. */
+double srtest_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Create a temp file from a template such as "/tmp/name_XXXXXX.ext", the
+ * X's are replaced with the name of the file. suffixlen is the length of
+ * what follows them. Returns the file opened for writing, or NULL.
+ */
+FILE *srtest_tmpfile(char *filename, int suffixlen)
+{
+	FILE *file;
+	int fd;
+
+	if ((fd = mkstemps(filename, suffixlen)) < 0)
+		return NULL;
+	if (!(file = fdopen(fd, "w"))) {
+		close(fd);
+		unlink(filename);
+	}
+
+	return file;
+}
+
+/*
+ * The input of a benchmark: the file given on its command line, or one
+ * written by the generator to the temp file template. The caller removes
+ * the latter when it is done. Returns NULL if it could not be written.
+ */
+const char *srtest_bench_file(int argc, char **argv, char *filename,
+			      int (*generate)(char *filename))
+{
+	if (argc > 1)
+		return argv[1];
+
+	if (generate(filename) != 0) {
+		fprintf(stderr, "Failed to write %s.\n", filename);
+		return NULL;
+	}
+
+	return filename;
+}
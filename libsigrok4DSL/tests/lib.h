@@ -21,6 +21,7 @@
 #ifndef LIBSIGROK_TESTS_LIB_H
 #define LIBSIGROK_TESTS_LIB_H
 
+#include <stdio.h>
 #include "../libsigrok.h"
 
 struct sr_dev_driver *srtest_driver_get(const char *drivername);
@@ -31,4 +32,10 @@ uint64_t srtest_get_samplerate(struct sr_dev_driver *driver);
 void srtest_check_samplerate(struct sr_context *sr_ctx, const char *drivername,
 			     uint64_t samplerate);
 
+/* Shared by the benchmarks. */
+double srtest_now(void);
+FILE *srtest_tmpfile(char *filename, int suffixlen);
+const char *srtest_bench_file(int argc, char **argv, char *filename,
+			      int (*generate)(char *filename));
+
 #endif